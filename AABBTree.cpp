@@ -0,0 +1,357 @@
+#include "AABBTree.h"
+
+using namespace DirectX;
+
+AABBTree::AABBTree(float margin) :
+	root(AABB_TREE_NONE),
+	firstFree(AABB_TREE_NONE),
+	leafCount(0),
+	margin(margin)
+{
+}
+
+int AABBTree::AllocateNode()
+{
+	int node;
+	if (firstFree != AABB_TREE_NONE)
+	{
+		node = firstFree;
+		firstFree = nodes[node].parent;
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.push_back({});
+	}
+
+	nodes[node].parent = AABB_TREE_NONE;
+	nodes[node].child1 = AABB_TREE_NONE;
+	nodes[node].child2 = AABB_TREE_NONE;
+	nodes[node].height = 0;
+	nodes[node].data = 0;
+	return node;
+}
+
+void AABBTree::FreeNode(int node)
+{
+	nodes[node].parent = firstFree;
+	nodes[node].height = -1;
+	firstFree = node;
+}
+
+void AABBTree::InsertLeaf(int leaf)
+{
+	if (root == AABB_TREE_NONE)
+	{
+		root = leaf;
+		nodes[root].parent = AABB_TREE_NONE;
+		return;
+	}
+
+	// Walk down toward the sibling that adds the least surface area
+	// - Creating a new parent here costs the combined area; going
+	//    deeper costs the growth of every node we pass through
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = Bounds::GetSurfaceArea(nodes[index].box);
+		float combinedArea = Bounds::GetSurfaceArea(Bounds::Merge(nodes[index].box, leafBox));
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int child)
+		{
+			float merged = Bounds::GetSurfaceArea(Bounds::Merge(leafBox, nodes[child].box));
+			if (!nodes[child].IsLeaf())
+				merged -= Bounds::GetSurfaceArea(nodes[child].box);
+			return merged + inheritanceCost;
+		};
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+		index = cost1 < cost2 ? child1 : child2;
+	}
+	int sibling = index;
+
+	// New parent for the sibling and the leaf
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Bounds::Merge(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == AABB_TREE_NONE)
+		root = newParent;
+	else if (nodes[oldParent].child1 == sibling)
+		nodes[oldParent].child1 = newParent;
+	else
+		nodes[oldParent].child2 = newParent;
+
+	RefitAncestors(newParent);
+}
+
+void AABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = AABB_TREE_NONE;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent == AABB_TREE_NONE)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	RefitAncestors(grandParent);
+}
+
+void AABBTree::RefitAncestors(int node)
+{
+	while (node != AABB_TREE_NONE)
+	{
+		int child1 = nodes[node].child1;
+		int child2 = nodes[node].child2;
+		nodes[node].box = Bounds::Merge(nodes[child1].box, nodes[child2].box);
+		nodes[node].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+
+		Rotate(node);
+		node = nodes[node].parent;
+	}
+}
+
+void AABBTree::Rotate(int a)
+{
+	// Try swapping one child of A with a grandchild under the other
+	// child, and keep the swap that shrinks that other child the most
+	// (A's own box can't change - it still holds the same leaves)
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+
+	int bestChild = AABB_TREE_NONE;		// Child of A that moves down
+	int bestGrandChild = AABB_TREE_NONE;	// Grandchild that moves up
+	float bestDiff = 0.0f;
+
+	auto consider = [&](int child, int other)
+	{
+		if (nodes[other].IsLeaf())
+			return;
+		int g1 = nodes[other].child1;
+		int g2 = nodes[other].child2;
+		float area = Bounds::GetSurfaceArea(nodes[other].box);
+
+		// child <-> g1 leaves other = child + g2, and vice versa
+		float diff1 = Bounds::GetSurfaceArea(Bounds::Merge(nodes[child].box, nodes[g2].box)) - area;
+		float diff2 = Bounds::GetSurfaceArea(Bounds::Merge(nodes[child].box, nodes[g1].box)) - area;
+		if (diff1 < bestDiff) { bestDiff = diff1; bestChild = child; bestGrandChild = g1; }
+		if (diff2 < bestDiff) { bestDiff = diff2; bestChild = child; bestGrandChild = g2; }
+	};
+	consider(b, c);
+	consider(c, b);
+
+	if (bestChild == AABB_TREE_NONE)
+		return;
+
+	// Swap the two subtrees
+	int other = bestChild == b ? c : b;
+	if (nodes[a].child1 == bestChild) nodes[a].child1 = bestGrandChild;
+	else nodes[a].child2 = bestGrandChild;
+	nodes[bestGrandChild].parent = a;
+
+	if (nodes[other].child1 == bestGrandChild) nodes[other].child1 = bestChild;
+	else nodes[other].child2 = bestChild;
+	nodes[bestChild].parent = other;
+
+	// Only "other" and A have new children
+	int o1 = nodes[other].child1;
+	int o2 = nodes[other].child2;
+	nodes[other].box = Bounds::Merge(nodes[o1].box, nodes[o2].box);
+	nodes[other].height = 1 + (nodes[o1].height > nodes[o2].height ? nodes[o1].height : nodes[o2].height);
+
+	int a1 = nodes[a].child1;
+	int a2 = nodes[a].child2;
+	nodes[a].height = 1 + (nodes[a1].height > nodes[a2].height ? nodes[a1].height : nodes[a2].height);
+}
+
+int AABBTree::Insert(const AABB& bounds, unsigned int data)
+{
+	int leaf = AllocateNode();
+	nodes[leaf].box.min = XMFLOAT3(bounds.min.x - margin, bounds.min.y - margin, bounds.min.z - margin);
+	nodes[leaf].box.max = XMFLOAT3(bounds.max.x + margin, bounds.max.y + margin, bounds.max.z + margin);
+	nodes[leaf].data = data;
+
+	InsertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void AABBTree::Remove(int proxy)
+{
+	if (proxy < 0 || proxy >= (int)nodes.size() || !nodes[proxy].IsLeaf() || nodes[proxy].height < 0)
+		return;
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	leafCount--;
+}
+
+bool AABBTree::Update(int proxy, const AABB& bounds)
+{
+	if (proxy < 0 || proxy >= (int)nodes.size() || !nodes[proxy].IsLeaf() || nodes[proxy].height < 0)
+		return false;
+
+	// Still inside the fat box - nothing to do
+	AABB fat = nodes[proxy].box;
+	if (Bounds::Contains(fat, bounds))
+		return false;
+
+	AABB newFat = {};
+	newFat.min = XMFLOAT3(bounds.min.x - margin, bounds.min.y - margin, bounds.min.z - margin);
+	newFat.max = XMFLOAT3(bounds.max.x + margin, bounds.max.y + margin, bounds.max.z + margin);
+
+	// A short move: refit the boxes above the leaf in place (with
+	// rotations to fix up anything that got worse)
+	if (Bounds::Overlaps(fat, bounds))
+	{
+		nodes[proxy].box = newFat;
+		RefitAncestors(nodes[proxy].parent);
+		return true;
+	}
+
+	// A long move: find it a new spot
+	RemoveLeaf(proxy);
+	nodes[proxy].box = newFat;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::Clear()
+{
+	nodes.clear();
+	root = AABB_TREE_NONE;
+	firstFree = AABB_TREE_NONE;
+	leafCount = 0;
+}
+
+RayHit AABBTree::RayCast(
+	XMFLOAT3 origin,
+	XMFLOAT3 direction,
+	float maxDistance,
+	const std::function<float(unsigned int data)>& exactTest)
+{
+	RayHit result = {};
+	result.distance = maxDistance;
+	if (root == AABB_TREE_NONE)
+		return result;
+
+	XMFLOAT3 inv(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	std::vector<int> stack;
+	stack.reserve(64);
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+
+		// Skip anything farther than the closest hit so far
+		float d = Bounds::RayDistance(origin, inv, nodes[node].box, result.distance);
+		if (d < 0.0f)
+			continue;
+
+		if (nodes[node].IsLeaf())
+		{
+			float t = exactTest ? exactTest(nodes[node].data) : d;
+			if (t >= 0.0f && t <= result.distance)
+			{
+				result.hit = true;
+				result.data = nodes[node].data;
+				result.distance = t;
+			}
+			continue;
+		}
+
+		stack.push_back(nodes[node].child1);
+		stack.push_back(nodes[node].child2);
+	}
+
+	return result;
+}
+
+void AABBTree::QueryAABB(const AABB& box, std::vector<unsigned int>& results)
+{
+	if (root == AABB_TREE_NONE)
+		return;
+
+	std::vector<int> stack;
+	stack.reserve(64);
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
+		if (!Bounds::Overlaps(box, nodes[node].box))
+			continue;
+
+		if (nodes[node].IsLeaf())
+		{
+			results.push_back(nodes[node].data);
+			continue;
+		}
+
+		stack.push_back(nodes[node].child1);
+		stack.push_back(nodes[node].child2);
+	}
+}
+
+unsigned int AABBTree::GetLeafCount()
+{
+	return leafCount;
+}
+
+unsigned int AABBTree::GetNodeCount()
+{
+	return leafCount > 0 ? leafCount * 2 - 1 : 0;
+}
+
+int AABBTree::GetHeight()
+{
+	return root == AABB_TREE_NONE ? 0 : nodes[root].height;
+}
+
+float AABBTree::GetTotalSurfaceArea()
+{
+	float total = 0.0f;
+	for (auto& node : nodes)
+		if (node.height > 0)
+			total += Bounds::GetSurfaceArea(node.box);
+	return total;
+}
+
+AABB AABBTree::GetFatBounds(int proxy)
+{
+	return nodes[proxy].box;
+}
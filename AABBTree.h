@@ -0,0 +1,89 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include <functional>
+
+#include "Bounds.h"
+
+#define AABB_TREE_NONE -1
+
+struct AABBTreeNode
+{
+	AABB box;				// Leaves: the item's bounds plus a margin
+	int parent;				// Also the next free node while on the free list
+	int child1;
+	int child2;
+	int height;				// 0 for leaves, -1 for free nodes
+	unsigned int data;
+
+	bool IsLeaf() const { return child1 == AABB_TREE_NONE; }
+};
+
+// Result of a ray cast against the tree
+struct RayHit
+{
+	bool hit;
+	unsigned int data;
+	float distance;
+};
+
+// --------------------------------------------------------
+// A dynamic bounding volume hierarchy over AABBs
+//
+// - Leaves hold "fat" boxes (the real bounds plus a margin),
+//    so small movements don't touch the tree at all
+// - Inserts pick the sibling with the cheapest surface area
+//    increase, and every insert/remove/refit walks back up
+//    applying tree rotations, which keeps the tree close to
+//    what a full rebuild would produce
+// - Nodes live in one flat array and refer to each other by
+//    index; freed nodes are recycled
+// --------------------------------------------------------
+class AABBTree
+{
+private:
+	std::vector<AABBTreeNode> nodes;
+	int root;
+	int firstFree;
+	unsigned int leafCount;
+	float margin;
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void RefitAncestors(int node);	// Recomputes boxes/heights upward, rotating as it goes
+	void Rotate(int node);
+
+public:
+	AABBTree(float margin = 0.1f);
+
+	// Proxies are leaf node indices; data is handed back by queries
+	int Insert(const AABB& bounds, unsigned int data);
+	void Remove(int proxy);
+	bool Update(int proxy, const AABB& bounds);	// Returns true if the tree changed
+	void Clear();
+
+	// Closest hit along the ray (direction need not be normalized;
+	// distances are in units of its length)
+	// - exactTest, if given, refines a leaf hit (for instance a test
+	//    against the object's oriented box) and returns a distance,
+	//    or a negative number for a miss
+	RayHit RayCast(
+		DirectX::XMFLOAT3 origin,
+		DirectX::XMFLOAT3 direction,
+		float maxDistance,
+		const std::function<float(unsigned int data)>& exactTest = nullptr);
+
+	// Appends the data of every leaf overlapping the box
+	void QueryAABB(const AABB& box, std::vector<unsigned int>& results);
+
+	// Getters
+	unsigned int GetLeafCount();
+	unsigned int GetNodeCount();
+	int GetHeight();
+	float GetTotalSurfaceArea();	// Of all internal nodes - lower is better
+	AABB GetFatBounds(int proxy);
+};
@@ -0,0 +1,243 @@
+#include "Animation.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+AnimationSystem::AnimationSystem(Pool<Transform>* transforms) :
+	paused(false),
+	transforms(transforms)
+{
+}
+
+int AnimationSystem::AddTrack(
+	TransformHandle target,
+	int channel,
+	int interpolation,
+	const std::vector<Keyframe>& keyframes)
+{
+	if (target.IsNull() || keyframes.empty())
+		return -1;
+
+	// Find the value range of the track so the keys can be quantized against it
+	XMVECTOR minV = XMLoadFloat3(&keyframes[0].value);
+	XMVECTOR maxV = minV;
+	for (auto& k : keyframes)
+	{
+		minV = XMVectorMin(minV, XMLoadFloat3(&k.value));
+		maxV = XMVectorMax(maxV, XMLoadFloat3(&k.value));
+	}
+	XMVECTOR extent = XMVectorSubtract(maxV, minV);
+
+	// Step between two neighboring quantized values (zero for a constant component)
+	XMFLOAT4 minF, stepF;
+	XMStoreFloat4(&minF, minV);
+	XMStoreFloat4(&stepF, XMVectorScale(extent, 1.0f / 65535.0f));
+	XMFLOAT3 extentF;
+	XMStoreFloat3(&extentF, extent);
+
+	float trackDuration = keyframes.back().time;
+
+	// Quantize and store the keys
+	unsigned int start = (unsigned int)keys.size();
+	for (auto& k : keyframes)
+	{
+		CompressedKey ck = {};
+		ck.time = trackDuration > 0.0f ?
+			(unsigned short)std::lround(std::clamp(k.time / trackDuration, 0.0f, 1.0f) * 65535.0f) : 0;
+
+		const float* v = &k.value.x;
+		const float* mn = &minF.x;
+		const float* ext = &extentF.x;
+		for (int c = 0; c < 3; c++)
+		{
+			ck.value[c] = ext[c] > 0.0f ?
+				(unsigned short)std::lround((v[c] - mn[c]) / ext[c] * 65535.0f) : 0;
+		}
+		keys.push_back(ck);
+	}
+
+	// Track header
+	keyStart.push_back(start);
+	keyCount.push_back((unsigned int)keyframes.size());
+	cursor.push_back(0);
+	duration.push_back(trackDuration);
+	rangeMin.push_back(minF);
+	rangeStep.push_back(stepF);
+	this->channel.push_back((unsigned char)channel);
+	this->interpolation.push_back((unsigned char)interpolation);
+	targets.push_back(target);
+
+	sampleKey.push_back(start);
+	sampleT.push_back(0.0f);
+	samples.push_back(XMFLOAT4(0, 0, 0, 0));
+
+	return (int)targets.size() - 1;
+}
+
+void AnimationSystem::Clear()
+{
+	keyStart.clear();
+	keyCount.clear();
+	cursor.clear();
+	duration.clear();
+	rangeMin.clear();
+	rangeStep.clear();
+	channel.clear();
+	interpolation.clear();
+	targets.clear();
+	keys.clear();
+	sampleKey.clear();
+	sampleT.clear();
+	samples.clear();
+}
+
+void AnimationSystem::Sample(float time)
+{
+	size_t trackCount = targets.size();
+
+	// Phase 1: find the pair of keys around the sample time for every track
+	// - Keys are compared in quantized time, so there's no per-key decode
+	// - The search starts at last frame's key, which is almost always right
+	for (size_t i = 0; i < trackCount; i++)
+	{
+		unsigned int n = keyCount[i];
+		const CompressedKey* k = &keys[keyStart[i]];
+
+		if (n < 2 || duration[i] <= 0.0f)
+		{
+			sampleKey[i] = keyStart[i];
+			sampleT[i] = 0.0f;
+			continue;
+		}
+
+		// Tracks loop, so wrap the time into the track
+		float local = std::fmod(time, duration[i]);
+		if (local < 0.0f) local += duration[i];
+		float qt = local / duration[i] * 65535.0f;
+
+		// Restart the search if we wrapped around (or time went backwards)
+		unsigned int c = cursor[i];
+		if (c > n - 2 || k[c].time > qt)
+			c = 0;
+		while (c < n - 2 && k[c + 1].time <= qt)
+			c++;
+
+		float span = (float)(k[c + 1].time - k[c].time);
+		float t = span > 0.0f ? (qt - k[c].time) / span : 0.0f;
+
+		cursor[i] = c;
+		sampleKey[i] = keyStart[i] + c;
+		sampleT[i] = std::clamp(t, 0.0f, 1.0f);
+	}
+
+	// Phase 2: decode and interpolate the keys
+	// - All math here is on XMVECTORs (SIMD), three channels at once
+	for (size_t i = 0; i < trackCount; i++)
+	{
+		XMVECTOR mn = XMLoadFloat4(&rangeMin[i]);
+		XMVECTOR step = XMLoadFloat4(&rangeStep[i]);
+
+		unsigned int first = keyStart[i];
+		unsigned int last = keyStart[i] + keyCount[i] - 1;
+		unsigned int k1 = sampleKey[i];
+		unsigned int k2 = std::min(k1 + 1, last);
+
+		// Dequantize a key: min + q * step
+		auto decode = [&](unsigned int idx)
+		{
+			const CompressedKey& k = keys[idx];
+			return XMVectorMultiplyAdd(
+				XMVectorSet((float)k.value[0], (float)k.value[1], (float)k.value[2], 0.0f),
+				step,
+				mn);
+		};
+
+		XMVECTOR result;
+		switch (interpolation[i])
+		{
+		case ANIM_INTERP_STEP:
+			result = decode(k1);
+			break;
+
+		case ANIM_INTERP_CUBIC:
+		{
+			// Neighbor keys are clamped at the ends of the track
+			unsigned int k0 = k1 > first ? k1 - 1 : first;
+			unsigned int k3 = std::min(k2 + 1, last);
+			result = XMVectorCatmullRom(decode(k0), decode(k1), decode(k2), decode(k3), sampleT[i]);
+			break;
+		}
+
+		case ANIM_INTERP_LINEAR:
+		default:
+			result = XMVectorLerp(decode(k1), decode(k2), sampleT[i]);
+			break;
+		}
+
+		XMStoreFloat4(&samples[i], result);
+	}
+}
+
+void AnimationSystem::Apply()
+{
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		// The target may have been removed since the track was added
+		Transform* target = transforms->Get(targets[i]);
+		if (!target)
+			continue;
+
+		XMFLOAT3 value(samples[i].x, samples[i].y, samples[i].z);
+
+		switch (channel[i])
+		{
+		case ANIM_CHANNEL_POSITION: target->SetPosition(value); break;
+		case ANIM_CHANNEL_ROTATION: target->SetRotation(value); break;
+		case ANIM_CHANNEL_SCALE: target->SetScale(value); break;
+		}
+	}
+}
+
+void AnimationSystem::Update(float time)
+{
+	if (paused)
+		return;
+
+	Sample(time);
+	Apply();
+}
+
+int AnimationSystem::GetTrackCount()
+{
+	return (int)targets.size();
+}
+
+size_t AnimationSystem::GetMemoryUsage()
+{
+	// Persistent track data only (not the per-frame scratch or samples)
+	size_t headerBytes =
+		sizeof(unsigned int) * 3 +		// keyStart, keyCount, cursor
+		sizeof(float) +					// duration
+		sizeof(XMFLOAT4) * 2 +			// rangeMin, rangeStep
+		sizeof(unsigned char) * 2 +		// channel, interpolation
+		sizeof(TransformHandle);
+
+	return headerBytes * targets.size() + sizeof(CompressedKey) * keys.size();
+}
+
+bool AnimationSystem::GetPaused()
+{
+	return paused;
+}
+
+const std::vector<DirectX::XMFLOAT4>& AnimationSystem::GetSamples()
+{
+	return samples;
+}
+
+void AnimationSystem::SetPaused(bool paused)
+{
+	this->paused = paused;
+}
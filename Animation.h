@@ -0,0 +1,84 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Resources.h"
+
+#define ANIM_CHANNEL_POSITION 0
+#define ANIM_CHANNEL_ROTATION 1	// Pitch, yaw, roll (radians) - matches Transform
+#define ANIM_CHANNEL_SCALE 2
+
+#define ANIM_INTERP_STEP 0
+#define ANIM_INTERP_LINEAR 1
+#define ANIM_INTERP_CUBIC 2		// Catmull-Rom through the keys
+
+// An uncompressed key, only used when adding a track
+struct Keyframe
+{
+	float time;
+	DirectX::XMFLOAT3 value;
+};
+
+// How keys are actually stored: time and value quantized to 16 bits
+// against the track's duration and value range (8 bytes instead of 16)
+struct CompressedKey
+{
+	unsigned short time;
+	unsigned short value[3];
+};
+
+class AnimationSystem
+{
+private:
+	// Per-track data, stored as parallel arrays so the sampling
+	// pass walks each array linearly
+	std::vector<unsigned int> keyStart;
+	std::vector<unsigned int> keyCount;
+	std::vector<unsigned int> cursor;			// Last key used, playback is usually coherent
+	std::vector<float> duration;
+	std::vector<DirectX::XMFLOAT4> rangeMin;		// Value dequantization: min + q * step
+	std::vector<DirectX::XMFLOAT4> rangeStep;
+	std::vector<unsigned char> channel;
+	std::vector<unsigned char> interpolation;
+	std::vector<TransformHandle> targets;
+
+	// Keys of every track, packed back to back
+	std::vector<CompressedKey> keys;
+
+	// Scratch from the key search phase (one entry per track)
+	std::vector<unsigned int> sampleKey;		// Index of the key at or before the sample time
+	std::vector<float> sampleT;					// 0-1 between that key and the next
+
+	// Output of the sampling pass (one entry per track)
+	std::vector<DirectX::XMFLOAT4> samples;
+
+	bool paused;
+	Pool<Transform>* transforms;	// Where the targets live
+
+public:
+	AnimationSystem(Pool<Transform>* transforms = &Resources::Transforms);
+
+	// Keys must be sorted by time and start at time 0; the last
+	// key's time is the track duration (tracks always loop)
+	int AddTrack(
+		TransformHandle target,
+		int channel,
+		int interpolation,
+		const std::vector<Keyframe>& keyframes);
+	void Clear();
+
+	// Batched passes over every track
+	void Sample(float time);	// Fills the samples array
+	void Apply();				// Writes samples into the target transforms (stale targets are skipped)
+	void Update(float time);	// Sample + Apply, unless paused
+
+	// Getters
+	int GetTrackCount();
+	size_t GetMemoryUsage();	// Bytes used by track headers and keys
+	bool GetPaused();
+	const std::vector<DirectX::XMFLOAT4>& GetSamples();
+
+	// Setters
+	void SetPaused(bool paused);
+};
@@ -0,0 +1,2176 @@
+#include "Benchmarks.h"
+#include "Animation.h"
+#include "GameEntity.h"
+#include "EntitySystems.h"
+#include "Octree.h"
+#include "AABBTree.h"
+#include "SceneFile.h"
+#include "WorldStreaming.h"
+#include "SceneGenerator.h"
+#include "SeededRandom.h"
+#include "LevelOfDetail.h"
+#include "SweepAndPrune.h"
+#include "ParticleSystem.h"
+#include "Culling.h"
+#include "Occlusion.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "Instancing.h"
+#include "LightClusters.h"
+#include "ObjectLights.h"
+#include "LightBudget.h"
+#include "FrameGraph.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Bounding boxes of a generated stress scene's entities
+	// (each entity's scale is the half size of its box)
+	std::vector<AABB> GenerateBoxes(int entityCount, int layout, float* worldHalf)
+	{
+		GeneratedScene scene;
+		SceneGenerator::Generate(SceneGenerator::DefaultSettings(entityCount, layout, 777), &scene);
+		*worldHalf = scene.boundsMax.x;
+
+		std::vector<AABB> boxes(entityCount);
+		for (int i = 0; i < entityCount; i++)
+			boxes[i] = Bounds::FromCenterExtents(scene.data.entities[i].position, scene.data.entities[i].scale);
+		return boxes;
+	}
+
+	// The previous shape of GameEntity: three shared_ptrs, with
+	// getters that return copies (an atomic refcount bump each)
+	class SharedPtrEntity
+	{
+	private:
+		std::shared_ptr<Mesh> mesh;
+		std::shared_ptr<Transform> transform;
+		std::shared_ptr<Material> material;
+
+	public:
+		SharedPtrEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
+			mesh(mesh), transform(std::make_shared<Transform>()), material(material) {}
+
+		std::shared_ptr<Mesh> GetMesh() { return mesh; }
+		std::shared_ptr<Transform> GetTransform() { return transform; }
+		std::shared_ptr<Material> GetMaterial() { return material; }
+	};
+}
+
+// --------------------------------------------------------
+// Samples trackCount animation tracks (16 keys each, mixed
+// channels and interpolation modes) for the given number
+// of frames
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunAnimationSampling(int trackCount, int frames)
+{
+	SeededRandom rng = { 12345 };
+
+	// One transform per track so writes don't all hit the same object
+	// (in a pool of our own, so the game's is left alone)
+	Pool<Transform> transformPool;
+	std::vector<TransformHandle> transforms;
+	AnimationSystem animations(&transformPool);
+	for (int i = 0; i < trackCount; i++)
+	{
+		transforms.push_back(transformPool.Emplace());
+
+		std::vector<Keyframe> keyframes;
+		for (int k = 0; k < 16; k++)
+		{
+			Keyframe key = {};
+			key.time = k * 0.25f;
+			key.value = XMFLOAT3(rng.Range(-10, 10), rng.Range(-10, 10), rng.Range(-10, 10));
+			keyframes.push_back(key);
+		}
+
+		animations.AddTrack(transforms.back(), i % 3, (i / 3) % 3, keyframes);
+	}
+
+	// Sampling only
+	Clock::time_point start = Clock::now();
+	for (int f = 0; f < frames; f++)
+		animations.Sample(f / 60.0f);
+	double sampleMs = ElapsedMs(start);
+
+	// Sampling and writing into the transforms
+	start = Clock::now();
+	for (int f = 0; f < frames; f++)
+		animations.Update(f / 60.0f);
+	double updateMs = ElapsedMs(start);
+
+	double totalSamples = (double)trackCount * frames;
+	size_t uncompressedKeyBytes = sizeof(Keyframe) * 16;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Tracks", (double)trackCount, "" });
+	results.push_back({ "Sample time per frame", sampleMs / frames, "ms" });
+	results.push_back({ "Samples per second", totalSamples / (sampleMs / 1000.0), "samples/s" });
+	results.push_back({ "Sample + apply per frame", updateMs / frames, "ms" });
+	results.push_back({ "Memory per channel", (double)animations.GetMemoryUsage() / trackCount, "bytes" });
+	results.push_back({ "Memory per channel (uncompressed keys)",
+		(double)(animations.GetMemoryUsage() - sizeof(CompressedKey) * 16 * trackCount) / trackCount + uncompressedKeyBytes, "bytes" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Walks entityCount entities the way Game::Draw() does
+// (material, world matrices and mesh of each), first with
+// shared_ptr members and then with pooled handles
+// - Uses the meshes and materials already in the pools
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunEntityIteration(int entityCount, int passes)
+{
+	std::vector<BenchmarkResult> results;
+	unsigned int meshCount = Resources::Meshes.Size();
+	unsigned int materialCount = Resources::Materials.Size();
+	if (meshCount == 0 || materialCount == 0)
+		return results;
+
+	// shared_ptr copies of the pooled meshes and materials for the old layout
+	std::vector<std::shared_ptr<Mesh>> sharedMeshes;
+	std::vector<std::shared_ptr<Material>> sharedMaterials;
+	for (unsigned int i = 0; i < meshCount; i++)
+		sharedMeshes.push_back(std::make_shared<Mesh>(Resources::Meshes[i]));
+	for (unsigned int i = 0; i < materialCount; i++)
+		sharedMaterials.push_back(std::make_shared<Material>(Resources::Materials[i]));
+
+	// Same entities in both layouts (the handle entities' transforms
+	// in a pool of our own, so the game's is left alone)
+	Pool<Transform> transformPool;
+	std::vector<SharedPtrEntity> sharedEntities;
+	std::vector<GameEntity> handleEntities;
+	sharedEntities.reserve(entityCount);
+	handleEntities.reserve(entityCount);
+	for (int i = 0; i < entityCount; i++)
+	{
+		sharedEntities.push_back(SharedPtrEntity(sharedMeshes[i % meshCount], sharedMaterials[i % materialCount]));
+		handleEntities.push_back(GameEntity(
+			Resources::Meshes.GetHandleAt(i % meshCount),
+			Resources::Materials.GetHandleAt(i % materialCount),
+			&transformPool));
+	}
+
+	// Keep the compiler from throwing the loops away
+	volatile float sink = 0.0f;
+
+	// Before: shared_ptr getters
+	Clock::time_point start = Clock::now();
+	for (int p = 0; p < passes; p++)
+	{
+		float checksum = 0.0f;
+		for (auto& e : sharedEntities)
+		{
+			std::shared_ptr<Material> material = e.GetMaterial();
+			XMFLOAT4 tint = material->GetColorTint();
+			XMFLOAT2 scale = material->GetScale();
+			XMFLOAT4X4 world = e.GetTransform()->GetRenderWorldMatrix();
+			XMFLOAT4X4 worldInvTranspose = e.GetTransform()->GetRenderWorldInverseTransposeMatrix();
+			checksum += tint.x + scale.x + world._41 + worldInvTranspose._11 + e.GetMesh()->GetIndexCount();
+		}
+		sink = sink + checksum;
+	}
+	double sharedMs = ElapsedMs(start) / passes;
+
+	// After: handles resolved through the pools
+	start = Clock::now();
+	for (int p = 0; p < passes; p++)
+	{
+		float checksum = 0.0f;
+		for (auto& e : handleEntities)
+		{
+			Material* material = e.GetMaterial();
+			XMFLOAT4 tint = material->GetColorTint();
+			XMFLOAT2 scale = material->GetScale();
+			Transform* transform = e.GetTransform();
+			XMFLOAT4X4 world = transform->GetRenderWorldMatrix();
+			XMFLOAT4X4 worldInvTranspose = transform->GetRenderWorldInverseTransposeMatrix();
+			checksum += tint.x + scale.x + world._41 + worldInvTranspose._11 + e.GetMesh()->GetIndexCount();
+		}
+		sink = sink + checksum;
+	}
+	double handleMs = ElapsedMs(start) / passes;
+
+	// Dense walk of the transform pool itself (what Game::Interpolate() does)
+	start = Clock::now();
+	for (int p = 0; p < passes; p++)
+	{
+		float checksum = 0.0f;
+		for (auto& t : transformPool)
+			checksum += t.GetRenderWorldMatrix()._41;
+		sink = sink + checksum;
+	}
+	double denseMs = ElapsedMs(start) / passes;
+
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "shared_ptr entities per pass", sharedMs, "ms" });
+	results.push_back({ "Handle entities per pass", handleMs, "ms" });
+	results.push_back({ "Speedup", sharedMs / handleMs, "x" });
+	results.push_back({ "Dense transform pool walk per pass", denseMs, "ms" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Runs the ECS systems over entityCount entities spread
+// across several archetypes, serially and in parallel
+// - Budget: 1M entities moved, spun, given world matrices
+//    and turned into a draw list in under 8 ms (half of a
+//    60 Hz frame) on the parallel path
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunECSUpdate(int entityCount, int frames)
+{
+	const double budgetMs = 8.0 * entityCount / 1000000.0;
+	const float dt = 1.0f / 60.0f;
+	const XMFLOAT3 boundsMin(-100, 0, -100);
+	const XMFLOAT3 boundsMax(100, 20, 100);
+
+	SeededRandom rng = { 2024 };
+	unsigned int meshCount = Resources::Meshes.Size();
+	unsigned int materialCount = Resources::Materials.Size();
+
+	// Mix of archetypes: mostly static props, some movers and
+	// spinners, and a few invisible entities that only move
+	const ComponentMask renderable = ComponentsOf<LocalTransform, WorldMatrix, MeshRenderer>();
+	const ComponentMask masks[] =
+	{
+		renderable,
+		renderable,
+		renderable,
+		renderable | ComponentsOf<Velocity>(),
+		renderable | ComponentsOf<Velocity>(),
+		renderable | ComponentsOf<AngularVelocity>(),
+		renderable | ComponentsOf<Velocity, AngularVelocity>(),
+		ComponentsOf<LocalTransform, Velocity>(),
+	};
+	const int maskCount = sizeof(masks) / sizeof(masks[0]);
+
+	World world;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < entityCount; i++)
+	{
+		Entity e = world.CreateEntity(masks[i % maskCount]);
+
+		LocalTransform* t = world.GetComponent<LocalTransform>(e);
+		t->position = XMFLOAT3(rng.Range(boundsMin.x, boundsMax.x), rng.Range(boundsMin.y, boundsMax.y), rng.Range(boundsMin.z, boundsMax.z));
+		t->scale = XMFLOAT3(1, 1, 1);
+
+		if (Velocity* v = world.GetComponent<Velocity>(e))
+			v->linear = XMFLOAT3(rng.Range(-2, 2), rng.Range(-2, 2), rng.Range(-2, 2));
+		if (AngularVelocity* a = world.GetComponent<AngularVelocity>(e))
+			a->pitchYawRoll = XMFLOAT3(0, rng.Range(-3, 3), 0);
+		if (MeshRenderer* r = world.GetComponent<MeshRenderer>(e))
+		{
+			if (meshCount > 0) r->mesh = Resources::Meshes.GetHandleAt(i % meshCount);
+			if (materialCount > 0) r->material = Resources::Materials.GetHandleAt(i % materialCount);
+		}
+	}
+	double createMs = ElapsedMs(start);
+
+	std::vector<DrawItem> drawList;
+	double moveMs = 0, spinMs = 0, matrixMs = 0, drawListMs = 0;
+
+	// Serial, as a baseline
+	start = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		Systems::Move(world, dt, boundsMin, boundsMax, false);
+		Systems::Spin(world, dt, false);
+		Systems::UpdateWorldMatrices(world, false);
+		Systems::BuildDrawList(world, drawList, false);
+	}
+	double serialMs = ElapsedMs(start) / frames;
+
+	// Parallel, timing each system
+	for (int f = 0; f < frames; f++)
+	{
+		start = Clock::now();
+		Systems::Move(world, dt, boundsMin, boundsMax);
+		moveMs += ElapsedMs(start);
+
+		start = Clock::now();
+		Systems::Spin(world, dt);
+		spinMs += ElapsedMs(start);
+
+		start = Clock::now();
+		Systems::UpdateWorldMatrices(world);
+		matrixMs += ElapsedMs(start);
+
+		start = Clock::now();
+		Systems::BuildDrawList(world, drawList);
+		drawListMs += ElapsedMs(start);
+	}
+	double parallelMs = (moveMs + spinMs + matrixMs + drawListMs) / frames;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Archetypes", (double)world.GetArchetypeCount(), "" });
+	results.push_back({ "Chunks", (double)world.GetChunkCount(), "" });
+	results.push_back({ "Memory", world.GetMemoryUsage() / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Create", createMs, "ms" });
+	results.push_back({ "Move", moveMs / frames, "ms" });
+	results.push_back({ "Spin", spinMs / frames, "ms" });
+	results.push_back({ "World matrices", matrixMs / frames, "ms" });
+	results.push_back({ "Draw list", drawListMs / frames, "ms" });
+	results.push_back({ "Draw list size", (double)drawList.size(), "items" });
+	results.push_back({ "Frame (serial)", serialMs, "ms" });
+	results.push_back({ "Frame (parallel)", parallelMs, "ms" });
+	results.push_back({ "Budget", budgetMs, "ms" });
+	results.push_back({ "Budget used", parallelMs / budgetMs * 100.0, "%" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Builds an octree over entityCount boxes, then each frame
+// moves 5% of them and runs frustum, box and sphere queries
+// - Boxes come from a generated scene with the given layout;
+//    the world grows with the count so density stays the same
+// - The frustum query is checked against a brute force scan
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunOctree(int entityCount, int frames, int layout)
+{
+	SeededRandom rng = { 777 };
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+
+	// Build, splitting down to cells about the size of the boxes
+	int depth = std::max(1, (int)std::floor(std::log2(worldHalf / 2.0f)));
+	Octree octree(XMFLOAT3(0, 0, 0), worldHalf, depth);
+	std::vector<int> items(entityCount);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < entityCount; i++)
+		items[i] = octree.Insert(boxes[i], i);
+	double buildMs = ElapsedMs(start);
+
+	// A camera at the edge of the world looking at its center
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, -worldHalf, 0), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, worldHalf);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, view * proj);
+	Frustum frustum = Bounds::FrustumFromMatrix(viewProj);
+
+	const int moverCount = entityCount / 20;
+	const int queriesPerFrame = 100;
+	std::vector<unsigned int> found;
+	double updateMs = 0, frustumMs = 0, aabbMs = 0, sphereMs = 0;
+	size_t frustumHits = 0, aabbHits = 0, sphereHits = 0;
+
+	for (int f = 0; f < frames; f++)
+	{
+		// Move a different 5% of the boxes every frame
+		start = Clock::now();
+		for (int m = 0; m < moverCount; m++)
+		{
+			int i = (m * 20 + f) % entityCount;
+			XMFLOAT3 offset(rng.Range(-0.5f, 0.5f), rng.Range(-0.5f, 0.5f), rng.Range(-0.5f, 0.5f));
+			XMStoreFloat3(&boxes[i].min, XMVectorAdd(XMLoadFloat3(&boxes[i].min), XMLoadFloat3(&offset)));
+			XMStoreFloat3(&boxes[i].max, XMVectorAdd(XMLoadFloat3(&boxes[i].max), XMLoadFloat3(&offset)));
+			octree.Update(items[i], boxes[i]);
+		}
+		updateMs += ElapsedMs(start);
+
+		start = Clock::now();
+		found.clear();
+		octree.QueryFrustum(frustum, found);
+		frustumMs += ElapsedMs(start);
+		frustumHits += found.size();
+
+		// Query volumes about the size of a room
+		start = Clock::now();
+		for (int q = 0; q < queriesPerFrame; q++)
+		{
+			XMFLOAT3 center(rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf));
+			found.clear();
+			octree.QueryAABB(Bounds::FromCenterExtents(center, XMFLOAT3(5, 5, 5)), found);
+			aabbHits += found.size();
+		}
+		aabbMs += ElapsedMs(start);
+
+		start = Clock::now();
+		for (int q = 0; q < queriesPerFrame; q++)
+		{
+			XMFLOAT3 center(rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf));
+			found.clear();
+			octree.QuerySphere(center, 5.0f, found);
+			sphereHits += found.size();
+		}
+		sphereMs += ElapsedMs(start);
+	}
+
+	// Brute force frustum test of every box, for comparison
+	start = Clock::now();
+	size_t bruteHits = 0;
+	for (auto& box : boxes)
+		if (Bounds::FrustumTest(frustum, box) != BOUNDS_OUTSIDE)
+			bruteHits++;
+	double bruteMs = ElapsedMs(start);
+
+	found.clear();
+	octree.QueryFrustum(frustum, found);
+
+	double totalQueries = (double)frames * queriesPerFrame;
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Depth", (double)depth, "" });
+	results.push_back({ "Nodes", (double)octree.GetNodeCount(), "" });
+	results.push_back({ "Memory", octree.GetMemoryUsage() / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Build", buildMs, "ms" });
+	results.push_back({ "Update 5% movers per frame", updateMs / frames, "ms" });
+	results.push_back({ "Frustum query", frustumMs / frames, "ms" });
+	results.push_back({ "Frustum query hits", (double)frustumHits / frames, "" });
+	results.push_back({ "Brute force frustum", bruteMs, "ms" });
+	results.push_back({ "Frustum matches brute force", found.size() == bruteHits ? 1.0 : 0.0, "" });
+	results.push_back({ "AABB query", aabbMs / totalQueries * 1000.0, "us" });
+	results.push_back({ "AABB query hits", aabbHits / totalQueries, "" });
+	results.push_back({ "Sphere query", sphereMs / totalQueries * 1000.0, "us" });
+	results.push_back({ "Sphere query hits", sphereHits / totalQueries, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Builds a dynamic AABB tree over entityCount boxes, then
+// each frame moves 5% of them and casts rays and box queries
+// - Same world as the octree benchmark, so the two compare
+// - One ray is checked against a brute force scan
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunAABBTree(int entityCount, int frames, int layout)
+{
+	SeededRandom rng = { 777 };
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+
+	AABBTree tree(0.1f);
+	std::vector<int> proxies(entityCount);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < entityCount; i++)
+		proxies[i] = tree.Insert(boxes[i], i);
+	double buildMs = ElapsedMs(start);
+	int buildHeight = tree.GetHeight();
+	float buildArea = tree.GetTotalSurfaceArea();
+
+	const int moverCount = entityCount / 20;
+	const int queriesPerFrame = 100;
+	std::vector<unsigned int> found;
+	double updateMs = 0, rayMs = 0, aabbMs = 0;
+	size_t treeChanges = 0, rayHits = 0, aabbHits = 0;
+
+	for (int f = 0; f < frames; f++)
+	{
+		// Move a different 5% of the boxes every frame
+		start = Clock::now();
+		for (int m = 0; m < moverCount; m++)
+		{
+			int i = (m * 20 + f) % entityCount;
+			XMFLOAT3 offset(rng.Range(-0.5f, 0.5f), rng.Range(-0.5f, 0.5f), rng.Range(-0.5f, 0.5f));
+			XMStoreFloat3(&boxes[i].min, XMVectorAdd(XMLoadFloat3(&boxes[i].min), XMLoadFloat3(&offset)));
+			XMStoreFloat3(&boxes[i].max, XMVectorAdd(XMLoadFloat3(&boxes[i].max), XMLoadFloat3(&offset)));
+			if (tree.Update(proxies[i], boxes[i]))
+				treeChanges++;
+		}
+		updateMs += ElapsedMs(start);
+
+		// Rays from one side of the world through to the other,
+		// like picking rays from a camera at the edge
+		start = Clock::now();
+		for (int q = 0; q < queriesPerFrame; q++)
+		{
+			XMFLOAT3 origin(rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf), -worldHalf * 2.0f);
+			XMFLOAT3 dir(rng.Range(-0.2f, 0.2f), rng.Range(-0.2f, 0.2f), 1.0f);
+			if (tree.RayCast(origin, dir, worldHalf * 4.0f).hit)
+				rayHits++;
+		}
+		rayMs += ElapsedMs(start);
+
+		// Query volumes about the size of a room
+		start = Clock::now();
+		for (int q = 0; q < queriesPerFrame; q++)
+		{
+			XMFLOAT3 center(rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf), rng.Range(-worldHalf, worldHalf));
+			found.clear();
+			tree.QueryAABB(Bounds::FromCenterExtents(center, XMFLOAT3(5, 5, 5)), found);
+			aabbHits += found.size();
+		}
+		aabbMs += ElapsedMs(start);
+	}
+
+	// One ray checked against every (fat) box, for comparison
+	XMFLOAT3 origin(0.0f, 0.0f, -worldHalf * 2.0f);
+	XMFLOAT3 dir(0.01f, 0.02f, 1.0f);
+	XMFLOAT3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+	start = Clock::now();
+	float bruteDistance = worldHalf * 4.0f;
+	for (int i = 0; i < entityCount; i++)
+	{
+		float d = Bounds::RayDistance(origin, invDir, tree.GetFatBounds(proxies[i]), bruteDistance);
+		if (d >= 0.0f && d < bruteDistance)
+			bruteDistance = d;
+	}
+	double bruteMs = ElapsedMs(start);
+	RayHit hit = tree.RayCast(origin, dir, worldHalf * 4.0f);
+
+	double totalQueries = (double)frames * queriesPerFrame;
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Nodes", (double)tree.GetNodeCount(), "" });
+	results.push_back({ "Build", buildMs, "ms" });
+	results.push_back({ "Height after build", (double)buildHeight, "" });
+	results.push_back({ "Height after updates", (double)tree.GetHeight(), "" });
+	results.push_back({ "Node area after build", buildArea, "" });
+	results.push_back({ "Node area after updates", tree.GetTotalSurfaceArea(), "" });
+	results.push_back({ "Update 5% movers per frame", updateMs / frames, "ms" });
+	results.push_back({ "Movers that changed the tree", treeChanges * 100.0 / ((double)moverCount * frames), "%" });
+	results.push_back({ "Ray cast", rayMs / totalQueries * 1000.0, "us" });
+	results.push_back({ "Ray hit rate", rayHits * 100.0 / totalQueries, "%" });
+	results.push_back({ "Brute force ray", bruteMs, "ms" });
+	bool rayMatches = hit.hit ? hit.distance == bruteDistance : bruteDistance == worldHalf * 4.0f;
+	results.push_back({ "Ray matches brute force", rayMatches ? 1.0 : 0.0, "" });
+	results.push_back({ "AABB query", aabbMs / totalQueries * 1000.0, "us" });
+	results.push_back({ "AABB query hits", aabbHits / totalQueries, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Loads the same generated scene from text and from the
+// binary format, through to created entities
+// - Both files are written to the temp directory and
+//    deleted afterwards
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunSceneLoad(int entityCount, int layout)
+{
+	GeneratedScene generated;
+	SceneGenerator::Generate(SceneGenerator::DefaultSettings(entityCount, layout, 4242), &generated);
+	const SceneData& source = generated.data;
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path();
+	std::string textPath = (dir / "benchmark_scene.txt").string();
+	std::string binaryPath = (dir / "benchmark_scene.scene").string();
+
+	// Write the text version (entities only - lights are a handful of lines either way)
+	{
+		std::ofstream text(textPath);
+		for (size_t i = 0; i < source.meshNames.size(); i++)
+			text << "mesh " << source.meshNames[i] << " " << source.meshPaths[i] << "\n";
+		for (auto& name : source.materialNames)
+			text << "material " << name << "\n";
+		for (auto& e : source.entities)
+		{
+			text << "entity " << source.meshNames[e.mesh] << " " << source.materialNames[e.material] << " " <<
+				e.position.x << " " << e.position.y << " " << e.position.z << " " <<
+				e.pitchYawRoll.x << " " << e.pitchYawRoll.y << " " << e.pitchYawRoll.z << " " <<
+				e.scale.x << " " << e.scale.y << " " << e.scale.z << "\n";
+		}
+		text << "light directional 0 -0.707 0.707 1 1 1 0.5\n";
+	}
+
+	// Text -> entities
+	// Both paths get the same head start on allocations (the
+	// transforms go in a pool of our own, not the game's)
+	Pool<Transform> transformPool;
+	std::vector<GameEntity> entities;
+	entities.reserve(entityCount);
+	transformPool.Reserve(entityCount);
+	auto instantiate = [&](const SceneEntityRecord* records, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			entities.push_back(GameEntity(MeshHandle(), MaterialHandle(), &transformPool));
+			Transform* transform = entities.back().GetTransform();
+			transform->SetPosition(records[i].position);
+			transform->SetRotation(records[i].pitchYawRoll);
+			transform->SetScale(records[i].scale);
+		}
+	};
+	auto release = [&]()
+	{
+		// Each entity gives its transform back
+		entities.clear();
+	};
+
+	Clock::time_point start = Clock::now();
+	SceneData scene;
+	bool parsed = SceneFile::ParseText(textPath, &scene);
+	double parseMs = ElapsedMs(start);
+	instantiate(scene.entities.data(), (unsigned int)scene.entities.size());
+	double textTotalMs = ElapsedMs(start);
+	release();
+
+	// Convert
+	start = Clock::now();
+	bool written = SceneFile::Write(scene, binaryPath);
+	double writeMs = ElapsedMs(start);
+
+	// Binary -> entities
+	start = Clock::now();
+	SceneFile file;
+	bool opened = file.Open(binaryPath);
+	double openMs = ElapsedMs(start);
+	if (opened)
+		instantiate(file.GetEntities(), file.GetEntityCount());
+	double binaryTotalMs = ElapsedMs(start);
+	bool matches = opened && file.GetEntityCount() == scene.entities.size() &&
+		memcmp(file.GetEntities(), scene.entities.data(), scene.entities.size() * sizeof(SceneEntityRecord)) == 0;
+	size_t binarySize = opened ? file.GetFileSize() : 0;
+	file.Close();
+	release();
+
+	std::error_code error;
+	double textSize = (double)std::filesystem::file_size(textPath, error);
+	std::filesystem::remove(textPath, error);
+	std::filesystem::remove(binaryPath, error);
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Text size", textSize / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Binary size", binarySize / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Text parse", parseMs, "ms" });
+	results.push_back({ "Text to entities", textTotalMs, "ms" });
+	results.push_back({ "Convert (write binary)", writeMs, "ms" });
+	results.push_back({ "Binary map + fixup", openMs, "ms" });
+	results.push_back({ "Binary to entities", binaryTotalMs, "ms" });
+	results.push_back({ "Binary matches text", parsed && written && matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Flies a camera over a streamed, generated world at 60 fps
+// (sleeping out the rest of each frame, so the loader
+// threads get real time to work) and records the main
+// thread's streaming cost
+// - A hitch is a frame whose streaming work ran over twice
+//    the budget; a late frame is one where the cell under
+//    the camera wasn't in the world yet
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunStreaming(int entityCount, int frames, int layout)
+{
+	const float cellSize = 50.0f;
+	const float dt = 1.0f / 60.0f;
+
+	// A flat world with one entity per 3x3 units on average
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(entityCount, layout, 99);
+	settings.worldHalfSize = 1.5f * std::sqrt((float)entityCount);
+	settings.minHeight = 0.0f;
+	settings.maxHeight = 2.0f;
+	settings.pointLightCount = 0;
+	settings.spotLightCount = 0;
+	GeneratedScene generated;
+	SceneGenerator::Generate(settings, &generated);
+	const SceneData& scene = generated.data;
+	float half = settings.worldHalfSize;
+
+	std::string directory = (std::filesystem::temp_directory_path() / "benchmark_streaming").string();
+	Clock::time_point start = Clock::now();
+	bool written = WorldStreamer::WriteCells(scene, cellSize, directory);
+	double writeMs = ElapsedMs(start);
+
+	World world;
+	WorldStreamer streamer;
+	std::vector<BenchmarkResult> results;
+	if (!written || !streamer.Open(directory,
+		[](const std::string&, const std::string&) { return MeshHandle(); },
+		[](const std::string&) { return MaterialHandle(); }))
+		return results;
+
+	// Across the world along X, then a right turn along Z
+	// - Covers most of the world whatever the frame count
+	float speed = (half * 1.2f) / (frames * 0.5f * dt);
+	XMFLOAT3 position(-half * 0.6f, 2.0f, -half * 0.6f);
+
+	double totalMs = 0, worstMs = 0;
+	int hitches = 0, lateFrames = 0;
+	unsigned int peakEntities = 0;
+	float budget = streamer.GetSettings().budgetMs;
+	for (int f = 0; f < frames; f++)
+	{
+		Clock::time_point frameStart = Clock::now();
+		if (f < frames / 2)
+			position.x += speed * dt;
+		else
+			position.z += speed * dt;
+
+		streamer.Update(world, position, dt);
+		double ms = streamer.GetLastUpdateMs();
+		totalMs += ms;
+		worstMs = std::max(worstMs, ms);
+		if (ms > budget * 2.0f)
+			hitches++;
+		if (!streamer.IsResident(position))
+			lateFrames++;
+		peakEntities = std::max(peakEntities, streamer.GetResidentEntities());
+
+		// Rest of the frame goes to the loaders
+		double remaining = dt * 1000.0 - ElapsedMs(frameStart);
+		if (remaining > 0)
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining));
+	}
+
+	unsigned int cellCount = streamer.GetCellCount();
+	size_t peakBytes = streamer.GetPeakResidentBytes();
+	unsigned int loaded = streamer.GetCellsLoaded();
+	unsigned int unloaded = streamer.GetCellsUnloaded();
+	streamer.Close(world);
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Cells", (double)cellCount, "" });
+	results.push_back({ "Write cells", writeMs, "ms" });
+	results.push_back({ "Camera speed", speed, "units/s" });
+	results.push_back({ "Average streaming per frame", totalMs / frames, "ms" });
+	results.push_back({ "Worst streaming frame", worstMs, "ms" });
+	results.push_back({ "Hitches (over 2x budget)", (double)hitches, "" });
+	results.push_back({ "Late frames", (double)lateFrames, "" });
+	results.push_back({ "Cells loaded", (double)loaded, "" });
+	results.push_back({ "Cells unloaded", (double)unloaded, "" });
+	results.push_back({ "Peak resident entities", (double)peakEntities, "" });
+	results.push_back({ "Peak resident memory", peakBytes / (1024.0 * 1024.0), "MB" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Generates the same stress scene twice, timing it and
+// checking the two are identical, and reports how it's
+// spread out (how full the fullest 10 unit cell is)
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunSceneGenerator(int entityCount, int layout)
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(entityCount, layout, 1234);
+	GeneratedScene first, second;
+
+	Clock::time_point start = Clock::now();
+	SceneGenerator::Generate(settings, &first);
+	double generateMs = ElapsedMs(start);
+	SceneGenerator::Generate(settings, &second);
+
+	bool identical =
+		first.data.entities.size() == second.data.entities.size() &&
+		first.data.lights.size() == second.data.lights.size() &&
+		memcmp(first.data.entities.data(), second.data.entities.data(), first.data.entities.size() * sizeof(SceneEntityRecord)) == 0 &&
+		memcmp(first.data.lights.data(), second.data.lights.data(), first.data.lights.size() * sizeof(Light)) == 0 &&
+		memcmp(first.entityVelocities.data(), second.entityVelocities.data(), first.entityVelocities.size() * sizeof(XMFLOAT3)) == 0 &&
+		memcmp(first.entitySpins.data(), second.entitySpins.data(), first.entitySpins.size() * sizeof(XMFLOAT3)) == 0;
+
+	// Entities per 10 unit cell, over the occupied cells
+	std::unordered_map<long long, int> cells;
+	for (auto& e : first.data.entities)
+	{
+		long long x = (long long)std::floor(e.position.x / 10.0f) + (1 << 20);
+		long long y = (long long)std::floor(e.position.y / 10.0f) + (1 << 20);
+		long long z = (long long)std::floor(e.position.z / 10.0f) + (1 << 20);
+		cells[(x << 42) | (y << 21) | z]++;
+	}
+	int fullest = 0;
+	for (auto& cell : cells)
+		fullest = std::max(fullest, cell.second);
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "World size", first.boundsMax.x * 2.0, "units" });
+	results.push_back({ "Generate", generateMs, "ms" });
+	results.push_back({ "Same seed, same scene", identical ? 1.0 : 0.0, "" });
+	results.push_back({ "Lights", (double)first.data.lights.size(), "" });
+	results.push_back({ "Moving entities", (double)first.movingEntityCount, "" });
+	results.push_back({ "Spinning entities", (double)first.spinningEntityCount, "" });
+	results.push_back({ "Moving lights", (double)first.movingLightCount, "" });
+	results.push_back({ "Occupied 10 unit cells", (double)cells.size(), "" });
+	results.push_back({ "Average per occupied cell", (double)entityCount / std::max<size_t>(cells.size(), 1), "" });
+	results.push_back({ "Fullest cell", (double)fullest, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Runs LOD selection over a generated scene while a camera
+// flies in from the edge, then hovers there wobbling back
+// and forth a little every frame (the worst case for popping)
+// - Every object pretends to have all MESH_MAX_LODS levels
+// - The hover runs with and without hysteresis to compare
+//    how many objects keep switching level
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunLODSelection(int entityCount, int frames, int layout)
+{
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+	float projectionScale = 1.0f / std::tan(XM_PIDIV4 / 2.0f);
+
+	LODSettings withHysteresis = LOD::DefaultSettings();
+	LODSettings without = withHysteresis;
+	without.hysteresis = 0.0f;
+
+	// One pass over everything, returning how many changed level
+	auto select = [&](XMFLOAT3 camera, std::vector<int>& levels, const LODSettings& settings)
+	{
+		size_t changes = 0;
+		for (int i = 0; i < entityCount; i++)
+		{
+			float size = LOD::ScreenSize(boxes[i], camera, projectionScale);
+			int level = LOD::SelectLevel(size, levels[i], MESH_MAX_LODS, settings);
+			if (level != levels[i])
+				changes++;
+			levels[i] = level;
+		}
+		return changes;
+	};
+
+	// Fly in
+	std::vector<int> levels(entityCount, 0);
+	size_t flyChanges = 0;
+	double selectMs = 0;
+	XMFLOAT3 camera(0.0f, 0.0f, -worldHalf);
+	for (int f = 0; f < frames; f++)
+	{
+		camera.z = -worldHalf + worldHalf * f / frames;
+		Clock::time_point start = Clock::now();
+		flyChanges += select(camera, levels, withHysteresis);
+		selectMs += ElapsedMs(start);
+	}
+
+	unsigned int levelObjects[MESH_MAX_LODS] = {};
+	for (int level : levels)
+		levelObjects[level]++;
+
+	// Hover, from the same starting levels
+	std::vector<int> levelsWithout = levels;
+	size_t hoverChanges = 0, hoverChangesWithout = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		XMFLOAT3 wobble(camera.x, camera.y, camera.z + ((f % 2) ? 0.5f : -0.5f));
+		hoverChanges += select(wobble, levels, withHysteresis);
+		hoverChangesWithout += select(wobble, levelsWithout, without);
+	}
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Selection per frame", selectMs / frames, "ms" });
+	results.push_back({ "Level changes per frame (flying)", (double)flyChanges / frames, "" });
+	results.push_back({ "Level changes per frame (hovering)", (double)hoverChanges / frames, "" });
+	results.push_back({ "Level changes per frame (hovering, no hysteresis)", (double)hoverChangesWithout / frames, "" });
+	for (int i = 0; i < MESH_MAX_LODS; i++)
+		results.push_back({ "At level " + std::to_string(i), levelObjects[i] * 100.0 / entityCount, "%" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Moves the moving quarter of a generated scene's bodies
+// for a number of frames, finding overlap pairs with one
+// and three axis sort-and-sweep
+// - Brute force (every pair) runs once, on the last frame,
+//    to check the pairs and for scale; past 20k bodies that
+//    would take far too long, so it times a slice of the
+//    pairs and scales up instead
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunSweepAndPrune(int bodyCount, int frames, int layout)
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(bodyCount, layout, 31);
+	settings.movingEntityFraction = 0.25f;
+	settings.maxSpeed = 5.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+
+	std::vector<AABB> boxes(bodyCount);
+	std::vector<XMFLOAT3>& velocities = scene.entityVelocities;
+	std::vector<int> movers;
+	for (int i = 0; i < bodyCount; i++)
+	{
+		boxes[i] = Bounds::FromCenterExtents(scene.data.entities[i].position, scene.data.entities[i].scale);
+		if (velocities[i].x != 0.0f || velocities[i].y != 0.0f || velocities[i].z != 0.0f)
+			movers.push_back(i);
+	}
+
+	SweepAndPrune oneAxis(1);
+	SweepAndPrune threeAxes(3);
+	std::vector<int> oneProxies(bodyCount), threeProxies(bodyCount);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < bodyCount; i++)
+		oneProxies[i] = oneAxis.Add(boxes[i], i);
+	std::vector<OverlapPair> onePairs, threePairs;
+	oneAxis.FindPairs(onePairs);
+	double oneBuildMs = ElapsedMs(start);
+
+	start = Clock::now();
+	for (int i = 0; i < bodyCount; i++)
+		threeProxies[i] = threeAxes.Add(boxes[i], i);
+	threeAxes.FindPairs(threePairs);
+	double threeBuildMs = ElapsedMs(start);
+
+	const float dt = 1.0f / 60.0f;
+	double oneMs = 0, threeMs = 0;
+	size_t oneSwaps = 0, oneTests = 0, threeSwaps = 0, pairCount = 0;
+	bool stable = true;
+	for (int f = 0; f < frames; f++)
+	{
+		// Move (bouncing off the world's bounds)
+		for (int i : movers)
+		{
+			XMFLOAT3 center = Bounds::GetCenter(boxes[i]);
+			XMFLOAT3 extents = Bounds::GetExtents(boxes[i]);
+			float* c = &center.x;
+			float* v = &velocities[i].x;
+			const float* lo = &scene.boundsMin.x;
+			const float* hi = &scene.boundsMax.x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				c[axis] += v[axis] * dt;
+				if (c[axis] < lo[axis] || c[axis] > hi[axis])
+				{
+					v[axis] = -v[axis];
+					c[axis] = std::clamp(c[axis], lo[axis], hi[axis]);
+				}
+			}
+			boxes[i] = Bounds::FromCenterExtents(center, extents);
+			oneAxis.Update(oneProxies[i], boxes[i]);
+			threeAxes.Update(threeProxies[i], boxes[i]);
+		}
+
+		start = Clock::now();
+		oneAxis.FindPairs(onePairs);
+		oneMs += ElapsedMs(start);
+		oneSwaps += oneAxis.GetLastSwaps();
+		oneTests += oneAxis.GetLastTests();
+
+		start = Clock::now();
+		threeAxes.FindPairs(threePairs);
+		threeMs += ElapsedMs(start);
+		threeSwaps += threeAxes.GetLastSwaps();
+		pairCount += threePairs.size();
+
+		stable = stable && onePairs.size() == threePairs.size() &&
+			memcmp(onePairs.data(), threePairs.data(), onePairs.size() * sizeof(OverlapPair)) == 0;
+	}
+
+	// Every pair, once (or the first rows' worth, scaled up)
+	bool exact = bodyCount <= 20000;
+	int rows = exact ? bodyCount : 1000;
+	double bruteTests = 0;
+	start = Clock::now();
+	std::vector<OverlapPair> brutePairs;
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = i + 1; j < bodyCount; j++)
+			if (Bounds::Overlaps(boxes[i], boxes[j]))
+				brutePairs.push_back({ (unsigned int)i, (unsigned int)j });
+		bruteTests += bodyCount - i - 1;
+	}
+	double bruteMs = ElapsedMs(start) * ((double)bodyCount * (bodyCount - 1) / 2.0) / std::max(bruteTests, 1.0);
+	bool matches = brutePairs.size() == threePairs.size() &&
+		memcmp(brutePairs.data(), threePairs.data(), brutePairs.size() * sizeof(OverlapPair)) == 0;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Bodies", (double)bodyCount, "" });
+	results.push_back({ "Moving", (double)movers.size(), "" });
+	results.push_back({ "Pairs per frame", (double)pairCount / frames, "" });
+	results.push_back({ "Build, one axis", oneBuildMs, "ms" });
+	results.push_back({ "Build, three axes", threeBuildMs, "ms" });
+	results.push_back({ "Update, one axis", oneMs / frames, "ms" });
+	results.push_back({ "Update, three axes", threeMs / frames, "ms" });
+	results.push_back({ exact ? "Brute force" : "Brute force (estimated)", bruteMs, "ms" });
+	results.push_back({ "Swaps per frame, one axis", (double)oneSwaps / frames, "" });
+	results.push_back({ "Swaps per frame, three axes", (double)threeSwaps / frames, "" });
+	results.push_back({ "Box tests per frame, one axis", (double)oneTests / frames, "" });
+	results.push_back({ "One and three axes agree", stable ? 1.0 : 0.0, "" });
+	if (exact)
+		results.push_back({ "Matches brute force", matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Keeps particleCount particles alive (64 emitters spawning
+// a little faster than they die, so the system stays full)
+// and times the update, the depth sort and the packing
+// - Everything is single threaded, so particles per second
+//    is also per core
+// - The same integration on an array of structs, one
+//    particle at a time, runs as the baseline for the SIMD
+//    pass, and std::sort on the last frame's depths as the
+//    baseline for the radix sort
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunParticles(int particleCount, int frames)
+{
+	const float dt = 1.0f / 60.0f;
+	const int emitterCount = 64;
+	const XMFLOAT3 cameraPosition(0.0f, 10.0f, -80.0f);
+	const XMFLOAT3 cameraForward(0.0f, -0.1f, 1.0f);
+
+	ParticleEmitterSettings settings = ParticleSystem::DefaultEmitterSettings();
+	settings.minLifetime = 1.5f;
+	settings.maxLifetime = 2.5f;
+	settings.spread = XM_PIDIV2;
+	settings.rate = particleCount * 1.1f / 2.0f / emitterCount;
+
+	SeededRandom rng = { 99 };
+	ParticleSystem particles(particleCount);
+	for (int e = 0; e < emitterCount; e++)
+	{
+		settings.offset = XMFLOAT3(rng.Range(-50, 50), rng.Range(0, 10), rng.Range(-50, 50));
+		particles.AddEmitter(TransformHandle(), settings);
+	}
+
+	// Run until the oldest particles start dying, so the counts are steady
+	for (float t = 0.0f; t < settings.maxLifetime; t += dt)
+		particles.Update(dt);
+
+	double updateMs = 0, sortMs = 0, packMs = 0;
+	size_t particlesUpdated = 0, sortPasses = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		particles.Update(dt);
+		particles.Sort(cameraPosition, cameraForward);
+		particles.Pack();
+
+		ParticleStats stats = particles.GetStats();
+		updateMs += stats.updateMs;
+		sortMs += stats.sortMs;
+		packMs += stats.packMs;
+		sortPasses += stats.sortPasses;
+		particlesUpdated += particles.GetParticleCount();
+	}
+	double perFrame = (double)particlesUpdated / frames;
+
+	// Check the order and time std::sort on the same depths
+	const std::vector<ParticleInstance>& instances = particles.GetInstances();
+	XMVECTOR forward = XMVector3Normalize(XMLoadFloat3(&cameraForward));
+	std::vector<float> depths(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+		depths[i] = XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat3(&instances[i].position), XMLoadFloat3(&cameraPosition)), forward));
+	bool ordered = std::is_sorted(depths.begin(), depths.end(), std::greater<float>());
+
+	std::vector<unsigned int> order(depths.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (unsigned int)((i * 2654435761u) % order.size());
+	Clock::time_point start = Clock::now();
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return depths[a] > depths[b]; });
+	double stdSortMs = ElapsedMs(start);
+
+	// Array of structs, one particle at a time
+	struct ScalarParticle
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 velocity;
+		float age;
+		float lifetime;
+		float gravity;
+		float drag;
+	};
+	std::vector<ScalarParticle> scalar(particleCount);
+	for (auto& p : scalar)
+	{
+		p.position = XMFLOAT3(rng.Range(-50, 50), rng.Range(0, 10), rng.Range(-50, 50));
+		p.velocity = XMFLOAT3(rng.Range(-2, 2), rng.Range(0, 5), rng.Range(-2, 2));
+		p.age = rng.Range(0.0f, 1.5f);
+		p.lifetime = rng.Range(settings.minLifetime, settings.maxLifetime);
+		p.gravity = settings.gravity;
+		p.drag = settings.drag;
+	}
+	start = Clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		for (auto& p : scalar)
+		{
+			float damping = std::max(1.0f - p.drag * dt, 0.0f);
+			p.velocity.x *= damping;
+			p.velocity.y = p.velocity.y * damping - p.gravity * dt;
+			p.velocity.z *= damping;
+			p.position.x += p.velocity.x * dt;
+			p.position.y += p.velocity.y * dt;
+			p.position.z += p.velocity.z * dt;
+			p.age += dt;
+			if (p.age >= p.lifetime)
+				p.age = 0.0f;
+		}
+	}
+	double scalarMs = ElapsedMs(start) / frames;
+
+	updateMs /= frames;
+	sortMs /= frames;
+	packMs /= frames;
+	double totalMs = updateMs + sortMs + packMs;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Particles", perFrame, "" });
+	results.push_back({ "Emitters", (double)emitterCount, "" });
+	results.push_back({ "Memory", particles.GetMemoryUsage() / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Update (SoA, SIMD)", updateMs, "ms" });
+	results.push_back({ "Update (AoS, scalar)", scalarMs, "ms" });
+	results.push_back({ "Update throughput", perFrame / updateMs / 1000.0, "M particles/s/core" });
+	results.push_back({ "Sort (radix)", sortMs, "ms" });
+	results.push_back({ "Sort (std::sort)", stdSortMs, "ms" });
+	results.push_back({ "Radix passes per frame", (double)sortPasses / frames, "" });
+	results.push_back({ "Pack", packMs, "ms" });
+	results.push_back({ "Frame", totalMs, "ms" });
+	results.push_back({ "Frame throughput", perFrame / totalMs / 1000.0, "M particles/s/core" });
+	results.push_back({ "Sorted far to near", ordered ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Culls a generated scene's boxes against a camera circling
+// the world (inside it, looking across it), one frame per
+// step around the circle
+// - Per-box Bounds::FrustumTest on an array of boxes is the
+//    baseline for the SIMD culler, run serially and in
+//    parallel batches
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunFrustumCulling(int entityCount, int frames, int layout)
+{
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+
+	FrustumCuller culler;
+	Clock::time_point start = Clock::now();
+	culler.Resize(entityCount);
+	for (int i = 0; i < entityCount; i++)
+		culler.SetBounds(i, boxes[i]);
+	double gatherMs = ElapsedMs(start);
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, worldHalf * 2.0f);
+	std::vector<unsigned int> scalarVisible, serialVisible, parallelVisible;
+	double scalarMs = 0, serialMs = 0, parallelMs = 0;
+	size_t visibleTotal = 0;
+	unsigned int batches = 0;
+	bool matches = true;
+	for (int f = 0; f < frames; f++)
+	{
+		float angle = XM_2PI * f / frames;
+		XMVECTOR eye = XMVectorSet(sinf(angle) * worldHalf * 0.5f, 2.0f, cosf(angle) * worldHalf * 0.5f, 0);
+		XMVECTOR target = XMVectorSet(-sinf(angle) * worldHalf, 0.0f, -cosf(angle) * worldHalf, 0);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(eye, target, XMVectorSet(0, 1, 0, 0)) * proj);
+		Frustum frustum = Bounds::FrustumFromMatrix(viewProj);
+
+		start = Clock::now();
+		scalarVisible.clear();
+		for (int i = 0; i < entityCount; i++)
+			if (Bounds::FrustumTest(frustum, boxes[i]) != BOUNDS_OUTSIDE)
+				scalarVisible.push_back(i);
+		scalarMs += ElapsedMs(start);
+
+		start = Clock::now();
+		culler.Cull(frustum, serialVisible, false);
+		serialMs += ElapsedMs(start);
+
+		start = Clock::now();
+		culler.Cull(frustum, parallelVisible, true);
+		parallelMs += ElapsedMs(start);
+		batches = culler.GetStats().batches;
+
+		visibleTotal += parallelVisible.size();
+		matches = matches && scalarVisible == serialVisible && serialVisible == parallelVisible;
+	}
+
+	scalarMs /= frames;
+	serialMs /= frames;
+	parallelMs /= frames;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+	results.push_back({ "Visible", (double)visibleTotal / frames / entityCount * 100.0, "%" });
+	results.push_back({ "Fill bounds", gatherMs, "ms" });
+	results.push_back({ "Cull, per-box test", scalarMs, "ms" });
+	results.push_back({ "Cull, SIMD", serialMs, "ms" });
+	results.push_back({ "Cull, SIMD parallel", parallelMs, "ms" });
+	results.push_back({ "Parallel batches", (double)batches, "" });
+	results.push_back({ "SIMD throughput", entityCount / serialMs / 1000.0, "M boxes/s/core" });
+	results.push_back({ "Speedup over per-box test", scalarMs / std::max(parallelMs, 0.0001), "x" });
+	results.push_back({ "Matches per-box test", matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Culls a generated scene's boxes against 1 to 32 views at
+// once (cameras spread around a circle, all turning a step
+// each frame), to see how one multi-view pass scales
+// against running a separate pass per view
+// - Both run serially, so the difference is the box data
+//    being loaded once rather than once per view
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunMultiViewCulling(int entityCount, int frames, int layout)
+{
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+
+	FrustumCuller culler;
+	culler.Resize(entityCount);
+	for (int i = 0; i < entityCount; i++)
+		culler.SetBounds(i, boxes[i]);
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, worldHalf * 2.0f);
+	std::vector<Frustum> frustums(CULL_MAX_VIEWS);
+	std::vector<std::vector<unsigned int>> separateVisible(CULL_MAX_VIEWS);
+	std::vector<unsigned int> masks, viewVisible;
+	double separateAt32 = 0, combinedAt32 = 0;
+	bool matches = true;
+	for (int viewCount = 1; viewCount <= CULL_MAX_VIEWS; viewCount *= 2)
+	{
+		double separateMs = 0, combinedMs = 0;
+		for (int f = 0; f < frames; f++)
+		{
+			for (int v = 0; v < viewCount; v++)
+			{
+				float angle = XM_2PI * v / CULL_MAX_VIEWS + XM_2PI * f / frames;
+				XMVECTOR eye = XMVectorSet(sinf(angle) * worldHalf * 0.5f, 2.0f, cosf(angle) * worldHalf * 0.5f, 0);
+				XMVECTOR target = XMVectorSet(-sinf(angle) * worldHalf, 0.0f, -cosf(angle) * worldHalf, 0);
+				XMFLOAT4X4 viewProj;
+				XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(eye, target, XMVectorSet(0, 1, 0, 0)) * proj);
+				frustums[v] = Bounds::FrustumFromMatrix(viewProj);
+			}
+
+			Clock::time_point start = Clock::now();
+			for (int v = 0; v < viewCount; v++)
+				culler.Cull(frustums[v], separateVisible[v], false);
+			separateMs += ElapsedMs(start);
+
+			start = Clock::now();
+			culler.CullViews(frustums.data(), viewCount, masks, false);
+			combinedMs += ElapsedMs(start);
+
+			// Check every view's list once per view count
+			if (f == 0)
+			{
+				for (int v = 0; v < viewCount; v++)
+				{
+					FrustumCuller::GetVisible(masks, v, viewVisible);
+					matches = matches && viewVisible == separateVisible[v];
+				}
+			}
+		}
+
+		separateMs /= frames;
+		combinedMs /= frames;
+		std::string label = std::to_string(viewCount) + (viewCount == 1 ? " view" : " views");
+		results.push_back({ label + ", separate passes", separateMs, "ms" });
+		results.push_back({ label + ", one pass", combinedMs, "ms" });
+		if (viewCount == CULL_MAX_VIEWS)
+		{
+			separateAt32 = separateMs;
+			combinedAt32 = combinedMs;
+		}
+	}
+
+	results.push_back({ "Speedup at " + std::to_string(CULL_MAX_VIEWS) + " views", separateAt32 / std::max(combinedAt32, 0.0001), "x" });
+	results.push_back({ "Matches separate passes", matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Culls a generated scene with and without the temporal
+// cache while a share of the boxes drift and the camera
+// turns, once slowly and once quickly
+// - Both run serially (that the results match is checked
+//    by the tests)
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunTemporalCulling(int entityCount, int frames, int layout)
+{
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, layout, &worldHalf);
+
+	FrustumCuller culler;
+	culler.Resize(entityCount);
+	for (int i = 0; i < entityCount; i++)
+		culler.SetBounds(i, boxes[i]);
+
+	// A tenth of the boxes wander a little every frame
+	SeededRandom rng = { 99 };
+	std::vector<XMFLOAT3> velocities(entityCount, XMFLOAT3(0, 0, 0));
+	for (int i = 0; i < entityCount; i += 10)
+		velocities[i] = XMFLOAT3(rng.Range(-0.05f, 0.05f), rng.Range(-0.05f, 0.05f), rng.Range(-0.05f, 0.05f));
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Entities", (double)entityCount, "" });
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, worldHalf * 2.0f);
+	std::vector<unsigned int> fullVisible, temporalVisible;
+	const char* speedNames[2] = { "Slow camera", "Fast camera" };
+	const float degreesPerFrame[2] = { 0.05f, 2.0f };
+	for (int speed = 0; speed < 2; speed++)
+	{
+		culler.InvalidateTemporal();
+		double fullMs = 0, temporalMs = 0;
+		size_t retested = 0, tested = 0;
+		int refreshes = 0;
+		for (int f = 0; f < frames; f++)
+		{
+			for (int i = 0; i < entityCount; i += 10)
+			{
+				XMFLOAT3 v = velocities[i];
+				boxes[i].min = XMFLOAT3(boxes[i].min.x + v.x, boxes[i].min.y + v.y, boxes[i].min.z + v.z);
+				boxes[i].max = XMFLOAT3(boxes[i].max.x + v.x, boxes[i].max.y + v.y, boxes[i].max.z + v.z);
+				culler.SetBounds(i, boxes[i]);
+			}
+
+			float angle = XMConvertToRadians(degreesPerFrame[speed] * f);
+			XMVECTOR eye = XMVectorSet(sinf(angle) * worldHalf * 0.5f, 2.0f, cosf(angle) * worldHalf * 0.5f, 0);
+			XMVECTOR target = XMVectorSet(-sinf(angle) * worldHalf, 0.0f, -cosf(angle) * worldHalf, 0);
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(eye, target, XMVectorSet(0, 1, 0, 0)) * proj);
+			Frustum frustum = Bounds::FrustumFromMatrix(viewProj);
+
+			Clock::time_point start = Clock::now();
+			culler.Cull(frustum, fullVisible, false);
+			fullMs += ElapsedMs(start);
+
+			start = Clock::now();
+			culler.CullTemporal(frustum, temporalVisible, false);
+			temporalMs += ElapsedMs(start);
+
+			TemporalCullStats stats = culler.GetTemporalStats();
+			retested += stats.retested;
+			tested += stats.tested;
+			refreshes += stats.fullRefresh ? 1 : 0;
+		}
+
+		std::string name = speedNames[speed];
+		results.push_back({ name + ", full cull", fullMs / frames, "ms" });
+		results.push_back({ name + ", temporal", temporalMs / frames, "ms" });
+		results.push_back({ name + ", retested", tested > 0 ? 100.0 * retested / tested : 0.0, "%" });
+		results.push_back({ name + ", full refreshes", (double)refreshes, "" });
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Occlusion culls a generated city: a grid of buildings
+// with streets between them and small props scattered over
+// everything, seen by a camera walking down a street
+// - Buildings are the occluders (the biggest on screen, up
+//    to occluderBudget), and everything the frustum keeps is
+//    tested against them
+// - The raster is timed again serially, to compare with the
+//    tiled parallel one
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunOcclusionCulling(int blocksPerSide, int propCount, int frames, int occluderBudget)
+{
+	SeededRandom rng = { 4242 };
+	const float blockSize = 20.0f;
+	const float streetWidth = 8.0f;
+	const float pitch = blockSize + streetWidth;
+	float cityHalf = blocksPerSide * pitch * 0.5f;
+
+	// Buildings first, then props (the culler's indices follow)
+	std::vector<AABB> boxes;
+	for (int bz = 0; bz < blocksPerSide; bz++)
+		for (int bx = 0; bx < blocksPerSide; bx++)
+		{
+			float footprint = rng.Range(blockSize * 0.7f, blockSize) * 0.5f;
+			float height = rng.Range(10.0f, 60.0f);
+			XMFLOAT3 center(-cityHalf + (bx + 0.5f) * pitch, height * 0.5f, -cityHalf + (bz + 0.5f) * pitch);
+			boxes.push_back(Bounds::FromCenterExtents(center, XMFLOAT3(footprint, height * 0.5f, footprint)));
+		}
+	int buildingCount = (int)boxes.size();
+	for (int i = 0; i < propCount; i++)
+	{
+		float half = rng.Range(0.25f, 1.0f);
+		XMFLOAT3 center(rng.Range(-cityHalf, cityHalf), half, rng.Range(-cityHalf, cityHalf));
+		boxes.push_back(Bounds::FromCenterExtents(center, XMFLOAT3(half, half, half)));
+	}
+
+	FrustumCuller culler;
+	culler.Resize((unsigned int)boxes.size());
+	for (unsigned int i = 0; i < (unsigned int)boxes.size(); i++)
+		culler.SetBounds(i, boxes[i]);
+
+	// Unit cube, front faces clockwise from outside
+	const XMFLOAT3 cubePositions[8] = {
+		{ -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f },
+		{ -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f } };
+	const unsigned int cubeIndices[36] = {
+		2, 3, 1, 2, 1, 0,	7, 6, 4, 7, 4, 5,	6, 2, 0, 6, 0, 4,
+		3, 7, 5, 3, 5, 1,	6, 7, 3, 6, 3, 2,	5, 4, 0, 5, 0, 1 };
+
+	// Walk down the street between the middle two columns of blocks
+	float streetX = -cityHalf + (blocksPerSide / 2) * pitch - streetWidth * 0.5f;
+	float projectionScale = 1.0f / tanf(XM_PIDIV4 * 0.5f);
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, cityHalf * 3.0f);
+	OcclusionCuller occlusion;
+	std::vector<unsigned int> visible;
+	std::vector<std::pair<float, unsigned int>> candidates;
+	double setupMs = 0, rasterMs = 0, serialRasterMs = 0, testMs = 0;
+	size_t frustumVisible = 0, occluded = 0, occluders = 0, triangles = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		float t = (float)f / frames;
+		XMFLOAT3 eye(streetX, 1.7f, -cityHalf * 0.9f + t * cityHalf * 1.8f);
+		float yaw = sinf(t * XM_2PI * 2.0f) * 0.3f;
+		XMVECTOR eyeVector = XMLoadFloat3(&eye);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixLookToLH(eyeVector, XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)) * proj);
+
+		culler.Cull(Bounds::FrustumFromMatrix(viewProj), visible, true);
+		frustumVisible += visible.size();
+
+		// Biggest buildings on screen are the occluders
+		candidates.clear();
+		for (unsigned int index : visible)
+		{
+			if (index >= (unsigned int)buildingCount)
+				break;
+			float size = LOD::ScreenSize(boxes[index], eye, projectionScale);
+			if (size >= 0.1f)
+				candidates.push_back({ size, index });
+		}
+		size_t occluderCount = std::min(candidates.size(), (size_t)occluderBudget);
+		std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end(), std::greater<>());
+
+		occlusion.BeginFrame(viewProj);
+		for (size_t i = 0; i < occluderCount; i++)
+		{
+			const AABB& box = boxes[candidates[i].second];
+			XMFLOAT3 center = Bounds::GetCenter(box);
+			XMFLOAT3 extents = Bounds::GetExtents(box);
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world,
+				XMMatrixScaling(extents.x * 2.0f, extents.y * 2.0f, extents.z * 2.0f) *
+				XMMatrixTranslation(center.x, center.y, center.z));
+			occlusion.AddOccluder(cubePositions, 8, cubeIndices, 36, world);
+		}
+
+		Clock::time_point start = Clock::now();
+		occlusion.Rasterize(false);
+		serialRasterMs += ElapsedMs(start);
+		occlusion.Rasterize(true);
+		occlusion.Cull(culler, visible, true);
+
+		OcclusionStats stats = occlusion.GetStats();
+		setupMs += stats.setupMs;
+		rasterMs += stats.rasterMs;
+		testMs += stats.testMs;
+		occluded += stats.occluded;
+		occluders += stats.occluders;
+		triangles += stats.triangles;
+	}
+
+	double objectCount = (double)boxes.size();
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Buildings", (double)buildingCount, "" });
+	results.push_back({ "Props", (double)propCount, "" });
+	results.push_back({ "Frustum visible", (double)frustumVisible / frames / objectCount * 100.0, "%" });
+	results.push_back({ "Occluders", (double)occluders / frames, "" });
+	results.push_back({ "Occluder triangles", (double)triangles / frames, "" });
+	results.push_back({ "Setup", setupMs / frames, "ms" });
+	results.push_back({ "Raster, tiled parallel", rasterMs / frames, "ms" });
+	results.push_back({ "Raster, serial", serialRasterMs / frames, "ms" });
+	results.push_back({ "Test", testMs / frames, "ms" });
+	results.push_back({ "Occluded (of frustum visible)", frustumVisible > 0 ? (double)occluded / frustumVisible * 100.0 : 0.0, "%" });
+	results.push_back({ "Culled in total", (1.0 - (double)(frustumVisible - occluded) / frames / objectCount) * 100.0, "%" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Sorts a generated scene's draws with the render queue
+// - Materials are spread over three shader pairs (like the
+//    lit, custom and debug shaders), and one draw in twenty
+//    is transparent
+// - The radix sort is checked against std::sort, and the
+//    transparent draws against their depths
+// - Keys made from handles are checked too: slots further
+//    apart than a key field can hold must not share state
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunRenderQueue(int drawCount, int frames, int layout)
+{
+	GeneratedScene scene;
+	SceneGenerator::Generate(SceneGenerator::DefaultSettings(drawCount, layout, 777), &scene);
+	float worldHalf = scene.boundsMax.x;
+
+	SeededRandom rng = { 2024 };
+	std::vector<bool> transparent(drawCount);
+	for (int i = 0; i < drawCount; i++)
+		transparent[i] = rng.Next() < 0.05f;
+
+	RenderQueue queue;
+	float farPlane = worldHalf * 3.0f;
+	std::vector<float> depths(drawCount);
+	std::vector<std::pair<uint64_t, unsigned int>> reference;
+	double keyMs = 0, radixMs = 0, stdSortMs = 0;
+	bool matches = true;
+	bool backToFront = true;
+	float depthTolerance = farPlane / (1 << RENDER_KEY_DEPTH_BITS) * 2.0f;
+	RenderQueueStats stats = {};
+	for (int f = 0; f < frames; f++)
+	{
+		float angle = XM_2PI * f / frames;
+		XMFLOAT3 eye(sinf(angle) * worldHalf, 5.0f, cosf(angle) * worldHalf);
+		XMFLOAT3 forward(-sinf(angle), 0.0f, -cosf(angle));
+
+		// Keys, in scene order (like the culler's output)
+		Clock::time_point start = Clock::now();
+		queue.Begin(farPlane);
+		for (int i = 0; i < drawCount; i++)
+		{
+			const SceneEntityRecord& entity = scene.data.entities[i];
+			float depth =
+				(entity.position.x - eye.x) * forward.x +
+				(entity.position.y - eye.y) * forward.y +
+				(entity.position.z - eye.z) * forward.z;
+			int lod = std::clamp((int)(depth / worldHalf * 2.0f), 0, MESH_MAX_LODS - 1);
+			depths[i] = depth;
+			queue.Add(queue.MakeKey(transparent[i] ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE,
+				entity.material % 3, entity.material, entity.mesh, lod, depth), i);
+		}
+		keyMs += ElapsedMs(start);
+
+		// std::sort of the same keys (the radix sort is stable, so
+		// ties stay in submission order: sort by item second)
+		reference.resize(drawCount);
+		for (int i = 0; i < drawCount; i++)
+			reference[i] = { queue.GetKeys()[i], queue.GetItems()[i] };
+		start = Clock::now();
+		std::sort(reference.begin(), reference.end());
+		stdSortMs += ElapsedMs(start);
+
+		queue.Sort();
+		stats = queue.GetStats();
+		radixMs += stats.sortMs;
+
+		const uint64_t* keys = queue.GetKeys();
+		const unsigned int* items = queue.GetItems();
+		for (int i = 0; i < drawCount; i++)
+		{
+			matches = matches && reference[i].first == keys[i] && reference[i].second == items[i];
+			if (i > 0 && RenderQueue::GetPass(keys[i - 1]) == RENDER_PASS_TRANSPARENT)
+				backToFront = backToFront && std::clamp(depths[items[i]], 0.0f, farPlane) <= std::clamp(depths[items[i - 1]], 0.0f, farPlane) + depthTolerance;
+		}
+	}
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Draws", (double)stats.draws, "" });
+	results.push_back({ "Transparent draws", (double)stats.transparentDraws, "" });
+	results.push_back({ "Build keys", keyMs / frames, "ms" });
+	results.push_back({ "Radix sort", radixMs / frames, "ms" });
+	results.push_back({ "Radix passes run", (double)stats.sortPasses, "" });
+	results.push_back({ "std::sort", stdSortMs / frames, "ms" });
+	results.push_back({ "Shader changes, unsorted", (double)stats.shaderChangesUnsorted, "" });
+	results.push_back({ "Shader changes, sorted", (double)stats.shaderChanges, "" });
+	results.push_back({ "Material changes, unsorted", (double)stats.materialChangesUnsorted, "" });
+	results.push_back({ "Material changes, sorted", (double)stats.materialChanges, "" });
+	results.push_back({ "Mesh changes, unsorted", (double)stats.meshChangesUnsorted, "" });
+	results.push_back({ "Mesh changes, sorted", (double)stats.meshChanges, "" });
+	results.push_back({ "Matches std::sort", matches ? 1.0 : 0.0, "" });
+	results.push_back({ "Transparent back to front", backToFront ? 1.0 : 0.0, "" });
+
+	// Slots 1 and 1 + 65536 of each pool (generation 1)
+	Material material("Key Check", XMFLOAT4(1, 1, 1, 1), ShaderHandle(), ShaderHandle());
+	MaterialHandle materials[2] = { { 1u | (1u << HANDLE_INDEX_BITS) }, { (1u + (1u << RENDER_KEY_MATERIAL_BITS)) | (1u << HANDLE_INDEX_BITS) } };
+	MeshHandle meshes[2] = { { 1u | (1u << HANDLE_INDEX_BITS) }, { (1u + (1u << RENDER_KEY_MESH_BITS)) | (1u << HANDLE_INDEX_BITS) } };
+	queue.Begin(farPlane);
+	uint64_t state = RenderQueue::GetState(queue.MakeKey(materials[0], &material, meshes[0], 0, 1.0f));
+	int aliased =
+		(RenderQueue::GetState(queue.MakeKey(materials[1], &material, meshes[0], 0, 1.0f)) == state ? 1 : 0) +
+		(RenderQueue::GetState(queue.MakeKey(materials[0], &material, meshes[1], 0, 1.0f)) == state ? 1 : 0);
+	results.push_back({ "Aliased handle keys (should be 0)", (double)aliased, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Runs a generated scene's binds through the state cache,
+// against a recording target (no device)
+// - Every draw asks for everything, like a naive draw loop:
+//    shaders, the material's four textures and sampler, and
+//    the mesh's buffers
+// - Draws go in scene order and in render queue order, with
+//    filtering on and off; the recorded state is checked
+//    against what each draw asked for
+// - Meshes share buffers (four to a buffer), and some pairs
+//    only differ by offset, stride or index format, so a bind
+//    that only changes one of those must still go out
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunStateCache(int drawCount, int frames, int layout)
+{
+	GeneratedScene scene;
+	SceneGenerator::Generate(SceneGenerator::DefaultSettings(drawCount, layout, 777), &scene);
+	float worldHalf = scene.boundsMax.x;
+
+	// Stand-in handles: distinct values the target never looks up
+	// (vertex and pixel shaders share the handle space, so apart)
+	auto vertexShader = [](unsigned int shader) { return ShaderHandle::Make(shader * 2, 1); };
+	auto pixelShader = [](unsigned int shader) { return ShaderHandle::Make(shader * 2 + 1, 1); };
+	auto texture = [](unsigned int material, unsigned int slot) { return TextureHandle::Make(material * 4 + slot, 1); };
+	auto sampler = SamplerHandle::Make(0, 1);
+	auto vertexBuffer = [](unsigned int mesh) { return BufferHandle::Make(mesh / 4 * 2, 1); };
+	auto indexBuffer = [](unsigned int mesh) { return BufferHandle::Make(mesh / 4 * 2 + 1, 1); };
+	auto bufferOffset = [](unsigned int mesh) { return (mesh % 4 / 2) * 4096u; };
+	auto vertexStride = [](unsigned int mesh) { return mesh % 2 == 0 ? 32u : 48u; };
+	auto indexFormat = [](unsigned int mesh) { return mesh % 2 == 0 ? RENDER_INDEX_32 : RENDER_INDEX_16; };
+
+	// Scene order, and the render queue's order from a corner
+	std::vector<unsigned int> orders[2];
+	orders[0].resize(drawCount);
+	for (int i = 0; i < drawCount; i++)
+		orders[0][i] = i;
+	RenderQueue queue;
+	queue.Begin(worldHalf * 3.0f);
+	for (int i = 0; i < drawCount; i++)
+	{
+		const SceneEntityRecord& entity = scene.data.entities[i];
+		float depth = entity.position.x + entity.position.z + worldHalf * 2.0f;
+		queue.Add(queue.MakeKey(RENDER_PASS_OPAQUE, entity.material % 3, entity.material, entity.mesh, 0, depth), i);
+	}
+	queue.Sort();
+	orders[1].assign(queue.GetItems(), queue.GetItems() + queue.GetCount());
+
+	RecordingStateTarget target;
+	StateCache cache(&target);
+	auto drawAll = [&](const std::vector<unsigned int>& order, bool check)
+	{
+		bool matches = true;
+		for (unsigned int index : order)
+		{
+			const SceneEntityRecord& entity = scene.data.entities[index];
+			unsigned int shader = entity.material % 3;
+			cache.SetVertexShader(vertexShader(shader));
+			cache.SetPixelShader(pixelShader(shader));
+			for (unsigned int slot = 0; slot < 4; slot++)
+				cache.SetPixelShaderResource(slot, texture(entity.material, slot));
+			cache.SetPixelSampler(0, sampler);
+			cache.SetVertexBuffer(vertexBuffer(entity.mesh), vertexStride(entity.mesh), bufferOffset(entity.mesh));
+			cache.SetIndexBuffer(indexBuffer(entity.mesh), indexFormat(entity.mesh), bufferOffset(entity.mesh));
+			cache.Commit();
+
+			if (check)
+			{
+				matches = matches &&
+					target.vs == vertexShader(shader) && target.ps == pixelShader(shader) &&
+					target.samplers[0] == sampler &&
+					target.vertexBuffer == vertexBuffer(entity.mesh) && target.indexBuffer == indexBuffer(entity.mesh) &&
+					target.vertexStride == vertexStride(entity.mesh) && target.vertexOffset == bufferOffset(entity.mesh) &&
+					target.indexFormat == indexFormat(entity.mesh) && target.indexOffset == bufferOffset(entity.mesh);
+				for (unsigned int slot = 0; slot < 4; slot++)
+					matches = matches && target.srvs[slot] == texture(entity.material, slot);
+			}
+		}
+		return matches;
+	};
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Draws", (double)drawCount, "" });
+
+	const char* orderNames[2] = { "Scene order", "Sorted" };
+	bool matches = true;
+	for (int o = 0; o < 2; o++)
+	{
+		for (int filtering = 1; filtering >= 0; filtering--)
+		{
+			cache.SetFiltering(filtering != 0);
+
+			// Checked pass first (it also warms up)
+			cache.BeginFrame();
+			target.calls.clear();
+			matches = drawAll(orders[o], true) && matches;
+
+			double ms = 0;
+			for (int f = 0; f < frames; f++)
+			{
+				cache.BeginFrame();
+				target.calls.clear();
+				Clock::time_point start = Clock::now();
+				drawAll(orders[o], false);
+				ms += ElapsedMs(start);
+			}
+
+			StateCacheStats stats = cache.GetStats();
+			unsigned int requested = 0;
+			for (int i = 0; i < STATE_BIND_KINDS; i++)
+				requested += stats.requested[i];
+
+			std::string name = std::string(orderNames[o]) + (filtering ? ", filtered" : ", unfiltered");
+			if (o == 0 && filtering)
+				results.push_back({ "Bind requests", (double)requested, "" });
+			results.push_back({ name + ", API calls", (double)target.calls.size(), "" });
+			results.push_back({ name, ms / frames, "ms" });
+		}
+	}
+
+	results.push_back({ "State matches requests", matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Groups a generated scene's sorted draws into instanced
+// draws and fills their matrices
+// - LOD goes by distance from a camera at the edge, so the
+//    groups are mesh x material x level
+// - Filling (inverse transposes included) is timed serially
+//    and in parallel, and the constant data each way of
+//    drawing uploads is compared
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunInstancing(int drawCount, int frames, int layout)
+{
+	GeneratedScene scene;
+	SceneGenerator::Generate(SceneGenerator::DefaultSettings(drawCount, layout, 777), &scene);
+	float worldHalf = scene.boundsMax.x;
+
+	std::vector<XMFLOAT4X4> worlds(drawCount);
+	for (int i = 0; i < drawCount; i++)
+	{
+		const SceneEntityRecord& entity = scene.data.entities[i];
+		XMMATRIX world =
+			XMMatrixScaling(entity.scale.x, entity.scale.y, entity.scale.z) *
+			XMMatrixRotationRollPitchYaw(entity.pitchYawRoll.x, entity.pitchYawRoll.y, entity.pitchYawRoll.z) *
+			XMMatrixTranslation(entity.position.x, entity.position.y, entity.position.z);
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranspose(world));
+	}
+
+	XMFLOAT3 eye(-worldHalf, 5.0f, 0.0f);
+	RenderQueue queue;
+	queue.Begin(worldHalf * 3.0f);
+	for (int i = 0; i < drawCount; i++)
+	{
+		const SceneEntityRecord& entity = scene.data.entities[i];
+		float depth = entity.position.x - eye.x;
+		int lod = std::clamp((int)(depth / worldHalf * 2.0f), 0, MESH_MAX_LODS - 1);
+		queue.Add(queue.MakeKey(RENDER_PASS_OPAQUE, 0, entity.material, entity.mesh, lod, depth), i);
+	}
+	queue.Sort();
+
+	const unsigned int* items = queue.GetItems();
+	auto fillRange = [&](unsigned int begin, unsigned int end, InstanceData* out)
+	{
+		for (unsigned int i = begin; i < end; i++, out++)
+		{
+			const XMFLOAT4X4& world = worlds[items[i]];
+			out->world = world;
+			XMStoreFloat4x4(&out->worldInvTranspose, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(&world))));
+		}
+	};
+
+	InstanceBatcher batcher;
+	double groupMs = 0, serialMs = 0, parallelMs = 0;
+	bool matches = true;
+	for (int f = 0; f < frames; f++)
+	{
+		batcher.Group(queue.GetKeys(), queue.GetCount());
+		groupMs += batcher.GetStats().groupMs;
+		batcher.Fill(fillRange, false);
+		serialMs += batcher.GetStats().fillMs;
+		batcher.Fill(fillRange, true);
+		parallelMs += batcher.GetStats().fillMs;
+	}
+
+	// Every group is one mesh, material and level
+	for (const InstanceGroup& group : batcher.GetGroups())
+	{
+		const SceneEntityRecord& first = scene.data.entities[items[group.start]];
+		for (unsigned int i = group.start; i < group.start + group.count; i++)
+		{
+			const SceneEntityRecord& entity = scene.data.entities[items[i]];
+			matches = matches && entity.mesh == first.mesh && entity.material == first.material;
+		}
+	}
+
+	// Constant buffer chunks are rounded up to 256 bytes
+	auto reserved = [](size_t size) { return (double)((size + 255) / 256 * 256); };
+	InstancingStats stats = batcher.GetStats();
+	double singleKB = drawCount * reserved(sizeof(VSConstantBuffer)) / 1024.0;
+	double instancedKB = (drawCount * sizeof(InstanceData) + stats.groups * reserved(sizeof(InstancedVSConstantBuffer))) / 1024.0;
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Draws", (double)stats.draws, "" });
+	results.push_back({ "Instanced draw calls", (double)stats.groups, "" });
+	results.push_back({ "Largest group", (double)stats.largestGroup, "" });
+	results.push_back({ "Group", groupMs / frames, "ms" });
+	results.push_back({ "Fill, serial", serialMs / frames, "ms" });
+	results.push_back({ "Fill, parallel", parallelMs / frames, "ms" });
+	results.push_back({ "Vertex data per frame, one draw each", singleKB, "KB" });
+	results.push_back({ "Vertex data per frame, instanced", instancedKB, "KB" });
+	results.push_back({ "Groups share state", matches ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Copies a generated scene's constant data into a memory
+// ring the size of the graphics constant buffer heap
+// - One block per draw: the vertex and pixel shader data,
+//    lights included, every draw (the old layout)
+// - Split by frequency: camera and lights once a frame,
+//    material data when the material changes, and only the
+//    matrices per draw
+// - Draws go in render queue order, as in the main pass
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunConstantBuffers(int drawCount, int frames, int lightCount, int layout)
+{
+	GeneratedScene scene;
+	SceneGenerator::Generate(SceneGenerator::DefaultSettings(drawCount, layout, 777), &scene);
+
+	RenderQueue queue;
+	queue.Begin(1.0f);
+	for (int i = 0; i < drawCount; i++)
+	{
+		const SceneEntityRecord& entity = scene.data.entities[i];
+		queue.Add(queue.MakeKey(RENDER_PASS_OPAQUE, 0, entity.material, entity.mesh, 0, 0.0f), i);
+	}
+	queue.Sort();
+	const unsigned int* items = queue.GetItems();
+
+	// The old combined blocks, rebuilt here from the split ones
+	struct SingleVSBlock
+	{
+		VSConstantBuffer object;
+		VSFrameConstantBuffer frame;
+	};
+	struct SinglePSBlock
+	{
+		PSConstantBuffer material;
+		PSFrameConstantBuffer frame;
+	};
+
+	SingleVSBlock vsBlock = {};
+	SinglePSBlock psBlock = {};
+	psBlock.frame.lightCount = std::min(lightCount, MAX_LIGHTS);
+	VSConstantBuffer vsObject = {};
+	PSConstantBuffer psMaterial = {};
+
+	const size_t ringSize = 1000 * 256;
+	std::vector<unsigned char> ring(ringSize);
+	size_t ringOffset = 0;
+	size_t bytes = 0;
+	unsigned int wraps = 0;
+	auto upload = [&](const void* data, size_t size)
+	{
+		size_t reservation = (size + 255) / 256 * 256;
+		if (ringOffset + reservation >= ringSize)
+		{
+			ringOffset = 0;
+			wraps++;
+		}
+		memcpy(&ring[ringOffset], data, size);
+		ringOffset += reservation;
+		bytes += reservation;
+	};
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Draws", (double)drawCount, "" });
+	results.push_back({ "Lights", (double)psBlock.frame.lightCount, "" });
+
+	const char* names[2] = { "One block per draw", "Split by frequency" };
+	for (int split = 0; split < 2; split++)
+	{
+		bytes = 0;
+		wraps = 0;
+		Clock::time_point start = Clock::now();
+		for (int f = 0; f < frames; f++)
+		{
+			if (split)
+			{
+				upload(&vsBlock.frame, sizeof(VSFrameConstantBuffer));
+				upload(&psBlock.frame, sizeof(PSFrameConstantBuffer));
+			}
+
+			unsigned int boundMaterial = UINT_MAX;
+			for (int i = 0; i < drawCount; i++)
+			{
+				const SceneEntityRecord& entity = scene.data.entities[items[i]];
+				if (!split)
+				{
+					vsBlock.object.world._41 = entity.position.x;
+					psBlock.material.colorTint.x = (float)entity.material;
+					upload(&vsBlock, sizeof(SingleVSBlock));
+					upload(&psBlock, sizeof(SinglePSBlock));
+					continue;
+				}
+
+				if (entity.material != boundMaterial)
+				{
+					psMaterial.colorTint.x = (float)entity.material;
+					upload(&psMaterial, sizeof(PSConstantBuffer));
+					boundMaterial = entity.material;
+				}
+				vsObject.world._41 = entity.position.x;
+				upload(&vsObject, sizeof(VSConstantBuffer));
+			}
+		}
+		double ms = ElapsedMs(start);
+
+		std::string name = names[split];
+		results.push_back({ name + ", uploaded per frame", bytes / 1024.0 / frames, "KB" });
+		results.push_back({ name + ", ring wraps per frame", (double)wraps / frames, "" });
+		results.push_back({ name + ", copy time", ms / frames, "ms" });
+	}
+	return results;
+}
+
+// --------------------------------------------------------
+// Assigns a generated scene's point and spot lights to the
+// froxel grid of a camera looking across it
+// - Serial and parallel assignment, against the budget
+//    (that the lists are right is checked by the tests)
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunLightClusters(int lightCount, int frames, int layout)
+{
+	// Sized for a light per ten entities, so the density stays
+	// the same at any light count
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(lightCount * 10, layout, 31337);
+	settings.pointLightCount = lightCount * 2 / 3;
+	settings.spotLightCount = lightCount - settings.pointLightCount;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	float nearPlane = 0.1f;
+	float farPlane = settings.worldHalfSize * 2.0f;
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(
+		XMVectorSet(0, settings.maxHeight, -settings.worldHalfSize, 0),
+		XMVectorSet(0, 0, settings.worldHalfSize * 0.25f, 0),
+		XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, nearPlane, farPlane));
+
+	LightClusters clusters;
+	double buildMs = 0, serialMs = 0, parallelMs = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		Clock::time_point start = Clock::now();
+		clusters.Build(view, projection, nearPlane, farPlane);
+		buildMs += ElapsedMs(start);
+
+		start = Clock::now();
+		clusters.Assign(lights.data(), (unsigned int)lights.size(), false);
+		serialMs += ElapsedMs(start);
+
+		start = Clock::now();
+		clusters.Assign(lights.data(), (unsigned int)lights.size(), true);
+		parallelMs += ElapsedMs(start);
+	}
+	LightClusterStats stats = clusters.GetStats();
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Lights", (double)stats.lights, "" });
+	results.push_back({ "Clusters", (double)LIGHT_CLUSTER_COUNT, "" });
+	results.push_back({ "Lights touching the grid", (double)stats.clusteredLights, "" });
+	results.push_back({ "Light references", (double)stats.references, "" });
+	results.push_back({ "Average per non-empty cluster", stats.references / (double)std::max(LIGHT_CLUSTER_COUNT - stats.emptyClusters, 1u), "" });
+	results.push_back({ "Largest cluster", (double)stats.largestCluster, "" });
+	results.push_back({ "Empty clusters", (double)stats.emptyClusters, "" });
+	results.push_back({ "Build grid", buildMs / frames, "ms" });
+	results.push_back({ "Assign, serial", serialMs / frames, "ms" });
+	results.push_back({ "Assign, parallel", parallelMs / frames, "ms" });
+	results.push_back({ "  of which bounds", stats.boundsMs, "ms" });
+	results.push_back({ "  of which slices", stats.assignMs, "ms" });
+	results.push_back({ "  of which compaction", stats.compactMs, "ms" });
+	results.push_back({ "Budget", LIGHT_CLUSTER_BUDGET_MS, "ms" });
+	results.push_back({ "Within budget", (buildMs + parallelMs) / frames <= LIGHT_CLUSTER_BUDGET_MS ? 1.0 : 0.0, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Picks the strongest lights for every entity of a generated
+// scene (boxes from their positions and scales)
+// - Serial and parallel selection (that the lists are
+//    right is checked by the tests)
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunObjectLights(int entityCount, int lightCount, int frames, int layout)
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(entityCount, layout, 4242);
+	settings.pointLightCount = lightCount * 2 / 3;
+	settings.spotLightCount = lightCount - settings.pointLightCount;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	std::vector<AABB> boxes(scene.data.entities.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		boxes[i] = Bounds::FromCenterExtents(scene.data.entities[i].position, scene.data.entities[i].scale);
+	auto getBounds = [&](unsigned int object) { return boxes[object]; };
+
+	ObjectLightSelector selector;
+	double serialMs = 0, parallelMs = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		Clock::time_point start = Clock::now();
+		selector.Select(getBounds, (unsigned int)boxes.size(), lights.data(), (unsigned int)lights.size(), false);
+		serialMs += ElapsedMs(start);
+
+		start = Clock::now();
+		selector.Select(getBounds, (unsigned int)boxes.size(), lights.data(), (unsigned int)lights.size(), true);
+		parallelMs += ElapsedMs(start);
+	}
+	ObjectLightStats stats = selector.GetStats();
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Objects", (double)stats.objects, "" });
+	results.push_back({ "Point and spot lights", (double)stats.lights, "" });
+	results.push_back({ "Grid cells", (double)stats.gridCells, "" });
+	results.push_back({ "Grid references", (double)stats.gridReferences, "" });
+	results.push_back({ "Pairs tested", (double)stats.candidates, "" });
+	results.push_back({ "Pairs touching", (double)stats.touching, "" });
+	results.push_back({ "Average lights per object", stats.kept / (double)std::max(stats.objects, 1u), "" });
+	results.push_back({ "Objects over the cap", (double)stats.cappedObjects, "" });
+	results.push_back({ "Select, serial", serialMs / frames, "ms" });
+	results.push_back({ "Select, parallel", parallelMs / frames, "ms" });
+	results.push_back({ "  of which grid", stats.gridMs, "ms" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Scores a generated scene's lights from a camera circling it
+// and keeps the constant buffer's worth
+// - Serial and parallel updates (that they agree and pick
+//    the right lights is checked by the tests)
+// - Counts lights entering the budget and lights fading
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunLightBudget(int lightCount, int frames, int layout)
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(lightCount, layout, 777);
+	settings.pointLightCount = lightCount * 2 / 3;
+	settings.spotLightCount = lightCount - settings.pointLightCount;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	unsigned int budget = MAX_LIGHTS * 3 / 4;
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, settings.worldHalfSize * 2.0f);
+	auto cameraAt = [&](int frame, XMFLOAT3* position, XMFLOAT4X4* viewProjection)
+	{
+		// Once around every ten seconds at 60 fps
+		float angle = frame * XM_2PI / 600.0f;
+		*position = XMFLOAT3(sinf(angle) * settings.worldHalfSize, settings.maxHeight, -cosf(angle) * settings.worldHalfSize);
+		XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(position), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+		XMStoreFloat4x4(viewProjection, XMMatrixMultiply(view, projection));
+	};
+
+	LightBudget serial, parallel;
+	XMFLOAT3 position;
+	XMFLOAT4X4 viewProjection;
+	double serialMs = 0, parallelMs = 0;
+	unsigned int entered = 0, mostFading = 0;
+	std::vector<unsigned int> lastSelected;
+	for (int f = 0; f < frames; f++)
+	{
+		cameraAt(f, &position, &viewProjection);
+
+		Clock::time_point start = Clock::now();
+		serial.Update(lights.data(), (unsigned int)lights.size(), viewProjection, position, budget, MAX_LIGHTS, 1.0f / 60.0f, false);
+		serialMs += ElapsedMs(start);
+
+		start = Clock::now();
+		parallel.Update(lights.data(), (unsigned int)lights.size(), viewProjection, position, budget, MAX_LIGHTS, 1.0f / 60.0f, true);
+		parallelMs += ElapsedMs(start);
+
+		const std::vector<unsigned int>& selected = parallel.GetSelected();
+		LightBudgetStats stats = parallel.GetStats();
+		mostFading = std::max(mostFading, stats.fadingIn + stats.fadingOut);
+		if (f > 0)
+		{
+			for (unsigned int i : selected)
+				entered += !std::binary_search(lastSelected.begin(), lastSelected.end(), i);
+		}
+		lastSelected = selected;
+	}
+	LightBudgetStats stats = parallel.GetStats();
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Layout", (double)layout, SceneGenerator::GetLayoutName(layout) });
+	results.push_back({ "Lights", (double)stats.lights, "" });
+	results.push_back({ "In view (last frame)", (double)stats.visible, "" });
+	results.push_back({ "Budget", (double)budget, "" });
+	results.push_back({ "Capacity", (double)MAX_LIGHTS, "" });
+	results.push_back({ "Update, serial", serialMs / frames, "ms" });
+	results.push_back({ "Update, parallel", parallelMs / frames, "ms" });
+	results.push_back({ "  of which scoring", stats.scoreMs, "ms" });
+	results.push_back({ "  of which selection", stats.selectMs, "ms" });
+	results.push_back({ "Lights entering per frame", entered / (double)std::max(frames - 1, 1), "" });
+	results.push_back({ "Most lights fading at once", (double)mostFading, "" });
+	return results;
+}
+
+// --------------------------------------------------------
+// Compiles the game's frame (shadow, main, bloom extract, blur
+// and combine, then a final blur) plus a debug pass nothing
+// reads, without a device (what it culls and aliases is checked
+// by the tests)
+// --------------------------------------------------------
+std::vector<BenchmarkResult> Benchmarks::RunFrameGraph(int width, int height, int frames)
+{
+	FrameGraphTextureDesc screenDesc = { (unsigned int)width, (unsigned int)height, RENDER_FORMAT_RGBA8 };
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	FrameGraph graph;
+	double compileMs = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		Clock::time_point start = Clock::now();
+		graph.Reset();
+		FrameGraphResource backBuffer = graph.Import("Back Buffer", TextureHandle(), true);
+		FrameGraphResource shadowMap = graph.Import("Shadow Map", TextureHandle(), false, false);
+		FrameGraphResource sceneColor = graph.CreateTexture("Scene Color", screenDesc);
+		FrameGraphResource bloomExtract = graph.CreateTexture("Bloom Extract", screenDesc);
+		FrameGraphResource bloomBlur = graph.CreateTexture("Bloom Blur", screenDesc);
+		FrameGraphResource bloomCombined = graph.CreateTexture("Bloom Combined", screenDesc);
+		FrameGraphResource debugView = graph.CreateTexture("Debug View", screenDesc);
+
+		int pass = graph.AddPass("Shadow", nullptr);
+		graph.Write(pass, shadowMap);
+
+		pass = graph.AddPass("Main", nullptr);
+		graph.Read(pass, shadowMap);
+		graph.Write(pass, sceneColor, black);
+
+		pass = graph.AddPass("Bloom Extract", nullptr);
+		graph.Read(pass, sceneColor, 0);
+		graph.Write(pass, bloomExtract);
+
+		pass = graph.AddPass("Bloom Blur", nullptr);
+		graph.Read(pass, bloomExtract, 0);
+		graph.Write(pass, bloomBlur);
+
+		pass = graph.AddPass("Bloom Combine", nullptr);
+		graph.Read(pass, sceneColor, 0);
+		graph.Read(pass, bloomBlur, 1);
+		graph.Write(pass, bloomCombined);
+
+		pass = graph.AddPass("Blur", nullptr);
+		graph.Read(pass, bloomCombined, 0);
+		graph.Write(pass, backBuffer);
+
+		pass = graph.AddPass("Debug View", nullptr);
+		graph.Read(pass, sceneColor, 0);
+		graph.Write(pass, debugView, black);
+
+		graph.Compile();
+		compileMs += ElapsedMs(start);
+	}
+	FrameGraphStats stats = graph.GetStats();
+
+	std::vector<BenchmarkResult> results;
+	results.push_back({ "Passes", (double)stats.passes, "" });
+	results.push_back({ "Culled passes", (double)stats.culledPasses, "" });
+	results.push_back({ "Transient textures", (double)stats.usedTextures, "" });
+	results.push_back({ "Physical textures", (double)stats.physicalTextures, "" });
+	results.push_back({ "Transient memory", stats.peakBytes / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "Transient memory, unaliased", stats.unaliasedBytes / (1024.0 * 1024.0), "MB" });
+	results.push_back({ "SRV unbinds", (double)stats.unbinds, "" });
+	results.push_back({ "Build and compile", compileMs / frames, "ms" });
+	return results;
+}
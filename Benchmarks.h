@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One labelled measurement from a benchmark run
+struct BenchmarkResult
+{
+	std::string label;
+	double value;
+	std::string unit;
+};
+
+// CPU micro-benchmarks for engine subsystems
+// - Each Run function builds its own data, times the work
+//   and returns its results for display in the UI
+namespace Benchmarks
+{
+	std::vector<BenchmarkResult> RunAnimationSampling(int trackCount, int frames);
+	std::vector<BenchmarkResult> RunEntityIteration(int entityCount, int passes);
+	std::vector<BenchmarkResult> RunECSUpdate(int entityCount, int frames);
+	std::vector<BenchmarkResult> RunParticles(int particleCount, int frames);
+
+	// These run on a generated stress scene with the given layout (SCENE_LAYOUT_*)
+	std::vector<BenchmarkResult> RunOctree(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunAABBTree(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunFrustumCulling(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunMultiViewCulling(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunTemporalCulling(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunOcclusionCulling(int blocksPerSide, int propCount, int frames, int occluderBudget);
+	std::vector<BenchmarkResult> RunRenderQueue(int drawCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunStateCache(int drawCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunInstancing(int drawCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunConstantBuffers(int drawCount, int frames, int lightCount, int layout);
+	std::vector<BenchmarkResult> RunLightClusters(int lightCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunObjectLights(int entityCount, int lightCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunLightBudget(int lightCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunFrameGraph(int width, int height, int frames);
+	std::vector<BenchmarkResult> RunSceneLoad(int entityCount, int layout);
+	std::vector<BenchmarkResult> RunStreaming(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunSceneGenerator(int entityCount, int layout);
+	std::vector<BenchmarkResult> RunLODSelection(int entityCount, int frames, int layout);
+	std::vector<BenchmarkResult> RunSweepAndPrune(int bodyCount, int frames, int layout);
+}
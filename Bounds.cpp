@@ -0,0 +1,209 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+AABB Bounds::FromCenterExtents(XMFLOAT3 center, XMFLOAT3 extents)
+{
+	AABB box = {};
+	XMStoreFloat3(&box.min, XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&extents)));
+	XMStoreFloat3(&box.max, XMVectorAdd(XMLoadFloat3(&center), XMLoadFloat3(&extents)));
+	return box;
+}
+
+AABB Bounds::Merge(const AABB& a, const AABB& b)
+{
+	AABB box = {};
+	XMStoreFloat3(&box.min, XMVectorMin(XMLoadFloat3(&a.min), XMLoadFloat3(&b.min)));
+	XMStoreFloat3(&box.max, XMVectorMax(XMLoadFloat3(&a.max), XMLoadFloat3(&b.max)));
+	return box;
+}
+
+AABB Bounds::TransformAABB(const AABB& local, const XMFLOAT4X4& world)
+{
+	// Move the center, and let each axis of the box contribute
+	// the absolute value of its rotated/scaled extent (Arvo's method)
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	XMFLOAT3 c = GetCenter(local);
+	XMFLOAT3 e = GetExtents(local);
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&c), m);
+
+	XMVECTOR extents = XMVectorAbs(XMVectorScale(m.r[0], e.x));
+	extents = XMVectorAdd(extents, XMVectorAbs(XMVectorScale(m.r[1], e.y)));
+	extents = XMVectorAdd(extents, XMVectorAbs(XMVectorScale(m.r[2], e.z)));
+
+	AABB box = {};
+	XMStoreFloat3(&box.min, XMVectorSubtract(center, extents));
+	XMStoreFloat3(&box.max, XMVectorAdd(center, extents));
+	return box;
+}
+
+XMFLOAT3 Bounds::GetCenter(const AABB& box)
+{
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.min), XMLoadFloat3(&box.max)), 0.5f));
+	return center;
+}
+
+XMFLOAT3 Bounds::GetExtents(const AABB& box)
+{
+	XMFLOAT3 extents;
+	XMStoreFloat3(&extents, XMVectorScale(XMVectorSubtract(XMLoadFloat3(&box.max), XMLoadFloat3(&box.min)), 0.5f));
+	return extents;
+}
+
+float Bounds::GetSurfaceArea(const AABB& box)
+{
+	float x = box.max.x - box.min.x;
+	float y = box.max.y - box.min.y;
+	float z = box.max.z - box.min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+float Bounds::DistanceSq(XMFLOAT3 point, const AABB& box)
+{
+	// Per axis distance outside the box (0 between its sides)
+	float dx = std::max(std::max(box.min.x - point.x, point.x - box.max.x), 0.0f);
+	float dy = std::max(std::max(box.min.y - point.y, point.y - box.max.y), 0.0f);
+	float dz = std::max(std::max(box.min.z - point.z, point.z - box.max.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+Frustum Bounds::FrustumFromMatrix(const XMFLOAT4X4& m)
+{
+	// Each plane is a sum/difference of the matrix's columns
+	// (Gribb & Hartmann); near is just the z column since D3D
+	// clip space depth goes from 0 to w
+	XMVECTOR c0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR c1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR c2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR c3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(c3, c0),		// Left
+		XMVectorSubtract(c3, c0),	// Right
+		XMVectorAdd(c3, c1),		// Bottom
+		XMVectorSubtract(c3, c1),	// Top
+		c2,							// Near
+		XMVectorSubtract(c3, c2),	// Far
+	};
+
+	Frustum frustum = {};
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.planes[i], XMPlaneNormalize(planes[i]));
+	return frustum;
+}
+
+bool Bounds::Overlaps(const AABB& a, const AABB& b)
+{
+	return
+		a.min.x <= b.max.x && a.max.x >= b.min.x &&
+		a.min.y <= b.max.y && a.max.y >= b.min.y &&
+		a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool Bounds::Contains(const AABB& outer, const AABB& inner)
+{
+	return
+		outer.min.x <= inner.min.x && outer.max.x >= inner.max.x &&
+		outer.min.y <= inner.min.y && outer.max.y >= inner.max.y &&
+		outer.min.z <= inner.min.z && outer.max.z >= inner.max.z;
+}
+
+int Bounds::AABBTest(const AABB& query, const AABB& box)
+{
+	if (!Overlaps(query, box)) return BOUNDS_OUTSIDE;
+	return Contains(query, box) ? BOUNDS_INSIDE : BOUNDS_INTERSECTS;
+}
+
+int Bounds::SphereTest(XMFLOAT3 center, float radius, const AABB& box)
+{
+	// Closest point on the box to the center
+	XMVECTOR c = XMLoadFloat3(&center);
+	XMVECTOR mn = XMLoadFloat3(&box.min);
+	XMVECTOR mx = XMLoadFloat3(&box.max);
+	XMVECTOR closest = XMVectorClamp(c, mn, mx);
+	float r2 = radius * radius;
+	if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closest, c))) > r2)
+		return BOUNDS_OUTSIDE;
+
+	// Farthest corner inside too?
+	XMVECTOR farthest = XMVectorMax(XMVectorAbs(XMVectorSubtract(mn, c)), XMVectorAbs(XMVectorSubtract(mx, c)));
+	return XMVectorGetX(XMVector3LengthSq(farthest)) <= r2 ? BOUNDS_INSIDE : BOUNDS_INTERSECTS;
+}
+
+int Bounds::FrustumTest(const Frustum& frustum, const AABB& box)
+{
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.min), XMLoadFloat3(&box.max)), 0.5f);
+	XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&box.max), XMLoadFloat3(&box.min)), 0.5f);
+	center = XMVectorSetW(center, 1.0f);
+
+	int result = BOUNDS_INSIDE;
+	for (int i = 0; i < 6; i++)
+	{
+		// Signed distance of the center, and how far the box
+		// reaches along the plane normal
+		XMVECTOR plane = XMLoadFloat4(&frustum.planes[i]);
+		float d = XMVectorGetX(XMVector4Dot(plane, center));
+		float r = XMVectorGetX(XMVector3Dot(XMVectorAbs(plane), extents));
+
+		if (d + r < 0.0f) return BOUNDS_OUTSIDE;
+		if (d - r < 0.0f) result = BOUNDS_INTERSECTS;
+	}
+	return result;
+}
+
+float Bounds::SphereInsideFraction(const Frustum& frustum, XMFLOAT3 center, float radius)
+{
+	float inside = 1.0f;
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& plane = frustum.planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		if (distance < -radius)
+			return 0.0f;
+		inside = std::min(inside, (distance + radius) / (2.0f * radius));
+	}
+	return inside;
+}
+
+bool Bounds::ConeOverlapsSphere(XMFLOAT3 apex, XMFLOAT3 direction, float cosAngle, float sinAngle, float range, XMFLOAT3 center, float radius)
+{
+	// The sphere's center split on the axis and off it, and
+	// each side checked against the cone's edge
+	XMFLOAT3 v(center.x - apex.x, center.y - apex.y, center.z - apex.z);
+	float lengthSq = v.x * v.x + v.y * v.y + v.z * v.z;
+	float alongAxis = v.x * direction.x + v.y * direction.y + v.z * direction.z;
+	float offAxis = sqrtf(std::max(lengthSq - alongAxis * alongAxis, 0.0f));
+	float toEdge = cosAngle * offAxis - alongAxis * sinAngle;
+
+	if (toEdge > radius)
+		return false;
+	if (alongAxis > radius + range)
+		return false;
+	return alongAxis >= -radius;
+}
+
+float Bounds::RayDistance(XMFLOAT3 origin, XMFLOAT3 invDirection, const AABB& box, float maxDistance)
+{
+	// Distances to the near and far planes of each slab
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR inv = XMLoadFloat3(&invDirection);
+	XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&box.min), o), inv);
+	XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&box.max), o), inv);
+
+	XMFLOAT3 tMin, tMax;
+	XMStoreFloat3(&tMin, XMVectorMin(t1, t2));
+	XMStoreFloat3(&tMax, XMVectorMax(t1, t2));
+
+	// The ray is inside the box between the last entry and the first exit
+	float enter = tMin.x > tMin.y ? (tMin.x > tMin.z ? tMin.x : tMin.z) : (tMin.y > tMin.z ? tMin.y : tMin.z);
+	float exit = tMax.x < tMax.y ? (tMax.x < tMax.z ? tMax.x : tMax.z) : (tMax.y < tMax.z ? tMax.y : tMax.z);
+	if (enter < 0.0f) enter = 0.0f;
+	if (exit > maxDistance) exit = maxDistance;
+
+	return enter <= exit ? enter : -1.0f;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// Results of containment tests
+#define BOUNDS_OUTSIDE 0
+#define BOUNDS_INTERSECTS 1
+#define BOUNDS_INSIDE 2
+
+// Axis-aligned bounding box
+struct AABB
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+};
+
+// Six planes (left, right, bottom, top, near, far) with
+// normals pointing inward: ax + by + cz + d >= 0 is inside
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+};
+
+// --------------------------------------------------------
+// Helpers for building and testing bounding volumes
+// --------------------------------------------------------
+namespace Bounds
+{
+	AABB FromCenterExtents(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents);
+	AABB Merge(const AABB& a, const AABB& b);
+	AABB TransformAABB(const AABB& local, const DirectX::XMFLOAT4X4& world);	// Box around the transformed box
+
+	DirectX::XMFLOAT3 GetCenter(const AABB& box);
+	DirectX::XMFLOAT3 GetExtents(const AABB& box);	// Half size
+	float GetSurfaceArea(const AABB& box);
+	float DistanceSq(DirectX::XMFLOAT3 point, const AABB& box);	// To the closest point in the box (0 inside)
+
+	// Planes of a (D3D style, 0-1 depth) view * projection matrix
+	Frustum FrustumFromMatrix(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Tests (the *Test functions return a BOUNDS_ value)
+	bool Overlaps(const AABB& a, const AABB& b);
+	bool Contains(const AABB& outer, const AABB& inner);
+	int AABBTest(const AABB& query, const AABB& box);
+	int SphereTest(DirectX::XMFLOAT3 center, float radius, const AABB& box);
+	int FrustumTest(const Frustum& frustum, const AABB& box);
+
+	// How much of a sphere is inside, by the plane that cuts the
+	// most (0 outside, 1 all the way inside)
+	float SphereInsideFraction(const Frustum& frustum, DirectX::XMFLOAT3 center, float radius);
+
+	// Whether a sphere is at least partly inside a cone capped at
+	// range (direction normalized, angles of the cone's half angle)
+	bool ConeOverlapsSphere(DirectX::XMFLOAT3 apex, DirectX::XMFLOAT3 direction, float cosAngle, float sinAngle, float range, DirectX::XMFLOAT3 center, float radius);
+
+	// Slab test: distance along the ray to the box (0 if the origin
+	// is inside), or a negative number for a miss
+	float RayDistance(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 invDirection, const AABB& box, float maxDistance);
+}
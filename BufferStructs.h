@@ -5,26 +5,63 @@
 
 #define MAX_LIGHTS 128
 
+// Where the pixel shader finds point and spot lights (must
+// match PixelShader.hlsl)
+#define LIGHTING_CONSTANT_BUFFER 0		// The first MAX_LIGHTS, in the frame constants
+#define LIGHTING_CLUSTERED 1			// Per froxel lists (see LightClusters.h)
+#define LIGHTING_PER_OBJECT 2			// Per object lists (see ObjectLights.h)
+
+// Constant buffer slots, by how often the data changes
+#define CB_SLOT_DRAW 0			// Per object (or per material in the pixel shader)
+#define CB_SLOT_FRAME 1			// Camera, shadow and lights, once per frame
+
+// Per object vertex shader data (b0)
 struct VSConstantBuffer
 {
 	DirectX::XMFLOAT4X4 world;
 	DirectX::XMFLOAT4X4 worldInvTranspose;
+	unsigned int objectIndex;		// Its render queue position (its light list)
+	DirectX::XMFLOAT3 padding;
+};
+
+// Per frame vertex shader data (b1)
+struct VSFrameConstantBuffer
+{
 	DirectX::XMFLOAT4X4 view;
 	DirectX::XMFLOAT4X4 projection;
 	DirectX::XMFLOAT4X4 lightView;
 	DirectX::XMFLOAT4X4 lightProjection;
 };
 
+// Per draw data for the instanced vertex shader (one structured
+// buffer element per instance)
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+
+// Per instanced draw vertex shader data (b0, with VSFrameConstantBuffer at b1)
+struct InstancedVSConstantBuffer
+{
+	unsigned int instanceStart;		// This draw's first element (SV_InstanceID starts at 0)
+	DirectX::XMFLOAT3 padding;
+};
+
+// Per material pixel shader data (b0)
 struct PSConstantBuffer
 {
 	DirectX::XMFLOAT4 colorTint;
+	DirectX::XMFLOAT2 scale;
+	DirectX::XMFLOAT2 offset;
+};
 
+// Per frame pixel shader data (b1)
+struct PSFrameConstantBuffer
+{
 	float totalTime;
 	DirectX::XMFLOAT3 intensities;
 
-	DirectX::XMFLOAT2 scale;
-	DirectX::XMFLOAT2 offset;
-
 	DirectX::XMFLOAT3 cameraPos;
 	float padding1;
 
@@ -33,6 +70,15 @@ struct PSConstantBuffer
 
 	Light lights[MAX_LIGHTS];
 	int lightCount;
+
+	// Clustered or per object point and spot lights (the lights
+	// above are then only the directional ones)
+	DirectX::XMFLOAT3 cameraForward;
+	DirectX::XMFLOAT2 clusterScreenScale;	// Pixels to tiles
+	float clusterDepthScale;				// slice = log(view depth) * scale + bias
+	float clusterDepthBias;
+	int lightingMode;						// LIGHTING_ above
+	DirectX::XMFLOAT3 padding2;
 };
 
 struct SkyVSConstantBuffer
@@ -41,6 +87,28 @@ struct SkyVSConstantBuffer
 	DirectX::XMFLOAT4X4 projection;
 };
 
+struct ParticleVSConstantBuffer
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+	DirectX::XMFLOAT3 cameraRight;	// Billboard axes
+	float padding1;
+	DirectX::XMFLOAT3 cameraUp;
+	float padding2;
+};
+
+// Constant data the main pass uploaded in the last frame
+struct ConstantBufferStats
+{
+	unsigned int frameUploads;
+	unsigned int materialUploads;
+	unsigned int objectUploads;
+	size_t frameBytes;
+	size_t materialBytes;
+	size_t objectBytes;				// Instanced draws' blocks included
+	size_t singleBlockBytes;		// The same draws with everything in one block per draw
+};
+
 struct ShadowOptions 
 {
 	DirectX::XMFLOAT4X4 lightViewMatrix;
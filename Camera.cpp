@@ -48,6 +48,18 @@ std::shared_ptr<Transform> Camera::GetTransform()
 	return transform;
 }
 
+DirectX::XMFLOAT4X4 Camera::GetViewProjection()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	return viewProjection;
+}
+
+Frustum Camera::GetFrustum()
+{
+	return Bounds::FrustumFromMatrix(GetViewProjection());
+}
+
 float Camera::GetFov()
 {
 	return fov;
@@ -197,3 +209,19 @@ void Camera::Update(float dt)
 
 	UpdateViewMatrix();
 }
+
+void Camera::GetPickRay(float screenX, float screenY, float screenWidth, float screenHeight, XMFLOAT3* origin, XMFLOAT3* direction)
+{
+	// Screen position to normalized device coordinates (y flips)
+	float x = 2.0f * screenX / screenWidth - 1.0f;
+	float y = 1.0f - 2.0f * screenY / screenHeight;
+
+	// Unproject the point on the near and far planes
+	XMMATRIX viewProj = XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection));
+	XMMATRIX invViewProj = XMMatrixInverse(0, viewProj);
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), invViewProj);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(x, y, 1.0f, 1.0f), invViewProj);
+
+	XMStoreFloat3(origin, nearPoint);
+	XMStoreFloat3(direction, XMVectorSubtract(farPoint, nearPoint));
+}
@@ -3,6 +3,7 @@
 #include <DirectXMath.h>
 #include <memory>
 
+#include "Bounds.h"
 #include "Transform.h"
 
 class Camera
@@ -38,6 +39,8 @@ public:
 	DirectX::XMFLOAT4X4 GetView();
 	DirectX::XMFLOAT4X4 GetProjection();
 	std::shared_ptr<Transform> GetTransform();
+	DirectX::XMFLOAT4X4 GetViewProjection();
+	Frustum GetFrustum();		// Planes of the current view and projection
 
 	float GetFov();
 	float GetNearPlane();
@@ -55,5 +58,15 @@ public:
 	void UpdateViewMatrix();
 	void UpdateProjectionMatrix(float aspectRatio);
 	void Update(float dt);
+
+	// World space ray through a point on the screen (in pixels);
+	// the direction spans the near plane to the far plane
+	void GetPickRay(
+		float screenX,
+		float screenY,
+		float screenWidth,
+		float screenHeight,
+		DirectX::XMFLOAT3* origin,
+		DirectX::XMFLOAT3* direction);
 };
 
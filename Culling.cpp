@@ -0,0 +1,440 @@
+#include "Culling.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	inline XMVECTOR LoadLanes(const std::vector<float>& stream, unsigned int i)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[i]));
+	}
+}
+
+FrustumCuller::FrustumCuller() :
+	count(0),
+	stats{},
+	referenceFrustum{},
+	cachedCount(0),
+	framesSinceRefresh(0),
+	temporalSettings{ 30, 0.5f },
+	temporalStats{}
+{
+}
+
+void FrustumCuller::Resize(unsigned int count)
+{
+	unsigned int padded = (count + CULL_LANES - 1) / CULL_LANES * CULL_LANES;
+	this->count = count;
+	centerX.resize(padded, 0.0f);
+	centerY.resize(padded, 0.0f);
+	centerZ.resize(padded, 0.0f);
+	extentX.resize(padded, 0.0f);
+	extentY.resize(padded, 0.0f);
+	extentZ.resize(padded, 0.0f);
+	motion.resize(padded, 0.0f);
+}
+
+void FrustumCuller::SetBounds(unsigned int index, const AABB& box)
+{
+	float cx = (box.min.x + box.max.x) * 0.5f;
+	float cy = (box.min.y + box.max.y) * 0.5f;
+	float cz = (box.min.z + box.max.z) * 0.5f;
+	float ex = (box.max.x - box.min.x) * 0.5f;
+	float ey = (box.max.y - box.min.y) * 0.5f;
+	float ez = (box.max.z - box.min.z) * 0.5f;
+
+	// How far any plane distance can have moved because of this
+	// (planes are normalized), for the temporal cache
+	float dx = cx - centerX[index], dy = cy - centerY[index], dz = cz - centerZ[index];
+	motion[index] += sqrtf(dx * dx + dy * dy + dz * dz) +
+		fabsf(ex - extentX[index]) + fabsf(ey - extentY[index]) + fabsf(ez - extentZ[index]);
+
+	centerX[index] = cx;
+	centerY[index] = cy;
+	centerZ[index] = cz;
+	extentX[index] = ex;
+	extentY[index] = ey;
+	extentZ[index] = ez;
+}
+
+void FrustumCuller::SplatFrustum(const Frustum& frustum, SplatPlane* planes)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+		planes[p].a = XMVectorSplatX(plane);
+		planes[p].b = XMVectorSplatY(plane);
+		planes[p].c = XMVectorSplatZ(plane);
+		planes[p].d = XMVectorSplatW(plane);
+		planes[p].absA = XMVectorAbs(planes[p].a);
+		planes[p].absB = XMVectorAbs(planes[p].b);
+		planes[p].absC = XMVectorAbs(planes[p].c);
+	}
+}
+
+XMVECTOR FrustumCuller::OutsideLanes(const SplatPlane* planes, unsigned int i)
+{
+	XMVECTOR cx = LoadLanes(centerX, i);
+	XMVECTOR cy = LoadLanes(centerY, i);
+	XMVECTOR cz = LoadLanes(centerZ, i);
+	XMVECTOR ex = LoadLanes(extentX, i);
+	XMVECTOR ey = LoadLanes(extentY, i);
+	XMVECTOR ez = LoadLanes(extentZ, i);
+
+	// A box is outside if it's entirely behind any plane:
+	// center distance + extents projected on the normal < 0
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR allOutside = XMVectorTrueInt();
+	XMVECTOR outside = XMVectorFalseInt();
+	for (int p = 0; p < 6; p++)
+	{
+		const SplatPlane& plane = planes[p];
+		XMVECTOR distance = XMVectorMultiplyAdd(plane.a, cx, plane.d);
+		distance = XMVectorMultiplyAdd(plane.b, cy, distance);
+		distance = XMVectorMultiplyAdd(plane.c, cz, distance);
+		XMVECTOR reach = XMVectorMultiply(plane.absA, ex);
+		reach = XMVectorMultiplyAdd(plane.absB, ey, reach);
+		reach = XMVectorMultiplyAdd(plane.absC, ez, reach);
+		outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(distance, reach), zero));
+
+		// Most boxes in a big scene are culled by the first
+		// few planes, so stop once the whole group is out
+		if (XMVector4EqualInt(outside, allOutside))
+			break;
+	}
+	return outside;
+}
+
+void FrustumCuller::CullRange(const SplatPlane* planes, unsigned int begin, unsigned int end, std::vector<unsigned int>& visible)
+{
+	for (unsigned int i = begin; i < end; i += CULL_LANES)
+	{
+		uint32_t lanes[CULL_LANES];
+		XMStoreInt4(lanes, OutsideLanes(planes, i));
+		for (unsigned int l = 0; l < CULL_LANES && i + l < end; l++)
+		{
+			if (!lanes[l])
+				visible.push_back(i + l);
+		}
+	}
+}
+
+unsigned int FrustumCuller::CullViewsRange(int viewCount, unsigned int begin, unsigned int end, unsigned int* masks)
+{
+	// The group's box data stays in cache (and mostly in
+	// registers) while it's run past every view in turn
+	unsigned int visibleCount = 0;
+	for (unsigned int i = begin; i < end; i += CULL_LANES)
+	{
+		XMVECTOR groupMask = XMVectorZero();
+		for (int v = 0; v < viewCount; v++)
+		{
+			XMVECTOR bit = XMVectorReplicateInt(1u << v);
+			groupMask = XMVectorOrInt(groupMask, XMVectorAndCInt(bit, OutsideLanes(&viewPlanes[v * 6], i)));
+		}
+
+		uint32_t lanes[CULL_LANES];
+		XMStoreInt4(lanes, groupMask);
+		for (unsigned int l = 0; l < CULL_LANES && i + l < end; l++)
+		{
+			masks[i + l] = lanes[l];
+			if (lanes[l])
+				visibleCount++;
+		}
+	}
+	return visibleCount;
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible, bool parallel)
+{
+	Clock::time_point start = Clock::now();
+	visible.clear();
+
+	SplatPlane planes[6];
+	SplatFrustum(frustum, planes);
+
+	if (!parallel || count < CULL_PARALLEL_MIN)
+	{
+		CullRange(planes, 0, count, visible);
+		stats.batches = 1;
+	}
+	else
+	{
+		// Batch sizes are a multiple of CULL_LANES, so batches never share a group
+		unsigned int batchCount = (count + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE;
+		if (batchVisible.size() < batchCount)
+			batchVisible.resize(batchCount);
+
+		std::vector<unsigned int> batches(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), [&](unsigned int batch)
+		{
+			std::vector<unsigned int>& out = batchVisible[batch];
+			out.clear();
+			unsigned int begin = batch * CULL_BATCH_SIZE;
+			CullRange(planes, begin, std::min(begin + CULL_BATCH_SIZE, count), out);
+		});
+
+		// Join in batch order
+		size_t total = 0;
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+			total += batchVisible[batch].size();
+		visible.reserve(total);
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+			visible.insert(visible.end(), batchVisible[batch].begin(), batchVisible[batch].end());
+		stats.batches = batchCount;
+	}
+
+	stats.tested = count;
+	stats.views = 1;
+	stats.visible = (unsigned int)visible.size();
+	stats.culled = count - stats.visible;
+	stats.cullMs = ElapsedMs(start);
+}
+
+void FrustumCuller::CullViews(const Frustum* frustums, int viewCount, std::vector<unsigned int>& masks, bool parallel)
+{
+	Clock::time_point start = Clock::now();
+	viewCount = std::clamp(viewCount, 0, CULL_MAX_VIEWS);
+	masks.resize(count);
+
+	viewPlanes.resize(viewCount * 6);
+	for (int v = 0; v < viewCount; v++)
+		SplatFrustum(frustums[v], &viewPlanes[v * 6]);
+
+	unsigned int visibleCount = 0;
+	if (!parallel || count < CULL_PARALLEL_MIN)
+	{
+		visibleCount = CullViewsRange(viewCount, 0, count, masks.data());
+		stats.batches = 1;
+	}
+	else
+	{
+		// Every batch writes its own slice of the masks, so only the counts need joining
+		unsigned int batchCount = (count + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE;
+		std::vector<unsigned int> batches(batchCount);
+		std::vector<unsigned int> batchCounts(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), [&](unsigned int batch)
+		{
+			unsigned int begin = batch * CULL_BATCH_SIZE;
+			batchCounts[batch] = CullViewsRange(viewCount, begin, std::min(begin + CULL_BATCH_SIZE, count), masks.data());
+		});
+
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+			visibleCount += batchCounts[batch];
+		stats.batches = batchCount;
+	}
+
+	stats.tested = count;
+	stats.views = viewCount;
+	stats.visible = visibleCount;
+	stats.culled = count - visibleCount;
+	stats.cullMs = ElapsedMs(start);
+}
+
+void FrustumCuller::GetVisible(const std::vector<unsigned int>& masks, int view, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	unsigned int bit = 1u << view;
+	for (unsigned int i = 0; i < (unsigned int)masks.size(); i++)
+	{
+		if (masks[i] & bit)
+			visible.push_back(i);
+	}
+}
+
+unsigned int FrustumCuller::CullTemporalRange(const SplatPlane* planes, float normalDrift, float distanceDrift, bool refresh, unsigned int begin, unsigned int end, std::vector<unsigned int>& visible)
+{
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR epsilon = XMVectorReplicate(CULL_TEMPORAL_EPSILON);
+	XMVECTOR normalDrifts = XMVectorReplicate(normalDrift);
+	XMVECTOR distanceDrifts = XMVectorReplicate(distanceDrift);
+	XMVECTOR allLanes = XMVectorTrueInt();
+	unsigned int retested = 0;
+	for (unsigned int i = begin; i < end; i += CULL_LANES)
+	{
+		// The most any plane distance can have changed since the
+		// reference planes, for a box this far from the origin
+		XMVECTOR moved = LoadLanes(motion, i);
+		XMVECTOR drift = XMVectorMultiplyAdd(LoadLanes(cachedRadius, i), normalDrifts, distanceDrifts);
+		XMVECTOR trusted = XMVectorGreater(LoadLanes(cachedSlack, i), XMVectorAdd(XMVectorAdd(drift, moved), epsilon));
+
+		XMVECTOR visibleLanes;
+		if (!refresh && XMVector4EqualInt(trusted, allLanes))
+		{
+			visibleLanes = XMLoadInt4(&cachedVisible[i]);
+		}
+		else
+		{
+			XMVECTOR cx = LoadLanes(centerX, i);
+			XMVECTOR cy = LoadLanes(centerY, i);
+			XMVECTOR cz = LoadLanes(centerZ, i);
+			XMVECTOR ex = LoadLanes(extentX, i);
+			XMVECTOR ey = LoadLanes(extentY, i);
+			XMVECTOR ez = LoadLanes(extentZ, i);
+
+			// Closest any plane comes to flipping the result (all six,
+			// no early out, since the margin matters for next frame)
+			XMVECTOR closest = XMVectorReplicate(FLT_MAX);
+			for (int p = 0; p < 6; p++)
+			{
+				const SplatPlane& plane = planes[p];
+				XMVECTOR distance = XMVectorMultiplyAdd(plane.a, cx, plane.d);
+				distance = XMVectorMultiplyAdd(plane.b, cy, distance);
+				distance = XMVectorMultiplyAdd(plane.c, cz, distance);
+				XMVECTOR reach = XMVectorMultiply(plane.absA, ex);
+				reach = XMVectorMultiplyAdd(plane.absB, ey, reach);
+				reach = XMVectorMultiplyAdd(plane.absC, ez, reach);
+				closest = XMVectorMin(closest, XMVectorAdd(distance, reach));
+			}
+			visibleLanes = XMVectorGreaterOrEqual(closest, zero);
+
+			// Store the margin relative to the reference planes, so
+			// one drift value per frame covers every cached box
+			XMVECTOR radius = XMVectorSqrt(XMVectorMultiplyAdd(cx, cx, XMVectorMultiplyAdd(cy, cy, XMVectorMultiply(cz, cz))));
+			radius = XMVectorAdd(radius, XMVectorAdd(ex, XMVectorAdd(ey, ez)));
+			drift = XMVectorMultiplyAdd(radius, normalDrifts, distanceDrifts);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&cachedRadius[i]), radius);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&cachedSlack[i]), XMVectorSubtract(XMVectorAbs(closest), drift));
+			XMStoreInt4(&cachedVisible[i], visibleLanes);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&motion[i]), zero);
+			retested += std::min(end - i, (unsigned int)CULL_LANES);
+		}
+
+		uint32_t lanes[CULL_LANES];
+		XMStoreInt4(lanes, visibleLanes);
+		for (unsigned int l = 0; l < CULL_LANES && i + l < end; l++)
+		{
+			if (lanes[l])
+				visible.push_back(i + l);
+		}
+	}
+	return retested;
+}
+
+void FrustumCuller::CullTemporal(const Frustum& frustum, std::vector<unsigned int>& visible, bool parallel)
+{
+	Clock::time_point start = Clock::now();
+	visible.clear();
+
+	// Refresh everything now and then, when the box count changes,
+	// or once the planes have drifted far enough from the reference
+	// that most boxes were retested anyway
+	bool refresh =
+		cachedCount != count ||
+		framesSinceRefresh >= temporalSettings.refreshInterval ||
+		(!temporalStats.fullRefresh && temporalStats.retested > temporalSettings.refreshFraction * temporalStats.tested);
+	if (refresh)
+	{
+		unsigned int padded = (unsigned int)centerX.size();
+		cachedRadius.resize(padded);
+		cachedSlack.resize(padded);
+		cachedVisible.resize(padded);
+		referenceFrustum = frustum;
+		cachedCount = count;
+		framesSinceRefresh = 0;
+	}
+	framesSinceRefresh++;
+
+	// How far the planes are from the reference ones (worst plane)
+	float normalDrift = 0.0f;
+	float distanceDrift = 0.0f;
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&frustum.planes[p]);
+		XMVECTOR reference = XMLoadFloat4(&referenceFrustum.planes[p]);
+		normalDrift = std::max(normalDrift, XMVectorGetX(XMVector3Length(XMVectorSubtract(plane, reference))));
+		distanceDrift = std::max(distanceDrift, fabsf(frustum.planes[p].w - referenceFrustum.planes[p].w));
+	}
+
+	SplatPlane planes[6];
+	SplatFrustum(frustum, planes);
+
+	unsigned int retested = 0;
+	if (!parallel || count < CULL_PARALLEL_MIN)
+	{
+		retested = CullTemporalRange(planes, normalDrift, distanceDrift, refresh, 0, count, visible);
+	}
+	else
+	{
+		unsigned int batchCount = (count + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE;
+		if (batchVisible.size() < batchCount)
+			batchVisible.resize(batchCount);
+
+		std::vector<unsigned int> batches(batchCount);
+		std::vector<unsigned int> batchRetested(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), [&](unsigned int batch)
+		{
+			std::vector<unsigned int>& out = batchVisible[batch];
+			out.clear();
+			unsigned int begin = batch * CULL_BATCH_SIZE;
+			batchRetested[batch] = CullTemporalRange(planes, normalDrift, distanceDrift, refresh, begin, std::min(begin + CULL_BATCH_SIZE, count), out);
+		});
+
+		// Join in batch order
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+		{
+			visible.insert(visible.end(), batchVisible[batch].begin(), batchVisible[batch].end());
+			retested += batchRetested[batch];
+		}
+	}
+
+	temporalStats.tested = count;
+	temporalStats.retested = retested;
+	temporalStats.visible = (unsigned int)visible.size();
+	temporalStats.fullRefresh = refresh;
+	temporalStats.cullMs = ElapsedMs(start);
+}
+
+void FrustumCuller::CullViewsTemporal(const Frustum* frustums, int viewCount, std::vector<unsigned int>& masks, bool parallel)
+{
+	viewCount = std::clamp(viewCount, 0, CULL_MAX_VIEWS);
+	if (viewCount == 0)
+	{
+		masks.assign(count, 0);
+		return;
+	}
+
+	// The other views (at most CULL_MAX_VIEWS - 1 of them) are
+	// shifted up a bit, so the top one still fits in the mask
+	CullTemporal(frustums[0], temporalVisible, parallel);
+	CullViews(frustums + 1, viewCount - 1, masks, parallel);
+	for (unsigned int& mask : masks)
+		mask <<= 1;
+	for (unsigned int index : temporalVisible)
+		masks[index] |= 1;
+}
+
+void FrustumCuller::InvalidateTemporal()
+{
+	cachedCount = UINT_MAX;
+}
+
+// Getters
+unsigned int FrustumCuller::GetCount() { return count; }
+CullStats FrustumCuller::GetStats() { return stats; }
+TemporalCullStats FrustumCuller::GetTemporalStats() { return temporalStats; }
+TemporalCullSettings FrustumCuller::GetTemporalSettings() { return temporalSettings; }
+
+AABB FrustumCuller::GetBounds(unsigned int index)
+{
+	XMFLOAT3 center(centerX[index], centerY[index], centerZ[index]);
+	XMFLOAT3 extents(extentX[index], extentY[index], extentZ[index]);
+	return Bounds::FromCenterExtents(center, extents);
+}
+
+// Setters
+void FrustumCuller::SetGatherMs(double gatherMs) { stats.gatherMs = gatherMs; }
+void FrustumCuller::SetTemporalSettings(const TemporalCullSettings& settings) { temporalSettings = settings; }
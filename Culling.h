@@ -0,0 +1,148 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+
+// Boxes tested per SIMD step (the streams are padded to this)
+#define CULL_LANES 4
+
+// Parallel culling splits the boxes into batches of this many;
+// below CULL_PARALLEL_MIN boxes it isn't worth waking threads
+#define CULL_BATCH_SIZE 4096
+#define CULL_PARALLEL_MIN 16384
+
+// Views one CullViews() pass can test (one bit each in the masks)
+#define CULL_MAX_VIEWS 32
+
+// Slack (world units) a cached result needs beyond the worst
+// case change before it's trusted, to absorb rounding
+#define CULL_TEMPORAL_EPSILON 0.0001f
+
+// When the temporal cache throws everything away
+struct TemporalCullSettings
+{
+	int refreshInterval;		// Frames between full refreshes
+	float refreshFraction;		// Retesting more than this share of boxes refreshes next frame
+};
+
+// What the last CullTemporal() did
+struct TemporalCullStats
+{
+	unsigned int tested;
+	unsigned int retested;		// Boxes whose cached result couldn't be trusted
+	unsigned int visible;
+	bool fullRefresh;
+	double cullMs;
+};
+
+// What the last Cull() did
+struct CullStats
+{
+	unsigned int tested;
+	unsigned int views;
+	unsigned int visible;		// In at least one view
+	unsigned int culled;		// In no view
+	unsigned int batches;		// 1 on the serial path
+	double gatherMs;			// Filling the bounds (timed by whoever fills them)
+	double cullMs;
+};
+
+// --------------------------------------------------------
+// Frustum culling over a flat list of world space boxes
+//
+// - Boxes are stored as centers and half sizes, one stream
+//    per component, and tested CULL_LANES at a time against
+//    all six planes (center distance + projected extents)
+// - Big lists are split into batches that run in parallel,
+//    each writing its own visible list; those are joined in
+//    batch order, so the output is always ascending
+// - CullViews() tests every box against up to CULL_MAX_VIEWS
+//    frustums in one pass, so each box is loaded once however
+//    many views there are (main camera, shadow light, ...)
+// - CullTemporal() keeps each box's last result and how far
+//    it was from flipping; only boxes that moved, or whose
+//    planes moved, by more than that are tested again
+// - SetBounds() only touches its own index, so filling the
+//    boxes can be done in parallel too
+// --------------------------------------------------------
+class FrustumCuller
+{
+private:
+	// A plane's components splatted across the lanes, plus their
+	// absolute values for projecting the extents onto the normal
+	struct SplatPlane
+	{
+		DirectX::XMVECTOR a, b, c, d;
+		DirectX::XMVECTOR absA, absB, absC;
+	};
+
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	unsigned int count;
+
+	std::vector<std::vector<unsigned int>> batchVisible;
+	std::vector<SplatPlane> viewPlanes;		// 6 per view
+	CullStats stats;
+
+	// Temporal cache, per box (padded like the bounds)
+	std::vector<float> motion;					// Distance moved (center + extents) since last tested
+	std::vector<float> cachedRadius;			// Length of the center + sum of the extents, when tested
+	std::vector<float> cachedSlack;				// Margin from flipping, relative to the reference planes
+	std::vector<unsigned int> cachedVisible;	// All bits set if visible
+	Frustum referenceFrustum;					// Planes at the last full refresh
+	std::vector<unsigned int> temporalVisible;	// First view's result, for CullViewsTemporal()
+	unsigned int cachedCount;
+	int framesSinceRefresh;
+	TemporalCullSettings temporalSettings;
+	TemporalCullStats temporalStats;
+
+	void SplatFrustum(const Frustum& frustum, SplatPlane* planes);
+	DirectX::XMVECTOR OutsideLanes(const SplatPlane* planes, unsigned int i);		// All bits set in lanes that are out
+	void CullRange(const SplatPlane* planes, unsigned int begin, unsigned int end, std::vector<unsigned int>& visible);
+	unsigned int CullViewsRange(int viewCount, unsigned int begin, unsigned int end, unsigned int* masks);
+	unsigned int CullTemporalRange(const SplatPlane* planes, float normalDrift, float distanceDrift, bool refresh, unsigned int begin, unsigned int end, std::vector<unsigned int>& visible);
+
+public:
+	FrustumCuller();
+
+	// Sets the number of boxes (new ones are empty, at the origin)
+	void Resize(unsigned int count);
+	void SetBounds(unsigned int index, const AABB& box);
+
+	// Replaces visible with the indices of every box at least
+	// partly inside the frustum, in ascending order
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& visible, bool parallel = true);
+
+	// Replaces masks with one entry per box: bit v is set if the
+	// box is at least partly inside frustums[v]
+	void CullViews(const Frustum* frustums, int viewCount, std::vector<unsigned int>& masks, bool parallel = true);
+
+	// Ascending indices of the boxes visible in one view of CullViews()'s masks
+	static void GetVisible(const std::vector<unsigned int>& masks, int view, std::vector<unsigned int>& visible);
+
+	// Same result as Cull(), reusing last frame's results for
+	// boxes that can't have changed sides of any plane
+	void CullTemporal(const Frustum& frustum, std::vector<unsigned int>& visible, bool parallel = true);
+
+	// Same masks as CullViews(), with the first view culled through
+	// CullTemporal() and the rest together
+	void CullViewsTemporal(const Frustum* frustums, int viewCount, std::vector<unsigned int>& masks, bool parallel = true);
+	void InvalidateTemporal();		// The next CullTemporal() tests everything
+
+	// Getters
+	unsigned int GetCount();
+	AABB GetBounds(unsigned int index);
+	CullStats GetStats();
+	TemporalCullStats GetTemporalStats();
+	TemporalCullSettings GetTemporalSettings();
+
+	// Setters
+	void SetGatherMs(double gatherMs);		// Reported in the stats alongside the cull time
+	void SetTemporalSettings(const TemporalCullSettings& settings);
+};
@@ -0,0 +1,738 @@
+#include "D3D11Backend.h"
+#include "Graphics.h"
+#include "PathHelpers.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Needed for loading textures
+#include <WICTextureLoader.h>
+
+// Needed for reading compiled shaders (for input layouts)
+#pragma comment(lib, "d3dcompiler.lib")
+#include <d3dcompiler.h>
+
+#include "ImGui/imgui.h"
+#include "ImGui/imgui_impl_dx11.h"
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// How a texture format is stored and viewed
+	// - Depth formats are typeless, so they can be viewed both
+	//    as depth and as a color for shaders
+	struct TextureFormats
+	{
+		DXGI_FORMAT texture;
+		DXGI_FORMAT color;
+		DXGI_FORMAT depth;
+	};
+
+	TextureFormats GetTextureFormats(int format)
+	{
+		switch (format)
+		{
+		case RENDER_FORMAT_R8: return { DXGI_FORMAT_R8_UNORM, DXGI_FORMAT_R8_UNORM, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_RG8: return { DXGI_FORMAT_R8G8_UNORM, DXGI_FORMAT_R8G8_UNORM, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_R16F: return { DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_RGBA8: return { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_R32F: return { DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_RG32F: return { DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_RGBA16F: return { DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_RGBA32F: return { DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_UNKNOWN };
+		case RENDER_FORMAT_DEPTH24_STENCIL8: return { DXGI_FORMAT_R24G8_TYPELESS, DXGI_FORMAT_R24_UNORM_X8_TYPELESS, DXGI_FORMAT_D24_UNORM_S8_UINT };
+		case RENDER_FORMAT_DEPTH32: return { DXGI_FORMAT_R32_TYPELESS, DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_D32_FLOAT };
+		default: return { DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_UNKNOWN };
+		}
+	}
+}
+
+D3D11Backend::D3D11Backend()
+{
+	// Placeholders: the views themselves live in Graphics::
+	backBuffer = RetagHandle<RenderTexture>(textures.Add({}));
+	depthBuffer = RetagHandle<RenderTexture>(textures.Add({}));
+
+	CreateStates();
+
+	// Tell the input assembler (IA) stage of the pipeline what kind of
+	// geometric primitives (points, lines or triangles) we want to draw.
+	// Essentially: "What kind of shape should the GPU draw with our vertices?"
+	Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+// --------------------------------------------------------
+// State objects for the fixed function modes
+// --------------------------------------------------------
+void D3D11Backend::CreateStates()
+{
+	// Ordinary alpha blending
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = true;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	Graphics::Device->CreateBlendState(&blendDesc, blendStates[RENDER_BLEND_ALPHA].GetAddressOf());
+
+	// Both tested against the scene but never written: the sky
+	// sits exactly at the far plane, transparent things are
+	// drawn after everything solid
+	D3D11_DEPTH_STENCIL_DESC dsDesc = {};
+	dsDesc.DepthEnable = true;
+	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	Graphics::Device->CreateDepthStencilState(&dsDesc, depthStates[RENDER_DEPTH_LESS_EQUAL].GetAddressOf());
+
+	dsDesc.DepthFunc = D3D11_COMPARISON_LESS;
+	Graphics::Device->CreateDepthStencilState(&dsDesc, depthStates[RENDER_DEPTH_READ_ONLY].GetAddressOf());
+
+	// Inside of the sky box
+	D3D11_RASTERIZER_DESC rsDesc = {};
+	rsDesc.FillMode = D3D11_FILL_SOLID;
+	rsDesc.CullMode = D3D11_CULL_FRONT;
+	Graphics::Device->CreateRasterizerState(&rsDesc, rasterStates[RENDER_RASTER_CULL_FRONT].GetAddressOf());
+
+	// Camera facing quads
+	rsDesc.CullMode = D3D11_CULL_NONE;
+	rsDesc.DepthClipEnable = true;
+	Graphics::Device->CreateRasterizerState(&rsDesc, rasterStates[RENDER_RASTER_CULL_NONE].GetAddressOf());
+
+	// Shadow map rendering
+	rsDesc.CullMode = D3D11_CULL_BACK;
+	rsDesc.DepthClipEnable = false; // Keep out-of-frustum objects!
+	rsDesc.DepthBias = 1000; // Min. precision units, not world units!
+	rsDesc.SlopeScaledDepthBias = 1.0f; // Bias more based on slope
+	Graphics::Device->CreateRasterizerState(&rsDesc, rasterStates[RENDER_RASTER_SHADOW].GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Handle lookups (null for stale handles)
+// --------------------------------------------------------
+ID3D11Buffer* D3D11Backend::GetBuffer(BufferHandle buffer)
+{
+	Buffer* b = buffers.Get(RetagHandle<Buffer>(buffer));
+	return b ? b->buffer.Get() : nullptr;
+}
+
+ID3D11ShaderResourceView* D3D11Backend::GetSRV(TextureHandle texture)
+{
+	Texture* t = textures.Get(RetagHandle<Texture>(texture));
+	return t ? t->srv.Get() : nullptr;
+}
+
+ID3D11RenderTargetView* D3D11Backend::GetRTV(TextureHandle texture)
+{
+	if (texture == backBuffer)
+		return Graphics::BackBufferRTV.Get();
+	Texture* t = textures.Get(RetagHandle<Texture>(texture));
+	return t ? t->rtv.Get() : nullptr;
+}
+
+ID3D11DepthStencilView* D3D11Backend::GetDSV(TextureHandle texture)
+{
+	if (texture == depthBuffer)
+		return Graphics::DepthBufferDSV.Get();
+	Texture* t = textures.Get(RetagHandle<Texture>(texture));
+	return t ? t->dsv.Get() : nullptr;
+}
+
+// --------------------------------------------------------
+// Buffers
+// --------------------------------------------------------
+BufferHandle D3D11Backend::CreateBuffer(RenderBufferDesc desc, const void* initialData)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = desc.size;
+	bufferDesc.Usage = desc.dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
+	bufferDesc.CPUAccessFlags = desc.dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	switch (desc.type)
+	{
+	case RENDER_BUFFER_VERTEX: bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; break;
+	case RENDER_BUFFER_INDEX: bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER; break;
+	case RENDER_BUFFER_CONSTANT: bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER; break;
+	case RENDER_BUFFER_STRUCTURED:
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = desc.stride;
+		break;
+	}
+
+	D3D11_SUBRESOURCE_DATA initial = {};
+	initial.pSysMem = initialData;
+
+	Buffer record = { nullptr, desc };
+	if (FAILED(Graphics::Device->CreateBuffer(&bufferDesc, initialData ? &initial : 0, record.buffer.GetAddressOf())))
+	{
+		printf("Could not create a %u byte buffer\n", desc.size);
+		stats.errors++;
+		return BufferHandle();
+	}
+
+	if (initialData)
+	{
+		stats.uploads++;
+		stats.uploadBytes += desc.size;
+	}
+	return RetagHandle<RenderBuffer>(buffers.Add(std::move(record)));
+}
+
+TextureHandle D3D11Backend::CreateBufferView(BufferHandle buffer)
+{
+	Buffer* b = buffers.Get(RetagHandle<Buffer>(buffer));
+	if (!b || b->desc.type != RENDER_BUFFER_STRUCTURED)
+	{
+		stats.errors++;
+		return TextureHandle();
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = b->desc.size / b->desc.stride;
+
+	Texture record = {};
+	if (FAILED(Graphics::Device->CreateShaderResourceView(b->buffer.Get(), &srvDesc, record.srv.GetAddressOf())))
+	{
+		printf("Could not create a buffer view\n");
+		stats.errors++;
+		return TextureHandle();
+	}
+	return RetagHandle<RenderTexture>(textures.Add(std::move(record)));
+}
+
+// --------------------------------------------------------
+// Replaces a dynamic buffer's contents (write discard)
+// - False only if the map fails (a successful map without
+//    memory is unmapped with nothing copied)
+// --------------------------------------------------------
+bool D3D11Backend::UpdateBuffer(BufferHandle buffer, const void* data, size_t bytes)
+{
+	ID3D11Buffer* b = GetBuffer(buffer);
+	if (!b)
+	{
+		stats.errors++;
+		return false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(Graphics::Context->Map(b, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		stats.errors++;
+		return false;
+	}
+	if (mapped.pData && bytes > 0)
+		memcpy(mapped.pData, data, bytes);
+	Graphics::Context->Unmap(b, 0);
+
+	stats.uploads++;
+	stats.uploadBytes += bytes;
+	return true;
+}
+
+void D3D11Backend::DestroyBuffer(BufferHandle buffer)
+{
+	buffers.Remove(RetagHandle<Buffer>(buffer));
+}
+
+// --------------------------------------------------------
+// Textures
+// --------------------------------------------------------
+TextureHandle D3D11Backend::CreateTexture(RenderTextureDesc desc)
+{
+	TextureFormats formats = GetTextureFormats(desc.format);
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = formats.texture;
+	textureDesc.MipLevels = 1;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	if (desc.flags & RENDER_TEXTURE_SHADER) textureDesc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	if (desc.flags & RENDER_TEXTURE_TARGET) textureDesc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+	if (desc.flags & RENDER_TEXTURE_DEPTH) textureDesc.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
+
+	// The views keep the texture alive
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Texture record = {};
+	bool created = SUCCEEDED(Graphics::Device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf()));
+
+	if (created && (desc.flags & RENDER_TEXTURE_SHADER))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = formats.color;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		created = SUCCEEDED(Graphics::Device->CreateShaderResourceView(texture.Get(), &srvDesc, record.srv.GetAddressOf()));
+	}
+	if (created && (desc.flags & RENDER_TEXTURE_TARGET))
+		created = SUCCEEDED(Graphics::Device->CreateRenderTargetView(texture.Get(), 0, record.rtv.GetAddressOf()));
+	if (created && (desc.flags & RENDER_TEXTURE_DEPTH))
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = formats.depth;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		dsvDesc.Texture2D.MipSlice = 0;
+		created = SUCCEEDED(Graphics::Device->CreateDepthStencilView(texture.Get(), &dsvDesc, record.dsv.GetAddressOf()));
+	}
+
+	if (!created)
+	{
+		printf("Could not create a %ux%u texture\n", desc.width, desc.height);
+		stats.errors++;
+		return TextureHandle();
+	}
+	return RetagHandle<RenderTexture>(textures.Add(std::move(record)));
+}
+
+TextureHandle D3D11Backend::LoadTexture(const std::wstring& path)
+{
+	Texture record = {};
+	if (FAILED(DirectX::CreateWICTextureFromFile(
+		Graphics::Device.Get(),
+		Graphics::Context.Get(),
+		FixPath(path).c_str(),
+		0,
+		record.srv.GetAddressOf())))
+	{
+		printf("Could not load %ls\n", path.c_str());
+		stats.errors++;
+		return TextureHandle();
+	}
+
+	stats.uploads++;
+	return RetagHandle<RenderTexture>(textures.Add(std::move(record)));
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Creates a cube map on the GPU from 6 individual textures
+// 
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Note: This code assumes youre putting the function in Sky.cpp, 
+//   youve included WICTextureLoader.h and you have an ID3D11Device 
+//   ComPtr called device.  Make any adjustments necessary for
+//   your own implementation.
+// --------------------------------------------------------
+// --------------------------------------------------------
+// Loads six individual textures (the six faces of a cube map), then
+// creates a blank cube map and copies each of the six textures to
+// another face.  Afterwards, creates a shader resource view for
+// the cube map and cleans up all of the temporary resources.
+// --------------------------------------------------------
+TextureHandle D3D11Backend::LoadCubemap(const std::wstring paths[6])
+{
+	// Load the 6 textures into an array.
+	// - We need references to the TEXTURES, not SHADER RESOURCE VIEWS!
+	// - Explicitly NOT generating mipmaps, as we don't need them for the sky!
+	// - Order matters here!  +X, -X, +Y, -Y, +Z, -Z
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6] = {};
+	for (int i = 0; i < 6; i++)
+	{
+		if (FAILED(DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), FixPath(paths[i]).c_str(), (ID3D11Resource**)textures[i].GetAddressOf(), 0)))
+		{
+			printf("Could not load %ls\n", paths[i].c_str());
+			stats.errors++;
+			return TextureHandle();
+		}
+	}
+
+	// We'll assume all of the textures are the same color format and resolution,
+	// so get the description of the first texture
+	D3D11_TEXTURE2D_DESC faceDesc = {};
+	textures[0]->GetDesc(&faceDesc);
+
+	// Describe the resource for the cube map, which is simply 
+	// a "texture 2d array" with the TEXTURECUBE flag set.  
+	// This is a special GPU resource format, NOT just a 
+	// C++ array of textures!!!
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.ArraySize = 6;            // Cube map!
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // We'll be using as a texture in a shader
+	cubeDesc.CPUAccessFlags = 0;       // No read back
+	cubeDesc.Format = faceDesc.Format; // Match the loaded texture's color format
+	cubeDesc.Width = faceDesc.Width;   // Match the size
+	cubeDesc.Height = faceDesc.Height; // Match the size
+	cubeDesc.MipLevels = 1;            // Only need 1
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; // This should be treated as a CUBE, not 6 separate textures
+	cubeDesc.Usage = D3D11_USAGE_DEFAULT; // Standard usage
+	cubeDesc.SampleDesc.Count = 1;
+	cubeDesc.SampleDesc.Quality = 0;
+
+	// Create the final texture resource to hold the cube map
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
+	Graphics::Device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
+
+	// Loop through the individual face textures and copy them,
+	// one at a time, to the cube map texure
+	for (int i = 0; i < 6; i++)
+	{
+		// Calculate the subresource position to copy into
+		unsigned int subresource = D3D11CalcSubresource(
+			0,  // Which mip (zero, since there's only one)
+			i,  // Which array element?
+			1); // How many mip levels are in the texture?
+
+		// Copy from one resource (texture) to another
+		Graphics::Context->CopySubresourceRegion(
+			cubeMapTexture.Get(),  // Destination resource
+			subresource,           // Dest subresource index (one of the array elements)
+			0, 0, 0,               // XYZ location of copy
+			textures[i].Get(),     // Source resource
+			0,                     // Source subresource index (we're assuming there's only one)
+			0);                    // Source subresource "box" of data to copy (zero means the whole thing)
+	}
+
+	// At this point, all of the faces have been copied into the 
+	// cube map texture, so we can describe a shader resource view for it
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = cubeDesc.Format;         // Same format as texture
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE; // Treat this as a cube!
+	srvDesc.TextureCube.MipLevels = 1;        // Only need access to 1 mip
+	srvDesc.TextureCube.MostDetailedMip = 0;  // Index of the first mip we want to see
+
+	// Make the SRV
+	Texture record = {};
+	Graphics::Device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, record.srv.GetAddressOf());
+
+	// Send back a handle to the SRV, which is what we need for our shaders
+	stats.uploads++;
+	return RetagHandle<RenderTexture>(this->textures.Add(std::move(record)));
+}
+
+void D3D11Backend::DestroyTexture(TextureHandle texture)
+{
+	if (texture == backBuffer || texture == depthBuffer)
+		return;
+	textures.Remove(RetagHandle<Texture>(texture));
+}
+
+TextureHandle D3D11Backend::GetBackBuffer() { return backBuffer; }
+TextureHandle D3D11Backend::GetDepthBuffer() { return depthBuffer; }
+
+// --------------------------------------------------------
+// Shaders and samplers
+// --------------------------------------------------------
+ShaderHandle D3D11Backend::LoadVertexShader(const std::wstring& path, int input)
+{
+	Shader record = {};
+	record.vs = Graphics::LoadVertexShader(path);
+	if (!record.vs)
+	{
+		printf("Could not load %ls\n", path.c_str());
+		stats.errors++;
+		return ShaderHandle();
+	}
+
+	if (input == RENDER_INPUT_VERTEX)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob;
+		D3DReadFileToBlob(FixPath(path).c_str(), vertexShaderBlob.GetAddressOf());
+
+		// Create an input layout
+		//  - This describes the layout of data sent to a vertex shader
+		//  - In other words, it describes how to interpret data (numbers) in a vertex buffer
+		//  - Doing this NOW because it requires a vertex shader's byte code to verify against!
+		//  - Luckily, we already have that loaded (the vertex shader blob above)
+		D3D11_INPUT_ELEMENT_DESC inputElements[4] = {};
+
+		// Set up the first element - a position, which is 3 float values
+		inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// Most formats are described as color channels; really it just means "Three 32-bit floats"
+		inputElements[0].SemanticName = "POSITION";							// This is "POSITION" - needs to match the semantics in our vertex shader input!
+		inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// How far into the vertex is this?  Assume it's after the previous element
+
+		// Set up the second element - a UV coordinate, which is 2 float values
+		inputElements[1].Format = DXGI_FORMAT_R32G32_FLOAT;					// 2x 32-bit floats
+		inputElements[1].SemanticName = "TEXCOORD";							// Match our vertex shader input!
+		inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
+
+		// Set up the third element - a normal, which is 3 float values
+		inputElements[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// 3x 32-bit floats
+		inputElements[2].SemanticName = "NORMAL";							// Match our vertex shader input!
+		inputElements[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
+
+		// Set up the fourth element - a tangent, which is 3 more float values
+		inputElements[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+		inputElements[3].SemanticName = "TANGENT";
+		inputElements[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+
+		// Create the input layout, verifying our description against actual shader code
+		Graphics::Device->CreateInputLayout(
+			inputElements,							// An array of descriptions
+			4,										// How many elements in that array?
+			vertexShaderBlob->GetBufferPointer(),	// Pointer to the code of a shader that uses this layout
+			vertexShaderBlob->GetBufferSize(),		// Size of the shader code that uses this layout
+			record.inputLayout.GetAddressOf());		// Address of the resulting ID3D11InputLayout pointer
+	}
+
+	return RetagHandle<RenderShader>(shaders.Add(std::move(record)));
+}
+
+ShaderHandle D3D11Backend::LoadPixelShader(const std::wstring& path)
+{
+	Shader record = {};
+	record.ps = Graphics::LoadPixelShader(path);
+	if (!record.ps)
+	{
+		printf("Could not load %ls\n", path.c_str());
+		stats.errors++;
+		return ShaderHandle();
+	}
+	return RetagHandle<RenderShader>(shaders.Add(std::move(record)));
+}
+
+SamplerHandle D3D11Backend::CreateSampler(int kind)
+{
+	D3D11_SAMPLER_DESC sd = {};
+	switch (kind)
+	{
+	case RENDER_SAMPLER_WRAP_ANISOTROPIC:
+		sd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		sd.Filter = D3D11_FILTER_ANISOTROPIC;
+		sd.MaxAnisotropy = 16;
+		sd.MaxLOD = D3D11_FLOAT32_MAX;
+		break;
+	case RENDER_SAMPLER_CLAMP_LINEAR:
+		sd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sd.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sd.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		sd.MaxLOD = D3D11_FLOAT32_MAX;
+		break;
+	case RENDER_SAMPLER_SHADOW:
+		sd.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
+		sd.ComparisonFunc = D3D11_COMPARISON_LESS;
+		sd.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+		sd.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+		sd.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+		sd.BorderColor[0] = 1.0f; // Only need the first component
+		break;
+	default:
+		stats.errors++;
+		return SamplerHandle();
+	}
+
+	Sampler record = {};
+	if (FAILED(Graphics::Device->CreateSamplerState(&sd, record.sampler.GetAddressOf())))
+	{
+		stats.errors++;
+		return SamplerHandle();
+	}
+	return RetagHandle<RenderSampler>(samplers.Add(std::move(record)));
+}
+
+// --------------------------------------------------------
+// State target: straight through to the device context
+// --------------------------------------------------------
+void D3D11Backend::SetVertexShader(ShaderHandle vs)
+{
+	stats.binds++;
+	Shader* shader = shaders.Get(RetagHandle<Shader>(vs));
+	Graphics::Context->VSSetShader(shader ? shader->vs.Get() : nullptr, 0, 0);
+
+	// Each vertex shader brings the layout of what it reads
+	Graphics::Context->IASetInputLayout(shader ? shader->inputLayout.Get() : nullptr);
+}
+
+void D3D11Backend::SetPixelShader(ShaderHandle ps)
+{
+	stats.binds++;
+	Shader* shader = shaders.Get(RetagHandle<Shader>(ps));
+	Graphics::Context->PSSetShader(shader ? shader->ps.Get() : nullptr, 0, 0);
+}
+
+void D3D11Backend::SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures)
+{
+	stats.binds++;
+	ID3D11ShaderResourceView* srvs[RENDER_MAX_SHADER_RESOURCES] = {};
+	for (unsigned int i = 0; i < count && i < RENDER_MAX_SHADER_RESOURCES; i++)
+		srvs[i] = GetSRV(textures[i]);
+	Graphics::Context->PSSetShaderResources(startSlot, count, srvs);
+}
+
+void D3D11Backend::SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers)
+{
+	stats.binds++;
+	ID3D11SamplerState* states[RENDER_MAX_SAMPLERS] = {};
+	for (unsigned int i = 0; i < count && i < RENDER_MAX_SAMPLERS; i++)
+	{
+		Sampler* s = this->samplers.Get(RetagHandle<Sampler>(samplers[i]));
+		states[i] = s ? s->sampler.Get() : nullptr;
+	}
+	Graphics::Context->PSSetSamplers(startSlot, count, states);
+}
+
+void D3D11Backend::SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	stats.binds++;
+	ID3D11Buffer* b = GetBuffer(buffer);
+	UINT strides[1] = { stride };
+	UINT offsets[1] = { offset };
+	Graphics::Context->IASetVertexBuffers(0, 1, &b, strides, offsets);
+}
+
+void D3D11Backend::SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset)
+{
+	stats.binds++;
+	Graphics::Context->IASetIndexBuffer(
+		GetBuffer(buffer),
+		format == RENDER_INDEX_16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
+		offset);
+}
+
+// --------------------------------------------------------
+// Targets
+// --------------------------------------------------------
+void D3D11Backend::SetRenderTargets(unsigned int count, const TextureHandle* targets, TextureHandle depth)
+{
+	stats.binds++;
+	ID3D11RenderTargetView* rtvs[RENDER_MAX_TARGETS] = {};
+	for (unsigned int i = 0; i < count && i < RENDER_MAX_TARGETS; i++)
+		rtvs[i] = GetRTV(targets[i]);
+	Graphics::Context->OMSetRenderTargets(count, rtvs, GetDSV(depth));
+}
+
+void D3D11Backend::ClearRenderTarget(TextureHandle target, const float color[4])
+{
+	ID3D11RenderTargetView* rtv = GetRTV(target);
+	if (rtv)
+		Graphics::Context->ClearRenderTargetView(rtv, color);
+}
+
+void D3D11Backend::ClearDepth(TextureHandle depth, float value)
+{
+	ID3D11DepthStencilView* dsv = GetDSV(depth);
+	if (dsv)
+		Graphics::Context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, value, 0);
+}
+
+void D3D11Backend::SetViewport(unsigned int width, unsigned int height)
+{
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)width;
+	viewport.Height = (float)height;
+	viewport.MaxDepth = 1.0f;
+	Graphics::Context->RSSetViewports(1, &viewport);
+}
+
+// --------------------------------------------------------
+// Fixed function state
+// --------------------------------------------------------
+void D3D11Backend::SetBlendMode(int mode)
+{
+	Graphics::Context->OMSetBlendState(blendStates[mode].Get(), 0, 0xFFFFFFFF);
+}
+
+void D3D11Backend::SetDepthMode(int mode)
+{
+	Graphics::Context->OMSetDepthStencilState(depthStates[mode].Get(), 0);
+}
+
+void D3D11Backend::SetRasterMode(int mode)
+{
+	Graphics::Context->RSSetState(rasterStates[mode].Get());
+}
+
+// --------------------------------------------------------
+// Resources outside the state cache
+// --------------------------------------------------------
+void D3D11Backend::SetVertexShaderResource(unsigned int slot, TextureHandle texture)
+{
+	stats.binds++;
+	ID3D11ShaderResourceView* srv = GetSRV(texture);
+	Graphics::Context->VSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11Backend::SetConstantBuffer(int stage, unsigned int slot, BufferHandle buffer)
+{
+	stats.binds++;
+	ID3D11Buffer* b = GetBuffer(buffer);
+	if (stage == RENDER_STAGE_VERTEX)
+		Graphics::Context->VSSetConstantBuffers(slot, 1, &b);
+	else
+		Graphics::Context->PSSetConstantBuffers(slot, 1, &b);
+}
+
+void D3D11Backend::SetConstants(int stage, unsigned int slot, const void* data, unsigned int size)
+{
+	stats.binds++;
+	stats.uploads++;
+	stats.uploadBytes += size;
+	Graphics::FillAndBindNextConstantBuffer(
+		const_cast<void*>(data),
+		size,
+		stage == RENDER_STAGE_VERTEX ? D3D11_VERTEX_SHADER : D3D11_PIXEL_SHADER,
+		slot);
+}
+
+// --------------------------------------------------------
+// Drawing
+// --------------------------------------------------------
+void D3D11Backend::Draw(unsigned int vertexCount)
+{
+	stats.draws++;
+	Graphics::Context->Draw(vertexCount, 0);
+}
+
+void D3D11Backend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	stats.draws++;
+	Graphics::Context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11Backend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex)
+{
+	stats.draws++;
+	Graphics::Context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, 0);
+}
+
+void D3D11Backend::Present()
+{
+	bool vsync = Graphics::VsyncState();
+	Graphics::SwapChain->Present(
+		vsync ? 1 : 0,
+		vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+}
+
+// --------------------------------------------------------
+// ImGui renderer
+// --------------------------------------------------------
+void D3D11Backend::InitUI()
+{
+	ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
+}
+
+void D3D11Backend::NewUIFrame()
+{
+	ImGui_ImplDX11_NewFrame();
+}
+
+void D3D11Backend::RenderUI(ImDrawData* drawData)
+{
+	ImGui_ImplDX11_RenderDrawData(drawData);
+}
+
+void D3D11Backend::ShutDownUI()
+{
+	ImGui_ImplDX11_Shutdown();
+}
+
+void* D3D11Backend::GetUITexture(TextureHandle texture)
+{
+	return GetSRV(texture);
+}
+
+const char* D3D11Backend::GetName() { return "D3D11"; }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// The backend on Graphics::Device and Graphics::Context
+//
+// - Each handle's record owns the D3D objects, so destroying
+//    a handle releases them (anything still bound stays alive
+//    until the context lets go of it)
+// - The back and depth buffers are looked up through
+//    Graphics:: on every use, so their handles stay good
+//    across ResizeBuffers()
+// - Create it after Graphics::Initialize()
+// --------------------------------------------------------
+class D3D11Backend : public RenderBackend
+{
+private:
+	struct Buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		RenderBufferDesc desc;
+	};
+
+	struct Texture
+	{
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+	};
+
+	struct Shader
+	{
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> ps;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	};
+
+	struct Sampler
+	{
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
+	};
+
+	Pool<Buffer> buffers;
+	Pool<Texture> textures;
+	Pool<Shader> shaders;
+	Pool<Sampler> samplers;
+
+	TextureHandle backBuffer;
+	TextureHandle depthBuffer;
+
+	// One state object per mode (the defaults are null)
+	Microsoft::WRL::ComPtr<ID3D11BlendState> blendStates[RENDER_BLEND_MODES];
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthStates[RENDER_DEPTH_MODES];
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterStates[RENDER_RASTER_MODES];
+
+	ID3D11Buffer* GetBuffer(BufferHandle buffer);
+	ID3D11ShaderResourceView* GetSRV(TextureHandle texture);
+	ID3D11RenderTargetView* GetRTV(TextureHandle texture);
+	ID3D11DepthStencilView* GetDSV(TextureHandle texture);
+
+	void CreateStates();
+
+public:
+	D3D11Backend();
+
+	BufferHandle CreateBuffer(RenderBufferDesc desc, const void* initialData) override;
+	TextureHandle CreateBufferView(BufferHandle buffer) override;
+	bool UpdateBuffer(BufferHandle buffer, const void* data, size_t bytes) override;
+	void DestroyBuffer(BufferHandle buffer) override;
+
+	TextureHandle CreateTexture(RenderTextureDesc desc) override;
+	TextureHandle LoadTexture(const std::wstring& path) override;
+	TextureHandle LoadCubemap(const std::wstring paths[6]) override;
+	void DestroyTexture(TextureHandle texture) override;
+	TextureHandle GetBackBuffer() override;
+	TextureHandle GetDepthBuffer() override;
+
+	ShaderHandle LoadVertexShader(const std::wstring& path, int input) override;
+	ShaderHandle LoadPixelShader(const std::wstring& path) override;
+	SamplerHandle CreateSampler(int kind) override;
+
+	void SetVertexShader(ShaderHandle vs) override;
+	void SetPixelShader(ShaderHandle ps) override;
+	void SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures) override;
+	void SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers) override;
+	void SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset) override;
+
+	void SetRenderTargets(unsigned int count, const TextureHandle* targets, TextureHandle depth) override;
+	void ClearRenderTarget(TextureHandle target, const float color[4]) override;
+	void ClearDepth(TextureHandle depth, float value) override;
+	void SetViewport(unsigned int width, unsigned int height) override;
+
+	void SetBlendMode(int mode) override;
+	void SetDepthMode(int mode) override;
+	void SetRasterMode(int mode) override;
+
+	void SetVertexShaderResource(unsigned int slot, TextureHandle texture) override;
+	void SetConstantBuffer(int stage, unsigned int slot, BufferHandle buffer) override;
+	void SetConstants(int stage, unsigned int slot, const void* data, unsigned int size) override;
+
+	void Draw(unsigned int vertexCount) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex) override;
+	void Present() override;
+
+	void InitUI() override;
+	void NewUIFrame() override;
+	void RenderUI(ImDrawData* drawData) override;
+	void ShutDownUI() override;
+	void* GetUITexture(TextureHandle texture) override;
+
+	const char* GetName() override;
+};
@@ -3,17 +3,21 @@
 
 #define MAX_LIGHTS 128
 
+// Per material
 cbuffer ExternalData : register(b0)
 {
     float4 colorTint;
-    float totalTime;
-    float3 intensities;
     float2 scale;
     float2 offset;
+}
+
+// Per frame
+cbuffer FrameData : register(b1)
+{
+    float totalTime;
+    float3 intensities;
     float3 cameraPos;
     float padding1;
-    float3 ambientColor;
-    float padding2;
     Light lights[MAX_LIGHTS];
     int lightCount;
 }
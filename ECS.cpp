@@ -0,0 +1,252 @@
+#include "ECS.h"
+
+#include <cstring>
+
+World::World()
+{
+}
+
+Archetype* World::GetArchetype(ComponentMask mask)
+{
+	auto it = archetypeLookup.find(mask);
+	if (it != archetypeLookup.end())
+		return it->second;
+
+	auto archetype = std::make_unique<Archetype>();
+	archetype->mask = mask;
+	archetype->entityCount = 0;
+
+	// How much one entity needs across all of its arrays
+	unsigned int bytesPerEntity = sizeof(Entity);
+	for (int c = 0; c < ECS_COMPONENT_COUNT; c++)
+		if (mask & (1u << c))
+			bytesPerEntity += ComponentSizes[c];
+
+	// Lay the arrays out back to back (16-byte aligned for SIMD loads),
+	// shrinking the capacity until the padding fits too
+	for (unsigned int capacity = ECS_CHUNK_BYTES / bytesPerEntity; capacity > 0; capacity--)
+	{
+		unsigned int offset = 0;
+		for (int c = 0; c < ECS_COMPONENT_COUNT; c++)
+		{
+			if (!(mask & (1u << c)))
+			{
+				archetype->offsets[c] = ECS_NO_COMPONENT;
+				continue;
+			}
+			offset = (offset + 15) & ~15u;
+			archetype->offsets[c] = offset;
+			offset += ComponentSizes[c] * capacity;
+		}
+		offset = (offset + 15) & ~15u;
+		archetype->entityOffset = offset;
+		offset += sizeof(Entity) * capacity;
+
+		if (offset <= ECS_CHUNK_BYTES)
+		{
+			archetype->capacity = capacity;
+			break;
+		}
+	}
+
+	Archetype* result = archetype.get();
+	archetypes.push_back(std::move(archetype));
+	archetypeLookup[mask] = result;
+	return result;
+}
+
+EntityLocation World::AllocateRow(Archetype* archetype, Entity entity)
+{
+	// Only the last chunk can have room
+	if (archetype->chunks.empty() || archetype->chunks.back()->count == archetype->capacity)
+	{
+		auto chunk = std::make_unique<Chunk>();
+		chunk->archetype = archetype;
+		chunk->count = 0;
+		archetype->chunks.push_back(std::move(chunk));
+	}
+
+	Chunk* chunk = archetype->chunks.back().get();
+	EntityLocation location = {};
+	location.archetype = archetype;
+	location.chunk = (unsigned int)archetype->chunks.size() - 1;
+	location.row = chunk->count;
+
+	chunk->GetEntities()[location.row] = entity;
+	chunk->count++;
+	archetype->entityCount++;
+	return location;
+}
+
+void World::RemoveRow(EntityLocation location)
+{
+	Archetype* archetype = location.archetype;
+	Chunk* hole = archetype->chunks[location.chunk].get();
+	Chunk* last = archetype->chunks.back().get();
+	unsigned int lastRow = last->count - 1;
+
+	// Move the archetype's very last entity into the hole so
+	// every chunk but the last stays full
+	if (hole != last || location.row != lastRow)
+	{
+		for (int c = 0; c < ECS_COMPONENT_COUNT; c++)
+		{
+			unsigned int offset = archetype->offsets[c];
+			if (offset == ECS_NO_COMPONENT)
+				continue;
+			unsigned int size = ComponentSizes[c];
+			memcpy(hole->data + offset + size * location.row, last->data + offset + size * lastRow, size);
+		}
+
+		Entity moved = last->GetEntities()[lastRow];
+		hole->GetEntities()[location.row] = moved;
+		*entities.Get(moved) = location;
+	}
+
+	last->count--;
+	archetype->entityCount--;
+	if (last->count == 0)
+		archetype->chunks.pop_back();
+}
+
+void* World::GetComponentData(Entity entity, int componentID)
+{
+	EntityLocation* location = entities.Get(entity);
+	if (!location)
+		return nullptr;
+
+	unsigned int offset = location->archetype->offsets[componentID];
+	if (offset == ECS_NO_COMPONENT)
+		return nullptr;
+
+	Chunk* chunk = location->archetype->chunks[location->chunk].get();
+	return chunk->data + offset + ComponentSizes[componentID] * location->row;
+}
+
+Entity World::CreateEntity(ComponentMask mask)
+{
+	Archetype* archetype = GetArchetype(mask);
+	Entity entity = entities.Emplace();
+	if (entity.IsNull())
+		return entity;
+
+	EntityLocation location = AllocateRow(archetype, entity);
+	*entities.Get(entity) = location;
+
+	// Zero the new row
+	Chunk* chunk = archetype->chunks[location.chunk].get();
+	for (int c = 0; c < ECS_COMPONENT_COUNT; c++)
+	{
+		unsigned int offset = archetype->offsets[c];
+		if (offset != ECS_NO_COMPONENT)
+			memset(chunk->data + offset + ComponentSizes[c] * location.row, 0, ComponentSizes[c]);
+	}
+
+	return entity;
+}
+
+void World::DestroyEntity(Entity entity)
+{
+	EntityLocation* location = entities.Get(entity);
+	if (!location)
+		return;
+
+	RemoveRow(*location);
+	entities.Remove(entity);
+}
+
+void World::SetMask(Entity entity, ComponentMask mask)
+{
+	EntityLocation* location = entities.Get(entity);
+	if (!location || location->archetype->mask == mask)
+		return;
+
+	EntityLocation from = *location;
+	Archetype* target = GetArchetype(mask);
+	EntityLocation to = AllocateRow(target, entity);
+
+	// Carry over the components both archetypes have, zero the new ones
+	Chunk* src = from.archetype->chunks[from.chunk].get();
+	Chunk* dst = target->chunks[to.chunk].get();
+	for (int c = 0; c < ECS_COMPONENT_COUNT; c++)
+	{
+		unsigned int dstOffset = target->offsets[c];
+		if (dstOffset == ECS_NO_COMPONENT)
+			continue;
+
+		unsigned int size = ComponentSizes[c];
+		unsigned int srcOffset = from.archetype->offsets[c];
+		if (srcOffset != ECS_NO_COMPONENT)
+			memcpy(dst->data + dstOffset + size * to.row, src->data + srcOffset + size * from.row, size);
+		else
+			memset(dst->data + dstOffset + size * to.row, 0, size);
+	}
+
+	RemoveRow(from);
+	*entities.Get(entity) = to;
+}
+
+void World::Reserve(ComponentMask mask, unsigned int count)
+{
+	Archetype* archetype = GetArchetype(mask);
+	unsigned int chunkCount = (count + archetype->capacity - 1) / archetype->capacity;
+	archetype->chunks.reserve(chunkCount);
+	entities.Reserve(entities.Size() + count);
+}
+
+void World::Clear()
+{
+	// Archetypes are kept (their layouts don't change) but all chunks go
+	for (auto& a : archetypes)
+	{
+		a->chunks.clear();
+		a->entityCount = 0;
+	}
+	entities.Clear();
+}
+
+bool World::IsAlive(Entity entity)
+{
+	return entities.IsValid(entity);
+}
+
+ComponentMask World::GetMask(Entity entity)
+{
+	EntityLocation* location = entities.Get(entity);
+	return location ? location->archetype->mask : 0;
+}
+
+void World::GetChunks(ComponentMask required, std::vector<Chunk*>& out)
+{
+	out.clear();
+	for (auto& a : archetypes)
+	{
+		if ((a->mask & required) != required)
+			continue;
+		for (auto& c : a->chunks)
+			out.push_back(c.get());
+	}
+}
+
+unsigned int World::GetEntityCount()
+{
+	return entities.Size();
+}
+
+unsigned int World::GetArchetypeCount()
+{
+	return (unsigned int)archetypes.size();
+}
+
+unsigned int World::GetChunkCount()
+{
+	unsigned int count = 0;
+	for (auto& a : archetypes)
+		count += (unsigned int)a->chunks.size();
+	return count;
+}
+
+size_t World::GetMemoryUsage()
+{
+	return (size_t)GetChunkCount() * sizeof(Chunk) + (size_t)entities.Size() * sizeof(EntityLocation);
+}
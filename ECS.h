@@ -0,0 +1,226 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <execution>
+
+#include "HandlePool.h"
+#include "Resources.h"
+
+// Size of one block of component storage
+#define ECS_CHUNK_BYTES (16 * 1024)
+
+// Number of component types below (IDs must be 0 to count - 1)
+#define ECS_COMPONENT_COUNT 6
+
+// Offset used for components an archetype doesn't have
+#define ECS_NO_COMPONENT 0xFFFFFFFF
+
+typedef unsigned int ComponentMask;
+
+// --------------------------------------------------------
+// Components
+//
+// - Plain data only: they're moved around with memcpy
+// - Each has a unique ID, which is its bit in a ComponentMask
+// --------------------------------------------------------
+struct LocalTransform
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 pitchYawRoll;
+	DirectX::XMFLOAT3 scale;
+	static const int ID = 0;
+};
+
+struct WorldMatrix
+{
+	DirectX::XMFLOAT4X4 world;
+	static const int ID = 1;
+};
+
+struct Velocity
+{
+	DirectX::XMFLOAT3 linear;
+	static const int ID = 2;
+};
+
+struct AngularVelocity
+{
+	DirectX::XMFLOAT3 pitchYawRoll;	// Radians per second
+	static const int ID = 3;
+};
+
+struct MeshRenderer
+{
+	MeshHandle mesh;
+	MaterialHandle material;
+	int lod;						// Detail level, picked by Systems::SelectLODs
+	static const int ID = 4;
+};
+
+// LocalTransform before the current simulation step, so moving
+// entities can be drawn between steps (like Transform)
+struct PreviousTransform
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 pitchYawRoll;
+	DirectX::XMFLOAT3 scale;
+	static const int ID = 5;
+};
+
+inline const unsigned int ComponentSizes[ECS_COMPONENT_COUNT] =
+{
+	sizeof(LocalTransform),
+	sizeof(WorldMatrix),
+	sizeof(Velocity),
+	sizeof(AngularVelocity),
+	sizeof(MeshRenderer),
+	sizeof(PreviousTransform),
+};
+
+// Builds a mask from a list of component types: ComponentsOf<LocalTransform, Velocity>()
+template<typename... T>
+constexpr ComponentMask ComponentsOf() { return ((1u << T::ID) | ... | 0u); }
+
+// --------------------------------------------------------
+// Entities are handles into the world's location table
+// --------------------------------------------------------
+struct Archetype;
+
+struct EntityLocation
+{
+	Archetype* archetype;
+	unsigned int chunk;
+	unsigned int row;
+};
+
+typedef Handle<EntityLocation> Entity;
+
+// --------------------------------------------------------
+// A fixed-size block holding up to "capacity" entities of
+// one archetype, with each component in its own array
+// --------------------------------------------------------
+struct Chunk
+{
+	Archetype* archetype;
+	unsigned int count;
+	alignas(64) unsigned char data[ECS_CHUNK_BYTES];
+
+	// Array of the given component (nullptr if the archetype doesn't have it)
+	template<typename T> T* Get();
+	Entity* GetEntities();
+};
+
+// --------------------------------------------------------
+// Every entity with exactly the same set of components
+// --------------------------------------------------------
+struct Archetype
+{
+	ComponentMask mask;
+	unsigned int capacity;							// Entities per chunk
+	unsigned int offsets[ECS_COMPONENT_COUNT];		// Byte offset of each component array in a chunk
+	unsigned int entityOffset;						// Byte offset of the entity array in a chunk
+
+	// All chunks but the last are always full
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	unsigned int entityCount;
+};
+
+template<typename T>
+T* Chunk::Get()
+{
+	unsigned int offset = archetype->offsets[T::ID];
+	return offset == ECS_NO_COMPONENT ? nullptr : (T*)(data + offset);
+}
+
+inline Entity* Chunk::GetEntities()
+{
+	return (Entity*)(data + archetype->entityOffset);
+}
+
+// --------------------------------------------------------
+// Owns all archetypes and their entities
+//
+// - Systems query for a set of components and get back every
+//    chunk whose archetype has (at least) all of them
+// - Pointers to components are only valid until the next
+//    structural change (create, destroy, add/remove component)
+// --------------------------------------------------------
+class World
+{
+private:
+	std::vector<std::unique_ptr<Archetype>> archetypes;
+	std::unordered_map<ComponentMask, Archetype*> archetypeLookup;
+	Pool<EntityLocation> entities;
+
+	Archetype* GetArchetype(ComponentMask mask);
+	EntityLocation AllocateRow(Archetype* archetype, Entity entity);
+	void RemoveRow(EntityLocation location);
+	void* GetComponentData(Entity entity, int componentID);
+
+public:
+	World();
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	// Structural changes
+	Entity CreateEntity(ComponentMask mask);	// Components start zeroed
+	void DestroyEntity(Entity entity);
+	void SetMask(Entity entity, ComponentMask mask);	// Moves the entity to another archetype
+	void Reserve(ComponentMask mask, unsigned int count);
+	void Clear();
+
+	template<typename T> void AddComponent(Entity entity, const T& value)
+	{
+		SetMask(entity, GetMask(entity) | ComponentsOf<T>());
+		*GetComponent<T>(entity) = value;
+	}
+
+	template<typename T> void RemoveComponent(Entity entity)
+	{
+		SetMask(entity, GetMask(entity) & ~ComponentsOf<T>());
+	}
+
+	// Per-entity access (nullptr for dead entities or missing components)
+	template<typename T> T* GetComponent(Entity entity)
+	{
+		return (T*)GetComponentData(entity, T::ID);
+	}
+
+	bool IsAlive(Entity entity);
+	ComponentMask GetMask(Entity entity);
+
+	// Queries
+	void GetChunks(ComponentMask required, std::vector<Chunk*>& out);
+
+	template<typename Func>
+	void ForEachChunk(ComponentMask required, Func func)
+	{
+		for (auto& a : archetypes)
+		{
+			if ((a->mask & required) != required)
+				continue;
+			for (auto& c : a->chunks)
+				func(*c);
+		}
+	}
+
+	// Chunks are independent, so they can be handed to
+	// separate threads as long as func only writes to its own
+	template<typename Func>
+	void ForEachChunkParallel(ComponentMask required, Func func)
+	{
+		std::vector<Chunk*> chunks;
+		GetChunks(required, chunks);
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](Chunk* c) { func(*c); });
+	}
+
+	// Stats
+	unsigned int GetEntityCount();
+	unsigned int GetArchetypeCount();
+	unsigned int GetChunkCount();
+	size_t GetMemoryUsage();
+};
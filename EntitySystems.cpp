@@ -0,0 +1,235 @@
+#include "EntitySystems.h"
+
+#include <atomic>
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename Func>
+	void RunQuery(World& world, ComponentMask required, bool parallel, Func func)
+	{
+		if (parallel)
+			world.ForEachChunkParallel(required, func);
+		else
+			world.ForEachChunk(required, func);
+	}
+}
+
+void Systems::Move(World& world, float deltaTime, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, bool parallel)
+{
+	XMVECTOR minV = XMLoadFloat3(&boundsMin);
+	XMVECTOR maxV = XMLoadFloat3(&boundsMax);
+
+	RunQuery(world, ComponentsOf<LocalTransform, Velocity>(), parallel, [=](Chunk& chunk)
+	{
+		LocalTransform* transforms = chunk.Get<LocalTransform>();
+		Velocity* velocities = chunk.Get<Velocity>();
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			XMVECTOR pos = XMLoadFloat3(&transforms[i].position);
+			XMVECTOR vel = XMLoadFloat3(&velocities[i].linear);
+			pos = XMVectorMultiplyAdd(vel, XMVectorReplicate(deltaTime), pos);
+
+			// Flip the velocity on any axis that left the bounds
+			XMVECTOR outside = XMVectorOrInt(XMVectorLess(pos, minV), XMVectorGreater(pos, maxV));
+			vel = XMVectorSelect(vel, XMVectorNegate(vel), outside);
+			pos = XMVectorClamp(pos, minV, maxV);
+
+			XMStoreFloat3(&transforms[i].position, pos);
+			XMStoreFloat3(&velocities[i].linear, vel);
+		}
+	});
+}
+
+void Systems::Spin(World& world, float deltaTime, bool parallel)
+{
+	RunQuery(world, ComponentsOf<LocalTransform, AngularVelocity>(), parallel, [=](Chunk& chunk)
+	{
+		LocalTransform* transforms = chunk.Get<LocalTransform>();
+		AngularVelocity* spins = chunk.Get<AngularVelocity>();
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			XMVECTOR rot = XMLoadFloat3(&transforms[i].pitchYawRoll);
+			rot = XMVectorMultiplyAdd(XMLoadFloat3(&spins[i].pitchYawRoll), XMVectorReplicate(deltaTime), rot);
+
+			// Keep the angles from growing without bound
+			XMStoreFloat3(&transforms[i].pitchYawRoll, XMVectorModAngles(rot));
+		}
+	});
+}
+
+void Systems::UpdateWorldMatrices(World& world, bool parallel)
+{
+	RunQuery(world, ComponentsOf<LocalTransform, WorldMatrix>(), parallel, [](Chunk& chunk)
+	{
+		LocalTransform* transforms = chunk.Get<LocalTransform>();
+		WorldMatrix* worlds = chunk.Get<WorldMatrix>();
+
+		// Same S * R * T order as Transform
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&transforms[i].scale));
+			XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&transforms[i].pitchYawRoll));
+			XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&transforms[i].position));
+			XMStoreFloat4x4(&worlds[i].world, s * r * t);
+		}
+	});
+}
+
+void Systems::StorePreviousTransforms(World& world, bool parallel)
+{
+	RunQuery(world, ComponentsOf<LocalTransform, PreviousTransform>(), parallel, [](Chunk& chunk)
+	{
+		LocalTransform* transforms = chunk.Get<LocalTransform>();
+		PreviousTransform* previous = chunk.Get<PreviousTransform>();
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			previous[i].position = transforms[i].position;
+			previous[i].pitchYawRoll = transforms[i].pitchYawRoll;
+			previous[i].scale = transforms[i].scale;
+		}
+	});
+}
+
+void Systems::InterpolateWorldMatrices(World& world, float alpha, bool parallel)
+{
+	RunQuery(world, ComponentsOf<LocalTransform, WorldMatrix>(), parallel, [=](Chunk& chunk)
+	{
+		LocalTransform* transforms = chunk.Get<LocalTransform>();
+		PreviousTransform* previous = chunk.Get<PreviousTransform>();
+		WorldMatrix* worlds = chunk.Get<WorldMatrix>();
+
+		// Entities that never move have nothing to blend
+		if (!previous)
+		{
+			for (unsigned int i = 0; i < chunk.count; i++)
+			{
+				XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&transforms[i].scale));
+				XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&transforms[i].pitchYawRoll));
+				XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&transforms[i].position));
+				XMStoreFloat4x4(&worlds[i].world, s * r * t);
+			}
+			return;
+		}
+
+		// Positions and scales linearly, rotations as quaternions
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			XMVECTOR p = XMVectorLerp(XMLoadFloat3(&previous[i].position), XMLoadFloat3(&transforms[i].position), alpha);
+			XMVECTOR s = XMVectorLerp(XMLoadFloat3(&previous[i].scale), XMLoadFloat3(&transforms[i].scale), alpha);
+			XMVECTOR q = XMQuaternionSlerp(
+				XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&previous[i].pitchYawRoll)),
+				XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&transforms[i].pitchYawRoll)),
+				alpha);
+			XMStoreFloat4x4(&worlds[i].world,
+				XMMatrixScalingFromVector(s) * XMMatrixRotationQuaternion(q) * XMMatrixTranslationFromVector(p));
+		}
+	});
+}
+
+unsigned int Systems::SelectLODs(World& world, XMFLOAT3 cameraPosition, float projectionScale, const LODSettings& settings, bool parallel)
+{
+	std::atomic<unsigned int> changes = 0;
+	RunQuery(world, ComponentsOf<WorldMatrix, MeshRenderer>(), parallel, [&](Chunk& chunk)
+	{
+		WorldMatrix* worlds = chunk.Get<WorldMatrix>();
+		MeshRenderer* renderers = chunk.Get<MeshRenderer>();
+		unsigned int chunkChanges = 0;
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			Mesh* mesh = Resources::Meshes.Get(renderers[i].mesh);
+			if (!mesh)
+				continue;
+
+			AABB bounds = Bounds::TransformAABB(mesh->GetBounds(), worlds[i].world);
+			float size = LOD::ScreenSize(bounds, cameraPosition, projectionScale);
+			int level = LOD::SelectLevel(size, renderers[i].lod, mesh->GetLODCount(), settings);
+			if (level != renderers[i].lod)
+			{
+				renderers[i].lod = level;
+				chunkChanges++;
+			}
+		}
+		changes += chunkChanges;
+	});
+	return changes;
+}
+
+void Systems::BuildDrawList(World& world, std::vector<DrawItem>& drawList, bool parallel)
+{
+	std::vector<Chunk*> chunks;
+	world.GetChunks(ComponentsOf<WorldMatrix, MeshRenderer>(), chunks);
+
+	// Each chunk writes to its own range of the list, so
+	// find where those ranges start before filling them
+	std::vector<unsigned int> firstItem(chunks.size());
+	unsigned int total = 0;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		firstItem[i] = total;
+		total += chunks[i]->count;
+	}
+	drawList.resize(total);
+
+	auto fill = [&](Chunk*& chunkRef)
+	{
+		Chunk& chunk = *chunkRef;
+		DrawItem* out = &drawList[firstItem[&chunkRef - chunks.data()]];
+		WorldMatrix* worlds = chunk.Get<WorldMatrix>();
+		MeshRenderer* renderers = chunk.Get<MeshRenderer>();
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			out[i].mesh = renderers[i].mesh;
+			out[i].material = renderers[i].material;
+			out[i].world = &worlds[i].world;
+			out[i].lod = renderers[i].lod;
+		}
+	};
+
+	if (parallel)
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), fill);
+	else
+		std::for_each(chunks.begin(), chunks.end(), fill);
+}
+
+void Systems::GatherBounds(World& world, FrustumCuller& culler, unsigned int firstIndex, bool parallel)
+{
+	std::vector<Chunk*> chunks;
+	world.GetChunks(ComponentsOf<WorldMatrix, MeshRenderer>(), chunks);
+
+	// Same ranges as BuildDrawList
+	std::vector<unsigned int> firstItem(chunks.size());
+	unsigned int total = firstIndex;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		firstItem[i] = total;
+		total += chunks[i]->count;
+	}
+
+	auto gather = [&](Chunk*& chunkRef)
+	{
+		Chunk& chunk = *chunkRef;
+		unsigned int out = firstItem[&chunkRef - chunks.data()];
+		WorldMatrix* worlds = chunk.Get<WorldMatrix>();
+		MeshRenderer* renderers = chunk.Get<MeshRenderer>();
+
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			// No mesh: an empty box (the draw loop skips it anyway)
+			Mesh* mesh = Resources::Meshes.Get(renderers[i].mesh);
+			AABB bounds = mesh ? Bounds::TransformAABB(mesh->GetBounds(), worlds[i].world) : AABB{};
+			culler.SetBounds(out + i, bounds);
+		}
+	};
+
+	if (parallel)
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), gather);
+	else
+		std::for_each(chunks.begin(), chunks.end(), gather);
+}
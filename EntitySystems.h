@@ -0,0 +1,57 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Culling.h"
+#include "ECS.h"
+#include "LevelOfDetail.h"
+
+// One thing to draw, produced from WorldMatrix + MeshRenderer
+// - world points into chunk memory, so the list is only valid
+//    until the next structural change to the world
+struct DrawItem
+{
+	MeshHandle mesh;
+	MaterialHandle material;
+	const DirectX::XMFLOAT4X4* world;
+	int lod;
+};
+
+// --------------------------------------------------------
+// Systems that run over the ECS world
+//
+// - Each one only touches the chunks that have the components
+//    it needs, and runs chunks in parallel unless told not to
+// --------------------------------------------------------
+namespace Systems
+{
+	// LocalTransform + Velocity: moves and bounces off the bounds
+	void Move(World& world, float deltaTime, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, bool parallel = true);
+
+	// LocalTransform + AngularVelocity
+	void Spin(World& world, float deltaTime, bool parallel = true);
+
+	// LocalTransform + WorldMatrix
+	void UpdateWorldMatrices(World& world, bool parallel = true);
+
+	// LocalTransform + PreviousTransform: call before each simulation step
+	void StorePreviousTransforms(World& world, bool parallel = true);
+
+	// LocalTransform + WorldMatrix: the render matrices, blended from
+	// PreviousTransform by alpha (0 = previous, 1 = current) where
+	// there is one, as Transform::Interpolate() does
+	void InterpolateWorldMatrices(World& world, float alpha, bool parallel = true);
+
+	// WorldMatrix + MeshRenderer: picks each renderer's detail level
+	// from its screen size (returns how many changed level)
+	unsigned int SelectLODs(World& world, DirectX::XMFLOAT3 cameraPosition, float projectionScale, const LODSettings& settings, bool parallel = true);
+
+	// WorldMatrix + MeshRenderer (replaces the contents of drawList)
+	void BuildDrawList(World& world, std::vector<DrawItem>& drawList, bool parallel = true);
+
+	// WorldMatrix + MeshRenderer: world space boxes into culler, in the
+	// same order as BuildDrawList, starting at firstIndex (the culler
+	// must already be big enough)
+	void GatherBounds(World& world, FrustumCuller& culler, unsigned int firstIndex, bool parallel = true);
+}
@@ -0,0 +1,324 @@
+#include "FrameGraph.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	bool SameDesc(const FrameGraphTextureDesc& a, const FrameGraphTextureDesc& b)
+	{
+		return a.width == b.width && a.height == b.height && a.format == b.format;
+	}
+}
+
+FrameGraph::FrameGraph() :
+	stats{},
+	compiled(false)
+{
+}
+
+void FrameGraph::Reset()
+{
+	textures.clear();
+	passes.clear();
+	compiled = false;
+}
+
+FrameGraphResource FrameGraph::CreateTexture(const std::string& name, FrameGraphTextureDesc desc)
+{
+	Texture texture = {};
+	texture.name = name;
+	texture.desc = desc;
+	texture.target = true;
+	texture.firstPass = texture.lastPass = texture.physical = -1;
+	textures.push_back(texture);
+	compiled = false;
+	return (FrameGraphResource)textures.size() - 1;
+}
+
+FrameGraphResource FrameGraph::Import(const std::string& name, TextureHandle handle, bool exported, bool target)
+{
+	Texture texture = {};
+	texture.name = name;
+	texture.imported = true;
+	texture.exported = exported;
+	texture.handle = handle;
+	texture.target = target;
+	texture.firstPass = texture.lastPass = texture.physical = -1;
+	textures.push_back(texture);
+	compiled = false;
+	return (FrameGraphResource)textures.size() - 1;
+}
+
+void FrameGraph::Export(FrameGraphResource resource)
+{
+	if (resource < 0 || resource >= (int)textures.size())
+		return;
+	textures[resource].exported = true;
+	compiled = false;
+}
+
+int FrameGraph::AddPass(const std::string& name, std::function<void()> execute)
+{
+	Pass pass = {};
+	pass.name = name;
+	pass.execute = execute;
+	passes.push_back(pass);
+	compiled = false;
+	return (int)passes.size() - 1;
+}
+
+void FrameGraph::Read(int pass, FrameGraphResource resource, int slot)
+{
+	if (pass < 0 || pass >= (int)passes.size() || resource < 0 || resource >= (int)textures.size() || slot >= FRAME_GRAPH_MAX_SLOTS)
+	{
+		printf("Frame graph: bad read (pass %i, texture %i, slot %i)\n", pass, resource, slot);
+		return;
+	}
+
+	Access access = {};
+	access.resource = resource;
+	access.slot = slot;
+	passes[pass].reads.push_back(access);
+	compiled = false;
+}
+
+void FrameGraph::Write(int pass, FrameGraphResource resource, const float* clearColor)
+{
+	if (pass < 0 || pass >= (int)passes.size() || resource < 0 || resource >= (int)textures.size() ||
+		passes[pass].writes.size() >= FRAME_GRAPH_MAX_TARGETS)
+	{
+		printf("Frame graph: bad write (pass %i, texture %i)\n", pass, resource);
+		return;
+	}
+
+	Access access = {};
+	access.resource = resource;
+	access.slot = -1;
+	access.clear = clearColor != nullptr;
+	if (clearColor)
+		std::copy(clearColor, clearColor + 4, access.clearColor);
+	passes[pass].writes.push_back(access);
+	compiled = false;
+}
+
+void FrameGraph::SetDepth(int pass, TextureHandle depth)
+{
+	if (pass >= 0 && pass < (int)passes.size())
+		passes[pass].depth = depth;
+}
+
+void FrameGraph::Compile()
+{
+	auto start = Clock::now();
+	stats = {};
+	stats.passes = (unsigned int)passes.size();
+	for (const Texture& texture : textures)
+		stats.textures += !texture.imported;
+
+	CullPasses();
+	ComputeLifetimes();
+	AliasTextures();
+	FindUnbinds();
+
+	compiled = true;
+	stats.compileMs = ElapsedMs(start);
+}
+
+void FrameGraph::CullPasses()
+{
+	// Back to front: a pass lives if something later reads (or
+	// the frame exports) what it writes, and then what it reads
+	// is needed too
+	std::vector<bool> needed(textures.size());
+	for (size_t t = 0; t < textures.size(); t++)
+		needed[t] = textures[t].exported;
+
+	for (int p = (int)passes.size() - 1; p >= 0; p--)
+	{
+		Pass& pass = passes[p];
+
+		// Nothing to go by for passes that write nothing, so they stay
+		bool live = pass.writes.empty();
+		for (const Access& write : pass.writes)
+			live = live || needed[write.resource];
+
+		pass.culled = !live;
+		stats.culledPasses += pass.culled;
+		if (live)
+			for (const Access& read : pass.reads)
+				needed[read.resource] = true;
+	}
+}
+
+void FrameGraph::ComputeLifetimes()
+{
+	for (Texture& texture : textures)
+		texture.firstPass = texture.lastPass = texture.physical = -1;
+
+	for (int p = 0; p < (int)passes.size(); p++)
+	{
+		if (passes[p].culled)
+			continue;
+
+		auto touch = [&](const Access& access)
+		{
+			Texture& texture = textures[access.resource];
+			if (texture.firstPass < 0)
+				texture.firstPass = p;
+			texture.lastPass = p;
+		};
+		for (const Access& read : passes[p].reads)
+			touch(read);
+		for (const Access& write : passes[p].writes)
+			touch(write);
+	}
+
+	// Exported textures outlive every pass
+	for (Texture& texture : textures)
+		if (texture.exported && texture.firstPass >= 0)
+			texture.lastPass = (int)passes.size();
+}
+
+void FrameGraph::AliasTextures()
+{
+	for (PooledTexture& pooled : pool)
+	{
+		pooled.lastPass = -1;
+		pooled.used = false;
+	}
+
+	// By when they start: each takes the first pooled texture
+	// that matches and is free by then, or a new one
+	std::vector<int> order;
+	for (int t = 0; t < (int)textures.size(); t++)
+		if (!textures[t].imported && textures[t].firstPass >= 0)
+			order.push_back(t);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return textures[a].firstPass < textures[b].firstPass; });
+
+	for (int t : order)
+	{
+		Texture& texture = textures[t];
+		int physical = -1;
+		for (int i = 0; i < (int)pool.size() && physical < 0; i++)
+			if (SameDesc(pool[i].desc, texture.desc) && (!pool[i].used || pool[i].lastPass < texture.firstPass))
+				physical = i;
+
+		if (physical < 0)
+		{
+			PooledTexture pooled = {};
+			pooled.desc = texture.desc;
+			pool.push_back(pooled);
+			physical = (int)pool.size() - 1;
+		}
+
+		pool[physical].used = true;
+		pool[physical].lastPass = texture.lastPass;
+		texture.physical = physical;
+		stats.usedTextures++;
+		stats.unaliasedBytes += GetTextureBytes(texture.desc);
+	}
+
+	// Release what this frame doesn't use (disabled effects,
+	// an old size)
+	std::vector<int> remap(pool.size(), -1);
+	int kept = 0;
+	for (int i = 0; i < (int)pool.size(); i++)
+	{
+		if (!pool[i].used)
+		{
+			released.push_back(pool[i].texture);
+			continue;
+		}
+		remap[i] = kept;
+		if (kept != i)
+			pool[kept] = std::move(pool[i]);
+		kept++;
+	}
+	pool.resize(kept);
+	for (Texture& texture : textures)
+		if (texture.physical >= 0)
+			texture.physical = remap[texture.physical];
+
+	stats.physicalTextures = (unsigned int)pool.size();
+	for (const PooledTexture& pooled : pool)
+		stats.peakBytes += GetTextureBytes(pooled.desc);
+}
+
+void FrameGraph::FindUnbinds()
+{
+	// A slot is unbound after a pass when a later pass writes the
+	// texture underneath it (so it's never both an input and an
+	// output), or after its last use this frame (the next frame
+	// may write it first: a pooled texture gets reused, and an
+	// imported one like the shadow map is redrawn)
+	for (int p = 0; p < (int)passes.size(); p++)
+	{
+		Pass& pass = passes[p];
+		pass.unbindSlots.clear();
+		if (pass.culled)
+			continue;
+
+		for (const Access& read : pass.reads)
+		{
+			if (read.slot < 0)
+				continue;
+
+			int memory = GetMemory(read.resource);
+			bool writtenLater = false;
+			for (int q = p + 1; q < (int)passes.size() && !writtenLater; q++)
+			{
+				if (passes[q].culled)
+					continue;
+				for (const Access& write : passes[q].writes)
+					writtenLater = writtenLater || GetMemory(write.resource) == memory;
+			}
+
+			if (writtenLater || textures[read.resource].lastPass == p)
+			{
+				pass.unbindSlots.push_back(read.slot);
+				stats.unbinds++;
+			}
+		}
+	}
+}
+
+int FrameGraph::GetMemory(FrameGraphResource resource)
+{
+	const Texture& texture = textures[resource];
+	return texture.imported ? (int)pool.size() + resource : texture.physical;
+}
+
+size_t FrameGraph::GetTextureBytes(FrameGraphTextureDesc desc)
+{
+	return (size_t)desc.width * desc.height * RenderFormatBytes(desc.format);
+}
+
+// Getters
+bool FrameGraph::IsCulled(int pass) { return passes[pass].culled; }
+int FrameGraph::GetPassCount() { return (int)passes.size(); }
+const std::string& FrameGraph::GetPassName(int pass) { return passes[pass].name; }
+double FrameGraph::GetPassMs(int pass) { return passes[pass].executeMs; }
+int FrameGraph::GetFirstPass(FrameGraphResource resource) { return textures[resource].firstPass; }
+int FrameGraph::GetLastPass(FrameGraphResource resource) { return textures[resource].lastPass; }
+int FrameGraph::GetPhysical(FrameGraphResource resource) { return textures[resource].physical; }
+FrameGraphStats FrameGraph::GetStats() { return stats; }
+
+TextureHandle FrameGraph::GetTexture(FrameGraphResource resource)
+{
+	const Texture& texture = textures[resource];
+	if (texture.imported)
+		return texture.handle;
+	return texture.physical >= 0 && texture.physical < (int)pool.size() ? pool[texture.physical].texture : TextureHandle();
+}
+
+TextureHandle FrameGraph::FindTexture(const std::string& name)
+{
+	for (FrameGraphResource t = 0; t < (int)textures.size(); t++)
+		if (textures[t].name == name)
+			return GetTexture(t);
+	return TextureHandle();
+}
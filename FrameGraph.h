@@ -0,0 +1,166 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "RenderBackend.h"
+
+class StateCache;
+
+// Render targets a pass can write at once, and shader
+// resource slots the graph binds for it
+#define FRAME_GRAPH_MAX_TARGETS 8
+#define FRAME_GRAPH_MAX_SLOTS 16
+
+// A texture in the graph (an index; the back buffer and other
+// textures from outside are imported)
+typedef int FrameGraphResource;
+#define FRAME_GRAPH_NONE -1
+
+// What a transient texture needs to be (textures with the same
+// description can share memory)
+struct FrameGraphTextureDesc
+{
+	unsigned int width;
+	unsigned int height;
+	int format;							// RENDER_FORMAT_*
+};
+
+// What the last Compile() and Execute() did
+struct FrameGraphStats
+{
+	unsigned int passes;
+	unsigned int culledPasses;			// Nothing reads what they write
+	unsigned int textures;				// Transient textures declared
+	unsigned int usedTextures;			// Transient textures live passes touch
+	unsigned int physicalTextures;		// What they're aliased onto
+	unsigned int unbinds;				// SRV slots cleared before the texture is written again
+	size_t unaliasedBytes;				// Every used transient texture on its own
+	size_t peakBytes;					// Transient memory after aliasing
+	double compileMs;
+	double executeMs;
+};
+
+// --------------------------------------------------------
+// A frame's passes, declared up front with what they read
+// and write, then compiled and run in declaration order
+//
+// - Passes whose outputs nothing reads are culled (writing an
+//    imported, exported texture like the back buffer counts
+//    as being read)
+// - Each transient texture lives from the first live pass
+//    that touches it to the last; textures with the same
+//    description whose lifetimes don't overlap share one
+//    pooled texture (D3D11 has no placed resources, so a
+//    whole texture is the unit of aliasing)
+// - Before a pass runs, the graph binds and clears its render
+//    targets and binds the reads given a slot; after it, it
+//    unbinds the slots whose texture a later pass writes, and
+//    each texture's slots after its last use (the next frame
+//    may write it before reading it)
+// - Reads are bound and unbound through the frame's state
+//    cache, so it always knows what's in those slots; a pass
+//    may bind around the cache, so it's invalidated after each
+// - The pool is kept between frames and only grows or shrinks
+//    when the frame's needs change (what it drops is destroyed
+//    at the next Execute())
+// - Compile() only plans; Execute() creates textures and binds
+//    them through Graphics::Backend, and lives in
+//    FrameGraphExecute.cpp
+// --------------------------------------------------------
+class FrameGraph
+{
+private:
+	struct Texture
+	{
+		std::string name;
+		FrameGraphTextureDesc desc;
+		bool imported;
+		bool exported;					// Kept to the end of the frame (and its writers kept)
+		TextureHandle handle;			// Imported textures
+		bool target;					// Bound as a render target by the graph when written
+		int firstPass;					// Lifetime, over live passes (-1 if unused)
+		int lastPass;
+		int physical;					// Pooled texture it lives in (-1 if imported or unused)
+	};
+
+	struct Access
+	{
+		FrameGraphResource resource;
+		int slot;						// Reads: pixel shader slot the graph binds (-1: the pass binds it)
+		bool clear;						// Writes: cleared to clearColor first
+		float clearColor[4];
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void()> execute;
+		std::vector<Access> reads;
+		std::vector<Access> writes;
+		TextureHandle depth;
+		bool culled;
+		std::vector<int> unbindSlots;	// After it runs
+		double executeMs;				// Binds, clears and the pass itself, last Execute()
+	};
+
+	struct PooledTexture
+	{
+		FrameGraphTextureDesc desc;
+		int lastPass;					// Of the texture in it now, while compiling
+		bool used;
+		TextureHandle texture;			// Render target and shader resource
+	};
+
+	std::vector<Texture> textures;
+	std::vector<Pass> passes;
+	std::vector<PooledTexture> pool;
+	std::vector<TextureHandle> released;	// Dropped from the pool, not destroyed yet
+	FrameGraphStats stats;
+	bool compiled;
+
+	void CullPasses();
+	void ComputeLifetimes();
+	void AliasTextures();
+	void FindUnbinds();
+	int GetMemory(FrameGraphResource resource);		// Same number: same texture underneath
+	bool CreatePooledTexture(PooledTexture& pooled);
+
+public:
+	FrameGraph();
+
+	// Drops the passes and textures (the pool stays)
+	void Reset();
+
+	// Textures
+	FrameGraphResource CreateTexture(const std::string& name, FrameGraphTextureDesc desc);
+	FrameGraphResource Import(const std::string& name, TextureHandle texture, bool exported, bool target = true);	// Not a target: its writers bind it (depth, say)
+	void Export(FrameGraphResource resource);
+
+	// Passes
+	int AddPass(const std::string& name, std::function<void()> execute);
+	void Read(int pass, FrameGraphResource resource, int slot = -1);
+	void Write(int pass, FrameGraphResource resource, const float* clearColor = nullptr);
+	void SetDepth(int pass, TextureHandle depth);
+
+	// Culls, finds lifetimes, aliases and places the unbinds
+	void Compile();
+
+	// Creates the pooled textures it needs, then runs the live passes
+	bool Execute(StateCache& states);
+
+	static size_t GetTextureBytes(FrameGraphTextureDesc desc);
+
+	// Getters
+	bool IsCulled(int pass);
+	int GetPassCount();
+	const std::string& GetPassName(int pass);
+	double GetPassMs(int pass);
+	int GetFirstPass(FrameGraphResource resource);
+	int GetLastPass(FrameGraphResource resource);
+	int GetPhysical(FrameGraphResource resource);
+	TextureHandle GetTexture(FrameGraphResource resource);
+	TextureHandle FindTexture(const std::string& name);		// As of the last Execute(), null if culled
+	FrameGraphStats GetStats();
+};
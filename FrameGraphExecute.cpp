@@ -0,0 +1,84 @@
+#include "FrameGraph.h"
+#include "StateCache.h"
+#include "Timing.h"
+
+#include <cstdio>
+
+// --------------------------------------------------------
+// The backend side of the graph, kept apart so Compile() builds
+// and runs on its own (see Tests.cpp)
+// --------------------------------------------------------
+bool FrameGraph::CreatePooledTexture(PooledTexture& pooled)
+{
+	RenderTextureDesc desc = {};
+	desc.width = pooled.desc.width;
+	desc.height = pooled.desc.height;
+	desc.format = pooled.desc.format;
+	desc.flags = RENDER_TEXTURE_TARGET | RENDER_TEXTURE_SHADER;
+	pooled.texture = Graphics::Backend->CreateTexture(desc);
+	if (pooled.texture.IsNull())
+	{
+		printf("Frame graph: could not create a %ux%u texture\n", pooled.desc.width, pooled.desc.height);
+		return false;
+	}
+	return true;
+}
+
+bool FrameGraph::Execute(StateCache& states)
+{
+	if (!compiled)
+		Compile();
+
+	auto start = Clock::now();
+	for (TextureHandle texture : released)
+		Graphics::Backend->DestroyTexture(texture);
+	released.clear();
+
+	for (PooledTexture& pooled : pool)
+		if (pooled.texture.IsNull() && !CreatePooledTexture(pooled))
+			return false;
+
+	for (Pass& pass : passes)
+	{
+		pass.executeMs = 0;
+		if (pass.culled)
+			continue;
+
+		auto passStart = Clock::now();
+		// Targets (passes that write nothing bindable, like the
+		// shadow pass, bind their own)
+		TextureHandle targets[FRAME_GRAPH_MAX_TARGETS] = {};
+		unsigned int targetCount = 0;
+		for (const Access& write : pass.writes)
+		{
+			TextureHandle target = GetTexture(write.resource);
+			if (target.IsNull() || !textures[write.resource].target)
+				continue;
+			targets[targetCount++] = target;
+			if (write.clear)
+				Graphics::Backend->ClearRenderTarget(target, write.clearColor);
+		}
+		if (targetCount > 0 || !pass.depth.IsNull())
+			Graphics::Backend->SetRenderTargets(targetCount, targets, pass.depth);
+
+		for (const Access& read : pass.reads)
+		{
+			if (read.slot < 0)
+				continue;
+			states.SetPixelShaderResource(read.slot, GetTexture(read.resource));
+		}
+		states.Commit();
+
+		if (pass.execute)
+			pass.execute();
+
+		states.Invalidate();
+		for (int slot : pass.unbindSlots)
+			states.SetPixelShaderResource(slot, TextureHandle());
+		states.Commit();
+		pass.executeMs = ElapsedMs(passStart);
+	}
+
+	stats.executeMs = ElapsedMs(start);
+	return true;
+}
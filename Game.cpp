@@ -6,19 +6,14 @@
 #include "Window.h"
 
 #include <string>
+#include <filesystem>
+#include <numeric>
 #include <DirectXMath.h>
 
-// Needed for loading textures
-#include <WICTextureLoader.h>
-
-// Needed for a helper function to load pre-compiled shader files
-#pragma comment(lib, "d3dcompiler.lib")
-#include <d3dcompiler.h>
-
 // This code assumes files are in "ImGui" subfolder!
 // Adjust as necessary for your own folder structure and project setup
+// (the renderer side is the backend's)
 #include "ImGui/imgui.h"
-#include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
 
 // For the DirectX Math library
@@ -36,12 +31,52 @@ Game::Game() :
 	textInput("edit this text"),
 	rotateX(false),
 	rotateY(false),
-	rotateZ(false)
+	rotateZ(false),
+	benchmarkLayout(SCENE_LAYOUT_UNIFORM),
+	sceneMeshCount(0),
+	sceneMaterialCount(0),
+	sceneFileSize(0),
+	sceneOpenMs(0),
+	sceneInstantiateMs(0),
+	sceneFirstFrameMs(0),
+	sceneFirstFramePending(false),
+	bulkEntityCount(10000),
+	bulkLayout(SCENE_LAYOUT_UNIFORM),
+	bulkSeed(1),
+	bulkMovingFraction(0.25f),
+	bulkSpinningFraction(0.33f),
+	bulkLightCount(0),
+	bulkBoundsMin(-20.0f, -3.0f, -20.0f),
+	bulkBoundsMax(20.0f, 6.0f, 20.0f),
+	lodSettings(LOD::DefaultSettings()),
+	lodStats(),
+	cullingEnabled(true),
+	cullingParallel(true),
+	temporalCulling(false),
+	occlusionEnabled(true),
+	occluderBudget(32),
+	occluderMinScreenSize(0.1f),
+	stateCache(Graphics::Backend),
+	instancingEnabled(true),
+	mainPassDrawCalls(0),
+	mainPassSubmitMs(0),
+	lastDrawCalls{},
+	lastSubmitMs{},
+	lightingMode(LIGHTING_CLUSTERED),
+	lightBudgetCount(MAX_LIGHTS * 3 / 4),
+	octree(XMFLOAT3(0.0f, 0.0f, 0.0f), 64.0f, 5),
+	querySphereRadius(5.0f),
+	pickedEntity(-1),
+	openPickedEntity(false),
+	frameTimings{},
+	ppPreviewOpen(false)
 	//ambientColor(0.1f, 0.1f, 0.25f)
 {
 	// Set ups
 	CreateEntities();
-	SetUpInputLayoutAndGraphics();
+	CreateAnimations();
+	CreateEmitters();
+	SetUpGraphics();
 
 	// Create Cameras
 	{
@@ -73,8 +108,9 @@ Game::Game() :
 		// Initialize ImGui itself & platform/renderer backends
 		IMGUI_CHECKVERSION();
 		ImGui::CreateContext();
-		ImGui_ImplWin32_Init(Window::Handle());
-		ImGui_ImplDX11_Init(Graphics::Device.Get(), Graphics::Context.Get());
+		if (Window::Handle())
+			ImGui_ImplWin32_Init(Window::Handle());
+		Graphics::Backend->InitUI();
 		// Pick a style (uncomment one of these 3)
 		ImGui::StyleColorsDark();
 		//ImGui::StyleColorsLight();
@@ -87,16 +123,20 @@ Game::Game() :
 		// Set some initial data for the vs constant buffer
 		DirectX::XMStoreFloat4x4(&vsData.world, XMMatrixIdentity());
 		DirectX::XMStoreFloat4x4(&vsData.worldInvTranspose, XMMatrixIdentity());
-		DirectX::XMStoreFloat4x4(&vsData.view, XMMatrixIdentity());
-		DirectX::XMStoreFloat4x4(&vsData.projection, XMMatrixIdentity());
+		vsFrameData = {};
+		DirectX::XMStoreFloat4x4(&vsFrameData.view, XMMatrixIdentity());
+		DirectX::XMStoreFloat4x4(&vsFrameData.projection, XMMatrixIdentity());
 
 		psData = {};
-		// Set some initial data for the ps constant buffer
-		psData.intensities = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		// Set some initial data for the ps constant buffers
 		psData.scale = XMFLOAT2(1.0f, 1.0f);
 		psData.offset = XMFLOAT2(0.0f, 0.0f);
-		psData.cameraPos = XMFLOAT3(0.0f, 0.0f, 0.0f);
-		//psData.ambientColor = ambientColor;
+		psFrameData = {};
+		psFrameData.intensities = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		psFrameData.cameraPos = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		//psFrameData.ambientColor = ambientColor;
+
+		constantBufferStats = {};
 
 		shadowOptions = {};
 		// Set some initial data for the shadow mapping options struct
@@ -117,6 +157,313 @@ Game::Game() :
 	CreateShadowMapResources();
 }
 
+// --------------------------------------------------------
+// Fill the ECS world with a generated stress scene of count
+// small props (static, moving and spinning ones), using
+// the bulk layout, seed and light settings
+// --------------------------------------------------------
+void Game::CreateBulkEntities(int count)
+{
+	streamer.Close(world);
+	world.Clear();
+
+	// A slab around the default scene's floor, as wide as it needs to be
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(count, bulkLayout, (unsigned int)bulkSeed);
+	settings.worldHalfSize = std::max(20.0f, 0.5f * std::sqrt((float)count));
+	settings.minHeight = -3.0f;
+	settings.maxHeight = 6.0f;
+	settings.clusterRadius = std::max(2.0f, settings.worldHalfSize / std::sqrt((float)settings.clusterCount) * 0.5f);
+	settings.hotSpotRadius = std::max(2.0f, settings.worldHalfSize * 0.05f);
+	settings.minScale = 0.1f;
+	settings.maxScale = 0.3f;
+	settings.pointLightCount = bulkLightCount * 2 / 3;
+	settings.spotLightCount = bulkLightCount - settings.pointLightCount;
+	settings.lightRange = 8.0f;
+	settings.movingEntityFraction = bulkMovingFraction;
+	settings.spinningEntityFraction = bulkSpinningFraction;
+
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	bulkBoundsMin = scene.boundsMin;
+	bulkBoundsMax = scene.boundsMax;
+
+	// Generated mesh and material indices to the loaded ones
+	std::vector<MeshHandle> sceneMeshes;
+	for (size_t i = 0; i < scene.data.meshNames.size(); i++)
+		sceneMeshes.push_back(LoadMesh(scene.data.meshNames[i], scene.data.meshPaths[i]));
+	std::vector<MaterialHandle> sceneMaterials;
+	for (auto& name : scene.data.materialNames)
+		sceneMaterials.push_back(FindMaterial(name));
+
+	// Moving and spinning entities keep their previous transform,
+	// to be drawn between simulation steps
+	const ComponentMask renderable = ComponentsOf<LocalTransform, WorldMatrix, MeshRenderer>();
+	const ComponentMask moves = ComponentsOf<Velocity, PreviousTransform>();
+	const ComponentMask spins = ComponentsOf<AngularVelocity, PreviousTransform>();
+	for (int i = 0; i < count; i++)
+	{
+		const SceneEntityRecord& record = scene.data.entities[i];
+		const XMFLOAT3& velocity = scene.entityVelocities[i];
+		const XMFLOAT3& spin = scene.entitySpins[i];
+		ComponentMask mask = renderable;
+		if (velocity.x != 0.0f || velocity.y != 0.0f || velocity.z != 0.0f) mask |= moves;
+		if (spin.x != 0.0f || spin.y != 0.0f || spin.z != 0.0f) mask |= spins;
+		Entity e = world.CreateEntity(mask);
+
+		LocalTransform* t = world.GetComponent<LocalTransform>(e);
+		t->position = record.position;
+		t->pitchYawRoll = record.pitchYawRoll;
+		t->scale = record.scale;
+		if (PreviousTransform* p = world.GetComponent<PreviousTransform>(e))
+			*p = { t->position, t->pitchYawRoll, t->scale };
+
+		MeshRenderer* r = world.GetComponent<MeshRenderer>(e);
+		r->mesh = sceneMeshes[record.mesh];
+		r->material = sceneMaterials[record.material];
+
+		if (Velocity* v = world.GetComponent<Velocity>(e))
+			v->linear = velocity;
+		if (AngularVelocity* a = world.GetComponent<AngularVelocity>(e))
+			a->pitchYawRoll = spin;
+	}
+
+	// Swap in the generated lights (the sun first, so shadows still work)
+	if (bulkLightCount > 0)
+	{
+		size_t lightCount = std::min(scene.data.lights.size(), (size_t)MAX_CLUSTERED_LIGHTS);
+		lights.assign(scene.data.lights.begin(), scene.data.lights.begin() + lightCount);
+		lightVelocities.assign(scene.lightVelocities.begin(), scene.lightVelocities.begin() + lightCount);
+		lightBudget.Reset();
+	}
+
+	// Matrices for the first frame
+	Systems::UpdateWorldMatrices(world);
+}
+
+// --------------------------------------------------------
+// Pick a detail level for every entity from its size on
+// the active camera's screen
+// - One batched pass before any drawing, so the shadow
+//    pass uses the same levels as the main pass
+// --------------------------------------------------------
+void Game::SelectLODs()
+{
+	Clock::time_point start = Clock::now();
+	XMFLOAT3 cameraPosition = cameras[activeCamera]->GetTransform()->GetPosition();
+	float projectionScale = cameras[activeCamera]->GetProjection()._22;
+
+	unsigned int changes = 0;
+	for (auto& entity : entities)
+	{
+		Mesh* mesh = entity.GetMesh();
+		if (!mesh)
+			continue;
+
+		float size = LOD::ScreenSize(entity.GetWorldBounds(), cameraPosition, projectionScale);
+		int level = LOD::SelectLevel(size, entity.GetLOD(), mesh->GetLODCount(), lodSettings);
+		if (level != entity.GetLOD())
+		{
+			entity.SetLOD(level);
+			changes++;
+		}
+	}
+	changes += Systems::SelectLODs(world, cameraPosition, projectionScale, lodSettings);
+
+	// Objects and triangles are counted as they're drawn
+	lodStats = {};
+	lodStats.levelChanges = changes;
+	lodStats.selectMs = ElapsedMs(start);
+}
+
+// --------------------------------------------------------
+// Find what each view can see, in one culling pass
+//  - Entities take the culler's first indices and the bulk
+//    entities (in draw list order) the rest, so one pass
+//    covers both
+//  - Entities are culled with the interpolated matrices
+//    they're drawn with
+//  - View 0 is the active camera (the main pass), view 1 the
+//    shadow light (the shadow pass) and the rest are the
+//    other cameras, which are only counted for now
+// --------------------------------------------------------
+void Game::CullScene()
+{
+	unsigned int entityCount = (unsigned int)entities.size();
+	unsigned int objectCount = entityCount + (unsigned int)drawList.size();
+	if (!cullingEnabled)
+	{
+		visibleObjects.resize(objectCount);
+		std::iota(visibleObjects.begin(), visibleObjects.end(), 0);
+		shadowVisibleObjects = visibleObjects;
+		return;
+	}
+
+	Clock::time_point start = Clock::now();
+	culler.Resize(objectCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		Mesh* mesh = entities[i].GetMesh();
+		Transform* transform = entities[i].GetTransform();
+		culler.SetBounds(i, mesh && transform ?
+			Bounds::TransformAABB(mesh->GetBounds(), transform->GetRenderWorldMatrix()) : AABB{});
+	}
+	Systems::GatherBounds(world, culler, entityCount, cullingParallel);
+	culler.SetGatherMs(ElapsedMs(start));
+
+	cullViews.clear();
+	cullViews.push_back(cameras[activeCamera]->GetFrustum());
+	XMFLOAT4X4 lightViewProjection;
+	XMStoreFloat4x4(&lightViewProjection,
+		XMLoadFloat4x4(&shadowOptions.lightViewMatrix) * XMLoadFloat4x4(&shadowOptions.lightProjectionMatrix));
+	Frustum shadowFrustum = Bounds::FrustumFromMatrix(lightViewProjection);
+
+	// The shadow rasterizer doesn't clip depth, so casters in front of
+	// the near plane or past the far plane still land in the map: only
+	// the side planes can reject them
+	shadowFrustum.planes[4] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	shadowFrustum.planes[5] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	cullViews.push_back(shadowFrustum);
+	for (int i = 0; i < (int)cameras.size() && cullViews.size() < CULL_MAX_VIEWS; i++)
+	{
+		if (i != activeCamera)
+			cullViews.push_back(cameras[i]->GetFrustum());
+	}
+
+	// With temporal coherence, the main view reuses last frame's results where it can
+	if (!temporalCulling)
+		culler.CullViews(cullViews.data(), (int)cullViews.size(), visibilityMasks, cullingParallel);
+	else
+		culler.CullViewsTemporal(cullViews.data(), (int)cullViews.size(), visibilityMasks, cullingParallel);
+	FrustumCuller::GetVisible(visibilityMasks, 0, visibleObjects);
+	FrustumCuller::GetVisible(visibilityMasks, 1, shadowVisibleObjects);
+}
+
+// --------------------------------------------------------
+// Drop what the active camera can't see past the biggest
+// things in front of it
+//  - The objects covering the most screen (up to the budget)
+//    are rasterized as occluders, then everything left by
+//    the frustum is tested against their depth
+//  - Only the main pass is filtered; the shadow pass looks
+//    from the light
+// --------------------------------------------------------
+void Game::OccludeScene()
+{
+	if (!occlusionEnabled || !cullingEnabled)
+		return;
+
+	unsigned int entityCount = (unsigned int)entities.size();
+	XMFLOAT3 cameraPosition = cameras[activeCamera]->GetTransform()->GetPosition();
+	float projectionScale = cameras[activeCamera]->GetProjection()._22;
+
+	// Biggest on screen first
+	std::vector<std::pair<float, unsigned int>> candidates;
+	for (unsigned int index : visibleObjects)
+	{
+		float size = LOD::ScreenSize(culler.GetBounds(index), cameraPosition, projectionScale);
+		if (size >= occluderMinScreenSize)
+			candidates.push_back({ size, index });
+	}
+	size_t occluderCount = std::min(candidates.size(), (size_t)occluderBudget);
+	std::partial_sort(candidates.begin(), candidates.begin() + occluderCount, candidates.end(), std::greater<>());
+
+	occlusion.BeginFrame(cameras[activeCamera]->GetViewProjection());
+	for (size_t i = 0; i < occluderCount; i++)
+	{
+		unsigned int index = candidates[i].second;
+		Mesh* mesh = 0;
+		XMFLOAT4X4 world;
+		if (index < entityCount)
+		{
+			Transform* transform = entities[index].GetTransform();
+			mesh = transform ? entities[index].GetMesh() : 0;
+			if (transform)
+				world = transform->GetRenderWorldMatrix();
+		}
+		else
+		{
+			DrawItem& item = drawList[index - entityCount];
+			mesh = Resources::Meshes.Get(item.mesh);
+			world = *item.world;
+		}
+		if (!mesh)
+			continue;
+
+		const std::vector<XMFLOAT3>& positions = mesh->GetPositions();
+		const std::vector<unsigned int>& indices = mesh->GetIndices();
+		occlusion.AddOccluder(positions.data(), (unsigned int)positions.size(), indices.data(), (unsigned int)indices.size(), world);
+	}
+
+	occlusion.Rasterize(cullingParallel);
+	occlusion.Cull(culler, visibleObjects, cullingParallel);
+}
+
+// --------------------------------------------------------
+// Bring the spatial indices up to date with the entities
+//  - New entities are inserted, and only those whose
+//    transform changed since last time are updated
+// --------------------------------------------------------
+void Game::UpdateSpatialIndex()
+{
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		Transform* transform = entities[i].GetTransform();
+		unsigned int version = transform ? transform->GetVersion() : 0;
+
+		if (i >= entityOctreeItems.size())
+		{
+			AABB bounds = entities[i].GetWorldBounds();
+			entityOctreeItems.push_back(octree.Insert(bounds, (unsigned int)i));
+			entityTreeProxies.push_back(entityTree.Insert(bounds, (unsigned int)i));
+			entityOverlapProxies.push_back(overlaps.Add(bounds, (unsigned int)i));
+			entityTransformVersions.push_back(version);
+		}
+		else if (entityTransformVersions[i] != version)
+		{
+			AABB bounds = entities[i].GetWorldBounds();
+			octree.Update(entityOctreeItems[i], bounds);
+			entityTree.Update(entityTreeProxies[i], bounds);
+			overlaps.Update(entityOverlapProxies[i], bounds);
+			entityTransformVersions[i] = version;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Find the closest entity under a point on the screen
+//  - The tree narrows things down using world bounds, then
+//    each candidate is tested against its mesh's bounds in
+//    its own local space (an oriented box in the world)
+//  - Returns the entity index, or -1 if nothing was hit
+// --------------------------------------------------------
+int Game::PickEntity(int screenX, int screenY)
+{
+	XMFLOAT3 origin;
+	XMFLOAT3 direction;
+	cameras[activeCamera]->GetPickRay(
+		(float)screenX, (float)screenY,
+		(float)Window::Width(), (float)Window::Height(),
+		&origin, &direction);
+
+	// Distances are fractions of the near-to-far segment, which
+	// an affine transform leaves unchanged
+	RayHit hit = entityTree.RayCast(origin, direction, 1.0f, [&](unsigned int index)
+	{
+		XMFLOAT4X4 world = entities[index].GetTransform()->GetWorldMatrix();
+		XMMATRIX invWorld = XMMatrixInverse(0, XMLoadFloat4x4(&world));
+
+		XMFLOAT3 localOrigin;
+		XMFLOAT3 localDir;
+		XMStoreFloat3(&localOrigin, XMVector3TransformCoord(XMLoadFloat3(&origin), invWorld));
+		XMStoreFloat3(&localDir, XMVector3TransformNormal(XMLoadFloat3(&direction), invWorld));
+
+		XMFLOAT3 inv(1.0f / localDir.x, 1.0f / localDir.y, 1.0f / localDir.z);
+		return Bounds::RayDistance(localOrigin, inv, entities[index].GetMesh()->GetBounds(), 1.0f);
+	});
+
+	return hit.hit ? (int)hit.data : -1;
+}
+
 // --------------------------------------------------------
 // Clean up memory or objects created by this class
 // 
@@ -126,9 +473,13 @@ Game::Game() :
 Game::~Game()
 {
 	// ImGui clean up
-	ImGui_ImplDX11_Shutdown();
-	ImGui_ImplWin32_Shutdown();
+	Graphics::Backend->ShutDownUI();
+	if (Window::Handle())
+		ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+
+	// Release pooled resources while the graphics API is still alive
+	Resources::Clear();
 }
 
 // --------------------------------------------------------
@@ -142,21 +493,17 @@ void Game::OnResize()
 	{
 		if (camera) camera->UpdateProjectionMatrix(Window::AspectRatio());
 	}
-
-	CreatePPResources();
 }
 
+// Getters
+FrameTimings Game::GetFrameTimings() { return frameTimings; }
+
 // --------------------------------------------------------
 // Load texture helper
 // --------------------------------------------------------
-void Game::LoadTexture(std::wstring path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv)
+void Game::LoadTexture(std::wstring path, TextureHandle* texture)
 {
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(path).c_str(),
-		0,
-		srv->GetAddressOf());
+	*texture = Graphics::Backend->LoadTexture(path);
 }
 
 // --------------------------------------------------------
@@ -165,63 +512,53 @@ void Game::LoadTexture(std::wstring path, Microsoft::WRL::ComPtr<ID3D11ShaderRes
 void Game::CreateEntities()
 {
 	// Load shaders
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> basicVS = Graphics::LoadVertexShader(L"VertexShader.cso");
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> basicPS = Graphics::LoadPixelShader(L"PixelShader.cso");
-	// Microsoft::WRL::ComPtr<ID3D11PixelShader> uvPS = LoadPixelShader(L"DebugUVsPS.cso");
-	// Microsoft::WRL::ComPtr<ID3D11PixelShader> normalPS = LoadPixelShader(L"DebugNormalsPS.cso");
-	// Microsoft::WRL::ComPtr<ID3D11PixelShader> customPS = LoadPixelShader(L"CustomPS.cso");
-	// Microsoft::WRL::ComPtr<ID3D11PixelShader> combinePS = LoadPixelShader(L"CombineTexPS.cso");
-
-	// Sampler
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
-
-	// Sampler description
-	D3D11_SAMPLER_DESC sd = {};
-	sd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	sd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	sd.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	sd.Filter = D3D11_FILTER_ANISOTROPIC;
-	sd.MaxAnisotropy = 16;
-	sd.MaxLOD = D3D11_FLOAT32_MAX;
-
-	// Create the sampler
-	Graphics::Device->CreateSamplerState(&sd, sampler.GetAddressOf());
-
-	// Texture shader resource views
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMetal;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNormal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRoughness;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMetal;
+	ShaderHandle basicVS = Graphics::Backend->LoadVertexShader(L"VertexShader.cso", RENDER_INPUT_VERTEX);
+	litVS = basicVS;
+	instancedVS = Graphics::Backend->LoadVertexShader(L"InstancedVS.cso", RENDER_INPUT_VERTEX);
+	ShaderHandle basicPS = Graphics::Backend->LoadPixelShader(L"PixelShader.cso");
+	// ShaderHandle uvPS = Graphics::Backend->LoadPixelShader(L"DebugUVsPS.cso");
+	// ShaderHandle normalPS = Graphics::Backend->LoadPixelShader(L"DebugNormalsPS.cso");
+	// ShaderHandle customPS = Graphics::Backend->LoadPixelShader(L"CustomPS.cso");
+	// ShaderHandle combinePS = Graphics::Backend->LoadPixelShader(L"CombineTexPS.cso");
+
+	// Sampler (wrapping, 16x anisotropic)
+	SamplerHandle sampler = Graphics::Backend->CreateSampler(RENDER_SAMPLER_WRAP_ANISOTROPIC);
+
+	// Textures
+	TextureHandle bronzeAlbedo;
+	TextureHandle bronzeNormal;
+	TextureHandle bronzeRoughness;
+	TextureHandle bronzeMetal;
+
+	TextureHandle cobblestoneAlbedo;
+	TextureHandle cobblestoneNormal;
+	TextureHandle cobblestoneRoughness;
+	TextureHandle cobblestoneMetal;
+
+	TextureHandle floorAlbedo;
+	TextureHandle floorNormal;
+	TextureHandle floorRoughness;
+	TextureHandle floorMetal;
+
+	TextureHandle paintAlbedo;
+	TextureHandle paintNormal;
+	TextureHandle paintRoughness;
+	TextureHandle paintMetal;
+
+	TextureHandle roughAlbedo;
+	TextureHandle roughNormal;
+	TextureHandle roughRoughness;
+	TextureHandle roughMetal;
+
+	TextureHandle scratchedAlbedo;
+	TextureHandle scratchedNormal;
+	TextureHandle scratchedRoughness;
+	TextureHandle scratchedMetal;
+
+	TextureHandle woodAlbedo;
+	TextureHandle woodNormal;
+	TextureHandle woodRoughness;
+	TextureHandle woodMetal;
 
 	// Load textures
 	LoadTexture(L"../../Assets/Textures/bronze_albedo.png", &bronzeAlbedo);
@@ -260,250 +597,368 @@ void Game::CreateEntities()
 	LoadTexture(L"../../Assets/Textures/wood_metal.png", &woodMetal);
 
 	// Make materials
-	// Set textures and sampler for each material
-	std::shared_ptr<Material> bronze = std::make_shared<Material>("Bronze", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	bronze->AddTextureSRV(0, bronzeAlbedo);
-	bronze->AddTextureSRV(1, bronzeNormal);
-	bronze->AddTextureSRV(2, bronzeRoughness);
-	bronze->AddTextureSRV(3, bronzeMetal);
-	bronze->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> cobblestone = std::make_shared<Material>("Cobblestone", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	cobblestone->AddTextureSRV(0, cobblestoneAlbedo);
-	cobblestone->AddTextureSRV(1, cobblestoneNormal);
-	cobblestone->AddTextureSRV(2, cobblestoneRoughness);
-	cobblestone->AddTextureSRV(3, cobblestoneMetal);
-	cobblestone->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> floor = std::make_shared<Material>("Floor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	floor->AddTextureSRV(0, floorAlbedo);
-	floor->AddTextureSRV(1, floorNormal);
-	floor->AddTextureSRV(2, floorRoughness);
-	floor->AddTextureSRV(3, floorMetal);
-	floor->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> paint = std::make_shared<Material>("Paint", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	paint->AddTextureSRV(0, paintAlbedo);
-	paint->AddTextureSRV(1, paintNormal);
-	paint->AddTextureSRV(2, paintRoughness);
-	paint->AddTextureSRV(3, paintMetal);
-	paint->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> rough = std::make_shared<Material>("Rough", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	rough->AddTextureSRV(0, roughAlbedo);
-	rough->AddTextureSRV(1, roughNormal);
-	rough->AddTextureSRV(2, roughRoughness);
-	rough->AddTextureSRV(3, roughMetal);
-	rough->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> scratched = std::make_shared<Material>("Scratched", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	scratched->AddTextureSRV(0, scratchedAlbedo);
-	scratched->AddTextureSRV(1, scratchedNormal);
-	scratched->AddTextureSRV(2, scratchedRoughness);
-	scratched->AddTextureSRV(3, scratchedMetal);
-	scratched->AddSampler(0, sampler);
-
-	std::shared_ptr<Material> wood = std::make_shared<Material>("Wood", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
-	wood->AddTextureSRV(0, woodAlbedo);
-	wood->AddTextureSRV(1, woodNormal);
-	wood->AddTextureSRV(2, woodRoughness);
-	wood->AddTextureSRV(3, woodMetal);
-	wood->AddSampler(0, sampler);
-
-	// Make meshes from the .obj files
-	meshes.push_back(std::make_shared<Mesh>("Cube", FixPath("../../Assets/Meshes/cube.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Cylinder" ,FixPath("../../Assets/Meshes/cylinder.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Helix" ,FixPath("../../Assets/Meshes/helix.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Sphere" ,FixPath("../../Assets/Meshes/sphere.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Torus" ,FixPath("../../Assets/Meshes/torus.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Quad" ,FixPath("../../Assets/Meshes/quad.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Quad (Double-Sided)" ,FixPath("../../Assets/Meshes/quad_double_sided.obj").c_str()));
-
-	// Make entities from the meshes and materials
-	entities.push_back(GameEntity(meshes[3], bronze));
-	entities.push_back(GameEntity(meshes[0], cobblestone));
-	entities.push_back(GameEntity(meshes[1], floor));
-	entities.push_back(GameEntity(meshes[2], paint));
-	entities.push_back(GameEntity(meshes[3], rough));
-	entities.push_back(GameEntity(meshes[3], scratched));
-	entities.push_back(GameEntity(meshes[3], wood));
-	entities.push_back(GameEntity(meshes[6], wood));	// floor for shadows
-
-	// Spread out the entities
-	float x = -5.0f;
-	float y = 4.0f;
-	int i = 0;
-	int meshPerRow = 7;
-	int rows = (int)std::ceil((float)meshes.size() / meshPerRow);
-	for (int r = 0; r < rows; r++)
-	{
-		for (int c = 0; c < meshPerRow; c++)
-		{
-			if (i >= meshes.size()) break;
-
-			entities[i].GetTransform()->SetPosition(x, y, 0.0f);
-
-			x += 4.0f;
-			i++;
-		}
-		x = -5.0f;
-		y -= 4.0f;
-	}
-
-	entities[0].GetTransform()->SetPosition(-5.0f, 8.0f, -4.0f);
-
-	// Set up the floor entity to be larger and under all other entities
-	entities[7].GetTransform()->SetPosition(5.0f, -2.0f, 0.0f);
-	entities[7].GetTransform()->SetScale(30.0f, 1.0f, 20.0f);
-
-	// Lights
-	Light dirLight1 = {};	// shadow casting light
-	dirLight1.Type = LIGHT_TYPE_DIRECTIONAL;
-	dirLight1.Direction = XMFLOAT3(0.0f, -0.707f, 0.707f);
-	dirLight1.Color = XMFLOAT3(1.f, 1.0f, 1.0f);
-	dirLight1.Intensity = 0.5f;
-	lights.push_back(dirLight1);
-
-	Light dirLight2 = {};
-	dirLight2.Type = LIGHT_TYPE_DIRECTIONAL;
-	dirLight2.Direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
-	dirLight2.Color = XMFLOAT3(0.f, 1.0f, 0.0f);
-	dirLight2.Intensity = 0.5f;
-	lights.push_back(dirLight2);
-	
-	Light dirLight3 = {};
-	dirLight3.Type = LIGHT_TYPE_DIRECTIONAL;
-	dirLight3.Direction = XMFLOAT3(0.0f, 0.0f, 1.0f);
-	dirLight3.Color = XMFLOAT3(0.f, 0.0f, 1.0f);
-	dirLight3.Intensity = 0.5f;
-	lights.push_back(dirLight3);
-	
-	Light dirLight4 = {};
-	dirLight4.Type = LIGHT_TYPE_DIRECTIONAL;
-	dirLight4.Direction = XMFLOAT3(1.0f, 1.0f, 0.0f);
-	dirLight4.Color = XMFLOAT3(1.f, 1.0f, 0.0f);
-	dirLight4.Intensity = 0.5f;
-	lights.push_back(dirLight4);
-	
-	Light dirLight5 = {};
-	dirLight5.Type = LIGHT_TYPE_DIRECTIONAL;
-	dirLight5.Direction = XMFLOAT3(0.0f, 1.0f, 1.0f);
-	dirLight5.Color = XMFLOAT3(0.f, 1.0f, 1.0f);
-	dirLight5.Intensity = 0.5f;
-	lights.push_back(dirLight5);
-	
-	Light pointLight1 = {};
-	pointLight1.Type = LIGHT_TYPE_POINT;
-	pointLight1.Position = XMFLOAT3(3.0f, 4.0f, 0.0f);
-	pointLight1.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
-	pointLight1.Range = 8.0f;
-	pointLight1.Intensity = 1.0f;
-	lights.push_back(pointLight1);
-	
-	Light spotLight1 = {};
-	spotLight1.Type = LIGHT_TYPE_SPOT;
-	spotLight1.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
-	spotLight1.Position = XMFLOAT3(15.0f, 10.0f, 0.0f);
-	spotLight1.Color = XMFLOAT3(1.f, 0.0f, 1.0f);
-	spotLight1.Range = 10.0f;
-	spotLight1.SpotInnerAngle = XM_PI / 64.0f;
-	spotLight1.SpotOuterAngle = XM_PI / 32.0f;
-	spotLight1.Intensity = 2.0f;
-	lights.push_back(spotLight1);
+	// Set textures and sampler for each material, then move them into the material pool
+	Material bronze("Bronze", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	bronze.AddTexture(0, bronzeAlbedo);
+	bronze.AddTexture(1, bronzeNormal);
+	bronze.AddTexture(2, bronzeRoughness);
+	bronze.AddTexture(3, bronzeMetal);
+	bronze.AddSampler(0, sampler);
+
+	Material cobblestone("Cobblestone", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	cobblestone.AddTexture(0, cobblestoneAlbedo);
+	cobblestone.AddTexture(1, cobblestoneNormal);
+	cobblestone.AddTexture(2, cobblestoneRoughness);
+	cobblestone.AddTexture(3, cobblestoneMetal);
+	cobblestone.AddSampler(0, sampler);
+
+	Material floor("Floor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	floor.AddTexture(0, floorAlbedo);
+	floor.AddTexture(1, floorNormal);
+	floor.AddTexture(2, floorRoughness);
+	floor.AddTexture(3, floorMetal);
+	floor.AddSampler(0, sampler);
+
+	Material paint("Paint", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	paint.AddTexture(0, paintAlbedo);
+	paint.AddTexture(1, paintNormal);
+	paint.AddTexture(2, paintRoughness);
+	paint.AddTexture(3, paintMetal);
+	paint.AddSampler(0, sampler);
+
+	Material rough("Rough", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	rough.AddTexture(0, roughAlbedo);
+	rough.AddTexture(1, roughNormal);
+	rough.AddTexture(2, roughRoughness);
+	rough.AddTexture(3, roughMetal);
+	rough.AddSampler(0, sampler);
+
+	Material scratched("Scratched", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	scratched.AddTexture(0, scratchedAlbedo);
+	scratched.AddTexture(1, scratchedNormal);
+	scratched.AddTexture(2, scratchedRoughness);
+	scratched.AddTexture(3, scratchedMetal);
+	scratched.AddSampler(0, sampler);
+
+	Material wood("Wood", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), basicPS, basicVS);
+	wood.AddTexture(0, woodAlbedo);
+	wood.AddTexture(1, woodNormal);
+	wood.AddTexture(2, woodRoughness);
+	wood.AddTexture(3, woodMetal);
+	wood.AddSampler(0, sampler);
+
+	materials.push_back(Resources::Materials.Add(bronze));
+	materials.push_back(Resources::Materials.Add(cobblestone));
+	materials.push_back(Resources::Materials.Add(floor));
+	materials.push_back(Resources::Materials.Add(paint));
+	materials.push_back(Resources::Materials.Add(rough));
+	materials.push_back(Resources::Materials.Add(scratched));
+	materials.push_back(Resources::Materials.Add(wood));
+
+	// Load the scene (meshes, entities and lights)
+	// - The text version is the source; rebuild the binary whenever
+	//    the text is newer (or the binary doesn't exist yet)
+	std::string sceneText = FixPath("../../Assets/Scenes/default.txt");
+	std::string sceneBinary = FixPath("../../Assets/Scenes/default.scene");
+	std::error_code error;
+	if (!std::filesystem::exists(sceneBinary, error) ||
+		std::filesystem::last_write_time(sceneText, error) > std::filesystem::last_write_time(sceneBinary, error))
+		SceneFile::ConvertText(sceneText, sceneBinary);
+	LoadScene(sceneBinary);
 
 	// Sky 
 	sky = std::make_shared<Sky>(
 		sampler,
-		meshes[0], // cube
+		LoadMesh("Cube", "../../Assets/Meshes/cube.obj"),
 		L"SkyVS.cso",
 		L"SkyPS.cso",
-		FixPath(L"../../Assets/Textures/sky/right.png").c_str(),
-		FixPath(L"../../Assets/Textures/sky/left.png").c_str(),
-		FixPath(L"../../Assets/Textures/sky/up.png").c_str(),
-		FixPath(L"../../Assets/Textures/sky/down.png").c_str(),
-		FixPath(L"../../Assets/Textures/sky/front.png").c_str(),
-		FixPath(L"../../Assets/Textures/sky/back.png").c_str()
+		L"../../Assets/Textures/sky/right.png",
+		L"../../Assets/Textures/sky/left.png",
+		L"../../Assets/Textures/sky/up.png",
+		L"../../Assets/Textures/sky/down.png",
+		L"../../Assets/Textures/sky/front.png",
+		L"../../Assets/Textures/sky/back.png"
 	);
 
+	// Particles (drawn after the sky, blended over everything)
+	particles.CreateRenderResources(L"ParticleVS.cso", L"ParticlePS.cso");
+
 	// Create post process resources
 	// Set up vertex shader and pixel shaders
-	ppVS = Graphics::LoadVertexShader(L"FullscreenVS.cso");
-	blurPS = Graphics::LoadPixelShader(L"BlurPS.cso");
-	bloomPS = Graphics::LoadPixelShader(L"BloomPS.cso");
-	combineBloomPS = Graphics::LoadPixelShader(L"CombineBloomPS.cso");
-
-	CreatePPResources();
-
-	// Sampler state for post processing
-	D3D11_SAMPLER_DESC ppSampDesc = {};
-	ppSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	ppSampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	ppSampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	Graphics::Device->CreateSamplerState(&ppSampDesc, ppSampler.GetAddressOf());
+	// (the fullscreen triangle comes from SV_VertexID, no vertex data)
+	ppVS = Graphics::Backend->LoadVertexShader(L"FullscreenVS.cso", RENDER_INPUT_NONE);
+	blurPS = Graphics::Backend->LoadPixelShader(L"BlurPS.cso");
+	bloomPS = Graphics::Backend->LoadPixelShader(L"BloomPS.cso");
+	combineBloomPS = Graphics::Backend->LoadPixelShader(L"CombineBloomPS.cso");
+
+	// Sampler state for post processing (clamped, linear)
+	ppSampler = Graphics::Backend->CreateSampler(RENDER_SAMPLER_CLAMP_LINEAR);
+}
+
+// --------------------------------------------------------
+// Find a loaded mesh by name, loading it if it isn't yet
+//  - An unknown mesh without a path can't be loaded, so it's
+//    reported and replaced by the first mesh
+// --------------------------------------------------------
+MeshHandle Game::LoadMesh(const std::string& name, const std::string& path)
+{
+	for (MeshHandle mesh : meshes)
+	{
+		if (Resources::Meshes.Get(mesh)->GetName() == name)
+			return mesh;
+	}
+
+	if (path.empty())
+	{
+		printf("Mesh %s has no path, using %s instead\n", name.c_str(),
+			Resources::Meshes.Get(meshes[0])->GetName().c_str());
+		return meshes[0];
+	}
+
+	meshes.push_back(Resources::Meshes.Emplace(name.c_str(), FixPath(path).c_str()));
+	return meshes.back();
+}
+
+// --------------------------------------------------------
+// Find a material by name (the first one if there's no match,
+// which is reported since the scene's reference is wrong)
+// --------------------------------------------------------
+MaterialHandle Game::FindMaterial(const std::string& name)
+{
+	for (MaterialHandle material : materials)
+	{
+		if (Resources::Materials.Get(material)->GetName() == name)
+			return material;
+	}
+
+	printf("Material %s not found, using %s instead\n", name.c_str(),
+		Resources::Materials.Get(materials[0])->GetName().c_str());
+	return materials[0];
 }
 
 // --------------------------------------------------------
-// Set ups for GPU and D3D stuffs
+// Replace the current scene with a binary scene file
+//  - The file is mapped rather than read, and its records
+//    are used in place to create the entities
+//  - Meshes are shared with whatever is already loaded;
+//    materials are matched by name
 // --------------------------------------------------------
-void Game::SetUpInputLayoutAndGraphics()
+bool Game::LoadScene(const std::string& path)
 {
-	// Create an input layout
-	{
-		ID3DBlob* vertexShaderBlob;
-		D3DReadFileToBlob(FixPath(L"VertexShader.cso").c_str(), &vertexShaderBlob);
-
-		// Create an input layout 
-		//  - This describes the layout of data sent to a vertex shader
-		//  - In other words, it describes how to interpret data (numbers) in a vertex buffer
-		//  - Doing this NOW because it requires a vertex shader's byte code to verify against!
-		//  - Luckily, we already have that loaded (the vertex shader blob above)
-		D3D11_INPUT_ELEMENT_DESC inputElements[4] = {};
-
-		// Set up the first element - a position, which is 3 float values
-		inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// Most formats are described as color channels; really it just means "Three 32-bit floats"
-		inputElements[0].SemanticName = "POSITION";							// This is "POSITION" - needs to match the semantics in our vertex shader input!
-		inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// How far into the vertex is this?  Assume it's after the previous element
-
-		// Set up the second element - a UV coordinate, which is 2 float values
-		inputElements[1].Format = DXGI_FORMAT_R32G32_FLOAT;					// 2x 32-bit floats
-		inputElements[1].SemanticName = "TEXCOORD";							// Match our vertex shader input!
-		inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
-
-		// Set up the third element - a normal, which is 3 float values
-		inputElements[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// 3x 32-bit floats
-		inputElements[2].SemanticName = "NORMAL";							// Match our vertex shader input!
-		inputElements[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
-
-		// Set up the fourth element - a tangent, which is 3 more float values
-		inputElements[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		inputElements[3].SemanticName = "TANGENT";
-		inputElements[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-
-		// Create the input layout, verifying our description against actual shader code
-		Graphics::Device->CreateInputLayout(
-			inputElements,							// An array of descriptions
-			4,										// How many elements in that array?
-			vertexShaderBlob->GetBufferPointer(),	// Pointer to the code of a shader that uses this layout
-			vertexShaderBlob->GetBufferSize(),		// Size of the shader code that uses this layout
-			inputLayout.GetAddressOf());			// Address of the resulting ID3D11InputLayout pointer
+	Clock::time_point start = Clock::now();
+
+	SceneFile scene;
+	if (!scene.Open(path))
+	{
+		printf("Unable to open scene %s\n", path.c_str());
+		return false;
+	}
+	Clock::time_point opened = Clock::now();
+
+	// Drop the current scene along with everything that refers to its
+	// entities (each entity gives its transform back to the pool)
+	entities.clear();
+	animations.Clear();
+	particles.Clear();
+	octree.Clear();
+	entityTree.Clear();
+	entityOctreeItems.clear();
+	entityTreeProxies.clear();
+	entityTransformVersions.clear();
+	overlaps.Clear();
+	entityOverlapProxies.clear();
+	overlapPairs.clear();
+	pickedEntity = -1;
+
+	// Resolve the scene's references
+	std::vector<MeshHandle> sceneMeshes;
+	for (unsigned int i = 0; i < scene.GetMeshCount(); i++)
+		sceneMeshes.push_back(LoadMesh(scene.GetMeshName(i), scene.GetMeshPath(i)));
+
+	std::vector<MaterialHandle> sceneMaterials;
+	for (unsigned int i = 0; i < scene.GetMaterialCount(); i++)
+		sceneMaterials.push_back(FindMaterial(scene.GetMaterialName(i)));
+
+	// Entities straight from the mapped records
+	const SceneEntityRecord* records = scene.GetEntities();
+	entities.reserve(scene.GetEntityCount());
+	Resources::Transforms.Reserve(Resources::Transforms.Size() + scene.GetEntityCount());
+	for (unsigned int i = 0; i < scene.GetEntityCount(); i++)
+	{
+		const SceneEntityRecord& record = records[i];
+		entities.push_back(GameEntity(sceneMeshes[record.mesh], sceneMaterials[record.material]));
+
+		// Entities start at rest - make sure the first interpolated
+		// frame doesn't blend from the default transform
+		Transform* transform = entities.back().GetTransform();
+		transform->SetPosition(record.position);
+		transform->SetRotation(record.pitchYawRoll);
+		transform->SetScale(record.scale);
+		transform->StorePreviousState();
+		transform->Interpolate(1.0f);
 	}
 
-	// Set initial graphics API state
-	//  - These settings persist until we change them
-	//  - Some of these, like the primitive topology & input layout, probably won't change
-	//  - Others, like setting shaders, will need to be moved elsewhere later
+	// Lights are stored in their GPU layout already
+	unsigned int lightCount = scene.GetLightCount();
+	if (lightCount > MAX_CLUSTERED_LIGHTS)
+	{
+		printf("Scene %s has %u lights - only the first %i are used\n", path.c_str(), lightCount, MAX_CLUSTERED_LIGHTS);
+		lightCount = MAX_CLUSTERED_LIGHTS;
+	}
+	lights.assign(scene.GetLights(), scene.GetLights() + lightCount);
+	lightVelocities.clear();
+	lightBudget.Reset();
+
+	// Fit the octree's root cell around the new entities, so
+	// they spread through the tree instead of piling up in
+	// the root
+	if (!entities.empty())
 	{
-		// Tell the input assembler (IA) stage of the pipeline what kind of
-		// geometric primitives (points, lines or triangles) we want to draw.  
-		// Essentially: "What kind of shape should the GPU draw with our vertices?"
-		Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		AABB sceneBounds = entities[0].GetWorldBounds();
+		for (auto& entity : entities)
+			sceneBounds = Bounds::Merge(sceneBounds, entity.GetWorldBounds());
+		XMFLOAT3 extents = Bounds::GetExtents(sceneBounds);
+		float halfSize = std::max(std::max(extents.x, extents.y), std::max(extents.z, 1.0f));
+		octree.Clear(Bounds::GetCenter(sceneBounds), halfSize);
+	}
+	UpdateSpatialIndex();
+
+	// Keep some stats around for the UI (the file itself is unmapped on return)
+	scenePath = path;
+	sceneMeshCount = scene.GetMeshCount();
+	sceneMaterialCount = scene.GetMaterialCount();
+	sceneFileSize = scene.GetFileSize();
+	sceneOpenMs = std::chrono::duration<double, std::milli>(opened - start).count();
+	sceneInstantiateMs = ElapsedMs(opened);
+	sceneLoadStart = start;
+	sceneFirstFramePending = true;
+	return true;
+}
+
+// --------------------------------------------------------
+// Make a scene with the default scene's meshes, materials
+// and lights, and the given number of entities in a grid
+// --------------------------------------------------------
+bool Game::MakeGridScene(int entityCount, SceneData* scene)
+{
+	if (!SceneFile::ParseText(FixPath("../../Assets/Scenes/default.txt"), scene) ||
+		scene->meshNames.empty() || scene->materialNames.empty())
+		return false;
+
+	// A square grid on the XZ plane, 3 units apart
+	int side = (int)std::ceil(std::sqrt((float)entityCount));
+	float start = -1.5f * side;
+	scene->entities.resize(entityCount);
+	for (int i = 0; i < entityCount; i++)
+	{
+		SceneEntityRecord& e = scene->entities[i];
+		e.position = XMFLOAT3(start + 3.0f * (i % side), 0.0f, start + 3.0f * (i / side));
+		e.pitchYawRoll = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		e.scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		e.mesh = (unsigned int)(i % scene->meshNames.size());
+		e.material = (unsigned int)(i % scene->materialNames.size());
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Create keyframe animations for some of the entities
+// - Must be called after the entities are laid out
+// --------------------------------------------------------
+void Game::CreateAnimations()
+{
+	// These target specific entities of the default scene
+	if (entities.size() < 4)
+		return;
+
+	// Sway the bronze sphere left and right (cubic, so it eases in and out)
+	XMFLOAT3 start = entities[0].GetTransform()->GetPosition();
+	animations.AddTrack(
+		entities[0].GetTransformHandle(),
+		ANIM_CHANNEL_POSITION,
+		ANIM_INTERP_CUBIC,
+		{
+			{ 0.0f,			start },
+			{ XM_PIDIV2,	XMFLOAT3(start.x + 0.6f, start.y, start.z) },
+			{ XM_PI,		start },
+			{ XM_PI * 1.5f,	XMFLOAT3(start.x - 0.6f, start.y, start.z) },
+			{ XM_2PI,		start },
+		});
+
+	// Spin the helix around its Y axis at a constant rate
+	animations.AddTrack(
+		entities[3].GetTransformHandle(),
+		ANIM_CHANNEL_ROTATION,
+		ANIM_INTERP_LINEAR,
+		{
+			{ 0.0f, XMFLOAT3(0.0f, 0.0f, 0.0f) },
+			{ 4.0f, XMFLOAT3(0.0f, XM_PI, 0.0f) },
+			{ 8.0f, XMFLOAT3(0.0f, XM_2PI, 0.0f) },
+		});
+
+	// Pulse the cube's scale once a second
+	animations.AddTrack(
+		entities[1].GetTransformHandle(),
+		ANIM_CHANNEL_SCALE,
+		ANIM_INTERP_STEP,
+		{
+			{ 0.0f, XMFLOAT3(1.0f, 1.0f, 1.0f) },
+			{ 0.5f, XMFLOAT3(1.25f, 1.25f, 1.25f) },
+			{ 1.0f, XMFLOAT3(1.0f, 1.0f, 1.0f) },
+		});
+}
+
+// --------------------------------------------------------
+// Attach particle emitters to some of the entities
+// - Must be called after the entities are laid out
+// --------------------------------------------------------
+void Game::CreateEmitters()
+{
+	// Sparks off the top of the swaying bronze sphere
+	if (entities.size() > 0)
+	{
+		ParticleEmitterSettings sparks = ParticleSystem::DefaultEmitterSettings();
+		sparks.offset = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		particles.AddEmitter(entities[0].GetTransformHandle(), sparks);
+	}
+
+	// Slow dust rising around the helix
+	if (entities.size() > 3)
+	{
+		ParticleEmitterSettings dust = ParticleSystem::DefaultEmitterSettings();
+		dust.rate = 40.0f;
+		dust.minLifetime = 3.0f;
+		dust.maxLifetime = 5.0f;
+		dust.speed = 0.3f;
+		dust.speedJitter = 0.2f;
+		dust.spread = XM_PI;
+		dust.gravity = -0.1f;
+		dust.drag = 0.2f;
+		dust.startSize = 0.2f;
+		dust.endSize = 0.6f;
+		dust.startColor = XMFLOAT4(0.6f, 0.55f, 0.5f, 0.35f);
+		dust.endColor = XMFLOAT4(0.6f, 0.55f, 0.5f, 0.0f);
+		particles.AddEmitter(entities[3].GetTransformHandle(), dust);
+	}
+}
 
-		// Ensure the pipeline knows how to interpret all the numbers stored in
-		// the vertex buffer. For this course, all of your vertices will probably
-		// have the same layout, so we can just set this once at startup.
-		Graphics::Context->IASetInputLayout(inputLayout.Get());
+// --------------------------------------------------------
+// Set ups for GPU stuffs (the input layout and the
+// topology are the backend's, per vertex shader)
+// --------------------------------------------------------
+void Game::SetUpGraphics()
+{
+	// Per frame constant buffers (rewritten once a frame, so they
+	// live outside the ring the per draw data goes through)
+	{
+		RenderBufferDesc cbDesc = {};
+		cbDesc.type = RENDER_BUFFER_CONSTANT;
+		cbDesc.dynamic = true;
+
+		cbDesc.size = (sizeof(VSFrameConstantBuffer) + 15) / 16 * 16;
+		vsFrameBuffer = Graphics::Backend->CreateBuffer(cbDesc, 0);
+		cbDesc.size = (sizeof(PSFrameConstantBuffer) + 15) / 16 * 16;
+		psFrameBuffer = Graphics::Backend->CreateBuffer(cbDesc, 0);
 	}
 }
 
@@ -519,8 +974,9 @@ void Game::UpdateImGui(float deltaTime)
 	io.DisplaySize.x = (float)Window::Width();
 	io.DisplaySize.y = (float)Window::Height();
 	// Reset the frame
-	ImGui_ImplDX11_NewFrame();
-	ImGui_ImplWin32_NewFrame();
+	Graphics::Backend->NewUIFrame();
+	if (Window::Handle())
+		ImGui_ImplWin32_NewFrame();
 	ImGui::NewFrame();
 	// Determine new input capture
 	Input::SetKeyboardCapture(io.WantCaptureKeyboard);
@@ -589,6 +1045,37 @@ void Game::BuildUI()
 	}
 	*/
 
+	// Scene file
+	if (ImGui::CollapsingHeader("Scene"))
+	{
+		ImGui::TextWrapped("File: %s", scenePath.c_str());
+		ImGui::Text("Size: %.2f MB", sceneFileSize / (1024.0f * 1024.0f));
+		ImGui::Text("Entities: %i, Lights: %i", (int)entities.size(), (int)lights.size());
+		ImGui::Text("Meshes: %u, Materials: %u", sceneMeshCount, sceneMaterialCount);
+		ImGui::Text("Map + Fixup: %.3f ms", sceneOpenMs);
+		ImGui::Text("Instantiate: %.3f ms", sceneInstantiateMs);
+		ImGui::Text("Open To First Frame: %.3f ms", sceneFirstFrameMs);
+
+		if (ImGui::Button("Load Default Scene"))
+		{
+			std::string sceneText = FixPath("../../Assets/Scenes/default.txt");
+			std::string sceneBinary = FixPath("../../Assets/Scenes/default.scene");
+			if (SceneFile::ConvertText(sceneText, sceneBinary) && LoadScene(sceneBinary))
+			{
+				CreateAnimations();
+				CreateEmitters();
+			}
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Load Grid Scene (100k)"))
+		{
+			SceneData grid;
+			std::string gridBinary = FixPath("../../Assets/Scenes/grid_100k.scene");
+			if (MakeGridScene(100000, &grid) && SceneFile::Write(grid, gridBinary))
+				LoadScene(gridBinary);
+		}
+	}
+
 	// Game Entities
 	if (ImGui::CollapsingHeader("Scene Entities"))
 	{
@@ -596,27 +1083,46 @@ void Game::BuildUI()
 		ImGui::Checkbox("Rotate about Y", &rotateY);
 		ImGui::Checkbox("Rotate about Z", &rotateZ);
 
+		ImGui::Text("Right click an entity to select it");
+		if (pickedEntity >= 0)
+			ImGui::Text("Selected: Entity %i", pickedEntity);
+		else
+			ImGui::Text("Selected: None");
+
+		// Large scenes only list the first entities (plus the selected one)
+		const uint maxHeaders = 100;
+		if (entities.size() > maxHeaders)
+			ImGui::Text("Listing %u of %i entities", maxHeaders, (int)entities.size());
+
 		for (uint i = 0; i < entities.size(); i++)
 		{
+			if (i >= maxHeaders && (int)i != pickedEntity)
+				continue;
+
 			// header for each entity
 			std::string header = "Entity " + std::to_string(i) +
 				" (" + entities[i].GetMesh()->GetName() + ')';
+			if (openPickedEntity && (int)i == pickedEntity)
+			{
+				ImGui::SetNextItemOpen(true);
+				openPickedEntity = false;
+			}
 			if (ImGui::CollapsingHeader(header.c_str()))
 			{
 				ImGui::PushID(i);
 
 				// Get material of this entity
-				std::shared_ptr<Material> material = entities[i].GetMaterial();
+				Material* material = entities[i].GetMaterial();
 
 				// Display material name
 				std::string matName = "Material Name: " + material->GetName();
 				ImGui::Text(matName.c_str());
 
-				// Display srvs in a table (4 in a row)
+				// Display textures in a table (4 in a row)
 				if (ImGui::BeginTable("Textures for Entity " + i, 4))
 				{
 					int idx = 0;
-					for (auto& tex : material->GetTextureSRVMap())
+					for (auto& tex : material->GetTextureMap())
 					{
 						if (idx % 4 == 0)
 							ImGui::TableNextRow();
@@ -624,7 +1130,7 @@ void Game::BuildUI()
 						ImGui::TableSetColumnIndex(idx % 4);
 
 						ImGui::Text("Texture %i", tex.first + 1);
-						ImGui::Image(tex.second.Get(), ImVec2(128, 128));
+						ImGui::Image(Graphics::Backend->GetUITexture(tex.second), ImVec2(128, 128));
 
 						idx++;
 					}
@@ -664,6 +1170,280 @@ void Game::BuildUI()
 		}
 	}
 
+	// Animation
+	if (ImGui::CollapsingHeader("Animation"))
+	{
+		bool paused = animations.GetPaused();
+		if (ImGui::Checkbox("Pause Animations", &paused))
+			animations.SetPaused(paused);
+
+		ImGui::Text("Tracks: %i", animations.GetTrackCount());
+		ImGui::Text("Track Memory: %i bytes", (int)animations.GetMemoryUsage());
+	}
+
+	// Particles
+	if (ImGui::CollapsingHeader("Particles"))
+	{
+		ParticleStats stats = particles.GetStats();
+		ImGui::Text("Particles: %u / %u", particles.GetParticleCount(), particles.GetCapacity());
+		ImGui::Text("Memory: %.2f MB", particles.GetMemoryUsage() / (1024.0f * 1024.0f));
+		ImGui::Text("Emitted: %u, Retired: %u, Dropped: %u", stats.emitted, stats.retired, stats.dropped);
+		ImGui::Text("Update: %.3f ms, Sort: %.3f ms (%u passes), Pack: %.3f ms", stats.updateMs, stats.sortMs, stats.sortPasses, stats.packMs);
+		if (ImGui::Button("Kill All Particles"))
+			particles.KillAll();
+
+		// Attach another emitter to whatever was picked with a right click
+		if (pickedEntity >= 0 && ImGui::Button("Add Emitter To Picked Entity"))
+			particles.AddEmitter(entities[pickedEntity].GetTransformHandle(), ParticleSystem::DefaultEmitterSettings());
+
+		for (int i = 0; i < particles.GetEmitterCount(); i++)
+		{
+			ImGui::PushID(i);
+			ParticleEmitterSettings settings = particles.GetEmitterSettings(i);
+			bool enabled = particles.GetEmitterEnabled(i);
+			std::string label = "Emitter " + std::to_string(i);
+			if (ImGui::Checkbox(label.c_str(), &enabled))
+				particles.SetEmitterEnabled(i, enabled);
+			ImGui::SameLine();
+			if (ImGui::SliderFloat("Rate", &settings.rate, 0.0f, 20000.0f, "%.0f", ImGuiSliderFlags_Logarithmic))
+				particles.SetEmitterSettings(i, settings);
+			ImGui::PopID();
+		}
+	}
+
+	// Spatial index
+	if (ImGui::CollapsingHeader("Spatial Index"))
+	{
+		ImGui::Text("Octree Items: %u", octree.GetItemCount());
+		ImGui::Text("Octree Nodes: %u (%i bytes)", octree.GetNodeCount(), (int)octree.GetMemoryUsage());
+
+		// Entities in the active camera's view
+		queryResults.clear();
+		octree.QueryFrustum(cameras[activeCamera]->GetFrustum(), queryResults);
+		ImGui::Text("Entities In View: %i", (int)queryResults.size());
+
+		// Entities near the active camera
+		ImGui::SliderFloat("Sphere Radius", &querySphereRadius, 0.0f, 50.0f);
+		queryResults.clear();
+		octree.QuerySphere(cameras[activeCamera]->GetTransform()->GetPosition(), querySphereRadius, queryResults);
+		ImGui::Text("Entities In Sphere: %i", (int)queryResults.size());
+
+		ImGui::Text("AABB Tree Leaves: %u (height %i)", entityTree.GetLeafCount(), entityTree.GetHeight());
+
+		// Entities touching each other
+		int axisCount = overlaps.GetAxisCount();
+		if (ImGui::RadioButton("Sweep 1 Axis", axisCount == 1))
+			overlaps.SetAxisCount(1);
+		ImGui::SameLine();
+		if (ImGui::RadioButton("Sweep 3 Axes", axisCount == 3))
+			overlaps.SetAxisCount(3);
+		ImGui::Text("Overlapping Pairs: %i (%u swaps, %u tests)", (int)overlapPairs.size(), overlaps.GetLastSwaps(), overlaps.GetLastTests());
+		for (size_t i = 0; i < overlapPairs.size() && i < 10; i++)
+			ImGui::Text("  Entity %u - Entity %u", overlapPairs[i].a, overlapPairs[i].b);
+	}
+
+	// Bulk entities (ECS)
+	if (ImGui::CollapsingHeader("Bulk Entities"))
+	{
+		const char* layoutNames[] = {
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_UNIFORM),
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_CLUSTERED),
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_HOTSPOTS) };
+		ImGui::SliderInt("Count", &bulkEntityCount, 0, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+		ImGui::Combo("Layout", &bulkLayout, layoutNames, IM_ARRAYSIZE(layoutNames));
+		ImGui::InputInt("Seed", &bulkSeed);
+		ImGui::SliderFloat("Moving", &bulkMovingFraction, 0.0f, 1.0f);
+		ImGui::SliderFloat("Spinning", &bulkSpinningFraction, 0.0f, 1.0f);
+		ImGui::SliderInt("Lights", &bulkLightCount, 0, MAX_CLUSTERED_LIGHTS - 1, "%d", ImGuiSliderFlags_Logarithmic);
+		if (ImGui::Button("Spawn"))
+			CreateBulkEntities(bulkEntityCount);
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+		{
+			streamer.Close(world);
+			world.Clear();
+		}
+
+		ImGui::Text("Entities: %u", world.GetEntityCount());
+		ImGui::Text("Archetypes: %u", world.GetArchetypeCount());
+		ImGui::Text("Chunks: %u (%.2f MB)", world.GetChunkCount(), world.GetMemoryUsage() / (1024.0f * 1024.0f));
+		ImGui::Text("Draw List: %i", (int)drawList.size());
+		ImGui::Text("Bounds: %.0f x %.0f", bulkBoundsMax.x - bulkBoundsMin.x, bulkBoundsMax.z - bulkBoundsMin.z);
+	}
+
+	// Level of detail
+	if (ImGui::CollapsingHeader("Level Of Detail"))
+	{
+		ImGui::Checkbox("LOD Enabled", &lodSettings.enabled);
+		for (int i = 0; i < MESH_MAX_LODS - 1; i++)
+		{
+			std::string label = "Level " + std::to_string(i + 1) + " Below";
+			ImGui::SliderFloat(label.c_str(), &lodSettings.screenSizes[i], 0.0f, 1.0f);
+		}
+		ImGui::SliderFloat("Hysteresis", &lodSettings.hysteresis, 0.0f, 0.5f);
+		ImGui::SliderFloat("Bias", &lodSettings.bias, 0.25f, 4.0f);
+
+		double saved = lodStats.trianglesFull > 0 ? 100.0 * (1.0 - (double)lodStats.trianglesSubmitted / lodStats.trianglesFull) : 0.0;
+		ImGui::Text("Triangles: %llu (%llu without LOD, %.1f%% saved)", lodStats.trianglesSubmitted, lodStats.trianglesFull, saved);
+		for (int i = 0; i < MESH_MAX_LODS; i++)
+			ImGui::Text("Level %i: %u objects", i, lodStats.levelObjects[i]);
+		ImGui::Text("Level Changes: %u", lodStats.levelChanges);
+		ImGui::Text("Selection: %.3f ms", lodStats.selectMs);
+	}
+
+	// Frustum culling
+	if (ImGui::CollapsingHeader("Culling"))
+	{
+		ImGui::Checkbox("Frustum Culling", &cullingEnabled);
+		ImGui::Checkbox("Cull In Parallel", &cullingParallel);
+		ImGui::Checkbox("Temporal Coherence (main view)", &temporalCulling);
+		if (cullingEnabled)
+		{
+			CullStats stats = culler.GetStats();
+			ImGui::Text("Tested: %u against %u views", stats.tested, stats.views);
+			ImGui::Text("In Any View: %u, In None: %u", stats.visible, stats.culled);
+			ImGui::Text("Gather Bounds: %.3f ms", stats.gatherMs);
+			ImGui::Text("Cull: %.3f ms (%u batches)", stats.cullMs, stats.batches);
+
+			if (temporalCulling)
+			{
+				TemporalCullSettings temporalSettings = culler.GetTemporalSettings();
+				if (ImGui::SliderInt("Full Refresh Interval", &temporalSettings.refreshInterval, 1, 240))
+					culler.SetTemporalSettings(temporalSettings);
+
+				TemporalCullStats temporalStats = culler.GetTemporalStats();
+				double retestedPercent = temporalStats.tested > 0 ? 100.0 * temporalStats.retested / temporalStats.tested : 0.0;
+				ImGui::Text("Main View: %.3f ms, %u retested (%.1f%%)%s", temporalStats.cullMs, temporalStats.retested, retestedPercent,
+					temporalStats.fullRefresh ? ", full refresh" : "");
+			}
+
+			// Per view counts, straight from the masks
+			unsigned int viewVisible[CULL_MAX_VIEWS] = {};
+			for (unsigned int mask : visibilityMasks)
+			{
+				for (unsigned int v = 0; v < stats.views; v++)
+					viewVisible[v] += (mask >> v) & 1;
+			}
+			for (unsigned int v = 0; v < stats.views; v++)
+			{
+				if (v == 0)
+					ImGui::Text("Main Camera: %u visible", viewVisible[v]);
+				else if (v == 1)
+					ImGui::Text("Shadow Light: %u visible", viewVisible[v]);
+				else
+					ImGui::Text("Other Camera %u: %u visible", v - 1, viewVisible[v]);
+			}
+
+			ImGui::Separator();
+			ImGui::Checkbox("Occlusion Culling", &occlusionEnabled);
+			if (occlusionEnabled)
+			{
+				ImGui::SliderInt("Occluder Budget", &occluderBudget, 1, 128);
+				ImGui::SliderFloat("Occluder Min Screen Size", &occluderMinScreenSize, 0.01f, 1.0f);
+
+				OcclusionStats occlusionStats = occlusion.GetStats();
+				double occludedPercent = occlusionStats.tested > 0 ? 100.0 * occlusionStats.occluded / occlusionStats.tested : 0.0;
+				ImGui::Text("Occluders: %u (%u triangles)", occlusionStats.occluders, occlusionStats.triangles);
+				ImGui::Text("Occluded: %u of %u (%.1f%%)", occlusionStats.occluded, occlusionStats.tested, occludedPercent);
+				ImGui::Text("Setup: %.3f ms, Raster: %.3f ms, Test: %.3f ms", occlusionStats.setupMs, occlusionStats.rasterMs, occlusionStats.testMs);
+			}
+		}
+	}
+
+	// Sorting the main pass draws
+	if (ImGui::CollapsingHeader("Render Queue"))
+	{
+		RenderQueueStats queueStats = renderQueue.GetStats();
+		ImGui::Text("Draws: %u (%u transparent)", queueStats.draws, queueStats.transparentDraws);
+		ImGui::Text("Sort: %.3f ms (%u radix passes)", queueStats.sortMs, queueStats.sortPasses);
+		ImGui::Text("Shader Changes: %u (%u unsorted)", queueStats.shaderChanges, queueStats.shaderChangesUnsorted);
+		ImGui::Text("Material Changes: %u (%u unsorted)", queueStats.materialChanges, queueStats.materialChangesUnsorted);
+		ImGui::Text("Mesh Changes: %u (%u unsorted)", queueStats.meshChanges, queueStats.meshChangesUnsorted);
+
+		ImGui::Separator();
+		ImGui::Checkbox("Instancing", &instancingEnabled);
+		if (instancingEnabled)
+		{
+			InstancingStats instancingStats = instancing.GetStats();
+			ImGui::Text("Groups: %u for %u draws (largest %u)", instancingStats.groups, instancingStats.draws, instancingStats.largestGroup);
+			ImGui::Text("Group: %.3f ms, Fill: %.3f ms, Upload: %.3f ms", instancingStats.groupMs, instancingStats.fillMs, instancingStats.uploadMs);
+		}
+		ImGui::Text("Without Instancing: %u draw calls, %.3f ms submit", lastDrawCalls[0], lastSubmitMs[0]);
+		ImGui::Text("With Instancing: %u draw calls, %.3f ms submit", lastDrawCalls[1], lastSubmitMs[1]);
+	}
+
+	// What the main pass's constant data cost
+	if (ImGui::CollapsingHeader("Constant Buffers"))
+	{
+		const ConstantBufferStats& cb = constantBufferStats;
+		ImGui::Text("Per Frame: %u uploads, %.1f KB", cb.frameUploads, cb.frameBytes / 1024.0);
+		ImGui::Text("Per Material: %u uploads, %.1f KB", cb.materialUploads, cb.materialBytes / 1024.0);
+		ImGui::Text("Per Object: %u uploads, %.1f KB", cb.objectUploads, cb.objectBytes / 1024.0);
+		ImGui::Text("Total: %.1f KB (%.1f KB as one block per draw)",
+			(cb.frameBytes + cb.materialBytes + cb.objectBytes) / 1024.0, cb.singleBlockBytes / 1024.0);
+	}
+
+	// Redundant bind filtering (shadow and main passes)
+	if (ImGui::CollapsingHeader("State Cache"))
+	{
+		bool filtering = stateCache.GetFiltering();
+		if (ImGui::Checkbox("Filter Redundant Binds", &filtering))
+			stateCache.SetFiltering(filtering);
+
+		StateCacheStats cacheStats = stateCache.GetStats();
+		const char* kindNames[STATE_BIND_KINDS] = { "Vertex Shader", "Pixel Shader", "SRVs", "Samplers", "Vertex Buffer", "Index Buffer" };
+		unsigned int requested = 0, issued = 0;
+		for (int i = 0; i < STATE_BIND_KINDS; i++)
+		{
+			ImGui::Text("%s: %u requested, %u calls, %u skipped", kindNames[i], cacheStats.requested[i], cacheStats.issued[i], cacheStats.skipped[i]);
+			requested += cacheStats.requested[i];
+			issued += cacheStats.issued[i];
+		}
+		ImGui::Text("Total: %u calls for %u requests (%u commits)", issued, requested, cacheStats.commits);
+	}
+
+	// World streaming (into the bulk entities)
+	if (ImGui::CollapsingHeader("World Streaming"))
+	{
+		if (!streamer.IsOpen())
+		{
+			if (ImGui::Button("Build And Open Streaming World (250k)"))
+			{
+				// Split a big grid into cells on disk, then stream it back in
+				SceneData grid;
+				std::string directory = FixPath("../../Assets/Scenes/streaming");
+				if (MakeGridScene(250000, &grid) && WorldStreamer::WriteCells(grid, 50.0f, directory))
+				{
+					streamer.Open(directory,
+						[&](const std::string& name, const std::string& path) { return LoadMesh(name, path); },
+						[&](const std::string& name) { return FindMaterial(name); });
+				}
+			}
+		}
+		else if (ImGui::Button("Close"))
+			streamer.Close(world);
+
+		StreamSettings settings = streamer.GetSettings();
+		bool changed = ImGui::SliderFloat("Load Radius", &settings.loadRadius, 10.0f, 500.0f);
+		changed |= ImGui::SliderFloat("Unload Radius", &settings.unloadRadius, 10.0f, 600.0f);
+		changed |= ImGui::SliderFloat("Travel Weight", &settings.travelWeight, 0.0f, 4.0f);
+		changed |= ImGui::SliderFloat("Budget (ms)", &settings.budgetMs, 0.1f, 8.0f);
+		if (changed)
+			streamer.SetSettings(settings);
+
+		ImGui::Text("Cells: %u resident of %u", streamer.GetCellCount(STREAM_CELL_RESIDENT), streamer.GetCellCount());
+		ImGui::Text("Queued: %u, Loading: %u, Finalizing: %u",
+			streamer.GetCellCount(STREAM_CELL_QUEUED),
+			streamer.GetCellCount(STREAM_CELL_LOADING),
+			streamer.GetCellCount(STREAM_CELL_LOADED));
+		ImGui::Text("Entities: %u", streamer.GetResidentEntities());
+		ImGui::Text("Resident: %.2f MB (peak %.2f MB)",
+			streamer.GetResidentBytes() / (1024.0f * 1024.0f),
+			streamer.GetPeakResidentBytes() / (1024.0f * 1024.0f));
+		ImGui::Text("Loaded: %u, Unloaded: %u", streamer.GetCellsLoaded(), streamer.GetCellsUnloaded());
+		ImGui::Text("Main Thread: %.3f ms", streamer.GetLastUpdateMs());
+	}
+
 	// Camera
 	if (ImGui::CollapsingHeader("Cameras"))
 	{
@@ -727,9 +1507,9 @@ void Game::BuildUI()
 	/*
 	if (ImGui::CollapsingHeader("Custom Shader"))
 	{
-		XMFLOAT3 intensity = psData.intensities;
+		XMFLOAT3 intensity = psFrameData.intensities;
 		if (ImGui::SliderFloat3("RGB Intensities", &intensity.x, 0.0f, 1.0f))
-			DirectX::XMStoreFloat3(&psData.intensities, XMLoadFloat3(&intensity));
+			DirectX::XMStoreFloat3(&psFrameData.intensities, XMLoadFloat3(&intensity));
 	}
 	*/
 
@@ -738,7 +1518,41 @@ void Game::BuildUI()
 	{
 		// ImGui::ColorEdit3("Ambient Color", &ambientColor.x);
 
-		for (uint i = 0; i < lights.size(); i++)
+		const char* modeNames[] = { "Constant Buffer", "Clustered", "Per Object" };
+		ImGui::Combo("Point and Spot Lights", &lightingMode, modeNames, IM_ARRAYSIZE(modeNames));
+		if (lightingMode == LIGHTING_CLUSTERED)
+		{
+			LightClusterStats clusterStats = lightClusters.GetStats();
+			ImGui::Text("Grid: %i x %i x %i", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+			ImGui::Text("Lights: %u, %u touching the grid", clusterStats.lights, clusterStats.clusteredLights);
+			ImGui::Text("Indices: %u (largest cluster %u, %u empty)", clusterStats.references, clusterStats.largestCluster, clusterStats.emptyClusters);
+			ImGui::Text("Bounds: %.3f ms, Assign: %.3f ms, Compact: %.3f ms, Upload: %.3f ms",
+				clusterStats.boundsMs, clusterStats.assignMs, clusterStats.compactMs, clusterStats.uploadMs);
+		}
+		else if (lightingMode == LIGHTING_PER_OBJECT)
+		{
+			ObjectLightStats objectStats = objectLights.GetStats();
+			ImGui::Text("Objects: %u, up to %i lights each", objectStats.objects, OBJECT_LIGHTS_MAX);
+			ImGui::Text("Grid: %u cells, %u lights, %u references", objectStats.gridCells, objectStats.lights, objectStats.gridReferences);
+			ImGui::Text("Tested: %u, Touching: %u, Kept: %u (%u objects capped)",
+				objectStats.candidates, objectStats.touching, objectStats.kept, objectStats.cappedObjects);
+			ImGui::Text("Grid: %.3f ms, Select: %.3f ms, Upload: %.3f ms",
+				objectStats.gridMs, objectStats.selectMs, objectStats.uploadMs);
+		}
+		else
+		{
+			// The rest of the constant buffer is room for lights fading out
+			ImGui::SliderInt("Light Budget", &lightBudgetCount, 1, MAX_LIGHTS);
+			LightBudgetStats budgetStats = lightBudget.GetStats();
+			ImGui::Text("Lights: %u, %u in view, %u in the budget", budgetStats.lights, budgetStats.visible, budgetStats.selected);
+			ImGui::Text("Drawn: %u (%u fading in, %u fading out, %u cut)",
+				budgetStats.drawn, budgetStats.fadingIn, budgetStats.fadingOut, budgetStats.cut);
+			ImGui::Text("Score: %.3f ms, Select: %.3f ms", budgetStats.scoreMs, budgetStats.selectMs);
+		}
+		ImGui::Separator();
+
+		// Editing a few thousand lights by hand isn't useful
+		for (uint i = 0; i < lights.size() && i < MAX_LIGHTS; i++)
 		{
 			Light& light = lights[i];
 
@@ -808,18 +1622,25 @@ void Game::BuildUI()
 		// ImGui::SliderInt("Shadow Map Resolution", &shadowOptions.shadowMapResolution, 256, 4096);
 		// ImGui::SliderFloat("Light Projection Size", &shadowOptions.lightProjectionSize, 1.0f, 50.0f);
 		ImGui::Text("Shadow Map");
-		ImGui::Image(shadowSRV.Get(), ImVec2(256, 256));
+		ImGui::Image(Graphics::Backend->GetUITexture(shadowMap), ImVec2(256, 256));
 	}
 
 	// Post Processing
+	ppPreviewOpen = false;
 	if (ImGui::CollapsingHeader("Post Processing"))
 	{
+		ppPreviewOpen = true;
 		ImGui::Checkbox("Enable Post Processing", &ppOptions.postProcessEnabled);
 		ImGui::Checkbox("Enable Bloom", &ppOptions.bloomEnabled);
 		ImGui::Checkbox("Enable Blur", &ppOptions.blurEnabled);
 
-		ImGui::Text("Pre-Process");
-		ImGui::Image(preSRV.Get(), ImVec2(Window::Width() / 4.0f, Window::Height() / 4.0f));
+		// From the last frame (null until the next one exports them)
+		TextureHandle sceneColor = frameGraph.FindTexture("Scene Color");
+		if (!sceneColor.IsNull())
+		{
+			ImGui::Text("Pre-Process");
+			ImGui::Image(Graphics::Backend->GetUITexture(sceneColor), ImVec2(Window::Width() / 4.0f, Window::Height() / 4.0f));
+		}
 
 		if (ppOptions.bloomEnabled)
 		{
@@ -828,12 +1649,128 @@ void Game::BuildUI()
 			static const char* options[] = { "Average", "Lightness", "Luminance" };
 			ImGui::Combo("Bloom Type", &ppOptions.bloomType, options, IM_ARRAYSIZE(options));
 
-			ImGui::Text("Bloom (Extract)");
-			ImGui::Image(bloomExtractSRV.Get(), ImVec2(Window::Width() / 4.0f, Window::Height() / 4.0f));
+			TextureHandle bloomExtract = frameGraph.FindTexture("Bloom Extract");
+			if (!bloomExtract.IsNull())
+			{
+				ImGui::Text("Bloom (Extract)");
+				ImGui::Image(Graphics::Backend->GetUITexture(bloomExtract), ImVec2(Window::Width() / 4.0f, Window::Height() / 4.0f));
+			}
 		}
 
 		if (ppOptions.blurEnabled)
 			ImGui::SliderInt("Blur Distance", &ppOptions.blurDistance, 0, 10);
+
+		// What the frame graph made of this frame's passes
+		FrameGraphStats graphStats = frameGraph.GetStats();
+		ImGui::Text("Frame graph: %u passes (%u culled)", graphStats.passes, graphStats.culledPasses);
+		ImGui::Text("Transient targets: %u in %u textures", graphStats.usedTextures, graphStats.physicalTextures);
+		ImGui::Text("Transient memory: %.1f MB (%.1f MB unaliased)",
+			graphStats.peakBytes / (1024.0 * 1024.0), graphStats.unaliasedBytes / (1024.0 * 1024.0));
+		ImGui::Text("SRV unbinds: %u", graphStats.unbinds);
+		ImGui::Text("Compile: %.3f ms, execute: %.3f ms", graphStats.compileMs, graphStats.executeMs);
+	}
+
+	// Where the CPU time of the last frame went
+	if (ImGui::CollapsingHeader("Frame Timings"))
+	{
+		ImGui::Text("Update: %.3f ms", frameTimings.updateMs);
+		ImGui::Text("Fixed Update: %.3f ms", frameTimings.fixedUpdateMs);
+		ImGui::Text("Draw: %.3f ms", frameTimings.drawMs);
+		ImGui::Text("  LOD: %.3f ms", frameTimings.lodMs);
+		ImGui::Text("  Culling: %.3f ms", frameTimings.cullMs);
+		ImGui::Text("  Lights: %.3f ms", frameTimings.lightsMs);
+		ImGui::Text("  Render Queue: %.3f ms", frameTimings.queueMs);
+		ImGui::Text("  Shadow Pass: %.3f ms", frameTimings.shadowPassMs);
+		ImGui::Text("  Main Pass: %.3f ms", frameTimings.mainPassMs);
+		ImGui::Text("  Post Process: %.3f ms", frameTimings.postProcessMs);
+		ImGui::Text("  UI And Present: %.3f ms", frameTimings.presentMs);
+	}
+
+	// Benchmarks
+	if (ImGui::CollapsingHeader("Benchmarks"))
+	{
+		// Each button runs a CPU benchmark (this stalls the frame!)
+		if (ImGui::Button("Animation Sampling (10k tracks)"))
+			benchmarkResults = Benchmarks::RunAnimationSampling(10000, 300);
+		if (ImGui::Button("Entity Iteration (100k entities)"))
+			benchmarkResults = Benchmarks::RunEntityIteration(100000, 20);
+		if (ImGui::Button("ECS Update (1M entities)"))
+			benchmarkResults = Benchmarks::RunECSUpdate(1000000, 10);
+
+		// The rest run on a generated scene
+		const char* layoutNames[] = {
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_UNIFORM),
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_CLUSTERED),
+			SceneGenerator::GetLayoutName(SCENE_LAYOUT_HOTSPOTS) };
+		ImGui::Combo("Scene Layout", &benchmarkLayout, layoutNames, IM_ARRAYSIZE(layoutNames));
+		if (ImGui::Button("Scene Generator (1k)"))
+			benchmarkResults = Benchmarks::RunSceneGenerator(1000, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("(100k)"))
+			benchmarkResults = Benchmarks::RunSceneGenerator(100000, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("(1M)"))
+			benchmarkResults = Benchmarks::RunSceneGenerator(1000000, benchmarkLayout);
+		if (ImGui::Button("Octree (10k entities)"))
+			benchmarkResults = Benchmarks::RunOctree(10000, 60, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("Octree (100k)"))
+			benchmarkResults = Benchmarks::RunOctree(100000, 30, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("Octree (1M)"))
+			benchmarkResults = Benchmarks::RunOctree(1000000, 10, benchmarkLayout);
+		if (ImGui::Button("AABB Tree (100k entities)"))
+			benchmarkResults = Benchmarks::RunAABBTree(100000, 30, benchmarkLayout);
+		if (ImGui::Button("Frustum Culling (100k entities)"))
+			benchmarkResults = Benchmarks::RunFrustumCulling(100000, 60, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("(1M)##FrustumCulling"))
+			benchmarkResults = Benchmarks::RunFrustumCulling(1000000, 30, benchmarkLayout);
+		if (ImGui::Button("Multi-View Culling (100k entities)"))
+			benchmarkResults = Benchmarks::RunMultiViewCulling(100000, 10, benchmarkLayout);
+		if (ImGui::Button("Temporal Culling (100k entities)"))
+			benchmarkResults = Benchmarks::RunTemporalCulling(100000, 120, benchmarkLayout);
+		if (ImGui::Button("Occlusion Culling (city, 100k props)"))
+			benchmarkResults = Benchmarks::RunOcclusionCulling(20, 100000, 60, 32);
+		if (ImGui::Button("Render Queue (100k draws)"))
+			benchmarkResults = Benchmarks::RunRenderQueue(100000, 30, benchmarkLayout);
+		if (ImGui::Button("State Cache (100k draws)"))
+			benchmarkResults = Benchmarks::RunStateCache(100000, 10, benchmarkLayout);
+		if (ImGui::Button("Instancing (100k draws)"))
+			benchmarkResults = Benchmarks::RunInstancing(100000, 10, benchmarkLayout);
+		if (ImGui::Button("Constant Buffers (100k draws, 128 lights)"))
+			benchmarkResults = Benchmarks::RunConstantBuffers(100000, 10, MAX_LIGHTS, benchmarkLayout);
+		if (ImGui::Button("Light Clusters (10k lights)"))
+			benchmarkResults = Benchmarks::RunLightClusters(10000, 20, benchmarkLayout);
+		if (ImGui::Button("Object Lights (10k entities, 5k lights)"))
+			benchmarkResults = Benchmarks::RunObjectLights(10000, 5000, 20, benchmarkLayout);
+		if (ImGui::Button("Light Budget (50k lights)"))
+			benchmarkResults = Benchmarks::RunLightBudget(50000, 60, benchmarkLayout);
+		if (ImGui::Button("Frame Graph (1080p)"))
+			benchmarkResults = Benchmarks::RunFrameGraph(1920, 1080, 1000);
+		if (ImGui::Button("LOD Selection (100k entities)"))
+			benchmarkResults = Benchmarks::RunLODSelection(100000, 120, benchmarkLayout);
+		if (ImGui::Button("Sweep And Prune (1k bodies)"))
+			benchmarkResults = Benchmarks::RunSweepAndPrune(1000, 60, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("(10k)##SweepAndPrune"))
+			benchmarkResults = Benchmarks::RunSweepAndPrune(10000, 60, benchmarkLayout);
+		ImGui::SameLine();
+		if (ImGui::Button("(100k)##SweepAndPrune"))
+			benchmarkResults = Benchmarks::RunSweepAndPrune(100000, 30, benchmarkLayout);
+		if (ImGui::Button("Particles (100k)"))
+			benchmarkResults = Benchmarks::RunParticles(100000, 120);
+		ImGui::SameLine();
+		if (ImGui::Button("(1M)##Particles"))
+			benchmarkResults = Benchmarks::RunParticles(1000000, 30);
+		if (ImGui::Button("Scene Load (100k entities)"))
+			benchmarkResults = Benchmarks::RunSceneLoad(100000, benchmarkLayout);
+		if (ImGui::Button("Streaming (250k entities, 5 s flight)"))
+			benchmarkResults = Benchmarks::RunStreaming(250000, 300, benchmarkLayout);
+
+		// Show the results of the last run
+		for (auto& result : benchmarkResults)
+			ImGui::Text("%s: %.3f %s", result.label.c_str(), result.value, result.unit.c_str());
 	}
 
 	// End custom ui window
@@ -845,67 +1782,21 @@ void Game::BuildUI()
 // --------------------------------------------------------
 void Game::CreateShadowMapResources()
 {
-	shadowDSV.Reset();
-	shadowSRV.Reset();
-	shadowRasterizer.Reset();
-	shadowSampler.Reset();
+	Graphics::Backend->DestroyTexture(shadowMap);
 
 	// Create the actual texture that will be the shadow map
-	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = shadowOptions.shadowMapResolution;
-	shadowDesc.Height = shadowOptions.shadowMapResolution;
-	shadowDesc.ArraySize = 1;
-	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-	shadowDesc.CPUAccessFlags = 0;
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-	shadowDesc.MipLevels = 1;
-	shadowDesc.MiscFlags = 0;
-	shadowDesc.SampleDesc.Count = 1;
-	shadowDesc.SampleDesc.Quality = 0;
-	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	Graphics::Device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-	// Create the depth/stencil view
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	Graphics::Device->CreateDepthStencilView(
-		shadowTexture.Get(),
-		&shadowDSDesc,
-		shadowDSV.GetAddressOf());
-
-	// Create the SRV for the shadow map
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	Graphics::Device->CreateShaderResourceView(
-		shadowTexture.Get(),
-		&srvDesc,
-		shadowSRV.GetAddressOf());
-
-	// Create a RS for the shadow map
-	D3D11_RASTERIZER_DESC shadowRastDesc = {};
-	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
-	shadowRastDesc.CullMode = D3D11_CULL_BACK;
-	shadowRastDesc.DepthClipEnable = false; // Keep out-of-frustum objects!
-	shadowRastDesc.DepthBias = 1000; // Min. precision units, not world units!
-	shadowRastDesc.SlopeScaledDepthBias = 1.0f; // Bias more based on slope
-	Graphics::Device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
-
-	// Create a sampler for the shadow map
-	D3D11_SAMPLER_DESC shadowSampDesc = {};
-	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
-	shadowSampDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
-	shadowSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
-	shadowSampDesc.BorderColor[0] = 1.0f; // Only need the first component
-	Graphics::Device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
+	// (a depth buffer the pixel shader can read)
+	RenderTextureDesc shadowDesc = {};
+	shadowDesc.width = shadowOptions.shadowMapResolution;
+	shadowDesc.height = shadowOptions.shadowMapResolution;
+	shadowDesc.format = RENDER_FORMAT_DEPTH32;
+	shadowDesc.flags = RENDER_TEXTURE_DEPTH | RENDER_TEXTURE_SHADER;
+	shadowMap = Graphics::Backend->CreateTexture(shadowDesc);
+
+	// Create a sampler for the shadow map (comparison, and
+	// everything outside it is lit)
+	if (shadowSampler.IsNull())
+		shadowSampler = Graphics::Backend->CreateSampler(RENDER_SAMPLER_SHADOW);
 
 	// The first light is the shadow casting directional light
 	XMVECTOR lightDirection = XMLoadFloat3(&lights[0].Direction);
@@ -927,7 +1818,8 @@ void Game::CreateShadowMapResources()
 	);
 
 	// Set up shadow vertex shader
-	shadowVS = Graphics::LoadVertexShader(L"ShadowVS.cso");
+	if (shadowVS.IsNull())
+		shadowVS = Graphics::Backend->LoadVertexShader(L"ShadowVS.cso", RENDER_INPUT_VERTEX);
 }
 
 // --------------------------------------------------------
@@ -937,25 +1829,20 @@ void Game::CreateShadowMap()
 {
 	// Shadow map settings
 	// Reset all depth values to 1.0
-	Graphics::Context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	Graphics::Backend->ClearDepth(shadowMap, 1.0f);
 
-	// Bind to the shadow map render target instead of the back buffer
-	ID3D11RenderTargetView* nullRTV{};
-	Graphics::Context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
+	// Bind to the shadow map instead of the back buffer
+	Graphics::Backend->SetRenderTargets(0, 0, shadowMap);
 
 	// Set the rasterizer state to add depth bias to get rid of shadow acne
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
+	Graphics::Backend->SetRasterMode(RENDER_RASTER_SHADOW);
 
 	// Set shadow VS and deactivate PS
-	Graphics::Context->VSSetShader(shadowVS.Get(), 0, 0);
-	Graphics::Context->PSSetShader(0, 0, 0);
+	stateCache.SetVertexShader(shadowVS);
+	stateCache.SetPixelShader(ShaderHandle());
 
 	// Match the viewport size to the shadow map resolution
-	D3D11_VIEWPORT viewport = {};
-	viewport.Width = (float)shadowOptions.shadowMapResolution;
-	viewport.Height = (float)shadowOptions.shadowMapResolution;
-	viewport.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &viewport);
+	Graphics::Backend->SetViewport(shadowOptions.shadowMapResolution, shadowOptions.shadowMapResolution);
 
 	struct ShadowVSData
 	{
@@ -968,114 +1855,48 @@ void Game::CreateShadowMap()
 	shadowVSData.view = shadowOptions.lightViewMatrix;
 	shadowVSData.proj = shadowOptions.lightProjectionMatrix;
 
-	// Loop and draw all entities
-	for (auto& e : entities)
+	// Loop and draw the entities the light can see (they come
+	// first in the culled list, then the bulk entities)
+	unsigned int entityCount = (unsigned int)entities.size();
+	auto firstVisibleBulk = std::lower_bound(shadowVisibleObjects.begin(), shadowVisibleObjects.end(), entityCount);
+	for (auto it = shadowVisibleObjects.begin(); it != firstVisibleBulk; it++)
 	{
-		shadowVSData.world = e.GetTransform()->GetWorldMatrix();
-		Graphics::FillAndBindNextConstantBuffer(
+		GameEntity& e = entities[*it];
+		Mesh* mesh = e.GetMesh();
+		if (!mesh)
+			continue;
+
+		shadowVSData.world = e.GetTransform()->GetRenderWorldMatrix();
+		Graphics::Backend->SetConstants(
+			RENDER_STAGE_VERTEX,
+			0,
 			&shadowVSData,
-			sizeof(ShadowVSData),
-			D3D11_VERTEX_SHADER,
-			0);
-		e.Draw();
+			sizeof(ShadowVSData));
+		mesh->Bind(stateCache);
+		mesh->DrawBound(e.GetLOD());
 	}
 
-	// Change settings back to normal for regular drawing in Game::Draw()
-	if (ppOptions.postProcessEnabled)
-		Graphics::Context->OMSetRenderTargets(1, preRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
-	else 
-		Graphics::Context->OMSetRenderTargets(
-			1,
-			Graphics::BackBufferRTV.GetAddressOf(),
-			Graphics::DepthBufferDSV.Get());
-	
-	viewport.Width = (float)Window::Width();
-	viewport.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &viewport);
-	Graphics::Context->RSSetState(0);
-}
+	for (auto it = firstVisibleBulk; it != shadowVisibleObjects.end(); it++)
+	{
+		DrawItem& item = drawList[*it - entityCount];
+		Mesh* mesh = Resources::Meshes.Get(item.mesh);
+		if (!mesh)
+			continue;
+
+		shadowVSData.world = *item.world;
+		Graphics::Backend->SetConstants(
+			RENDER_STAGE_VERTEX,
+			0,
+			&shadowVSData,
+			sizeof(ShadowVSData));
+		mesh->Bind(stateCache);
+		mesh->DrawBound(item.lod);
+	}
 
-// --------------------------------------------------------
-// Create any resources needed for post processing here
-// --------------------------------------------------------
-void Game::CreatePPResources()
-{
-	bloomExtractSRV.Reset();
-	bloomExtractRTV.Reset();
-	bloomCombinedSRV.Reset();
-	bloomCombinedRTV.Reset();
-	blurSRV.Reset();
-	blurRTV.Reset();
-
-	// Describe the texture we're creating
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = Window::Width();
-	textureDesc.Height = Window::Height();
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	// Create the resource (no need to track it after the views are created below)
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> ppTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, ppTexture.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> bloomExtractTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, bloomExtractTexture.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> bloomCombinedTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, bloomCombinedTexture.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> blurTexture;
-	Graphics::Device->CreateTexture2D(&textureDesc, 0, blurTexture.GetAddressOf());
-
-	// Create the Render Target Views
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = textureDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-
-	Graphics::Device->CreateRenderTargetView(
-		ppTexture.Get(),
-		&rtvDesc,
-		preRTV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateRenderTargetView(
-		bloomExtractTexture.Get(),
-		&rtvDesc,
-		bloomExtractRTV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateRenderTargetView(
-		bloomCombinedTexture.Get(),
-		&rtvDesc,
-		bloomCombinedRTV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateRenderTargetView(
-		blurTexture.Get(),
-		&rtvDesc,
-		blurRTV.ReleaseAndGetAddressOf());
-
-	// Create the Shader Resource View
-	// By passing it a null description for the SRV, we
-	// get a "default" SRV that has access to the entire resource
-	Graphics::Device->CreateShaderResourceView(
-		ppTexture.Get(),
-		0,
-		preSRV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateShaderResourceView(
-		bloomExtractTexture.Get(),
-		0,
-		bloomExtractSRV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateShaderResourceView(
-		bloomCombinedTexture.Get(),
-		0,
-		bloomCombinedSRV.ReleaseAndGetAddressOf());
-	Graphics::Device->CreateShaderResourceView(
-		blurTexture.Get(),
-		0,
-		blurSRV.ReleaseAndGetAddressOf());
+	// Change settings back to normal for regular drawing (the
+	// frame graph binds the next pass's targets)
+	Graphics::Backend->SetViewport(Window::Width(), Window::Height());
+	Graphics::Backend->SetRasterMode(RENDER_RASTER_DEFAULT);
 }
 
 // --------------------------------------------------------
@@ -1083,6 +1904,9 @@ void Game::CreatePPResources()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	Clock::time_point start = Clock::now();
+	frameTimings.fixedUpdateMs = 0;
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
@@ -1091,6 +1915,39 @@ void Game::Update(float deltaTime, float totalTime)
 
 	BuildUI();
 
+	cameras[activeCamera]->Update(deltaTime);
+
+	// Particles are purely visual, so they run per frame
+	particles.Update(deltaTime);
+
+	if (streamer.IsOpen())
+		streamer.Update(world, cameras[activeCamera]->GetTransform()->GetPosition(), deltaTime);
+
+	// Right click selects whatever is under the mouse
+	if (Input::MouseRightPress())
+	{
+		pickedEntity = PickEntity(Input::GetMouseX(), Input::GetMouseY());
+		openPickedEntity = pickedEntity >= 0;
+	}
+
+	ppOptions.postProcessEnabled = ppOptions.bloomEnabled || ppOptions.blurEnabled;
+	frameTimings.updateMs = ElapsedMs(start);
+}
+
+// --------------------------------------------------------
+// Advance the simulation by exactly one fixed step
+//  - Called 0..N times per frame from the main loop, so
+//    deltaTime is always the same fixed value here
+// --------------------------------------------------------
+void Game::FixedUpdate(float deltaTime, float totalTime)
+{
+	Clock::time_point start = Clock::now();
+
+	// Remember where everything was before this step
+	for (auto& transform : Resources::Transforms)
+		transform.StorePreviousState();
+	Systems::StorePreviousTransforms(world);
+
 	for (auto& entity : entities)
 	{
 		// Calcualte the rotation
@@ -1105,11 +1962,47 @@ void Game::Update(float deltaTime, float totalTime)
 		entity.GetTransform()->Rotate(rot);
 	}
 
-	entities[0].GetTransform()->MoveAbsolute(XMFLOAT3((float)sin(totalTime) * 0.01f, 0.0f, 0.0f));
+	// Keyframed motion
+	animations.Update(totalTime);
 
-	cameras[activeCamera]->Update(deltaTime);
+	// Bulk entities
+	Systems::Move(world, deltaTime, bulkBoundsMin, bulkBoundsMax);
+	Systems::Spin(world, deltaTime);
 
-	ppOptions.postProcessEnabled = ppOptions.bloomEnabled || ppOptions.blurEnabled;
+	// Generated lights drift around the same bounds
+	XMVECTOR boundsMin = XMLoadFloat3(&bulkBoundsMin);
+	XMVECTOR boundsMax = XMLoadFloat3(&bulkBoundsMax);
+	for (size_t i = 0; i < lightVelocities.size() && i < lights.size(); i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&lights[i].Position);
+		XMVECTOR vel = XMLoadFloat3(&lightVelocities[i]);
+		pos = XMVectorMultiplyAdd(vel, XMVectorReplicate(deltaTime), pos);
+
+		XMVECTOR outside = XMVectorOrInt(XMVectorLess(pos, boundsMin), XMVectorGreater(pos, boundsMax));
+		XMStoreFloat3(&lightVelocities[i], XMVectorSelect(vel, XMVectorNegate(vel), outside));
+		XMStoreFloat3(&lights[i].Position, XMVectorClamp(pos, boundsMin, boundsMax));
+	}
+
+	// Only entities that moved this step touch the octree
+	UpdateSpatialIndex();
+	overlaps.FindPairs(overlapPairs);
+	frameTimings.fixedUpdateMs += ElapsedMs(start);
+}
+
+// --------------------------------------------------------
+// Build the render-side world matrices for this frame
+//  - alpha is how far we are between the last two
+//    simulation steps (0 = previous, 1 = current)
+// --------------------------------------------------------
+void Game::Interpolate(float alpha)
+{
+	// Walk the transform pool directly - it's densely packed
+	for (auto& transform : Resources::Transforms)
+		transform.Interpolate(alpha);
+
+	// Bulk entities the same way (their world matrices are only
+	// built here, from the last two steps)
+	Systems::InterpolateWorldMatrices(world, alpha);
 }
 
 // --------------------------------------------------------
@@ -1117,250 +2010,558 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	// Each part of the frame's CPU time, for the UI
+	Clock::time_point drawStart = Clock::now();
+	Clock::time_point start = drawStart;
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
 	{
-		// Clear the back buffer (erase what's on screen) and depth buffer
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	backgroundColor);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		// Clear the depth buffer (the frame graph clears the
+		// color targets as the passes that write them start)
+		Graphics::Backend->ClearDepth(Graphics::Backend->GetDepthBuffer(), 1.0f);
+	}
 
-		// Pre-render before post-processing
-		if (ppOptions.postProcessEnabled)
+	// Pick detail levels, then gather the bulk entities to draw
+	// (both are used by the shadow pass too)
+	SelectLODs();
+	Systems::BuildDrawList(world, drawList);
+	frameTimings.lodMs = ElapsedMs(start);
+	start = Clock::now();
+
+	// The main pass and the shadow pass are culled together,
+	// each against its own view, then the main pass is
+	// occlusion culled
+	CullScene();
+	OccludeScene();
+	frameTimings.cullMs = ElapsedMs(start);
+	start = Clock::now();
+	unsigned int entityCount = (unsigned int)entities.size();
+
+	// Everything from here to the sky binds through the state
+	// cache (it can't know what was left bound last frame)
+	stateCache.BeginFrame();
+
+	// The mode this frame actually lights with: a failed upload falls
+	// back to the constant buffer for the frame only, and the UI's
+	// choice is tried again next frame
+	int frameLightingMode = lightingMode;
+
+	// Point and spot lights into the active camera's froxels
+	if (frameLightingMode == LIGHTING_CLUSTERED)
+	{
+		std::shared_ptr<Camera> camera = cameras[activeCamera];
+		lightClusters.Build(camera->GetView(), camera->GetProjection(), camera->GetNearPlane(), camera->GetFarPlane());
+		lightClusters.Assign(lights.data(), (unsigned int)lights.size());
+		if (lightClusters.Upload(lights.data(), (unsigned int)lights.size()))
 		{
-			// Clear post process target too
-			const float rtClearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-			Graphics::Context->ClearRenderTargetView(preRTV.Get(), rtClearColor);
-			Graphics::Context->ClearRenderTargetView(bloomExtractRTV.Get(), rtClearColor);
-			Graphics::Context->ClearRenderTargetView(bloomCombinedRTV.Get(), rtClearColor);
-			Graphics::Context->ClearRenderTargetView(blurRTV.Get(), rtClearColor);
-
-			// Change the render target to render directly into the first pp texture
-			Graphics::Context->OMSetRenderTargets(1, preRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+			stateCache.SetPixelShaderResource(5, lightClusters.GetLightView());
+			stateCache.SetPixelShaderResource(6, lightClusters.GetRangeView());
+			stateCache.SetPixelShaderResource(7, lightClusters.GetIndexView());
+		}
+		else
+		{
+			frameLightingMode = LIGHTING_CONSTANT_BUFFER;
 		}
 	}
 
-	CreateShadowMap();
-
-	// Bind shadow resources to PS
-	Graphics::Context->PSSetShaderResources(4, 1, shadowSRV.GetAddressOf());
-	Graphics::Context->PSSetSamplers(1, 1, shadowSampler.GetAddressOf());
+	// The pixel shader's frame data, with the lights the frame's mode
+	// needs in the constant buffer (run again if the mode falls back)
+	auto uploadPSFrameData = [&]()
+	{
+		psFrameData.lightingMode = frameLightingMode;
+		if (frameLightingMode != LIGHTING_CONSTANT_BUFFER)
+		{
+			// Only the directional lights stay in the constant buffer
+			// (in order, so the shadowed one is still first)
+			psFrameData.lightCount = 0;
+			for (size_t i = 0; i < lights.size() && psFrameData.lightCount < MAX_LIGHTS; i++)
+				if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+					psFrameData.lights[psFrameData.lightCount++] = lights[i];
+
+			psFrameData.clusterScreenScale = XMFLOAT2(
+				(float)LIGHT_CLUSTERS_X / Window::Width(),
+				(float)LIGHT_CLUSTERS_Y / Window::Height());
+			psFrameData.clusterDepthScale = lightClusters.GetSliceScale();
+			psFrameData.clusterDepthBias = lightClusters.GetSliceBias();
+		}
+		else
+		{
+			// The lights worth the most on screen, faded in and out
+			// as they make or leave the budget
+			std::shared_ptr<Camera> camera = cameras[activeCamera];
+			lightBudget.Update(
+				lights.data(),
+				(unsigned int)lights.size(),
+				camera->GetViewProjection(),
+				camera->GetTransform()->GetPosition(),
+				lightBudgetCount,
+				MAX_LIGHTS,
+				deltaTime,
+				cullingParallel);
+
+			const std::vector<Light>& budgetLights = lightBudget.GetLights();
+			psFrameData.lightCount = (int)budgetLights.size();
+			if (!budgetLights.empty())
+				memcpy(&psFrameData.lights, budgetLights.data(), sizeof(Light) * psFrameData.lightCount);
+		}
 
-	// Update the constant buffer data (same for all entities)
-	vsData.view = cameras[activeCamera]->GetView();
-	vsData.projection = cameras[activeCamera]->GetProjection();
-	vsData.lightView = shadowOptions.lightViewMatrix;
-	vsData.lightProjection = shadowOptions.lightProjectionMatrix;
+		Graphics::Backend->UpdateBuffer(psFrameBuffer, &psFrameData, sizeof(PSFrameConstantBuffer));
+	};
 
-	psData.totalTime = totalTime;
-	psData.cameraPos = cameras[activeCamera]->GetTransform()->GetPosition();
-	// psData.ambientColor = ambientColor;
-	memcpy(&psData.lights, &lights[0], sizeof(Light) * (int)lights.size());
-	psData.lightCount = (int)lights.size();
+	// Upload the per frame constant data (camera, shadow and
+	// lights) once, to its own buffers at b1
+	// - Per object and per material data goes through the ring at b0
+	auto reservedBytes = [](size_t size) { return (size + 255) / 256 * 256; };
+	constantBufferStats = {};
+	{
+		vsFrameData.view = cameras[activeCamera]->GetView();
+		vsFrameData.projection = cameras[activeCamera]->GetProjection();
+		vsFrameData.lightView = shadowOptions.lightViewMatrix;
+		vsFrameData.lightProjection = shadowOptions.lightProjectionMatrix;
+
+		psFrameData.totalTime = totalTime;
+		psFrameData.cameraPos = cameras[activeCamera]->GetTransform()->GetPosition();
+		// psFrameData.ambientColor = ambientColor;
+		psFrameData.cameraForward = cameras[activeCamera]->GetTransform()->GetForward();
+		uploadPSFrameData();
+
+		Graphics::Backend->UpdateBuffer(vsFrameBuffer, &vsFrameData, sizeof(VSFrameConstantBuffer));
+		Graphics::Backend->SetConstantBuffer(RENDER_STAGE_VERTEX, CB_SLOT_FRAME, vsFrameBuffer);
+		Graphics::Backend->SetConstantBuffer(RENDER_STAGE_PIXEL, CB_SLOT_FRAME, psFrameBuffer);
+
+		constantBufferStats.frameUploads = 2;
+		constantBufferStats.frameBytes = sizeof(VSFrameConstantBuffer) + sizeof(PSFrameConstantBuffer);
+	}
+	frameTimings.lightsMs = ElapsedMs(start);
+	start = Clock::now();
 
-	// Draw all entities
-	for (auto& entity : entities)
+	// Tally what the main pass submits, and what it would without LOD
+	auto countTriangles = [&](Mesh* mesh, int lod)
 	{
-		std::shared_ptr<Material> material = entity.GetMaterial();
+		lodStats.objects++;
+		lodStats.levelObjects[std::min(lod, MESH_MAX_LODS - 1)]++;
+		lodStats.trianglesFull += mesh->GetIndexCount() / 3;
+		lodStats.trianglesSubmitted += mesh->GetIndexCount(lod) / 3;
+	};
 
-		// Pass material's scale and offset to ps
-		psData.scale = material->GetScale();
-		psData.offset = material->GetOffset();
-		
-		// Bind textures and samplers
-		material->BindTexturesAndSamplers();
+	// Queue every visible draw, keyed by pass, state and depth
+	// - Culler indices are the items: entities first, then the
+	//    bulk entities in draw list order
+	{
+		std::shared_ptr<Transform> cameraTransform = cameras[activeCamera]->GetTransform();
+		XMFLOAT3 cameraPosition = cameraTransform->GetPosition();
+		XMFLOAT3 cameraForward = cameraTransform->GetForward();
+		auto viewDepth = [&](const XMFLOAT4X4& world)
+		{
+			return
+				(world._41 - cameraPosition.x) * cameraForward.x +
+				(world._42 - cameraPosition.y) * cameraForward.y +
+				(world._43 - cameraPosition.z) * cameraForward.z;
+		};
+
+		renderQueue.Begin(cameras[activeCamera]->GetFarPlane());
+		for (unsigned int index : visibleObjects)
+		{
+			MeshHandle meshHandle;
+			MaterialHandle materialHandle;
+			int lod;
+			XMFLOAT4X4 world;
+			if (index < entityCount)
+			{
+				GameEntity& entity = entities[index];
+				meshHandle = entity.GetMeshHandle();
+				materialHandle = entity.GetMaterialHandle();
+				lod = entity.GetLOD();
+				world = entity.GetTransform()->GetRenderWorldMatrix();
+			}
+			else
+			{
+				DrawItem& item = drawList[index - entityCount];
+				meshHandle = item.mesh;
+				materialHandle = item.material;
+				lod = item.lod;
+				world = *item.world;
+			}
 
-		// Activate the shaders for this material
-		Graphics::Context->VSSetShader(material->GetVertexShader().Get(), 0, 0);
-		Graphics::Context->PSSetShader(material->GetPixelShader().Get(), 0, 0);
+			Material* material = Resources::Materials.Get(materialHandle);
+			if (!material || !Resources::Meshes.Get(meshHandle))
+				continue;
+			renderQueue.Add(renderQueue.MakeKey(materialHandle, material, meshHandle, lod, viewDepth(world)), index);
+		}
+		renderQueue.Sort();
+	}
 
-		// Update constant buffers (entity specific)
-		// Get matrices for this entity and store it in the constant buffer data
-		vsData.world = entity.GetTransform()->GetWorldMatrix();
-		vsData.worldInvTranspose = entity.GetTransform()->GetWorldInverseTransposeMatrix();
-		// Get the color tint of this entity's material
-		psData.colorTint = material->GetColorTint();
+	// What a queued draw uses (culler indices: entities, then
+	// the bulk entities in draw list order)
+	const uint64_t* queueKeys = renderQueue.GetKeys();
+	const unsigned int* queueItems = renderQueue.GetItems();
+	auto getDraw = [&](unsigned int index, Mesh** mesh, Material** material, int* lod)
+	{
+		if (index < entityCount)
+		{
+			GameEntity& entity = entities[index];
+			*mesh = entity.GetMesh();
+			*material = entity.GetMaterial();
+			*lod = entity.GetLOD();
+		}
+		else
+		{
+			DrawItem& item = drawList[index - entityCount];
+			*mesh = Resources::Meshes.Get(item.mesh);
+			*material = Resources::Materials.Get(item.material);
+			*lod = item.lod;
+		}
+	};
+	auto getMatrices = [&](unsigned int index, XMFLOAT4X4* world, XMFLOAT4X4* worldInvTranspose)
+	{
+		if (index < entityCount)
+		{
+			GameEntity& entity = entities[index];
+			*world = entity.GetTransform()->GetRenderWorldMatrix();
+			*worldInvTranspose = entity.GetTransform()->GetRenderWorldInverseTransposeMatrix();
+		}
+		else
+		{
+			const XMFLOAT4X4* itemWorld = drawList[index - entityCount].world;
+			*world = *itemWorld;
+			XMStoreFloat4x4(worldInvTranspose, XMMatrixInverse(0, XMMatrixTranspose(XMLoadFloat4x4(itemWorld))));
+		}
+	};
 
-		// Fill and bind Vertex Shader Constant Buffer
-		Graphics::FillAndBindNextConstantBuffer(
-			&vsData,
-			sizeof(VSConstantBuffer),
-			D3D11_VERTEX_SHADER,
-			0);
-		
-		// Fill and bind Pixel Shader Constant Buffer
-		Graphics::FillAndBindNextConstantBuffer(
-			&psData,
-			sizeof(PSConstantBuffer),
-			D3D11_PIXEL_SHADER,
-			0);
-
-		// Draw the entity
-		entity.Draw();
+	// Instancing: draws with the same state next to each other
+	// in the queue become one draw, with every draw's matrices
+	// in one buffer (filled in parallel)
+	if (instancingEnabled)
+	{
+		instancing.Group(queueKeys, renderQueue.GetCount());
+		instancing.Fill([&](unsigned int begin, unsigned int end, InstanceData* out)
+		{
+			for (unsigned int i = begin; i < end; i++, out++)
+				getMatrices(queueItems[i], &out->world, &out->worldInvTranspose);
+		}, cullingParallel);
+		instancing.Upload();
 	}
 
-	// draw the sky
-	sky->Draw(cameras[activeCamera]);
-
-	// Post Processing
-	{	
-		if (ppOptions.postProcessEnabled)
+	// Per object lights: each queued draw's strongest lights, found
+	// from its world box (its queue position is its index into the
+	// lists, in both vertex shaders)
+	if (frameLightingMode == LIGHTING_PER_OBJECT)
+	{
+		objectLights.Select([&](unsigned int i)
 		{
-			// Bloom
-			if (ppOptions.bloomEnabled)
-			{
-				// Extract bright areas to bloomRTV
-				{
-					// Set the render target to the bloom extract texture
-					Graphics::Context->OMSetRenderTargets(1, bloomExtractRTV.GetAddressOf(), 0);
+			Mesh* mesh;
+			Material* material;
+			int lod;
+			unsigned int index = queueItems[i];
+			getDraw(index, &mesh, &material, &lod);
+			XMFLOAT4X4 world = index < entityCount ?
+				entities[index].GetTransform()->GetRenderWorldMatrix() :
+				*drawList[index - entityCount].world;
+			return Bounds::TransformAABB(mesh->GetBounds(), world);
+		}, renderQueue.GetCount(), lights.data(), (unsigned int)lights.size(), cullingParallel);
+
+		if (objectLights.Upload(lights.data(), (unsigned int)lights.size()))
+		{
+			stateCache.SetPixelShaderResource(5, objectLights.GetLightView());
+			stateCache.SetPixelShaderResource(8, objectLights.GetListView());
+		}
+		else
+		{
+			// The frame data already went up for per object lights
+			frameLightingMode = LIGHTING_CONSTANT_BUFFER;
+			uploadPSFrameData();
+		}
+	}
 
-					// Activate shaders and bind resources
-					Graphics::Context->VSSetShader(ppVS.Get(), 0, 0);
-					Graphics::Context->PSSetShader(bloomPS.Get(), 0, 0);
-					Graphics::Context->PSSetShaderResources(0, 1, preSRV.GetAddressOf());
-					Graphics::Context->PSSetSamplers(0, 1, ppSampler.GetAddressOf());
+	// Binds a draw's material (only when it changes) and mesh
+	// (the state cache drops the binds that match the last draw's)
+	Material* boundMaterial = nullptr;
+	auto bindDraw = [&](Mesh* mesh, Material* material, ShaderHandle vs)
+	{
+		stateCache.SetVertexShader(vs);
+		stateCache.SetPixelShader(material->GetPixelShader());
+		if (material != boundMaterial)
+		{
+			// Pass material's scale, offset and tint to ps
+			psData.scale = material->GetScale();
+			psData.offset = material->GetOffset();
+			psData.colorTint = material->GetColorTint();
+			material->BindTexturesAndSamplers(stateCache);
+
+			Graphics::Backend->SetConstants(
+				RENDER_STAGE_PIXEL,
+				CB_SLOT_DRAW,
+				&psData,
+				sizeof(PSConstantBuffer));
+			constantBufferStats.materialUploads++;
+			constantBufferStats.materialBytes += reservedBytes(sizeof(PSConstantBuffer));
+			boundMaterial = material;
+		}
+		mesh->Bind(stateCache);
+		stateCache.Commit();
+	};
 
-					struct BloomData
-					{
-						float bloomThreshold;
-						int bloomType;
-					};
+	// One draw call per queued draw
+	auto drawSingle = [&](unsigned int i)
+	{
+		Mesh* mesh;
+		Material* material;
+		int lod;
+		getDraw(queueItems[i], &mesh, &material, &lod);
+		getMatrices(queueItems[i], &vsData.world, &vsData.worldInvTranspose);
+		vsData.objectIndex = i;
+		bindDraw(mesh, material, material->GetVertexShader());
+
+		// Fill and bind Vertex Shader Constant Buffer (draw specific)
+		Graphics::Backend->SetConstants(
+			RENDER_STAGE_VERTEX,
+			CB_SLOT_DRAW,
+			&vsData,
+			sizeof(VSConstantBuffer));
+		constantBufferStats.objectUploads++;
+		constantBufferStats.objectBytes += reservedBytes(sizeof(VSConstantBuffer));
 
-					BloomData psData = {};
-					psData.bloomThreshold = ppOptions.bloomThreshold;
-					psData.bloomType = ppOptions.bloomType;
-					Graphics::FillAndBindNextConstantBuffer(&psData, sizeof(BloomData), D3D11_PIXEL_SHADER, 0);
+		mesh->DrawBound(lod);
+		countTriangles(mesh, lod);
+		mainPassDrawCalls++;
+	};
 
-					// Draw exactly 3 vertices
-					Graphics::Context->Draw(3, 0);
+	// Runs part of the sorted queue, a group at a time when instancing
+	InstancedVSConstantBuffer instancedVSData = {};
+	auto drawQueued = [&](unsigned int begin, unsigned int end)
+	{
+		Clock::time_point start = Clock::now();
+		boundMaterial = nullptr;
+		if (!instancingEnabled)
+		{
+			for (unsigned int i = begin; i < end; i++)
+				drawSingle(i);
+		}
+		else
+		{
+			TextureHandle instanceView = instancing.GetView();
+			Graphics::Backend->SetVertexShaderResource(0, instanceView);
+			for (const InstanceGroup& group : instancing.GetGroups())
+			{
+				if (group.start < begin || group.start >= end)
+					continue;
 
-					// Unbind the SRV
-					ID3D11ShaderResourceView* nullSRV = nullptr;
-					Graphics::Context->PSSetShaderResources(0, 1, &nullSRV);
-				}
+				Mesh* mesh;
+				Material* material;
+				int lod;
+				getDraw(queueItems[group.start], &mesh, &material, &lod);
 
-				// Blur the bloomed image into blurRTV
+				// Only the lit vertex shader has an instanced version
+				if (material->GetVertexShader() != litVS || instanceView.IsNull())
 				{
-					// Set the render target to the blur texture
-					Graphics::Context->OMSetRenderTargets(1, blurRTV.GetAddressOf(), 0);
-
-					// Activate shaders and bind resources
-					Graphics::Context->VSSetShader(ppVS.Get(), 0, 0);
-					Graphics::Context->PSSetShader(blurPS.Get(), 0, 0);
-					Graphics::Context->PSSetShaderResources(0, 1, bloomExtractSRV.GetAddressOf());
-					Graphics::Context->PSSetSamplers(0, 1, ppSampler.GetAddressOf());
-
-					struct BlurData
-					{
-						int blurDistance;
-						float pixelWidth;
-						float pixelHeight;
-					};
-
-					BlurData psData = {};
-					psData.pixelWidth = 1.0f / Window::Width();
-					psData.pixelHeight = 1.0f / Window::Height();
-					psData.blurDistance = 5;
-					Graphics::FillAndBindNextConstantBuffer(&psData, sizeof(BlurData), D3D11_PIXEL_SHADER, 0);
-
-					// Draw exactly 3 vertices
-					Graphics::Context->Draw(3, 0);
-
-					// Unbind the SRV
-					ID3D11ShaderResourceView* nullSRV = nullptr;
-					Graphics::Context->PSSetShaderResources(0, 1, &nullSRV);
+					for (unsigned int i = group.start; i < group.start + group.count; i++)
+						drawSingle(i);
+					continue;
 				}
 
-				// Combine the oringial image with the bloomed image and draw to the back buffer
-				{
-					// Set the render target to the back buffer (or bloom combined texture if blur is also enabled)
-					if (ppOptions.blurEnabled)
-						Graphics::Context->OMSetRenderTargets(1, bloomCombinedRTV.GetAddressOf(),0);
-					else 
-						Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
-
-					// Activate shaders and bind resources
-					Graphics::Context->VSSetShader(ppVS.Get(), 0, 0);
-					Graphics::Context->PSSetShader(combineBloomPS.Get(), 0, 0);
-					Graphics::Context->PSSetShaderResources(0, 1, preSRV.GetAddressOf());
-					Graphics::Context->PSSetShaderResources(1, 1, blurSRV.GetAddressOf());
-					Graphics::Context->PSSetSamplers(0, 1, ppSampler.GetAddressOf());
-
-					// Draw exactly 3 vertices
-					Graphics::Context->Draw(3, 0);
-
-					// Unbind the SRVs
-					ID3D11ShaderResourceView* nullSRV = nullptr;
-					Graphics::Context->PSSetShaderResources(0, 1, &nullSRV);
-					Graphics::Context->PSSetShaderResources(1, 1, &nullSRV);
-				}
+				bindDraw(mesh, material, instancedVS);
+				instancedVSData.instanceStart = group.start;
+				Graphics::Backend->SetConstants(
+					RENDER_STAGE_VERTEX,
+					CB_SLOT_DRAW,
+					&instancedVSData,
+					sizeof(InstancedVSConstantBuffer));
+				constantBufferStats.objectUploads++;
+				constantBufferStats.objectBytes += reservedBytes(sizeof(InstancedVSConstantBuffer)) + group.count * sizeof(InstanceData);
+
+				mesh->DrawBoundInstanced(lod, group.count);
+				for (unsigned int i = 0; i < group.count; i++)
+					countTriangles(mesh, lod);
+				mainPassDrawCalls++;
 			}
+			Graphics::Backend->SetVertexShaderResource(0, TextureHandle());
+		}
+		mainPassSubmitMs += ElapsedMs(start);
+	};
 
-			// Blur
-			if (ppOptions.blurEnabled)
-			{
-				// Clean the blur render target if it was used for bloom
-				if (ppOptions.bloomEnabled)
-				{
-					const float rtClearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-					Graphics::Context->ClearRenderTargetView(blurRTV.Get(), rtClearColor);
-				}
-				// Set the render target to the back buffer
-				Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), 0);
+	// Transparent keys sort after every opaque one
+	unsigned int queueCount = renderQueue.GetCount();
+	unsigned int firstTransparent = (unsigned int)(std::partition_point(queueKeys, queueKeys + queueCount,
+		[](uint64_t key) { return RenderQueue::GetPass(key) == RENDER_PASS_OPAQUE; }) - queueKeys);
+
+	frameTimings.queueMs = ElapsedMs(start);
+
+	// The frame's passes, each with what it reads and writes:
+	// the graph binds and clears targets, unbinds inputs before
+	// they're written, skips passes nothing uses, and lets
+	// targets that are never alive at once share a texture
+	frameGraph.Reset();
+	FrameGraphTextureDesc screenDesc = { (unsigned int)Window::Width(), (unsigned int)Window::Height(), RENDER_FORMAT_RGBA8 };
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	FrameGraphResource backBuffer = frameGraph.Import("Back Buffer", Graphics::Backend->GetBackBuffer(), true);
+	FrameGraphResource shadowMapResource = frameGraph.Import("Shadow Map", shadowMap, false, false);
+	bool postProcess = ppOptions.postProcessEnabled && (ppOptions.bloomEnabled || ppOptions.blurEnabled);
+	FrameGraphResource sceneColor = postProcess ? frameGraph.CreateTexture("Scene Color", screenDesc) : backBuffer;
+
+	// Shadow map (binds its own depth target)
+	int shadowPass = frameGraph.AddPass("Shadow", [&]() { CreateShadowMap(); });
+	frameGraph.Write(shadowPass, shadowMapResource);
+
+	// Scene: opaque, sky, transparent, then particles
+	int mainPass = frameGraph.AddPass("Main", [&]()
+	{
+		// Bind shadow resources to PS (sent with the first draw)
+		stateCache.SetPixelShaderResource(4, shadowMap);
+		stateCache.SetPixelSampler(1, shadowSampler);
+
+		// Opaque draws
+		mainPassDrawCalls = 0;
+		mainPassSubmitMs = 0;
+		drawQueued(0, firstTransparent);
+
+		// draw the sky (around the state cache)
+		sky->Draw(cameras[activeCamera]);
+		stateCache.Invalidate();
+
+		// Transparent draws, far to near, blended over the opaque
+		// scene and the sky without writing depth
+		if (firstTransparent < queueCount)
+		{
+			Graphics::Backend->SetBlendMode(RENDER_BLEND_ALPHA);
+			Graphics::Backend->SetDepthMode(RENDER_DEPTH_READ_ONLY);
+			drawQueued(firstTransparent, queueCount);
+			Graphics::Backend->SetBlendMode(RENDER_BLEND_OPAQUE);
+			Graphics::Backend->SetDepthMode(RENDER_DEPTH_DEFAULT);
+		}
 
-				// Activate shaders and bind resources
-				Graphics::Context->VSSetShader(ppVS.Get(), 0, 0);
-				Graphics::Context->PSSetShader(blurPS.Get(), 0, 0);
+		// Kept per mode, so the UI can compare the two
+		InstancingStats instancingStats = instancing.GetStats();
+		lastDrawCalls[instancingEnabled] = mainPassDrawCalls;
+		lastSubmitMs[instancingEnabled] = mainPassSubmitMs +
+			(instancingEnabled ? instancingStats.groupMs + instancingStats.fillMs + instancingStats.uploadMs : 0.0);
+		constantBufferStats.singleBlockBytes = renderQueue.GetCount() * (
+			reservedBytes(sizeof(VSConstantBuffer) + sizeof(VSFrameConstantBuffer)) +
+			reservedBytes(sizeof(PSConstantBuffer) + sizeof(PSFrameConstantBuffer)));
 
-				// If bloom is enabled, blur the bloomed image
-				// Otherwise, just blur the original image
-				if (ppOptions.bloomEnabled)
-					Graphics::Context->PSSetShaderResources(0, 1, bloomCombinedSRV.GetAddressOf());
-				else
-					Graphics::Context->PSSetShaderResources(0, 1, preSRV.GetAddressOf());
+		// Particles last, far to near, over the opaque scene
+		{
+			std::shared_ptr<Transform> cameraTransform = cameras[activeCamera]->GetTransform();
+			particles.Sort(cameraTransform->GetPosition(), cameraTransform->GetForward());
+			particles.Pack();
+			particles.Draw(cameras[activeCamera]);
+		}
+	});
+	frameGraph.Read(mainPass, shadowMapResource);
+	frameGraph.Write(mainPass, sceneColor, postProcess ? black : backgroundColor);
+	frameGraph.SetDepth(mainPass, Graphics::Backend->GetDepthBuffer());
+
+	// Post processing: fullscreen triangles, each reading the
+	// last pass's output (the final one writes the back buffer)
+	auto drawFullscreen = [&](ShaderHandle ps, void* data, unsigned int dataSize)
+	{
+		Graphics::Backend->SetVertexShader(ppVS);
+		Graphics::Backend->SetPixelShader(ps);
+		Graphics::Backend->SetPixelSamplers(0, 1, &ppSampler);
+		if (data)
+			Graphics::Backend->SetConstants(RENDER_STAGE_PIXEL, 0, data, dataSize);
+
+		// Draw exactly 3 vertices
+		Graphics::Backend->Draw(3);
+	};
 
-				Graphics::Context->PSSetSamplers(0, 1, ppSampler.GetAddressOf());
+	struct BloomData
+	{
+		float bloomThreshold;
+		int bloomType;
+	};
 
-				struct BlurData
-				{
-					int blurDistance;
-					float pixelWidth;
-					float pixelHeight;
-				};
-
-				BlurData psData = {};
-				psData.pixelWidth = 1.0f / Window::Width();
-				psData.pixelHeight = 1.0f / Window::Height();
-				psData.blurDistance = ppOptions.blurDistance;
-				Graphics::FillAndBindNextConstantBuffer(&psData, sizeof(BlurData), D3D11_PIXEL_SHADER, 0);
-
-				// Draw exactly 3 vertices
-				Graphics::Context->Draw(3, 0);
-			}
-		}
+	struct BlurData
+	{
+		int blurDistance;
+		float pixelWidth;
+		float pixelHeight;
+	};
+
+	BloomData bloomData = {};
+	bloomData.bloomThreshold = ppOptions.bloomThreshold;
+	bloomData.bloomType = ppOptions.bloomType;
+	BlurData bloomBlurData = {};
+	bloomBlurData.pixelWidth = 1.0f / Window::Width();
+	bloomBlurData.pixelHeight = 1.0f / Window::Height();
+	bloomBlurData.blurDistance = 5;
+	BlurData blurData = bloomBlurData;
+	blurData.blurDistance = ppOptions.blurDistance;
+
+	FrameGraphResource bloomExtract = FRAME_GRAPH_NONE;
+	FrameGraphResource color = sceneColor;
+	if (postProcess && ppOptions.bloomEnabled)
+	{
+		// Extract bright areas, blur them, then add them back
+		bloomExtract = frameGraph.CreateTexture("Bloom Extract", screenDesc);
+		int extractPass = frameGraph.AddPass("Bloom Extract", [&]() { drawFullscreen(bloomPS, &bloomData, sizeof(BloomData)); });
+		frameGraph.Read(extractPass, sceneColor, 0);
+		frameGraph.Write(extractPass, bloomExtract);
+
+		FrameGraphResource bloomBlur = frameGraph.CreateTexture("Bloom Blur", screenDesc);
+		int bloomBlurPass = frameGraph.AddPass("Bloom Blur", [&]() { drawFullscreen(blurPS, &bloomBlurData, sizeof(BlurData)); });
+		frameGraph.Read(bloomBlurPass, bloomExtract, 0);
+		frameGraph.Write(bloomBlurPass, bloomBlur);
+
+		FrameGraphResource combined = ppOptions.blurEnabled ? frameGraph.CreateTexture("Bloom Combined", screenDesc) : backBuffer;
+		int combinePass = frameGraph.AddPass("Bloom Combine", [&]() { drawFullscreen(combineBloomPS, 0, 0); });
+		frameGraph.Read(combinePass, sceneColor, 0);
+		frameGraph.Read(combinePass, bloomBlur, 1);
+		frameGraph.Write(combinePass, combined);
+		color = combined;
+	}
+	if (postProcess && ppOptions.blurEnabled)
+	{
+		int blurPass = frameGraph.AddPass("Blur", [&]() { drawFullscreen(blurPS, &blurData, sizeof(BlurData)); });
+		frameGraph.Read(blurPass, color, 0);
+		frameGraph.Write(blurPass, backBuffer);
 	}
 
-	// Unbind all SRVs at the end of the frame so they won't be bound as inputs next frame
-	ID3D11ShaderResourceView* nullSRVs[128] = {};
-	Graphics::Context->PSSetShaderResources(0, 128, nullSRVs);
+	// The UI shows these after the frame, so they can't be
+	// aliased over while it's open
+	if (ppPreviewOpen)
+	{
+		if (sceneColor != backBuffer)
+			frameGraph.Export(sceneColor);
+		frameGraph.Export(bloomExtract);
+	}
+
+	frameGraph.Compile();
+	frameGraph.Execute(stateCache);
+	frameTimings.shadowPassMs = frameGraph.GetPassMs(shadowPass);
+	frameTimings.mainPassMs = frameGraph.GetPassMs(mainPass);
+	frameTimings.postProcessMs = frameGraph.GetStats().executeMs - frameTimings.shadowPassMs - frameTimings.mainPassMs;
+	start = Clock::now();
+
+	// Unbind all textures at the end of the frame so they won't be bound as inputs next frame
+	TextureHandle nullTextures[RENDER_MAX_SHADER_RESOURCES] = {};
+	Graphics::Backend->SetPixelShaderResources(0, RENDER_MAX_SHADER_RESOURCES, nullTextures);
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
 	// - At the very end of the frame (after drawing *everything*)
 	{
 		ImGui::Render(); // Turns this frames UI into renderable triangles
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData()); // Draws it to the screen
+		Graphics::Backend->RenderUI(ImGui::GetDrawData()); // Draws it to the screen
 
 		// Present at the end of the frame
-		bool vsync = Graphics::VsyncState();
-		Graphics::SwapChain->Present(
-			vsync ? 1 : 0,
-			vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		Graphics::Backend->Present();
+
+		// The first frame of a newly loaded scene is on screen
+		if (sceneFirstFramePending)
+		{
+			sceneFirstFrameMs = ElapsedMs(sceneLoadStart);
+			sceneFirstFramePending = false;
+		}
 
 		// Re-bind back buffer and depth buffer after presenting
-		Graphics::Context->OMSetRenderTargets(
+		TextureHandle backBufferTexture = Graphics::Backend->GetBackBuffer();
+		Graphics::Backend->SetRenderTargets(
 			1,
-			Graphics::BackBufferRTV.GetAddressOf(),
-			Graphics::DepthBufferDSV.Get());
+			&backBufferTexture,
+			Graphics::Backend->GetDepthBuffer());
 	}
+	frameTimings.presentMs = ElapsedMs(start);
+	frameTimings.drawMs = ElapsedMs(drawStart);
 }
@@ -1,18 +1,56 @@
 #pragma once
 
-#include <d3d11.h>
-#include <wrl/client.h>
 #include <memory>
 #include <vector>
+#include <string>
 #include <DirectXMath.h>
 
 #include "Mesh.h"
+#include "Timing.h"
 #include "BufferStructs.h"
+#include "Resources.h"
 #include "GameEntity.h"
 #include "Camera.h"
 #include "Material.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "Animation.h"
+#include "EntitySystems.h"
+#include "Octree.h"
+#include "AABBTree.h"
+#include "SweepAndPrune.h"
+#include "SceneFile.h"
+#include "WorldStreaming.h"
+#include "SceneGenerator.h"
+#include "LevelOfDetail.h"
+#include "Culling.h"
+#include "Occlusion.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "Instancing.h"
+#include "LightClusters.h"
+#include "ObjectLights.h"
+#include "LightBudget.h"
+#include "ParticleSystem.h"
+#include "FrameGraph.h"
+#include "RenderBackend.h"
+#include "Benchmarks.h"
+
+// Where the CPU time of the last frame went (ms)
+struct FrameTimings
+{
+	double updateMs;			// Input, UI building, camera, particles, streaming
+	double fixedUpdateMs;		// Every fixed step this frame
+	double drawMs;				// All of Draw(), which is:
+	double lodMs;				//   detail levels and the bulk draw list
+	double cullMs;				//   frustum and occlusion culling
+	double lightsMs;			//   clusters or the light budget, and the per frame upload
+	double queueMs;				//   the render queue, instancing and per object lights
+	double shadowPassMs;		//   frame graph passes, binds and clears included
+	double mainPassMs;
+	double postProcessMs;
+	double presentMs;			//   the UI's draw data and presenting
+};
 
 class Game
 {
@@ -25,9 +63,14 @@ public:
 
 	// Primary functions
 	void Update(float deltaTime, float totalTime);
+	void FixedUpdate(float deltaTime, float totalTime);
+	void Interpolate(float alpha);
 	void Draw(float deltaTime, float totalTime);
 	void OnResize();
 
+	// Getters
+	FrameTimings GetFrameTimings();
+
 private:
 	// Used for UI purposes ---------------------------------------------------
 	// UI components test
@@ -43,9 +86,14 @@ private:
 	bool rotateZ;
 	// ------------------------------------------------------------------------
 
-	// Constant Buffers
+	// Constant Buffers (per object / material, and per frame)
 	VSConstantBuffer vsData{};
 	PSConstantBuffer psData{};
+	VSFrameConstantBuffer vsFrameData{};
+	PSFrameConstantBuffer psFrameData{};
+	BufferHandle vsFrameBuffer;
+	BufferHandle psFrameBuffer;
+	ConstantBufferStats constantBufferStats;
 
 	// Sky
 	std::shared_ptr<Sky> sky;
@@ -54,67 +102,164 @@ private:
 	// DirectX::XMFLOAT3 ambientColor;
 	std::vector<Light> lights;
 
-	// Meshes
-	std::vector<std::shared_ptr<Mesh>> meshes;
+	// Meshes and materials (handles into the resource pools)
+	std::vector<MeshHandle> meshes;
+	std::vector<MaterialHandle> materials;
+
+	// Keyframe animations driving entity transforms
+	AnimationSystem animations;
+
+	// Small CPU particle effects, emitting from entities
+	ParticleSystem particles;
+
+	// Results of the last benchmark run from the UI
+	std::vector<BenchmarkResult> benchmarkResults;
+	int benchmarkLayout;					// Scene layout for the benchmarks that take one
+
+	// The loaded scene file and how long it took to get on screen
+	std::string scenePath;
+	unsigned int sceneMeshCount;
+	unsigned int sceneMaterialCount;
+	size_t sceneFileSize;
+	double sceneOpenMs;						// Map + fixup
+	double sceneInstantiateMs;				// Entities, lights and spatial indices
+	double sceneFirstFrameMs;				// From opening the file to the first present
+	bool sceneFirstFramePending;
+	Clock::time_point sceneLoadStart;
 
 	// Game entities
 	std::vector<GameEntity> entities;
 
+	// Bulk entities stored by archetype, and what they drew this frame
+	World world;
+	std::vector<DrawItem> drawList;
+	int bulkEntityCount;
+
+	// Stress scene settings for the bulk entities
+	int bulkLayout;							// SCENE_LAYOUT_*
+	int bulkSeed;
+	float bulkMovingFraction;
+	float bulkSpinningFraction;				// Of the static ones
+	int bulkLightCount;						// Generated point/spot lights (0 keeps the scene's lights)
+	DirectX::XMFLOAT3 bulkBoundsMin;		// Moving bulk entities bounce off these
+	DirectX::XMFLOAT3 bulkBoundsMax;
+	std::vector<DirectX::XMFLOAT3> lightVelocities;		// Per light, while generated lights are in use
+
+	// Grid cells of bulk entities streamed in around the active camera
+	WorldStreamer streamer;
+
+	// Detail level selection for everything drawn, and what it saved this frame
+	LODSettings lodSettings;
+	LODStats lodStats;
+
+	// Frustum culling of the main and shadow passes (entities, then the draw list)
+	FrustumCuller culler;
+	std::vector<Frustum> cullViews;				// Active camera, shadow light, other cameras
+	std::vector<unsigned int> visibilityMasks;	// Bit per view, per culler index
+	std::vector<unsigned int> visibleObjects;	// Ascending culler indices
+	std::vector<unsigned int> shadowVisibleObjects;
+	bool cullingEnabled;
+	bool cullingParallel;
+	bool temporalCulling;		// Main view reuses last frame's results where they can't have changed
+
+	// Software occlusion culling of the main pass, after the frustum
+	OcclusionCuller occlusion;
+	bool occlusionEnabled;
+	int occluderBudget;				// Most occluders rasterized per frame
+	float occluderMinScreenSize;	// Share of the screen height an occluder has to cover
+
+	// Main pass draws, sorted by state (transparent ones last, far to near)
+	RenderQueue renderQueue;
+
+	// Filters redundant binds on their way to the backend
+	StateCache stateCache;
+
+	// Main pass instancing, and what the main pass submitted
+	// the last time it ran with instancing off and on
+	InstanceBatcher instancing;
+	bool instancingEnabled;
+	ShaderHandle litVS;			// Materials using it are instanced
+	ShaderHandle instancedVS;
+	unsigned int mainPassDrawCalls;
+	double mainPassSubmitMs;		// Binding and drawing, this frame
+	unsigned int lastDrawCalls[2];	// Indexed by instancingEnabled
+	double lastSubmitMs[2];			// Also counts grouping, filling and uploading when instancing
+
+	// Point and spot lights assigned to the main camera's froxels,
+	// or the strongest few picked per drawn object (LIGHTING_ in
+	// BufferStructs.h; constant buffer: every light goes through it)
+	LightClusters lightClusters;
+	ObjectLightSelector objectLights;
+	int lightingMode;
+
+	// The constant buffer path's pick of point and spot lights
+	// (directional ones are always kept)
+	LightBudget lightBudget;
+	int lightBudgetCount;
+
+	// Spatial index over the scene entities
+	Octree octree;
+	std::vector<int> entityOctreeItems;					// Octree item of each entity
+	std::vector<unsigned int> entityTransformVersions;	// Transform version the octree last saw
+	std::vector<unsigned int> queryResults;
+	float querySphereRadius;
+
+	// Dynamic AABB tree over the same entities, for ray casts
+	AABBTree entityTree;
+	std::vector<int> entityTreeProxies;		// Tree leaf of each entity
+	int pickedEntity;
+	bool openPickedEntity;					// Expand its UI header next frame
+
+	// Sort-and-sweep over the same entities, for overlapping pairs (triggers)
+	SweepAndPrune overlaps;
+	std::vector<int> entityOverlapProxies;	// Body of each entity
+	std::vector<OverlapPair> overlapPairs;	// Entity indices, this step
+
 	// Cameras
 	std::vector<std::shared_ptr<Camera>> cameras;
 	int activeCamera;
 
 	// Shadow mapping
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
-	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> shadowVS;
+	TextureHandle shadowMap;		// Depth target, then read by the main pass
+	SamplerHandle shadowSampler;
+	ShaderHandle shadowVS;
 	ShadowOptions shadowOptions;
 
 	// Resources that are shared among all post processes
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> ppSampler;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> ppVS;
+	SamplerHandle ppSampler;
+	ShaderHandle ppVS;
 
 	// Resources that are tied to a particular post process
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> blurPS;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> bloomPS;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> combineBloomPS;
-
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> preRTV; // For rendering
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> preSRV; // For sampling
-
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> bloomExtractRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bloomExtractSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> bloomCombinedRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bloomCombinedSRV;
-
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> blurRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> blurSRV;
+	ShaderHandle blurPS;
+	ShaderHandle bloomPS;
+	ShaderHandle combineBloomPS;
 
 	PostProcessOptions ppOptions;
 
+	// The frame's passes and the targets between them
+	FrameGraph frameGraph;
+	FrameTimings frameTimings;
+	bool ppPreviewOpen;		// The UI shows the targets, so they're kept to the end of the frame
+
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
-	void LoadTexture(std::wstring path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv);
+	void LoadTexture(std::wstring path, TextureHandle* texture);
 	void CreateEntities();
-	void SetUpInputLayoutAndGraphics();
+	MeshHandle LoadMesh(const std::string& name, const std::string& path);
+	bool LoadScene(const std::string& path);
+	MaterialHandle FindMaterial(const std::string& name);
+	bool MakeGridScene(int entityCount, SceneData* scene);
+	void CreateAnimations();
+	void CreateEmitters();
+	void CreateBulkEntities(int count);
+	void UpdateSpatialIndex();
+	void SelectLODs();
+	void CullScene();
+	void OccludeScene();
+	int PickEntity(int screenX, int screenY);
+	void SetUpGraphics();
 	void UpdateImGui(float deltaTime);
 	void BuildUI();
 	void CreateShadowMapResources();
 	void CreateShadowMap();
-	void CreatePPResources();
-
-	// Note the usage of ComPtr below
-	//  - This is a smart pointer for objects that abide by the
-	//     Component Object Model, which DirectX objects do
-	//  - More info here: https://github.com/Microsoft/DirectXTK/wiki/ComPtr
-
-	// Buffers to hold actual geometry data
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
-
-	// Shaders and shader-related constructs
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 };
 
@@ -1,36 +1,113 @@
+
 #include "GameEntity.h"
 #include "Graphics.h"
 
 GameEntity::GameEntity(
-	std::shared_ptr<Mesh> mesh, 
-	std::shared_ptr<Material> material) :
+	MeshHandle mesh, 
+	MaterialHandle material,
+	Pool<Transform>* transforms) :
 	mesh(mesh),
-	material(material)
+	material(material),
+	lod(0),
+	transforms(transforms)
+{
+	this->transform = transforms->Emplace();
+}
+
+GameEntity::~GameEntity()
+{
+	// A stale handle (the pool was cleared first) is ignored
+	if (transforms)
+		transforms->Remove(transform);
+}
+
+GameEntity::GameEntity(GameEntity&& other) noexcept :
+	mesh(other.mesh),
+	transform(other.transform),
+	material(other.material),
+	lod(other.lod),
+	transforms(other.transforms)
+{
+	other.transform = TransformHandle();
+	other.transforms = nullptr;
+}
+
+GameEntity& GameEntity::operator=(GameEntity&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (transforms)
+			transforms->Remove(transform);
+
+		mesh = other.mesh;
+		transform = other.transform;
+		material = other.material;
+		lod = other.lod;
+		transforms = other.transforms;
+		other.transform = TransformHandle();
+		other.transforms = nullptr;
+	}
+	return *this;
+}
+
+Mesh* GameEntity::GetMesh()
+{
+	return Resources::Meshes.Get(mesh);
+}
+
+Transform* GameEntity::GetTransform()
+{
+	return transforms ? transforms->Get(transform) : nullptr;
+}
+
+Material* GameEntity::GetMaterial()
 {
-	this->transform = std::make_shared<Transform>();
+	return Resources::Materials.Get(material);
 }
 
-std::shared_ptr<Mesh> GameEntity::GetMesh()
+MeshHandle GameEntity::GetMeshHandle()
 {
 	return mesh;
 }
 
-std::shared_ptr<Transform> GameEntity::GetTransform()
+TransformHandle GameEntity::GetTransformHandle()
 {
 	return transform;
 }
 
-std::shared_ptr<Material> GameEntity::GetMaterial()
+MaterialHandle GameEntity::GetMaterialHandle()
 {
 	return material;
 }
 
-void GameEntity::SetMaterial(std::shared_ptr<Material> material)
+int GameEntity::GetLOD()
+{
+	return lod;
+}
+
+AABB GameEntity::GetWorldBounds()
+{
+	Mesh* m = GetMesh();
+	Transform* t = GetTransform();
+	if (!m || !t)
+		return AABB{};
+
+	return Bounds::TransformAABB(m->GetBounds(), t->GetWorldMatrix());
+}
+
+void GameEntity::SetMaterial(MaterialHandle material)
 {
 	this->material = material;
 }
 
+void GameEntity::SetLOD(int lod)
+{
+	this->lod = lod;
+}
+
 void GameEntity::Draw()
 {
-	mesh->Draw();
+	// Skip the draw if the mesh has been removed
+	Mesh* m = Resources::Meshes.Get(mesh);
+	if (m) m->Draw(lod);
 }
\ No newline at end of file
@@ -1,29 +1,45 @@
 #pragma once
 
-#include <memory>
-
-#include "Transform.h"
-#include "Mesh.h"
-#include "Material.h"
+#include "Resources.h"
 
 class GameEntity
 {
 private:
-	std::shared_ptr<Mesh> mesh;
-	std::shared_ptr<Transform> transform;
-	std::shared_ptr<Material> material;
+	MeshHandle mesh;
+	TransformHandle transform;
+	MaterialHandle material;
+	int lod;		// Detail level of the mesh to draw
+	Pool<Transform>* transforms;	// Owns the transform, released with the entity
 
 public:
-	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	GameEntity(MeshHandle mesh, MaterialHandle material, Pool<Transform>* transforms = &Resources::Transforms);
+	~GameEntity();
+
+	// Only one entity may own a transform, so entities move but don't copy
+	GameEntity(const GameEntity&) = delete;
+	GameEntity& operator=(const GameEntity&) = delete;
+	GameEntity(GameEntity&& other) noexcept;
+	GameEntity& operator=(GameEntity&& other) noexcept;
 
 	// Getters
-	std::shared_ptr<Mesh> GetMesh();
-	std::shared_ptr<Transform> GetTransform();
-	std::shared_ptr<Material> GetMaterial();
+	// - These resolve the handles through the resource pools; the
+	//    pointers are only valid until that pool next changes
+	// - A stale handle resolves to nullptr
+	Mesh* GetMesh();
+	Transform* GetTransform();
+	Material* GetMaterial();
+
+	MeshHandle GetMeshHandle();
+	TransformHandle GetTransformHandle();
+	MaterialHandle GetMaterialHandle();
+	int GetLOD();
+
+	// World space box around the mesh's bounds
+	AABB GetWorldBounds();
 
 	// Setters
-	void SetMaterial(std::shared_ptr<Material> material);
+	void SetMaterial(MaterialHandle material);
+	void SetLOD(int lod);
 
 	void Draw();
 };
-
@@ -375,19 +375,27 @@ void Graphics::FillAndBindNextConstantBuffer(void* data, unsigned int dataSizeIn
 		cbHeapOffsetInBytes = 0;
 
 	D3D11_MAPPED_SUBRESOURCE map{};
-	Context->Map(
+	HRESULT mapResult = Context->Map(
 		ConstantBufferHeap.Get(),
 		0,
 		D3D11_MAP_WRITE_NO_OVERWRITE,
 		0,
 		&map);
 
-	// Write into the proper portion of the buffer
-	void* uploadAddress = reinterpret_cast<void*>((UINT64)map.pData + cbHeapOffsetInBytes);
-	memcpy(uploadAddress, data, dataSizeInBytes);
+	// Write into the proper portion of the buffer (only if the map
+	// worked and gave us memory, but a successful map is always
+	// unmapped)
+	if (SUCCEEDED(mapResult))
+	{
+		if (map.pData)
+		{
+			void* uploadAddress = reinterpret_cast<void*>((UINT64)map.pData + cbHeapOffsetInBytes);
+			memcpy(uploadAddress, data, dataSizeInBytes);
+		}
 
-	// Unmap as soon as the copy is done
-	Context->Unmap(ConstantBufferHeap.Get(), 0);
+		// Unmap as soon as the copy is done
+		Context->Unmap(ConstantBufferHeap.Get(), 0);
+	}
 
 	// Calculate the binding offset and size as measured in 16-byte constants
 	unsigned int firstConstant = cbHeapOffsetInBytes / 16;
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+// Handles pack a slot index and a generation into 32 bits
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+#define HANDLE_MAX_OBJECTS (1u << HANDLE_INDEX_BITS)
+
+// --------------------------------------------------------
+// A typed reference to an object stored in a Pool<T>
+//
+// - The generation is bumped every time a slot is freed, so
+//    a handle to a removed object is detected as stale instead
+//    of silently pointing at whatever reused the slot
+// - Generations start at 1, so a zero handle is never valid
+// --------------------------------------------------------
+template<typename T>
+struct Handle
+{
+	unsigned int value = 0;
+
+	unsigned int Index() const { return value & HANDLE_INDEX_MASK; }
+	unsigned int Generation() const { return value >> HANDLE_INDEX_BITS; }
+	bool IsNull() const { return value == 0; }
+
+	bool operator==(const Handle& other) const { return value == other.value; }
+	bool operator!=(const Handle& other) const { return value != other.value; }
+
+	static Handle Make(unsigned int index, unsigned int generation)
+	{
+		Handle h;
+		h.value = (generation << HANDLE_INDEX_BITS) | (index & HANDLE_INDEX_MASK);
+		return h;
+	}
+};
+
+// Reinterprets a handle as one to another type (for pools whose
+// objects stand in for an opaque tag type)
+template<typename To, typename From>
+Handle<To> RetagHandle(Handle<From> handle)
+{
+	Handle<To> h;
+	h.value = handle.value;
+	return h;
+}
+
+// --------------------------------------------------------
+// Stores objects of one type densely, addressed by handles
+//
+// - Objects live back to back in one array, so iterating the
+//    pool (begin/end) is a linear walk with no indirection
+// - Removing swaps the last object into the hole; handles
+//    stay valid because they go through the slot table
+// - Pointers returned by Get() are only valid until the pool
+//    is next added to or removed from
+// --------------------------------------------------------
+template<typename T>
+class Pool
+{
+private:
+	// Objects, and the slot each one belongs to
+	std::vector<T> dense;
+	std::vector<unsigned int> denseToSlot;
+
+	// Slot table (indexed by handle index)
+	std::vector<unsigned int> slotToDense;
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> freeSlots;
+
+	Handle<T> Register()
+	{
+		unsigned int slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (unsigned int)slotToDense.size();
+			slotToDense.push_back(0);
+			generations.push_back(1);
+		}
+
+		slotToDense[slot] = (unsigned int)dense.size() - 1;
+		denseToSlot.push_back(slot);
+		return Handle<T>::Make(slot, generations[slot]);
+	}
+
+public:
+	// Adding (returns a null handle if the pool is full)
+	Handle<T> Add(const T& object)
+	{
+		if (dense.size() >= HANDLE_MAX_OBJECTS) return Handle<T>();
+		dense.push_back(object);
+		return Register();
+	}
+
+	Handle<T> Add(T&& object)
+	{
+		if (dense.size() >= HANDLE_MAX_OBJECTS) return Handle<T>();
+		dense.push_back(std::move(object));
+		return Register();
+	}
+
+	template<typename... Args>
+	Handle<T> Emplace(Args&&... args)
+	{
+		if (dense.size() >= HANDLE_MAX_OBJECTS) return Handle<T>();
+		dense.emplace_back(std::forward<Args>(args)...);
+		return Register();
+	}
+
+	// Removing (returns false for stale or null handles)
+	bool Remove(Handle<T> handle)
+	{
+		if (!IsValid(handle))
+			return false;
+
+		unsigned int slot = handle.Index();
+		unsigned int hole = slotToDense[slot];
+		unsigned int last = (unsigned int)dense.size() - 1;
+
+		// Move the last object into the hole to keep the array packed
+		if (hole != last)
+		{
+			dense[hole] = std::move(dense[last]);
+			denseToSlot[hole] = denseToSlot[last];
+			slotToDense[denseToSlot[hole]] = hole;
+		}
+		dense.pop_back();
+		denseToSlot.pop_back();
+
+		// Invalidate every outstanding handle to this slot
+		generations[slot] = (generations[slot] + 1) & HANDLE_GENERATION_MASK;
+		if (generations[slot] == 0) generations[slot] = 1;
+		freeSlots.push_back(slot);
+		return true;
+	}
+
+	void Clear()
+	{
+		// Bump every generation so no old handle survives a clear
+		for (auto& generation : generations)
+		{
+			generation = (generation + 1) & HANDLE_GENERATION_MASK;
+			if (generation == 0) generation = 1;
+		}
+
+		// Every slot is free again (lowest slots get reused first)
+		freeSlots.clear();
+		for (unsigned int slot = (unsigned int)slotToDense.size(); slot > 0; slot--)
+			freeSlots.push_back(slot - 1);
+
+		dense.clear();
+		denseToSlot.clear();
+	}
+
+	void Reserve(unsigned int count)
+	{
+		dense.reserve(count);
+		denseToSlot.reserve(count);
+	}
+
+	// Lookups
+	bool IsValid(Handle<T> handle) const
+	{
+		unsigned int slot = handle.Index();
+		return !handle.IsNull() &&
+			slot < generations.size() &&
+			generations[slot] == handle.Generation();
+	}
+
+	T* Get(Handle<T> handle)
+	{
+		return IsValid(handle) ? &dense[slotToDense[handle.Index()]] : nullptr;
+	}
+
+	unsigned int GetDenseIndex(Handle<T> handle) const
+	{
+		return slotToDense[handle.Index()];
+	}
+
+	Handle<T> GetHandleAt(unsigned int denseIndex) const
+	{
+		unsigned int slot = denseToSlot[denseIndex];
+		return Handle<T>::Make(slot, generations[slot]);
+	}
+
+	unsigned int Size() const { return (unsigned int)dense.size(); }
+
+	// Dense iteration
+	T* begin() { return dense.data(); }
+	T* end() { return dense.data() + dense.size(); }
+	T& operator[](unsigned int denseIndex) { return dense[denseIndex]; }
+};
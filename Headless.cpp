@@ -0,0 +1,131 @@
+#include "Headless.h"
+#include "Game.h"
+#include "Input.h"
+#include "NullBackend.h"
+#include "Timing.h"
+#include "Window.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// The columns printed per frame (ms, then backend counts)
+	const char* header =
+		"frame    total   update    fixed     draw      lod     cull   lights    queue   shadow     main     post  present    draws    binds  uploads   errors\n";
+
+	void PrintRow(const char* label, double totalMs, const FrameTimings& t, double draws, double binds, double uploads, double errors)
+	{
+		printf("%-5s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.0f %8.0f %8.0f %8.0f\n",
+			label, totalMs,
+			t.updateMs, t.fixedUpdateMs, t.drawMs,
+			t.lodMs, t.cullMs, t.lightsMs, t.queueMs,
+			t.shadowPassMs, t.mainPassMs, t.postProcessMs, t.presentMs,
+			draws, binds, uploads, errors);
+	}
+}
+
+int Headless::Run(unsigned int frames, unsigned int width, unsigned int height)
+{
+	Window::CreateHeadless(width, height);
+	NullBackend backend(width, height);
+	Graphics::Backend = &backend;
+	Input::Initialize(Window::Handle());
+
+	printf("Headless: %u frames at %ux%u on the %s backend\n", frames, width, height, backend.GetName());
+	Clock::time_point loadStart = Clock::now();
+	Game* game = new Game();
+	unsigned int loadErrors = backend.GetStats().errors;
+	printf("Load: %.3f ms (%u errors)\n\n", ElapsedMs(loadStart), loadErrors);
+	printf("%s", header);
+
+	// Sums for the averages, and the slowest frame
+	const float deltaTime = 1.0f / 60.0f;
+	double totalMs = 0;
+	FrameTimings sum = {};
+	RenderBackendStats statsSum = {};
+	double worstMs = -1;
+	unsigned int worstFrame = 0;
+	FrameTimings worst = {};
+	RenderBackendStats worstStats = {};
+
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		float totalTime = frame * deltaTime;
+		backend.ResetStats();
+
+		Clock::time_point frameStart = Clock::now();
+		game->Update(deltaTime, totalTime);
+		game->FixedUpdate(deltaTime, totalTime);
+		game->Interpolate(1.0f);
+		game->Draw(deltaTime, totalTime);
+		double frameMs = ElapsedMs(frameStart);
+
+		FrameTimings t = game->GetFrameTimings();
+		RenderBackendStats stats = backend.GetStats();
+		char label[16];
+		snprintf(label, sizeof(label), "%u", frame);
+		PrintRow(label, frameMs, t, stats.draws, stats.binds, stats.uploads, stats.errors);
+
+		totalMs += frameMs;
+		sum.updateMs += t.updateMs;
+		sum.fixedUpdateMs += t.fixedUpdateMs;
+		sum.drawMs += t.drawMs;
+		sum.lodMs += t.lodMs;
+		sum.cullMs += t.cullMs;
+		sum.lightsMs += t.lightsMs;
+		sum.queueMs += t.queueMs;
+		sum.shadowPassMs += t.shadowPassMs;
+		sum.mainPassMs += t.mainPassMs;
+		sum.postProcessMs += t.postProcessMs;
+		sum.presentMs += t.presentMs;
+		statsSum.draws += stats.draws;
+		statsSum.binds += stats.binds;
+		statsSum.uploads += stats.uploads;
+		statsSum.uploadBytes += stats.uploadBytes;
+		statsSum.errors += stats.errors;
+
+		if (frameMs > worstMs)
+		{
+			worstMs = frameMs;
+			worstFrame = frame;
+			worst = t;
+			worstStats = stats;
+		}
+	}
+
+	if (frames > 0)
+	{
+		double n = frames;
+		FrameTimings average = sum;
+		average.updateMs /= n;
+		average.fixedUpdateMs /= n;
+		average.drawMs /= n;
+		average.lodMs /= n;
+		average.cullMs /= n;
+		average.lightsMs /= n;
+		average.queueMs /= n;
+		average.shadowPassMs /= n;
+		average.mainPassMs /= n;
+		average.postProcessMs /= n;
+		average.presentMs /= n;
+
+		printf("\n%s", header);
+		PrintRow("avg", totalMs / n, average, statsSum.draws / n, statsSum.binds / n, statsSum.uploads / n, statsSum.errors / n);
+		PrintRow("worst", worstMs, worst, worstStats.draws, worstStats.binds, worstStats.uploads, worstStats.errors);
+		printf("\nWorst frame: %u, average: %.3f ms (%.1f fps), uploaded %.2f MB per frame\n",
+			worstFrame, totalMs / n, 1000.0 * n / std::max(totalMs, 0.001), statsSum.uploadBytes / n / (1024.0 * 1024.0));
+	}
+
+	// The game lets go of its backend objects on the way out too
+	backend.ResetStats();
+	delete game;
+	Input::ShutDown();
+	unsigned int errors = loadErrors + statsSum.errors + backend.GetStats().errors;
+	printf("Backend errors: %u\n", errors);
+
+	Graphics::Backend = nullptr;
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Runs the game without a window or a GPU
+// - The game draws through a NullBackend, so every frame
+//    costs only its CPU side, and every backend call is
+//    checked along the way
+// - Steps a fixed 1/60 s per frame (one fixed update each),
+//    so runs are repeatable
+// - Prints each frame's CPU time, split the way the game's
+//    FrameTimings are, then the averages and the worst frame
+namespace Headless
+{
+	// Non-zero if the backend reported any errors
+	int Run(unsigned int frames, unsigned int width, unsigned int height);
+}
@@ -0,0 +1,59 @@
+#include "StructsIncludes.hlsli"
+
+// One draw's matrices, matches InstanceData on the C++ side
+struct Instance
+{
+    matrix world;
+    matrix worldInvTranspose;
+};
+
+StructuredBuffer<Instance> Instances : register(t0);
+
+// Per draw
+cbuffer ExternalData : register(b0)
+{
+    uint instanceStart;
+}
+
+// Per frame
+cbuffer FrameData : register(b1)
+{
+    matrix view;
+    matrix projection;
+    matrix lightView;
+    matrix lightProjection;
+}
+
+// --------------------------------------------------------
+// VertexShader.hlsl for instanced draws
+// - The per draw matrices come from the structured buffer,
+//    starting at instanceStart for this draw
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input, uint instanceID : SV_InstanceID)
+{
+    VertexToPixel output;
+
+    Instance instance = Instances[instanceStart + instanceID];
+    matrix world = instance.world;
+
+    matrix wvp = mul(projection, mul(view, world));
+    output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+
+    output.uv = input.uv;
+
+    // use worldInvTranspose to avoid nonuniform scaling issues
+    output.normal = normalize(mul((float3x3) instance.worldInvTranspose, input.normal));
+
+    output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+
+    output.tangent = normalize(mul((float3x3) world, input.tangent));
+
+    // Position in the shadow map
+    matrix shadowWVP = mul(lightProjection, mul(lightView, world));
+    output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+
+    // Instances are in queue order, so this is the draw's queue position
+    output.objectIndex = instanceStart + instanceID;
+
+    return output;
+}
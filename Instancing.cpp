@@ -0,0 +1,104 @@
+#include "Instancing.h"
+#include "RenderQueue.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+InstanceBatcher::InstanceBatcher() :
+	stats{},
+	instanceBufferCapacity(0)
+{
+}
+
+void InstanceBatcher::Group(const uint64_t* keys, unsigned int count)
+{
+	auto start = Clock::now();
+	stats = {};
+	stats.draws = count;
+
+	groups.clear();
+	unsigned int first = 0;
+	while (first < count)
+	{
+		uint64_t state = RenderQueue::GetState(keys[first]);
+		unsigned int end = first + 1;
+		while (end < count && RenderQueue::GetState(keys[end]) == state)
+			end++;
+
+		groups.push_back({ first, end - first });
+		stats.largestGroup = std::max(stats.largestGroup, end - first);
+		first = end;
+	}
+
+	instances.resize(count);
+	stats.groups = (unsigned int)groups.size();
+	stats.groupMs = ElapsedMs(start);
+}
+
+void InstanceBatcher::Fill(const std::function<void(unsigned int begin, unsigned int end, InstanceData* out)>& fillRange, bool parallel)
+{
+	auto start = Clock::now();
+	unsigned int count = (unsigned int)instances.size();
+	if (!parallel || count <= INSTANCE_FILL_BATCH)
+	{
+		if (count > 0)
+			fillRange(0, count, instances.data());
+	}
+	else
+	{
+		// Each batch writes only its own instances
+		unsigned int batchCount = (count + INSTANCE_FILL_BATCH - 1) / INSTANCE_FILL_BATCH;
+		std::vector<unsigned int> batches(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), [&](unsigned int batch)
+		{
+			unsigned int begin = batch * INSTANCE_FILL_BATCH;
+			fillRange(begin, std::min(begin + INSTANCE_FILL_BATCH, count), &instances[begin]);
+		});
+	}
+	stats.fillMs = ElapsedMs(start);
+}
+
+bool InstanceBatcher::CreateInstanceBuffer(unsigned int instanceCount)
+{
+	// Grow in big steps so a growing scene doesn't recreate it every frame
+	unsigned int newCapacity = std::max(instanceBufferCapacity, 1024u);
+	while (newCapacity < instanceCount)
+		newCapacity *= 2;
+
+	instanceBufferCapacity = 0;
+	if (!Graphics::Backend->CreateStructuredBuffer(sizeof(InstanceData), newCapacity, &instanceBuffer, &instanceView))
+	{
+		printf("Could not create the instance buffer (%u instances)\n", newCapacity);
+		return false;
+	}
+
+	instanceBufferCapacity = newCapacity;
+	return true;
+}
+
+bool InstanceBatcher::Upload()
+{
+	auto start = Clock::now();
+	unsigned int count = (unsigned int)instances.size();
+	if (count == 0)
+		return true;
+	if (count > instanceBufferCapacity && !CreateInstanceBuffer(count))
+		return false;
+
+	if (!Graphics::Backend->UpdateBuffer(instanceBuffer, instances.data(), count * sizeof(InstanceData)))
+		return false;
+
+	stats.uploadMs = ElapsedMs(start);
+	return true;
+}
+
+// Getters
+const std::vector<InstanceGroup>& InstanceBatcher::GetGroups() { return groups; }
+const InstanceData* InstanceBatcher::GetInstances() { return instances.data(); }
+TextureHandle InstanceBatcher::GetView() { return instanceView; }
+InstancingStats InstanceBatcher::GetStats() { return stats; }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "BufferStructs.h"
+#include "RenderBackend.h"
+
+// Instances filled per parallel task
+#define INSTANCE_FILL_BATCH 2048
+
+// A run of draws sharing every piece of state (one instanced draw)
+struct InstanceGroup
+{
+	unsigned int start;		// First instance (and queue position)
+	unsigned int count;
+};
+
+// What the last frame's batching did
+struct InstancingStats
+{
+	unsigned int draws;
+	unsigned int groups;			// Draw calls issued
+	unsigned int largestGroup;
+	double groupMs;
+	double fillMs;
+	double uploadMs;
+};
+
+// --------------------------------------------------------
+// Groups a sorted render queue into instanced draws
+//
+// - Draws next to each other in the queue with the same
+//    pass, shader, material, mesh and LOD become one group
+//    (the sort already puts them together)
+// - Each draw's matrices go in one structured buffer, in
+//    queue order, so a group is a contiguous range of it
+// - Filling is split into batches that run in parallel; the
+//    caller writes each batch's instances
+// --------------------------------------------------------
+class InstanceBatcher
+{
+private:
+	std::vector<InstanceData> instances;
+	std::vector<InstanceGroup> groups;
+	InstancingStats stats;
+
+	// GPU copy of the instances
+	BufferHandle instanceBuffer;
+	TextureHandle instanceView;
+	unsigned int instanceBufferCapacity;
+
+	bool CreateInstanceBuffer(unsigned int instanceCount);
+
+public:
+	InstanceBatcher();
+
+	// Splits sorted render queue keys into groups
+	void Group(const uint64_t* keys, unsigned int count);
+
+	// Calls fillRange(begin, end, out) over every instance, where
+	// out points at instance begin
+	void Fill(const std::function<void(unsigned int begin, unsigned int end, InstanceData* out)>& fillRange, bool parallel = true);
+
+	// Copies the instances to the GPU buffer
+	bool Upload();
+
+	// Getters
+	const std::vector<InstanceGroup>& GetGroups();
+	const InstanceData* GetInstances();
+	TextureHandle GetView();
+	InstancingStats GetStats();
+};
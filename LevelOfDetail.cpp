@@ -0,0 +1,51 @@
+#include "LevelOfDetail.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+LODSettings LOD::DefaultSettings()
+{
+	LODSettings settings = {};
+	settings.enabled = true;
+	settings.screenSizes[0] = 0.25f;
+	settings.screenSizes[1] = 0.1f;
+	settings.screenSizes[2] = 0.04f;
+	settings.hysteresis = 0.15f;
+	settings.bias = 1.0f;
+	return settings;
+}
+
+float LOD::ScreenSize(const AABB& worldBounds, XMFLOAT3 cameraPosition, float projectionScale)
+{
+	XMVECTOR boundsMin = XMLoadFloat3(&worldBounds.min);
+	XMVECTOR boundsMax = XMLoadFloat3(&worldBounds.max);
+	XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+	float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, center)));
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&cameraPosition))));
+
+	// Inside the sphere: it fills the screen
+	if (distance <= radius)
+		return 1.0f;
+
+	return radius * projectionScale / distance;
+}
+
+int LOD::SelectLevel(float screenSize, int currentLevel, int levelCount, const LODSettings& settings)
+{
+	if (!settings.enabled || levelCount <= 1)
+		return 0;
+
+	float size = screenSize * settings.bias;
+	int level = std::clamp(currentLevel, 0, levelCount - 1);
+
+	// Finer while comfortably above the threshold that made it coarser...
+	while (level > 0 && size > settings.screenSizes[level - 1] * (1.0f + settings.hysteresis))
+		level--;
+
+	// ...and coarser while comfortably below the next one down
+	while (level < levelCount - 1 && size < settings.screenSizes[level] * (1.0f - settings.hysteresis))
+		level++;
+
+	return level;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Bounds.h"
+#include "Mesh.h"
+
+// When to switch detail levels
+struct LODSettings
+{
+	bool enabled;
+	float screenSizes[MESH_MAX_LODS - 1];	// Below screenSizes[i] (share of screen height), use level i + 1
+	float hysteresis;						// How far past a threshold (as a fraction of it) before switching
+	float bias;								// Scales every screen size; below 1 favors coarser levels
+};
+
+// What the selection pass did this frame
+struct LODStats
+{
+	unsigned int objects;
+	unsigned int levelObjects[MESH_MAX_LODS];	// Objects drawn at each level
+	unsigned int levelChanges;					// Objects that switched level
+	unsigned long long trianglesFull;			// Submitted if everything were drawn at level 0
+	unsigned long long trianglesSubmitted;
+	double selectMs;
+};
+
+// --------------------------------------------------------
+// Screen size based level of detail selection
+//
+// - Screen size is the height of the bounds' enclosing
+//    sphere on screen, as a share of the screen height
+// - Each object remembers its level; it only moves to
+//    another once it's clearly past the threshold, so
+//    objects sitting on a threshold don't flicker
+// --------------------------------------------------------
+namespace LOD
+{
+	LODSettings DefaultSettings();
+
+	// projectionScale is the projection matrix's _22 (1 / tan(fovY / 2))
+	float ScreenSize(const AABB& worldBounds, DirectX::XMFLOAT3 cameraPosition, float projectionScale);
+
+	// New level for an object currently at currentLevel
+	int SelectLevel(float screenSize, int currentLevel, int levelCount, const LODSettings& settings);
+}
@@ -0,0 +1,204 @@
+#include "LightBudget.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Eases the fade so lights don't visibly ramp in a line
+	inline float SmoothFade(float fade)
+	{
+		return fade * fade * (3.0f - 2.0f * fade);
+	}
+}
+
+LightBudget::LightBudget() :
+	stats{},
+	snap(true)
+{
+}
+
+void LightBudget::Update(
+	const Light* lights,
+	unsigned int lightCount,
+	const XMFLOAT4X4& viewProjection,
+	XMFLOAT3 cameraPosition,
+	unsigned int budget,
+	unsigned int capacity,
+	float deltaTime,
+	bool parallel)
+{
+	stats = {};
+	stats.lights = lightCount;
+
+	// A different set of lights starts over
+	if (scores.size() != lightCount)
+	{
+		scores.assign(lightCount, 0.0f);
+		fades.assign(lightCount, 0.0f);
+		inBudget.assign(lightCount, 0);
+		snap = true;
+	}
+
+	// Score every light (each batch writes only its own scores)
+	auto start = Clock::now();
+	Frustum frustum = Bounds::FrustumFromMatrix(viewProjection);
+	auto scoreBatch = [&](unsigned int batch)
+	{
+		unsigned int end = std::min((batch + 1) * LIGHT_BUDGET_BATCH, lightCount);
+		for (unsigned int i = batch * LIGHT_BUDGET_BATCH; i < end; i++)
+			scores[i] = ScoreLight(lights[i], frustum, cameraPosition);
+	};
+
+	unsigned int batchCount = (lightCount + LIGHT_BUDGET_BATCH - 1) / LIGHT_BUDGET_BATCH;
+	if (parallel && batchCount > 1)
+	{
+		std::vector<unsigned int> batches(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), scoreBatch);
+	}
+	else
+	{
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+			scoreBatch(batch);
+	}
+	stats.scoreMs = ElapsedMs(start);
+
+	// The best scores make the budget, with a bonus for the
+	// lights already in it (ties go to the lower index)
+	start = Clock::now();
+	unsigned int directionalCount = 0;
+	candidates.clear();
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			directionalCount++;
+		else if (scores[i] > 0.0f)
+			candidates.push_back(i);
+	}
+	stats.visible = (unsigned int)candidates.size();
+
+	unsigned int room = capacity > directionalCount ? capacity - directionalCount : 0;
+	unsigned int keep = std::min(std::min(budget, room), (unsigned int)candidates.size());
+	if (keep < candidates.size())
+	{
+		auto ranked = [&](unsigned int i) { return inBudget[i] ? scores[i] * LIGHT_BUDGET_HYSTERESIS : scores[i]; };
+		std::nth_element(candidates.begin(), candidates.begin() + keep, candidates.end(), [&](unsigned int a, unsigned int b)
+		{
+			float rankA = ranked(a);
+			float rankB = ranked(b);
+			return rankA > rankB || (rankA == rankB && a < b);
+		});
+	}
+	selected.assign(candidates.begin(), candidates.begin() + keep);
+	std::sort(selected.begin(), selected.end());
+	stats.selected = keep;
+
+	// Fade toward in or out (all the way at once after a reset)
+	std::fill(inBudget.begin(), inBudget.end(), 0);
+	for (unsigned int i : selected)
+		inBudget[i] = 1;
+
+	float step = snap ? 1.0f : deltaTime / LIGHT_BUDGET_FADE_SECONDS;
+	fadingOut.clear();
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			continue;
+
+		if (inBudget[i])
+		{
+			fades[i] = std::min(fades[i] + step, 1.0f);
+			stats.fadingIn += fades[i] < 1.0f;
+		}
+		else if (fades[i] > 0.0f)
+		{
+			fades[i] = std::max(fades[i] - step, 0.0f);
+			if (fades[i] > 0.0f)
+				fadingOut.push_back(i);
+		}
+	}
+	snap = false;
+
+	// Lights on their way out get the room the budget left,
+	// brightest first; the rest are cut
+	std::sort(fadingOut.begin(), fadingOut.end(), [&](unsigned int a, unsigned int b)
+	{
+		return fades[a] > fades[b] || (fades[a] == fades[b] && a < b);
+	});
+	unsigned int outRoom = room - keep;
+	if (fadingOut.size() > outRoom)
+	{
+		for (size_t i = outRoom; i < fadingOut.size(); i++)
+			fades[fadingOut[i]] = 0.0f;
+		stats.cut = (unsigned int)fadingOut.size() - outRoom;
+		fadingOut.resize(outRoom);
+	}
+	stats.fadingOut = (unsigned int)fadingOut.size();
+
+	// Directional lights (in order, so a shadowed first light
+	// stays first), then the budget, then the ones fading out
+	output.clear();
+	for (unsigned int i = 0; i < lightCount && output.size() < capacity; i++)
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			output.push_back(lights[i]);
+
+	auto addFaded = [&](unsigned int i)
+	{
+		if (fades[i] <= 0.0f)
+			return;
+		output.push_back(lights[i]);
+		output.back().Intensity *= SmoothFade(fades[i]);
+	};
+	for (unsigned int i : selected)
+		addFaded(i);
+	for (unsigned int i : fadingOut)
+		addFaded(i);
+
+	stats.drawn = (unsigned int)output.size();
+	stats.selectMs = ElapsedMs(start);
+}
+
+void LightBudget::Reset()
+{
+	snap = true;
+}
+
+float LightBudget::ScoreLight(const Light& light, const Frustum& frustum, XMFLOAT3 cameraPosition)
+{
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL || light.Range <= 0.0f || light.Intensity <= 0.0f)
+		return 0.0f;
+
+	// How much of the sphere is inside the view
+	const XMFLOAT3& center = light.Position;
+	float radius = light.Range;
+	float inside = Bounds::SphereInsideFraction(frustum, center, radius);
+	if (inside <= 0.0f)
+		return 0.0f;
+
+	// Screen covered: the range against the distance, squared
+	// (all of it with the camera inside the range)
+	float dx = center.x - cameraPosition.x;
+	float dy = center.y - cameraPosition.y;
+	float dz = center.z - cameraPosition.z;
+	float coverage = std::min(radius * radius / std::max(dx * dx + dy * dy + dz * dz, 0.0001f), 1.0f);
+
+	// Spots only light the part of the sphere in their cone
+	if (light.Type == LIGHT_TYPE_SPOT)
+		coverage *= (1.0f - cosf(std::min(light.SpotOuterAngle, XM_PI))) * 0.5f;
+
+	float brightness = light.Intensity * std::max(std::max(light.Color.x, light.Color.y), light.Color.z);
+	return brightness * coverage * inside;
+}
+
+// Getters
+const std::vector<Light>& LightBudget::GetLights() { return output; }
+const std::vector<unsigned int>& LightBudget::GetSelected() { return selected; }
+LightBudgetStats LightBudget::GetStats() { return stats; }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Lights.h"
+
+// Lights scored per parallel task
+#define LIGHT_BUDGET_BATCH 4096
+
+// Seconds a light takes to fade all the way in or out
+#define LIGHT_BUDGET_FADE_SECONDS 0.35f
+
+// A light already in the budget keeps its place until another
+// scores this much more (so close ones don't swap every frame)
+#define LIGHT_BUDGET_HYSTERESIS 1.25f
+
+// What the last Update() did
+struct LightBudgetStats
+{
+	unsigned int lights;
+	unsigned int visible;		// Point and spot lights with a score (in the frustum)
+	unsigned int selected;		// Point and spot lights in the budget
+	unsigned int fadingIn;
+	unsigned int fadingOut;		// Dropped from the budget, still drawn
+	unsigned int cut;			// Fading out, but no room left to draw them
+	unsigned int drawn;			// Every light in GetLights(), directional ones too
+	double scoreMs;
+	double selectMs;			// Picking, fading and building the list
+};
+
+// --------------------------------------------------------
+// Picks the point and spot lights worth drawing each frame
+// when there are more than the shaders take
+//
+// - Every light is scored (in parallel batches) by its
+//    intensity, how much of the screen its range covers from
+//    the camera, and how much of it is inside the frustum
+// - The best few make the budget; lights already in it get
+//    a bonus, so near ties don't flicker
+// - Lights fade in when they make the budget and out when
+//    they drop from it, using the room left under the capacity
+// - Directional lights are always kept, first and in order
+// --------------------------------------------------------
+class LightBudget
+{
+private:
+	std::vector<float> scores;
+	std::vector<float> fades;				// Per light, 0 (off) to 1
+	std::vector<unsigned char> inBudget;	// Per light, as of the last Update()
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> selected;
+	std::vector<unsigned int> fadingOut;
+	std::vector<Light> output;
+	LightBudgetStats stats;
+	bool snap;
+
+public:
+	LightBudget();
+
+	// Scores and picks up to budget point and spot lights, then
+	// fills the list of lights to draw (at most capacity long)
+	void Update(
+		const Light* lights,
+		unsigned int lightCount,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		DirectX::XMFLOAT3 cameraPosition,
+		unsigned int budget,
+		unsigned int capacity,
+		float deltaTime,
+		bool parallel = true);
+
+	// The next Update() starts every light fully in or out
+	// (for when the lights are replaced)
+	void Reset();
+
+	// Screen contribution of a point or spot light (0 if it's
+	// outside the frustum); directional lights aren't scored
+	static float ScoreLight(const Light& light, const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition);
+
+	// Getters
+	const std::vector<Light>& GetLights();				// Faded copies, ready for the shaders
+	const std::vector<unsigned int>& GetSelected();	// Light indices in the budget, ascending
+	LightBudgetStats GetStats();
+};
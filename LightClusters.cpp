@@ -0,0 +1,361 @@
+#include "LightClusters.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+using namespace DirectX;
+
+LightClusters::LightClusters() :
+	nearPlane(0.1f),
+	farPlane(100.0f),
+	sliceScale(0.0f),
+	sliceBias(0.0f),
+	sliceDepths{},
+	sidePlanes{},
+	gridBuilt(false),
+	stats{},
+	lightCapacity(0),
+	indexCapacity(0)
+{
+	XMStoreFloat4x4(&view, XMMatrixIdentity());
+	XMStoreFloat4x4(&projection, XMMatrixIdentity());
+	clusterBounds.resize(LIGHT_CLUSTER_COUNT);
+	clusterSpheres.resize(LIGHT_CLUSTER_COUNT);
+	clusterLists.resize(LIGHT_CLUSTER_COUNT);
+	sliceLights.resize(LIGHT_CLUSTERS_Z);
+	ranges.resize(LIGHT_CLUSTER_COUNT);
+}
+
+void LightClusters::Build(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float nearPlane, float farPlane)
+{
+	// The froxels are in view space: only the projection moves them
+	this->view = view;
+	nearPlane = std::max(nearPlane, 0.0001f);
+	farPlane = std::max(farPlane, nearPlane * 1.01f);
+	if (gridBuilt && memcmp(&this->projection, &projection, sizeof(XMFLOAT4X4)) == 0 && this->nearPlane == nearPlane && this->farPlane == farPlane)
+		return;
+
+	this->projection = projection;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+	gridBuilt = true;
+
+	// Side planes of the view volume, from -w <= x <= w and
+	// -w <= y <= w, for rejecting off screen lights
+	const XMFLOAT4X4& m = projection;
+	XMFLOAT4 planes[4] = {
+		{ m._11 + m._14, m._21 + m._24, m._31 + m._34, m._41 + m._44 },
+		{ m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41 },
+		{ m._12 + m._14, m._22 + m._24, m._32 + m._34, m._42 + m._44 },
+		{ m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42 } };
+	for (int i = 0; i < 4; i++)
+		XMStoreFloat4(&sidePlanes[i], XMPlaneNormalize(XMLoadFloat4(&planes[i])));
+
+	// Exponential slices: each is the same share of the depth
+	// range in log space, so near slices stay thin
+	float logRatio = logf(this->farPlane / this->nearPlane);
+	sliceScale = LIGHT_CLUSTERS_Z / logRatio;
+	sliceBias = -LIGHT_CLUSTERS_Z * logf(this->nearPlane) / logRatio;
+	for (int s = 0; s <= LIGHT_CLUSTERS_Z; s++)
+		sliceDepths[s] = this->nearPlane * powf(this->farPlane / this->nearPlane, (float)s / LIGHT_CLUSTERS_Z);
+
+	// View space box around each froxel: its tile's corners
+	// unprojected at both of its slice's depths
+	const XMFLOAT4X4& p = projection;
+	for (int s = 0; s < LIGHT_CLUSTERS_Z; s++)
+	{
+		float depths[2] = { sliceDepths[s], sliceDepths[s + 1] };
+		for (int y = 0; y < LIGHT_CLUSTERS_Y; y++)
+		{
+			// Tile rows go down the screen
+			float ndcY[2] = { 1.0f - 2.0f * (y + 1) / LIGHT_CLUSTERS_Y, 1.0f - 2.0f * y / LIGHT_CLUSTERS_Y };
+			for (int x = 0; x < LIGHT_CLUSTERS_X; x++)
+			{
+				float ndcX[2] = { -1.0f + 2.0f * x / LIGHT_CLUSTERS_X, -1.0f + 2.0f * (x + 1) / LIGHT_CLUSTERS_X };
+
+				AABB box = { { FLT_MAX, FLT_MAX, depths[0] }, { -FLT_MAX, -FLT_MAX, depths[1] } };
+				for (float z : depths)
+				{
+					float w = z * p._34 + p._44;
+					for (int i = 0; i < 2; i++)
+					{
+						float vx = (ndcX[i] * w - z * p._31 - p._41) / p._11;
+						float vy = (ndcY[i] * w - z * p._32 - p._42) / p._22;
+						box.min.x = std::min(box.min.x, vx);
+						box.max.x = std::max(box.max.x, vx);
+						box.min.y = std::min(box.min.y, vy);
+						box.max.y = std::max(box.max.y, vy);
+					}
+				}
+
+				unsigned int cluster = GetClusterIndex(x, y, s);
+				XMFLOAT3 center = Bounds::GetCenter(box);
+				XMFLOAT3 extents = Bounds::GetExtents(box);
+				clusterBounds[cluster] = box;
+				clusterSpheres[cluster] = XMFLOAT4(center.x, center.y, center.z, sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z));
+			}
+		}
+	}
+}
+
+void LightClusters::Assign(const Light* lights, unsigned int lightCount, bool parallel)
+{
+	stats = {};
+	lightCount = std::min(lightCount, (unsigned int)MAX_CLUSTERED_LIGHTS);
+	stats.lights = lightCount;
+
+	// Every light into view space, with the slices it spans
+	auto start = Clock::now();
+	lightBounds.resize(lightCount);
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	auto boundLight = [&](unsigned int i)
+	{
+		const Light& light = lights[i];
+		LightBounds& bounds = lightBounds[i];
+		bounds.firstSlice = 1;
+		bounds.lastSlice = 0;
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL || light.Range <= 0.0f)
+			return;
+
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&light.Position), viewMatrix);
+		XMStoreFloat3(&bounds.center, center);
+		bounds.radius = light.Range;
+
+		float zMin = bounds.center.z - bounds.radius;
+		float zMax = bounds.center.z + bounds.radius;
+		if (zMax < nearPlane || zMin > farPlane)
+			return;
+		for (const XMFLOAT4& plane : sidePlanes)
+			if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), center)) < -bounds.radius)
+				return;
+
+		// Cones past a hemisphere are bounded as points
+		bounds.spot = light.Type == LIGHT_TYPE_SPOT && light.SpotOuterAngle < XM_PIDIV2;
+		if (bounds.spot)
+		{
+			XMStoreFloat3(&bounds.direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), viewMatrix)));
+			bounds.cosAngle = cosf(light.SpotOuterAngle);
+			bounds.sinAngle = sinf(light.SpotOuterAngle);
+		}
+
+		// One slice of slack each way; the box tests trim it
+		bounds.firstSlice = std::max(GetSlice(zMin) - 1, 0);
+		bounds.lastSlice = std::min(GetSlice(zMax) + 1, LIGHT_CLUSTERS_Z - 1);
+	};
+
+	if (parallel && lightCount > LIGHT_CLUSTER_BATCH)
+	{
+		unsigned int batchCount = (lightCount + LIGHT_CLUSTER_BATCH - 1) / LIGHT_CLUSTER_BATCH;
+		std::vector<unsigned int> batches(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), [&](unsigned int batch)
+		{
+			unsigned int begin = batch * LIGHT_CLUSTER_BATCH;
+			unsigned int end = std::min(begin + LIGHT_CLUSTER_BATCH, lightCount);
+			for (unsigned int i = begin; i < end; i++)
+				boundLight(i);
+		});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < lightCount; i++)
+			boundLight(i);
+	}
+
+	// Then into the slices, in light order
+	for (std::vector<unsigned int>& slice : sliceLights)
+		slice.clear();
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		const LightBounds& bounds = lightBounds[i];
+		for (int s = bounds.firstSlice; s <= bounds.lastSlice; s++)
+			sliceLights[s].push_back(i);
+		stats.clusteredLights += bounds.firstSlice <= bounds.lastSlice;
+	}
+	stats.boundsMs = ElapsedMs(start);
+
+	// Each slice only writes its own clusters
+	start = Clock::now();
+	if (parallel)
+	{
+		std::vector<int> slices(LIGHT_CLUSTERS_Z);
+		std::iota(slices.begin(), slices.end(), 0);
+		std::for_each(std::execution::par, slices.begin(), slices.end(), [&](int slice) { AssignSlice(slice); });
+	}
+	else
+	{
+		for (int s = 0; s < LIGHT_CLUSTERS_Z; s++)
+			AssignSlice(s);
+	}
+	stats.assignMs = ElapsedMs(start);
+
+	// Offsets, then every list copied into place
+	start = Clock::now();
+	unsigned int offset = 0;
+	for (unsigned int c = 0; c < LIGHT_CLUSTER_COUNT; c++)
+	{
+		unsigned int count = (unsigned int)clusterLists[c].size();
+		ranges[c] = { offset, count };
+		offset += count;
+		stats.largestCluster = std::max(stats.largestCluster, count);
+		stats.emptyClusters += count == 0;
+	}
+	indices.resize(offset);
+	stats.references = offset;
+
+	auto copyCluster = [&](unsigned int c)
+	{
+		if (!clusterLists[c].empty())
+			memcpy(&indices[ranges[c].offset], clusterLists[c].data(), clusterLists[c].size() * sizeof(unsigned int));
+	};
+	if (parallel && offset > 0)
+	{
+		std::vector<unsigned int> clusters(LIGHT_CLUSTER_COUNT);
+		std::iota(clusters.begin(), clusters.end(), 0);
+		std::for_each(std::execution::par, clusters.begin(), clusters.end(), copyCluster);
+	}
+	else
+	{
+		for (unsigned int c = 0; c < LIGHT_CLUSTER_COUNT; c++)
+			copyCluster(c);
+	}
+	stats.compactMs = ElapsedMs(start);
+}
+
+void LightClusters::AssignSlice(int slice)
+{
+	for (int y = 0; y < LIGHT_CLUSTERS_Y; y++)
+		for (int x = 0; x < LIGHT_CLUSTERS_X; x++)
+			clusterLists[GetClusterIndex(x, y, slice)].clear();
+
+	// A little past the slice, so a point on its boundary is
+	// covered whichever side rounding puts it
+	float sliceNear = sliceDepths[slice] * 0.999f;
+	float sliceFar = sliceDepths[slice + 1] * 1.001f;
+	const AABB& sliceBox = clusterBounds[GetClusterIndex(0, 0, slice)];
+
+	for (unsigned int i : sliceLights[slice])
+	{
+		const LightBounds& light = lightBounds[i];
+		float rect[4];
+		if (!GetScreenRect(light, sliceNear, sliceFar, rect))
+			continue;
+
+		int x0 = std::clamp((int)floorf((rect[0] * 0.5f + 0.5f) * LIGHT_CLUSTERS_X), 0, LIGHT_CLUSTERS_X - 1);
+		int x1 = std::clamp((int)floorf((rect[1] * 0.5f + 0.5f) * LIGHT_CLUSTERS_X), 0, LIGHT_CLUSTERS_X - 1);
+		int y0 = std::clamp((int)floorf((0.5f - rect[3] * 0.5f) * LIGHT_CLUSTERS_Y), 0, LIGHT_CLUSTERS_Y - 1);
+		int y1 = std::clamp((int)floorf((0.5f - rect[2] * 0.5f) * LIGHT_CLUSTERS_Y), 0, LIGHT_CLUSTERS_Y - 1);
+
+		// Same test as Touches(), split up: a froxel's box spans
+		// the same depths across its slice and the same heights
+		// across its row, so only the x distance changes per tile
+		float radiusSq = light.radius * light.radius;
+		float dz = std::max(std::max(sliceBox.min.z - light.center.z, light.center.z - sliceBox.max.z), 0.0f);
+		float sliceRemaining = radiusSq - dz * dz;
+		if (sliceRemaining < 0.0f)
+			continue;
+		for (int y = y0; y <= y1; y++)
+		{
+			const AABB& rowBox = clusterBounds[GetClusterIndex(x0, y, slice)];
+			float dy = std::max(std::max(rowBox.min.y - light.center.y, light.center.y - rowBox.max.y), 0.0f);
+			float rowRemaining = sliceRemaining - dy * dy;
+			if (rowRemaining < 0.0f)
+				continue;
+
+			for (int x = x0; x <= x1; x++)
+			{
+				unsigned int cluster = GetClusterIndex(x, y, slice);
+				const AABB& box = clusterBounds[cluster];
+				float dx = std::max(std::max(box.min.x - light.center.x, light.center.x - box.max.x), 0.0f);
+				if (dx * dx > rowRemaining)
+					continue;
+
+				const XMFLOAT4& sphere = clusterSpheres[cluster];
+				if (light.spot && !Bounds::ConeOverlapsSphere(light.center, light.direction, light.cosAngle, light.sinAngle, light.radius, XMFLOAT3(sphere.x, sphere.y, sphere.z), sphere.w))
+					continue;
+				clusterLists[cluster].push_back(i);
+			}
+		}
+	}
+}
+
+bool LightClusters::Touches(unsigned int light, unsigned int cluster)
+{
+	const LightBounds& bounds = lightBounds[light];
+	if (bounds.firstSlice > bounds.lastSlice)
+		return false;
+
+	const AABB& box = clusterBounds[cluster];
+	if (Bounds::SphereTest(bounds.center, bounds.radius, box) == BOUNDS_OUTSIDE)
+		return false;
+	if (!bounds.spot)
+		return true;
+
+	// Spots: the cone against the sphere around the box
+	const XMFLOAT4& sphere = clusterSpheres[cluster];
+	return Bounds::ConeOverlapsSphere(bounds.center, bounds.direction, bounds.cosAngle, bounds.sinAngle, bounds.radius, XMFLOAT3(sphere.x, sphere.y, sphere.z), sphere.w);
+}
+
+// The light's box, cut to the depths, onto the screen as min
+// x, max x, min y, max y (the corners are the extremes of x / w
+// and y / w); false if none of it is on screen
+bool LightClusters::GetScreenRect(const LightBounds& light, float zNear, float zFar, float* rect)
+{
+	zNear = std::max(light.center.z - light.radius, zNear);
+	zFar = std::min(light.center.z + light.radius, zFar);
+	if (zNear > zFar)
+		return false;
+
+	const XMFLOAT4X4& p = projection;
+	float xLow = light.center.x - light.radius;
+	float xHigh = light.center.x + light.radius;
+	float yLow = light.center.y - light.radius;
+	float yHigh = light.center.y + light.radius;
+	rect[0] = FLT_MAX;
+	rect[1] = -FLT_MAX;
+	rect[2] = FLT_MAX;
+	rect[3] = -FLT_MAX;
+	for (float z : { zNear, zFar })
+	{
+		float invW = 1.0f / (z * p._34 + p._44);
+		float xOffset = z * p._31 + p._41;
+		float yOffset = z * p._32 + p._42;
+		float x0 = (xLow * p._11 + xOffset) * invW;
+		float x1 = (xHigh * p._11 + xOffset) * invW;
+		float y0 = (yLow * p._22 + yOffset) * invW;
+		float y1 = (yHigh * p._22 + yOffset) * invW;
+		rect[0] = std::min(rect[0], std::min(x0, x1));
+		rect[1] = std::max(rect[1], std::max(x0, x1));
+		rect[2] = std::min(rect[2], std::min(y0, y1));
+		rect[3] = std::max(rect[3], std::max(y0, y1));
+	}
+	return rect[1] >= -1.0f && rect[0] <= 1.0f && rect[3] >= -1.0f && rect[2] <= 1.0f;
+}
+
+unsigned int LightClusters::GetClusterIndex(int x, int y, int slice)
+{
+	return (slice * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+}
+
+// Getters
+int LightClusters::GetSlice(float viewDepth)
+{
+	if (viewDepth <= nearPlane)
+		return 0;
+	return std::clamp((int)floorf(logf(viewDepth) * sliceScale + sliceBias), 0, LIGHT_CLUSTERS_Z - 1);
+}
+
+float LightClusters::GetSliceScale() { return sliceScale; }
+float LightClusters::GetSliceBias() { return sliceBias; }
+AABB LightClusters::GetClusterBounds(unsigned int cluster) { return clusterBounds[cluster]; }
+const std::vector<LightClusterRange>& LightClusters::GetRanges() { return ranges; }
+const std::vector<unsigned int>& LightClusters::GetIndices() { return indices; }
+TextureHandle LightClusters::GetLightView() { return lightView; }
+TextureHandle LightClusters::GetRangeView() { return rangeView; }
+TextureHandle LightClusters::GetIndexView() { return indexView; }
+LightClusterStats LightClusters::GetStats() { return stats; }
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Lights.h"
+#include "RenderBackend.h"
+
+// Froxel grid: screen tiles across and down, then depth slices
+// (must match PixelShader.hlsl)
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Lights bounded per parallel task
+#define LIGHT_CLUSTER_BATCH 1024
+
+// Most lights the clustered path takes (the constant buffer
+// path stops at MAX_LIGHTS)
+#define MAX_CLUSTERED_LIGHTS 16384
+
+// Assignment time the clusters should fit in each frame, at
+// MAX_CLUSTERED_LIGHTS-ish light counts
+#define LIGHT_CLUSTER_BUDGET_MS 2.0
+
+// Where one cluster's lights sit in the index list (uint2 on the GPU)
+struct LightClusterRange
+{
+	unsigned int offset;
+	unsigned int count;
+};
+
+// What the last Assign() did
+struct LightClusterStats
+{
+	unsigned int lights;
+	unsigned int clusteredLights;	// Point and spot lights touching the grid
+	unsigned int references;		// Length of the index list
+	unsigned int largestCluster;
+	unsigned int emptyClusters;
+	double boundsMs;				// Lights into view space
+	double assignMs;				// Per slice, in parallel
+	double compactMs;				// Offsets and the index list
+	double uploadMs;
+};
+
+// --------------------------------------------------------
+// Clustered light assignment on the CPU
+//
+// - The view frustum is split into a grid of froxels: screen
+//    tiles, each cut into depth slices that grow exponentially
+//    from the near plane to the far plane
+// - Point and spot lights are bounded in view space and binned
+//    by the depth slices they span (off screen ones are dropped)
+// - Each slice (in parallel) finds the tiles each of its lights
+//    could reach, then keeps the clusters whose box the light's
+//    sphere touches (and, for spots, whose bounding sphere
+//    isn't outside the cone)
+// - The result is compact: an offset and count per cluster
+//    into one list of light indices, in light order
+// - Directional lights reach every pixel and aren't clustered
+// - Everything but Upload() runs without a device (Upload()
+//    is in LightClustersUpload.cpp, so the rest links alone)
+// --------------------------------------------------------
+class LightClusters
+{
+private:
+	// A light in view space, for the tests
+	struct LightBounds
+	{
+		DirectX::XMFLOAT3 center;
+		float radius;
+		DirectX::XMFLOAT3 direction;	// Spots only
+		float cosAngle;
+		float sinAngle;
+		int firstSlice;					// Past lastSlice when the light is skipped
+		int lastSlice;
+		bool spot;
+	};
+
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+	float nearPlane;
+	float farPlane;
+	float sliceScale;			// slice = log(depth) * scale + bias
+	float sliceBias;
+	float sliceDepths[LIGHT_CLUSTERS_Z + 1];
+	DirectX::XMFLOAT4 sidePlanes[4];		// View space left, right, bottom, top (inward)
+	bool gridBuilt;
+
+	std::vector<AABB> clusterBounds;					// View space
+	std::vector<DirectX::XMFLOAT4> clusterSpheres;		// Around each box, for the spot test
+	std::vector<LightBounds> lightBounds;
+	std::vector<std::vector<unsigned int>> sliceLights;		// Lights each slice tests
+	std::vector<std::vector<unsigned int>> clusterLists;	// Per cluster, filled per slice
+	std::vector<LightClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	LightClusterStats stats;
+
+	// GPU copies
+	BufferHandle lightBuffer;
+	TextureHandle lightView;
+	BufferHandle rangeBuffer;
+	TextureHandle rangeView;
+	BufferHandle indexBuffer;
+	TextureHandle indexView;
+	unsigned int lightCapacity;
+	unsigned int indexCapacity;
+
+	bool GetScreenRect(const LightBounds& light, float zNear, float zFar, float* rect);
+	void AssignSlice(int slice);
+
+public:
+	LightClusters();
+
+	// Builds the grid for a camera (its view and projection,
+	// and the planes the slices span); the froxels are only
+	// rebuilt when the projection or planes change
+	void Build(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, float nearPlane, float farPlane);
+
+	// Fills every cluster's light list
+	void Assign(const Light* lights, unsigned int lightCount, bool parallel = true);
+
+	// Copies the lights, ranges and index list to the GPU
+	bool Upload(const Light* lights, unsigned int lightCount);
+
+	// Whether light (as of the last Assign()) reaches a cluster,
+	// by the same test Assign() uses
+	bool Touches(unsigned int light, unsigned int cluster);
+
+	static unsigned int GetClusterIndex(int x, int y, int slice);
+
+	// Getters
+	int GetSlice(float viewDepth);			// Clamped to the grid
+	float GetSliceScale();
+	float GetSliceBias();
+	AABB GetClusterBounds(unsigned int cluster);
+	const std::vector<LightClusterRange>& GetRanges();
+	const std::vector<unsigned int>& GetIndices();
+	TextureHandle GetLightView();
+	TextureHandle GetRangeView();
+	TextureHandle GetIndexView();
+	LightClusterStats GetStats();
+};
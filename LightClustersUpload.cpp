@@ -0,0 +1,56 @@
+#include "LightClusters.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// --------------------------------------------------------
+// The backend side of the clusters, kept apart so the
+// assignment builds and runs on its own (see Tests.cpp)
+// --------------------------------------------------------
+bool LightClusters::Upload(const Light* lights, unsigned int lightCount)
+{
+	auto start = Clock::now();
+	lightCount = std::min(lightCount, (unsigned int)MAX_CLUSTERED_LIGHTS);
+	unsigned int indexCount = (unsigned int)indices.size();
+
+	// Grow in big steps so a growing scene doesn't recreate them every frame
+	if (lightCount > lightCapacity || lightBuffer.IsNull())
+	{
+		unsigned int capacity = std::max(lightCapacity, 256u);
+		while (capacity < lightCount)
+			capacity *= 2;
+		lightCapacity = 0;
+		if (!Graphics::Backend->CreateStructuredBuffer(sizeof(Light), capacity, &lightBuffer, &lightView))
+		{
+			printf("Could not create the clustered light buffer (%u lights)\n", capacity);
+			return false;
+		}
+		lightCapacity = capacity;
+	}
+	if (indexCount > indexCapacity || indexBuffer.IsNull())
+	{
+		unsigned int capacity = std::max(indexCapacity, 4096u);
+		while (capacity < indexCount)
+			capacity *= 2;
+		indexCapacity = 0;
+		if (!Graphics::Backend->CreateStructuredBuffer(sizeof(unsigned int), capacity, &indexBuffer, &indexView))
+		{
+			printf("Could not create the light index buffer (%u indices)\n", capacity);
+			return false;
+		}
+		indexCapacity = capacity;
+	}
+	if (rangeBuffer.IsNull() && !Graphics::Backend->CreateStructuredBuffer(sizeof(LightClusterRange), LIGHT_CLUSTER_COUNT, &rangeBuffer, &rangeView))
+	{
+		printf("Could not create the light cluster buffer\n");
+		return false;
+	}
+
+	bool filled =
+		Graphics::Backend->UpdateBuffer(lightBuffer, lights, lightCount * sizeof(Light)) &&
+		Graphics::Backend->UpdateBuffer(rangeBuffer, ranges.data(), ranges.size() * sizeof(LightClusterRange)) &&
+		Graphics::Backend->UpdateBuffer(indexBuffer, indices.data(), indexCount * sizeof(unsigned int));
+	stats.uploadMs = ElapsedMs(start);
+	return filled;
+}
@@ -1,10 +1,16 @@
 
 #include <Windows.h>
 #include <crtdbg.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "Window.h"
 #include "Graphics.h"
+#include "D3D11Backend.h"
 #include "Game.h"
+#include "Headless.h"
 #include "Input.h"
 
 // Annonymous namespace to hold variables
@@ -38,6 +44,36 @@ int WINAPI WinMain(
 	_In_ LPSTR lpCmdLine,				// Command line params
 	_In_ int nCmdShow)					// How the window should be shown (we ignore this)
 {
+	// "-headless [frames]" runs that many frames on the null backend
+	// and prints where the CPU time went (to the console it was
+	// started from, if there is one)
+	const char* headlessArg = strstr(lpCmdLine, "-headless");
+	if (headlessArg)
+	{
+		bool ownConsole = !AttachConsole(ATTACH_PARENT_PROCESS);
+		if (ownConsole)
+		{
+			Window::CreateConsoleWindow(500, 200, 32, 200);
+		}
+		else
+		{
+			FILE* stream;
+			freopen_s(&stream, "CONOUT$", "w", stdout);
+			freopen_s(&stream, "CONOUT$", "w", stderr);
+		}
+
+		int frames = atoi(headlessArg + strlen("-headless"));
+		int result = Headless::Run(frames > 0 ? frames : 300, 1280, 720);
+
+		// A console of our own closes with us, so keep it up to be read
+		if (ownConsole)
+		{
+			printf("Press enter to close\n");
+			(void)getchar();
+		}
+		return result;
+	}
+
 #if defined(DEBUG) | defined(_DEBUG)
 	// Enable memory leak detection as a quick and dirty
 	// way of determining if we forgot to clean something up
@@ -75,6 +111,10 @@ int WINAPI WinMain(
 	if (FAILED(graphicsResult))
 		return graphicsResult;
 
+	// Everything draws through the backend
+	D3D11Backend* backend = new D3D11Backend();
+	Graphics::Backend = backend;
+
 	// Initalize the input system, which requires the window handle
 	Input::Initialize(Window::Handle());
 
@@ -97,6 +137,17 @@ int WINAPI WinMain(
 	currentTime = startTime;
 	previousTime = startTime;
 
+	// Fixed-timestep simulation
+	//  - The simulation always advances in steps of exactly fixedTimeStep,
+	//     so its results no longer depend on the frame rate
+	//  - At most maxStepsPerFrame steps are run per rendered frame; if we fall
+	//     further behind than that, the extra time is dropped instead of
+	//     snowballing into even more simulation work next frame
+	const double fixedTimeStep = 1.0 / 60.0;
+	const int maxStepsPerFrame = 5;
+	double accumulator = 0.0;
+	double simulationTime = 0.0;
+
 	// Windows message loop (and our game loop)
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -123,8 +174,27 @@ int WINAPI WinMain(
 			// Input updating
 			Input::Update();
 
-			// Update and draw
+			// Per-frame update (input, UI, camera)
 			game->Update(deltaTime, totalTime);
+
+			// Run 0..N fixed simulation steps to catch up with real time
+			accumulator += deltaTime;
+			int steps = 0;
+			while (accumulator >= fixedTimeStep && steps < maxStepsPerFrame)
+			{
+				game->FixedUpdate((float)fixedTimeStep, (float)simulationTime);
+				simulationTime += fixedTimeStep;
+				accumulator -= fixedTimeStep;
+				steps++;
+			}
+
+			// Spiral-of-death protection: throw away any whole steps we
+			// couldn't afford this frame, keeping only the partial step
+			if (accumulator >= fixedTimeStep)
+				accumulator = fmod(accumulator, fixedTimeStep);
+
+			// Blend between the last two simulation states for rendering
+			game->Interpolate((float)(accumulator / fixedTimeStep));
 			game->Draw(deltaTime, totalTime);
 
 			// Notify Input system about end of frame
@@ -139,6 +209,8 @@ int WINAPI WinMain(
 
 	// Clean up
 	delete game;
+	Graphics::Backend = nullptr;
+	delete backend;
 	Input::ShutDown();
 	Graphics::ShutDown();
 	return (HRESULT)msg.wParam;
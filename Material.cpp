@@ -1,11 +1,10 @@
 #include "Material.h"
-#include "Graphics.h"
 
 Material::Material(
 	std::string name, 
 	DirectX::XMFLOAT4 colorTint, 
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> ps, 
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> vs) :
+	ShaderHandle ps, 
+	ShaderHandle vs) :
 	name(name),
 	colorTint(colorTint), 
 	scale(DirectX::XMFLOAT2(1.0f, 1.0f)),
@@ -35,19 +34,19 @@ DirectX::XMFLOAT2 Material::GetOffset()
 	return offset;
 }
 
-Microsoft::WRL::ComPtr<ID3D11PixelShader> Material::GetPixelShader()
+ShaderHandle Material::GetPixelShader()
 {
     return ps;
 }
 
-Microsoft::WRL::ComPtr<ID3D11VertexShader> Material::GetVertexShader()
+ShaderHandle Material::GetVertexShader()
 {
     return vs;
 }
 
-std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& Material::GetTextureSRVMap()
+std::unordered_map<unsigned int, TextureHandle>& Material::GetTextureMap()
 {
-	return textureSRVs;
+	return textures;
 }
 
 void Material::SetColorTint(DirectX::XMFLOAT4 colorTint)
@@ -65,33 +64,42 @@ void Material::SetOffset(DirectX::XMFLOAT2 offset)
 	this->offset = offset;
 }
 
-void Material::SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> ps)
+void Material::SetPixelShader(ShaderHandle ps)
 {
 	this->ps = ps;
 }
 
-void Material::SetVertexShader(Microsoft::WRL::ComPtr<ID3D11VertexShader> vs)
+void Material::SetVertexShader(ShaderHandle vs)
 {
 	this->vs = vs;
 }
 
-void Material::AddTextureSRV(unsigned int i, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+void Material::AddTexture(unsigned int i, TextureHandle texture)
 {
-	textureSRVs.insert({ i, srv });
+	textures.insert({ i, texture });
 }
 
-void Material::AddSampler(unsigned int i, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
+void Material::AddSampler(unsigned int i, SamplerHandle sampler)
 {
 	samplers.insert({ i, sampler });
 }
 
 void Material::BindTexturesAndSamplers()
 {
-	// Binding SRVs and Samplers in C++ (the first param is the index from the shader)
+	// Binding textures and samplers in C++ (the first param is the index from the shader)
 
-	for (auto& srv : textureSRVs)
-		Graphics::Context->PSSetShaderResources(srv.first, 1, srv.second.GetAddressOf());
+	for (auto& t : textures)
+		Graphics::Backend->SetPixelShaderResources(t.first, 1, &t.second);
 
 	for (auto& s : samplers)
-		Graphics::Context->PSSetSamplers(s.first, 1, s.second.GetAddressOf());
+		Graphics::Backend->SetPixelSamplers(s.first, 1, &s.second);
+}
+
+void Material::BindTexturesAndSamplers(StateCache& states)
+{
+	for (auto& t : textures)
+		states.SetPixelShaderResource(t.first, t.second);
+
+	for (auto& s : samplers)
+		states.SetPixelSampler(s.first, s.second);
 }
@@ -1,11 +1,11 @@
 #pragma once
 
-#include <d3d11.h>
-#include <wrl/client.h>
 #include <DirectXMath.h>
 #include <string>
 #include <unordered_map>
 
+#include "StateCache.h"
+
 class Material
 {
 private:
@@ -17,36 +17,37 @@ private:
 	DirectX::XMFLOAT2 offset;
 
 	// Shaders
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> ps;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;
+	ShaderHandle ps;
+	ShaderHandle vs;
 
-	//Unordered maps holding SRVs and Sampler for a single material
-	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
-	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+	//Unordered maps holding textures and samplers for a single material
+	std::unordered_map<unsigned int, TextureHandle> textures;
+	std::unordered_map<unsigned int, SamplerHandle> samplers;
 
 public:
-	Material(std::string name, DirectX::XMFLOAT4 colorTint, Microsoft::WRL::ComPtr<ID3D11PixelShader> ps, Microsoft::WRL::ComPtr<ID3D11VertexShader> vs);
+	Material(std::string name, DirectX::XMFLOAT4 colorTint, ShaderHandle ps, ShaderHandle vs);
 
 	// Getters
 	std::string GetName();
 	DirectX::XMFLOAT4 GetColorTint();
 	DirectX::XMFLOAT2 GetScale();
 	DirectX::XMFLOAT2 GetOffset();
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetPixelShader();
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetVertexShader();
-	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& GetTextureSRVMap();
+	ShaderHandle GetPixelShader();
+	ShaderHandle GetVertexShader();
+	std::unordered_map<unsigned int, TextureHandle>& GetTextureMap();
 
 	// Setters
 	void SetColorTint(DirectX::XMFLOAT4 colorTint);
 	void SetScale(DirectX::XMFLOAT2 scale);
 	void SetOffset(DirectX::XMFLOAT2 offset);
-	void SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> ps);
-	void SetVertexShader(Microsoft::WRL::ComPtr<ID3D11VertexShader> vs);
+	void SetPixelShader(ShaderHandle ps);
+	void SetVertexShader(ShaderHandle vs);
 
-	void AddTextureSRV(unsigned int i, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
-	void AddSampler(unsigned int i, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
+	void AddTexture(unsigned int i, TextureHandle texture);
+	void AddSampler(unsigned int i, SamplerHandle sampler);
 
 	// PS Helper
 	void BindTexturesAndSamplers();
+	void BindTexturesAndSamplers(StateCache& states);	// Staged: the caller commits
 };
 
@@ -273,12 +273,12 @@ Mesh::~Mesh()
 {
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
+BufferHandle Mesh::GetVertexBuffer()
 {
 	return vertexBuffer;
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
+BufferHandle Mesh::GetIndexBuffer()
 {
 	return indexBuffer;
 }
@@ -288,6 +288,16 @@ int Mesh::GetIndexCount()
 	return indexCount;
 }
 
+int Mesh::GetIndexCount(int lod)
+{
+	return lodIndexCount[ClampLOD(lod)];
+}
+
+int Mesh::GetLODCount()
+{
+	return lodCount;
+}
+
 int Mesh::GetVertexCount()
 {
 	return vertexCount;
@@ -298,34 +308,65 @@ std::string Mesh::GetName()
 	return displayName;
 }
 
+AABB Mesh::GetBounds()
+{
+	return bounds;
+}
+
+const std::vector<XMFLOAT3>& Mesh::GetPositions()
+{
+	return positions;
+}
+
+const std::vector<uint>& Mesh::GetIndices()
+{
+	return cpuIndices;
+}
+
 void Mesh::CreateBuffers(Vertex* vertices, uint* indices)
 {
+	// Bounds of the vertices (while we still have them on the CPU)
+	bounds = {};
+	if (vertexCount > 0)
+	{
+		bounds.min = vertices[0].Position;
+		bounds.max = vertices[0].Position;
+		for (uint i = 1; i < vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+			XMStoreFloat3(&bounds.min, XMVectorMin(XMLoadFloat3(&bounds.min), p));
+			XMStoreFloat3(&bounds.max, XMVectorMax(XMLoadFloat3(&bounds.max), p));
+		}
+	}
+
+	// Keep what occlusion culling needs to rasterize the mesh
+	positions.resize(vertexCount);
+	for (uint i = 0; i < vertexCount; i++)
+		positions[i] = vertices[i].Position;
+	cpuIndices.assign(indices, indices + indexCount);
+
+	// Simplified levels go after the full mesh in the index buffer
+	std::vector<uint> allIndices(indices, indices + indexCount);
+	BuildLODs(vertices, allIndices);
+
 	// Create a VERTEX BUFFER
 	{
 		// - This holds the vertex data of triangles for a single object
 		// - This buffer is created on the GPU, which is where the data needs to
 		//    be if we want the GPU to act on it (as in: draw it to the screen)
 
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
+		// First, we need to describe the buffer we want the backend to make
 		//  - Note that this variable is created on the stack since we only need it once
 		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;	// size of a vertex * number of vertices in the buffer
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
+		RenderBufferDesc vbd = {};
+		vbd.type = RENDER_BUFFER_VERTEX;	// Tells the backend this is a vertex buffer
+		vbd.size = sizeof(Vertex) * vertexCount;	// size of a vertex * number of vertices in the buffer
+		vbd.stride = sizeof(Vertex);
+		vbd.dynamic = false;	// Will NEVER change
 
 		// Actually create the buffer on the GPU with the initial data
 		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		vertexBuffer = Graphics::Backend->CreateBuffer(vbd, vertices);
 	}
 
 	// Create an INDEX BUFFER
@@ -336,23 +377,85 @@ void Mesh::CreateBuffers(Vertex* vertices, uint* indices)
 		//    be if we want the GPU to act on it (as in: draw it to the screen)
 
 		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(uint) * indexCount;	// size of int * number of indices in the buffer
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+		//  - Size (3 unsigned integers vs. 3 whole vertices)
+		//  - Type (used as an index buffer instead of a vertex buffer)
+		RenderBufferDesc ibd = {};
+		ibd.type = RENDER_BUFFER_INDEX;	// Tells the backend this is an index buffer
+		ibd.size = sizeof(uint) * (uint)allIndices.size();	// size of int * number of indices in the buffer (all levels)
+		ibd.stride = sizeof(uint);
+		ibd.dynamic = false;	// Will NEVER change
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+		indexBuffer = Graphics::Backend->CreateBuffer(ibd, allIndices.data());
+	}
+}
+
+// --------------------------------------------------------
+// Appends simplified versions of the mesh to indices, by
+// vertex clustering: vertices are snapped to a grid over
+// the bounds (one vertex kept per cell) and triangles that
+// collapse are dropped
+// - Each level halves the grid resolution
+// - Stops early once a level barely saves anything, so
+//    simple meshes (a cube) only have the one level
+// --------------------------------------------------------
+void Mesh::BuildLODs(Vertex* vertices, std::vector<uint>& indices)
+{
+	lodCount = 1;
+	lodIndexStart[0] = 0;
+	lodIndexCount[0] = indexCount;
+
+	XMFLOAT3 size(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z);
+	float largest = max(size.x, max(size.y, size.z));
+	if (largest <= 0.0f)
+		return;
+
+	std::vector<uint> representative(vertexCount);
+	std::unordered_map<uint, uint> cellVertex;
+	for (uint resolution = 32; lodCount < MESH_MAX_LODS && resolution >= 4; resolution /= 2)
+	{
+		// The first vertex to land in a cell stands in for the whole cell
+		float cellSize = largest / resolution;
+		cellVertex.clear();
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			uint x = min((uint)((vertices[v].Position.x - bounds.min.x) / cellSize), resolution - 1);
+			uint y = min((uint)((vertices[v].Position.y - bounds.min.y) / cellSize), resolution - 1);
+			uint z = min((uint)((vertices[v].Position.z - bounds.min.z) / cellSize), resolution - 1);
+			uint cell = (x * resolution + y) * resolution + z;
+			representative[v] = cellVertex.insert({ cell, v }).first->second;
+		}
+
+		// Keep the triangles that still have three distinct corners
+		uint start = (uint)indices.size();
+		for (uint i = 0; i < indexCount; i += 3)
+		{
+			uint a = representative[indices[i]];
+			uint b = representative[indices[i + 1]];
+			uint c = representative[indices[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+			}
+		}
+		uint count = (uint)indices.size() - start;
+
+		// Not worth a level (or nothing left): drop it
+		uint previous = lodIndexCount[lodCount - 1];
+		if (count == 0 || count > previous * 9 / 10)
+		{
+			indices.resize(start);
+			if (count == 0)
+				break;
+			continue;
+		}
+
+		lodIndexStart[lodCount] = start;
+		lodIndexCount[lodCount] = count;
+		lodCount++;
 	}
 }
 
@@ -446,31 +549,61 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 	}
 }
 
-void Mesh::Draw()
+void Mesh::Draw(int lod)
 {
+	Bind();
+	DrawBound(lod);
+}
+
+void Mesh::Bind()
+{
+	// Set buffers in the input assembler (IA) stage
+	//  - Do this ONCE PER OBJECT, since each object may have different geometry
+	//  - This needs to be done between DrawIndexed() calls that draw
+	//     different geometry; draws of the same mesh in a row can skip it
+	Graphics::Backend->SetVertexBuffer(vertexBuffer, sizeof(Vertex), 0);
+	Graphics::Backend->SetIndexBuffer(indexBuffer, RENDER_INDEX_32, 0);
+}
+
+void Mesh::Bind(StateCache& states)
+{
+	states.SetVertexBuffer(vertexBuffer, sizeof(Vertex));
+	states.SetIndexBuffer(indexBuffer, RENDER_INDEX_32);
+}
+
+// --------------------------------------------------------
+// Out of range levels fall back to the nearest one there is
+// (the full mesh below 0, the coarsest level past the end)
+// --------------------------------------------------------
+uint Mesh::ClampLOD(int lod)
+{
+	return lod < (int)lodCount ? (uint)max(lod, 0) : lodCount - 1;
+}
+
+void Mesh::DrawBound(int lod)
+{
+	uint level = ClampLOD(lod);
+
 	// DRAW geometry
-	// - These steps are generally repeated for EACH object you draw
-	// - Other Direct3D calls will also be necessary to do more complex things
 	{
-		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		UINT stride = sizeof(Vertex);
-		UINT offset = 0;
-		Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-
-		// Tell Direct3D to draw
+		// Tell the backend to draw
 		//  - Begins the rendering pipeline on the GPU
 		//  - Do this ONCE PER OBJECT you intend to draw
-		//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
+		//  - This will use all currently set resources (shaders, buffers, etc)
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
-		Graphics::Context->DrawIndexed(
-			indexCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,				// Offset to the first index we want to use
-			0);				// Offset to add to each index when looking up vertices
+		Graphics::Backend->DrawIndexed(
+			lodIndexCount[level],	// The number of indices to use (just this detail level)
+			lodIndexStart[level],	// Offset to the first index we want to use
+			0);						// Offset to add to each index when looking up vertices
 	}
 }
+
+void Mesh::DrawBoundInstanced(int lod, unsigned int instanceCount)
+{
+	uint level = ClampLOD(lod);
+
+	// The instances' data comes from whatever the vertex shader reads
+	// (SV_InstanceID starts at 0 for every draw)
+	Graphics::Backend->DrawIndexedInstanced(lodIndexCount[level], instanceCount, lodIndexStart[level], 0);
+}
@@ -1,23 +1,45 @@
 #pragma once
-#include <d3d11.h>
-#include <wrl/client.h>
 #include <string>
+#include <vector>
 #include "Vertex.h"
+#include "Bounds.h"
+#include "StateCache.h"
 
 #define uint unsigned int
 
+// Detail levels per mesh, including the full mesh
+#define MESH_MAX_LODS 4
+
 class Mesh
 {
 private:
 	// Buffers to hold actual geometry data
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	// (copies of a mesh share them; the backend owns them)
+	BufferHandle vertexBuffer;
+	BufferHandle indexBuffer;
 
 	// Information about the mesh
 	std::string displayName;
 	uint indexCount;
 	uint vertexCount;
 
+	// Object space bounds of the vertices
+	AABB bounds;
+
+	// Positions and full detail triangles, kept on the CPU for
+	// software occlusion (rasterizing the mesh as an occluder)
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<uint> cpuIndices;
+
+	// Detail levels, stored one after another in the index buffer
+	// (level 0 is the full mesh, the rest share its vertices)
+	uint lodCount;
+	uint lodIndexStart[MESH_MAX_LODS];
+	uint lodIndexCount[MESH_MAX_LODS];
+
+	void BuildLODs(Vertex* vertices, std::vector<uint>& indices);
+	uint ClampLOD(int lod);
+
 public:
 	Mesh(std::string name, Vertex* vertices, uint vertCount, uint* indices, uint idxCount);
 	Mesh(std::string name, const char* objFile);
@@ -25,16 +47,25 @@ public:
 	~Mesh();
 
 	// Getters
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	BufferHandle GetVertexBuffer();
+	BufferHandle GetIndexBuffer();
 	int GetIndexCount();
+	int GetIndexCount(int lod);
+	int GetLODCount();
 	int GetVertexCount();
 	std::string GetName();
+	AABB GetBounds();
+	const std::vector<DirectX::XMFLOAT3>& GetPositions();
+	const std::vector<uint>& GetIndices();		// Level 0 only
 
 	// Helper methods
 	void CreateBuffers(Vertex* vertices, uint* indices);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
-	void Draw();
+	void Draw(int lod = 0);		// Bind() then DrawBound()
+	void Bind();				// Vertex and index buffers
+	void Bind(StateCache& states);	// Same, skipped if they're already bound
+	void DrawBound(int lod = 0);	// Assumes this mesh's buffers are bound
+	void DrawBoundInstanced(int lod, unsigned int instanceCount);
 };
 
@@ -0,0 +1,742 @@
+#include "NullBackend.h"
+
+#include "ImGui/imgui.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+	bool IsDepthFormat(int format)
+	{
+		return format == RENDER_FORMAT_DEPTH24_STENCIL8 || format == RENDER_FORMAT_DEPTH32;
+	}
+
+	bool SameSize(const RenderTextureDesc& a, const RenderTextureDesc& b)
+	{
+		return a.width == b.width && a.height == b.height;
+	}
+}
+
+NullBackend::NullBackend(unsigned int width, unsigned int height) :
+	vertexStride(0),
+	vertexOffset(0),
+	indexFormat(RENDER_INDEX_UNKNOWN),
+	indexOffset(0),
+	targetCount(0),
+	psResourceEnd(0),
+	viewportSet(false),
+	presents(0),
+	printedErrors(0)
+{
+	backBuffer = RetagHandle<RenderTexture>(textures.Add({ { width, height, RENDER_FORMAT_RGBA8, RENDER_TEXTURE_TARGET }, BufferHandle() }));
+	depthBuffer = RetagHandle<RenderTexture>(textures.Add({ { width, height, RENDER_FORMAT_DEPTH24_STENCIL8, RENDER_TEXTURE_DEPTH }, BufferHandle() }));
+
+	// Start where Graphics::Initialize() leaves a device
+	targets[0] = backBuffer;
+	targetCount = 1;
+	depth = depthBuffer;
+	viewportSet = true;
+}
+
+// --------------------------------------------------------
+// Counts every error, prints the first few
+// --------------------------------------------------------
+void NullBackend::Fail(const char* format, ...)
+{
+	stats.errors++;
+	if (printedErrors >= NULL_BACKEND_MAX_PRINTED_ERRORS)
+		return;
+	printedErrors++;
+
+	printf("Null backend: ");
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	printf(printedErrors == NULL_BACKEND_MAX_PRINTED_ERRORS ? "\n(further errors are only counted)\n" : "\n");
+}
+
+NullBackend::Buffer* NullBackend::GetBuffer(BufferHandle buffer, const char* call)
+{
+	Buffer* b = buffers.Get(RetagHandle<Buffer>(buffer));
+	if (!b)
+		Fail("%s: %s buffer handle", call, buffer.IsNull() ? "null" : "stale");
+	return b;
+}
+
+NullBackend::Texture* NullBackend::GetTexture(TextureHandle texture, const char* call)
+{
+	Texture* t = textures.Get(RetagHandle<Texture>(texture));
+	if (!t)
+		Fail("%s: %s texture handle", call, texture.IsNull() ? "null" : "stale");
+	return t;
+}
+
+// --------------------------------------------------------
+// Buffers
+// --------------------------------------------------------
+BufferHandle NullBackend::CreateBuffer(RenderBufferDesc desc, const void* initialData)
+{
+	if (desc.size == 0)
+	{
+		Fail("CreateBuffer: zero size");
+		return BufferHandle();
+	}
+
+	switch (desc.type)
+	{
+	case RENDER_BUFFER_VERTEX:
+	case RENDER_BUFFER_INDEX:
+		break;
+	case RENDER_BUFFER_CONSTANT:
+		if (desc.size % 16 != 0 || desc.size > RENDER_MAX_CONSTANT_BYTES)
+		{
+			Fail("CreateBuffer: constant buffers are multiples of 16 bytes up to %u (asked for %u)", RENDER_MAX_CONSTANT_BYTES, desc.size);
+			return BufferHandle();
+		}
+		break;
+	case RENDER_BUFFER_STRUCTURED:
+		if (desc.stride == 0 || desc.size % desc.stride != 0)
+		{
+			Fail("CreateBuffer: structured buffer of %u bytes with a stride of %u", desc.size, desc.stride);
+			return BufferHandle();
+		}
+		break;
+	default:
+		Fail("CreateBuffer: unknown buffer type %d", desc.type);
+		return BufferHandle();
+	}
+
+	if (!desc.dynamic && !initialData)
+	{
+		Fail("CreateBuffer: immutable buffer with no data");
+		return BufferHandle();
+	}
+
+	if (initialData)
+	{
+		stats.uploads++;
+		stats.uploadBytes += desc.size;
+	}
+	return RetagHandle<RenderBuffer>(buffers.Add({ desc }));
+}
+
+TextureHandle NullBackend::CreateBufferView(BufferHandle buffer)
+{
+	Buffer* b = GetBuffer(buffer, "CreateBufferView");
+	if (!b)
+		return TextureHandle();
+	if (b->desc.type != RENDER_BUFFER_STRUCTURED)
+	{
+		Fail("CreateBufferView: only structured buffers have views");
+		return TextureHandle();
+	}
+
+	RenderTextureDesc desc = { b->desc.size / b->desc.stride, 1, RENDER_FORMAT_UNKNOWN, RENDER_TEXTURE_SHADER };
+	return RetagHandle<RenderTexture>(textures.Add({ desc, buffer }));
+}
+
+bool NullBackend::UpdateBuffer(BufferHandle buffer, const void* data, size_t bytes)
+{
+	Buffer* b = GetBuffer(buffer, "UpdateBuffer");
+	if (!b)
+		return false;
+	if (!b->desc.dynamic)
+	{
+		Fail("UpdateBuffer: buffer is immutable");
+		return false;
+	}
+	if (bytes > b->desc.size)
+	{
+		Fail("UpdateBuffer: %zu bytes into a %u byte buffer", bytes, b->desc.size);
+		return false;
+	}
+	if (bytes > 0 && !data)
+	{
+		Fail("UpdateBuffer: no data");
+		return false;
+	}
+
+	stats.uploads++;
+	stats.uploadBytes += bytes;
+	return true;
+}
+
+void NullBackend::DestroyBuffer(BufferHandle buffer)
+{
+	if (buffer.IsNull())
+		return;
+	if (!buffers.Remove(RetagHandle<Buffer>(buffer)))
+		Fail("DestroyBuffer: stale handle (destroyed twice?)");
+}
+
+// --------------------------------------------------------
+// Textures
+// --------------------------------------------------------
+TextureHandle NullBackend::CreateTexture(RenderTextureDesc desc)
+{
+	if (desc.width == 0 || desc.height == 0)
+	{
+		Fail("CreateTexture: %ux%u texture", desc.width, desc.height);
+		return TextureHandle();
+	}
+	if (RenderFormatBytes(desc.format) == 0)
+	{
+		Fail("CreateTexture: unknown format %d", desc.format);
+		return TextureHandle();
+	}
+	if (desc.flags == 0)
+	{
+		Fail("CreateTexture: texture can't be bound as anything");
+		return TextureHandle();
+	}
+	if ((desc.flags & RENDER_TEXTURE_DEPTH) && !IsDepthFormat(desc.format))
+	{
+		Fail("CreateTexture: depth texture without a depth format");
+		return TextureHandle();
+	}
+	if ((desc.flags & RENDER_TEXTURE_TARGET) && IsDepthFormat(desc.format))
+	{
+		Fail("CreateTexture: render target with a depth format");
+		return TextureHandle();
+	}
+
+	return RetagHandle<RenderTexture>(textures.Add({ desc, BufferHandle() }));
+}
+
+TextureHandle NullBackend::LoadTexture(const std::wstring& path)
+{
+	// Nothing is read; the image is assumed to be there
+	if (path.empty())
+	{
+		Fail("LoadTexture: no path");
+		return TextureHandle();
+	}
+
+	stats.uploads++;
+	return RetagHandle<RenderTexture>(textures.Add({ { 1, 1, RENDER_FORMAT_RGBA8, RENDER_TEXTURE_SHADER }, BufferHandle() }));
+}
+
+TextureHandle NullBackend::LoadCubemap(const std::wstring paths[6])
+{
+	for (int face = 0; face < 6; face++)
+	{
+		if (paths[face].empty())
+		{
+			Fail("LoadCubemap: no path for face %d", face);
+			return TextureHandle();
+		}
+	}
+
+	stats.uploads++;
+	return RetagHandle<RenderTexture>(textures.Add({ { 1, 1, RENDER_FORMAT_RGBA8, RENDER_TEXTURE_SHADER }, BufferHandle() }));
+}
+
+void NullBackend::DestroyTexture(TextureHandle texture)
+{
+	if (texture.IsNull())
+		return;
+	if (texture == backBuffer || texture == depthBuffer)
+	{
+		Fail("DestroyTexture: the back and depth buffers belong to the backend");
+		return;
+	}
+	if (!textures.Remove(RetagHandle<Texture>(texture)))
+		Fail("DestroyTexture: stale handle (destroyed twice?)");
+}
+
+TextureHandle NullBackend::GetBackBuffer() { return backBuffer; }
+TextureHandle NullBackend::GetDepthBuffer() { return depthBuffer; }
+
+// --------------------------------------------------------
+// Shaders and samplers
+// --------------------------------------------------------
+ShaderHandle NullBackend::LoadVertexShader(const std::wstring& path, int input)
+{
+	if (path.empty())
+	{
+		Fail("LoadVertexShader: no path");
+		return ShaderHandle();
+	}
+	if (input != RENDER_INPUT_NONE && input != RENDER_INPUT_VERTEX)
+	{
+		Fail("LoadVertexShader: unknown input %d", input);
+		return ShaderHandle();
+	}
+	return RetagHandle<RenderShader>(shaders.Add({ RENDER_STAGE_VERTEX, input }));
+}
+
+ShaderHandle NullBackend::LoadPixelShader(const std::wstring& path)
+{
+	if (path.empty())
+	{
+		Fail("LoadPixelShader: no path");
+		return ShaderHandle();
+	}
+	return RetagHandle<RenderShader>(shaders.Add({ RENDER_STAGE_PIXEL, RENDER_INPUT_NONE }));
+}
+
+SamplerHandle NullBackend::CreateSampler(int kind)
+{
+	if (kind < 0 || kind >= RENDER_SAMPLER_KINDS)
+	{
+		Fail("CreateSampler: unknown kind %d", kind);
+		return SamplerHandle();
+	}
+	return RetagHandle<RenderSampler>(samplers.Add({ kind }));
+}
+
+// --------------------------------------------------------
+// State target
+// --------------------------------------------------------
+void NullBackend::SetVertexShader(ShaderHandle vs)
+{
+	stats.binds++;
+	this->vs = vs;
+	if (vs.IsNull())
+		return;
+
+	Shader* shader = shaders.Get(RetagHandle<Shader>(vs));
+	if (!shader)
+		Fail("SetVertexShader: stale shader handle");
+	else if (shader->stage != RENDER_STAGE_VERTEX)
+		Fail("SetVertexShader: pixel shader bound as a vertex shader");
+}
+
+void NullBackend::SetPixelShader(ShaderHandle ps)
+{
+	stats.binds++;
+	this->ps = ps;
+	if (ps.IsNull())
+		return;
+
+	Shader* shader = shaders.Get(RetagHandle<Shader>(ps));
+	if (!shader)
+		Fail("SetPixelShader: stale shader handle");
+	else if (shader->stage != RENDER_STAGE_PIXEL)
+		Fail("SetPixelShader: vertex shader bound as a pixel shader");
+}
+
+void NullBackend::SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures)
+{
+	stats.binds++;
+	if (startSlot + count > RENDER_MAX_SHADER_RESOURCES)
+	{
+		Fail("SetPixelShaderResources: slots %u to %u are past the last slot", startSlot, startSlot + count - 1);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		psResources[startSlot + i] = textures[i];
+		if (textures[i].IsNull())
+			continue;
+
+		Texture* t = GetTexture(textures[i], "SetPixelShaderResources");
+		if (t && !(t->desc.flags & RENDER_TEXTURE_SHADER))
+			Fail("SetPixelShaderResources: texture in slot %u can't be read by shaders", startSlot + i);
+	}
+	if (startSlot + count > psResourceEnd)
+		psResourceEnd = startSlot + count;
+}
+
+void NullBackend::SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers)
+{
+	stats.binds++;
+	if (startSlot + count > RENDER_MAX_SAMPLERS)
+	{
+		Fail("SetPixelSamplers: slots %u to %u are past the last slot", startSlot, startSlot + count - 1);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+		if (!samplers[i].IsNull() && !this->samplers.IsValid(RetagHandle<Sampler>(samplers[i])))
+			Fail("SetPixelSamplers: stale sampler handle in slot %u", startSlot + i);
+}
+
+void NullBackend::SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	stats.binds++;
+	vertexBuffer = buffer;
+	vertexStride = stride;
+	vertexOffset = offset;
+	if (buffer.IsNull())
+		return;
+
+	Buffer* b = GetBuffer(buffer, "SetVertexBuffer");
+	if (b && b->desc.type != RENDER_BUFFER_VERTEX)
+		Fail("SetVertexBuffer: not a vertex buffer");
+	if (stride == 0)
+		Fail("SetVertexBuffer: zero stride");
+}
+
+void NullBackend::SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset)
+{
+	stats.binds++;
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	if (buffer.IsNull())
+		return;
+
+	Buffer* b = GetBuffer(buffer, "SetIndexBuffer");
+	if (b && b->desc.type != RENDER_BUFFER_INDEX)
+		Fail("SetIndexBuffer: not an index buffer");
+	if (format != RENDER_INDEX_16 && format != RENDER_INDEX_32)
+		Fail("SetIndexBuffer: unknown index format %d", format);
+}
+
+// --------------------------------------------------------
+// Targets
+// --------------------------------------------------------
+void NullBackend::SetRenderTargets(unsigned int count, const TextureHandle* targets, TextureHandle depth)
+{
+	stats.binds++;
+	if (count > RENDER_MAX_TARGETS)
+	{
+		Fail("SetRenderTargets: %u targets (at most %u)", count, RENDER_MAX_TARGETS);
+		return;
+	}
+
+	// Everything bound has to be the same size
+	const Texture* first = nullptr;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		this->targets[i] = targets[i];
+		if (targets[i].IsNull())
+			continue;
+
+		Texture* t = GetTexture(targets[i], "SetRenderTargets");
+		if (!t)
+			continue;
+		if (!(t->desc.flags & RENDER_TEXTURE_TARGET))
+			Fail("SetRenderTargets: texture %u isn't a render target", i);
+		else if (first && !SameSize(first->desc, t->desc))
+			Fail("SetRenderTargets: targets of different sizes");
+		else if (!first)
+			first = t;
+	}
+	targetCount = count;
+
+	this->depth = depth;
+	if (depth.IsNull())
+		return;
+
+	Texture* d = GetTexture(depth, "SetRenderTargets");
+	if (!d)
+		return;
+	if (!(d->desc.flags & RENDER_TEXTURE_DEPTH))
+		Fail("SetRenderTargets: depth texture isn't a depth buffer");
+	else if (first && !SameSize(first->desc, d->desc))
+		Fail("SetRenderTargets: depth buffer is %ux%u, targets are %ux%u", d->desc.width, d->desc.height, first->desc.width, first->desc.height);
+}
+
+void NullBackend::ClearRenderTarget(TextureHandle target, const float color[4])
+{
+	Texture* t = GetTexture(target, "ClearRenderTarget");
+	if (t && !(t->desc.flags & RENDER_TEXTURE_TARGET))
+		Fail("ClearRenderTarget: not a render target");
+}
+
+void NullBackend::ClearDepth(TextureHandle depth, float value)
+{
+	Texture* t = GetTexture(depth, "ClearDepth");
+	if (t && !(t->desc.flags & RENDER_TEXTURE_DEPTH))
+		Fail("ClearDepth: not a depth buffer");
+	if (value < 0.0f || value > 1.0f)
+		Fail("ClearDepth: depth %f outside 0 to 1", value);
+}
+
+void NullBackend::SetViewport(unsigned int width, unsigned int height)
+{
+	if (width == 0 || height == 0)
+	{
+		Fail("SetViewport: %ux%u viewport", width, height);
+		return;
+	}
+	viewportSet = true;
+}
+
+// --------------------------------------------------------
+// Fixed function state
+// --------------------------------------------------------
+void NullBackend::SetBlendMode(int mode)
+{
+	if (mode < 0 || mode >= RENDER_BLEND_MODES)
+		Fail("SetBlendMode: unknown mode %d", mode);
+}
+
+void NullBackend::SetDepthMode(int mode)
+{
+	if (mode < 0 || mode >= RENDER_DEPTH_MODES)
+		Fail("SetDepthMode: unknown mode %d", mode);
+}
+
+void NullBackend::SetRasterMode(int mode)
+{
+	if (mode < 0 || mode >= RENDER_RASTER_MODES)
+		Fail("SetRasterMode: unknown mode %d", mode);
+}
+
+// --------------------------------------------------------
+// Resources outside the state cache
+// --------------------------------------------------------
+void NullBackend::SetVertexShaderResource(unsigned int slot, TextureHandle texture)
+{
+	stats.binds++;
+	if (slot >= RENDER_MAX_SHADER_RESOURCES)
+	{
+		Fail("SetVertexShaderResource: slot %u is past the last slot", slot);
+		return;
+	}
+	if (texture.IsNull())
+		return;
+
+	Texture* t = GetTexture(texture, "SetVertexShaderResource");
+	if (t && !(t->desc.flags & RENDER_TEXTURE_SHADER))
+		Fail("SetVertexShaderResource: texture can't be read by shaders");
+}
+
+void NullBackend::SetConstantBuffer(int stage, unsigned int slot, BufferHandle buffer)
+{
+	stats.binds++;
+	if (stage != RENDER_STAGE_VERTEX && stage != RENDER_STAGE_PIXEL)
+		Fail("SetConstantBuffer: unknown stage %d", stage);
+	if (slot >= RENDER_MAX_CONSTANT_BUFFERS)
+		Fail("SetConstantBuffer: slot %u is past the last slot", slot);
+
+	Buffer* b = GetBuffer(buffer, "SetConstantBuffer");
+	if (b && b->desc.type != RENDER_BUFFER_CONSTANT)
+		Fail("SetConstantBuffer: not a constant buffer");
+}
+
+void NullBackend::SetConstants(int stage, unsigned int slot, const void* data, unsigned int size)
+{
+	stats.binds++;
+	if (stage != RENDER_STAGE_VERTEX && stage != RENDER_STAGE_PIXEL)
+		Fail("SetConstants: unknown stage %d", stage);
+	if (slot >= RENDER_MAX_CONSTANT_BUFFERS)
+		Fail("SetConstants: slot %u is past the last slot", slot);
+	if (!data || size == 0 || size > RENDER_MAX_CONSTANT_BYTES)
+	{
+		Fail("SetConstants: %u bytes", data ? size : 0);
+		return;
+	}
+
+	stats.uploads++;
+	stats.uploadBytes += size;
+}
+
+// --------------------------------------------------------
+// Drawing
+// --------------------------------------------------------
+bool NullBackend::CheckDraw(const char* call)
+{
+	Shader* shader = vs.IsNull() ? nullptr : shaders.Get(RetagHandle<Shader>(vs));
+	if (!shader)
+	{
+		Fail("%s: no vertex shader bound", call);
+		return false;
+	}
+	if (!ps.IsNull() && !shaders.IsValid(RetagHandle<Shader>(ps)))
+	{
+		Fail("%s: stale pixel shader", call);
+		return false;
+	}
+	if (shader->input == RENDER_INPUT_VERTEX && (vertexBuffer.IsNull() || !buffers.IsValid(RetagHandle<Buffer>(vertexBuffer))))
+	{
+		Fail("%s: the vertex shader reads vertices but no vertex buffer is bound", call);
+		return false;
+	}
+
+	bool anyTarget = !depth.IsNull();
+	for (unsigned int i = 0; i < targetCount; i++)
+		anyTarget = anyTarget || !targets[i].IsNull();
+	if (!anyTarget || !viewportSet)
+	{
+		Fail("%s: nothing to draw to", call);
+		return false;
+	}
+
+	// Reading what's being written
+	for (unsigned int slot = 0; slot < psResourceEnd; slot++)
+	{
+		TextureHandle resource = psResources[slot];
+		if (resource.IsNull())
+			continue;
+
+		bool written = resource == depth;
+		for (unsigned int i = 0; i < targetCount; i++)
+			written = written || resource == targets[i];
+		if (written)
+		{
+			Fail("%s: pixel shader resource %u is also bound as a target", call, slot);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool NullBackend::CheckIndices(const char* call, unsigned int indexCount, unsigned int startIndex)
+{
+	Buffer* b = indexBuffer.IsNull() ? nullptr : buffers.Get(RetagHandle<Buffer>(indexBuffer));
+	if (!b)
+	{
+		Fail("%s: no index buffer bound", call);
+		return false;
+	}
+
+	size_t indexBytes = indexFormat == RENDER_INDEX_16 ? 2 : 4;
+	size_t end = indexOffset + ((size_t)startIndex + indexCount) * indexBytes;
+	if (end > b->desc.size)
+	{
+		Fail("%s: indices %u to %u run past the %u byte index buffer", call, startIndex, startIndex + indexCount, b->desc.size);
+		return false;
+	}
+	return true;
+}
+
+void NullBackend::Draw(unsigned int vertexCount)
+{
+	stats.draws++;
+	if (!CheckDraw("Draw"))
+		return;
+
+	Shader* shader = shaders.Get(RetagHandle<Shader>(vs));
+	if (shader->input == RENDER_INPUT_VERTEX)
+	{
+		Buffer* b = buffers.Get(RetagHandle<Buffer>(vertexBuffer));
+		if (vertexOffset + (size_t)vertexCount * vertexStride > b->desc.size)
+			Fail("Draw: %u vertices run past the %u byte vertex buffer", vertexCount, b->desc.size);
+	}
+}
+
+void NullBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	stats.draws++;
+	if (CheckDraw("DrawIndexed"))
+		CheckIndices("DrawIndexed", indexCount, startIndex);
+}
+
+void NullBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex)
+{
+	stats.draws++;
+	if (CheckDraw("DrawIndexedInstanced"))
+		CheckIndices("DrawIndexedInstanced", indexCount, startIndex);
+}
+
+void NullBackend::Present()
+{
+	presents++;
+}
+
+// --------------------------------------------------------
+// ImGui renderer hooks: font atlas pages become textures in
+// the backend, and every draw command is checked against them
+// --------------------------------------------------------
+void NullBackend::InitUI()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	io.BackendRendererName = "null";
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+}
+
+void NullBackend::NewUIFrame()
+{
+}
+
+void NullBackend::RenderUI(ImDrawData* drawData)
+{
+	if (drawData->Textures)
+	{
+		for (ImTextureData* tex : *drawData->Textures)
+		{
+			if (tex->Status == ImTextureStatus_WantCreate)
+			{
+				RenderTextureDesc desc = { (unsigned int)tex->Width, (unsigned int)tex->Height, RENDER_FORMAT_RGBA8, RENDER_TEXTURE_SHADER };
+				TextureHandle texture = CreateTexture(desc);
+				stats.uploads++;
+				stats.uploadBytes += tex->GetSizeInBytes();
+				tex->SetTexID((ImTextureID)texture.value);
+				tex->SetStatus(ImTextureStatus_OK);
+			}
+			else if (tex->Status == ImTextureStatus_WantUpdates)
+			{
+				for (ImTextureRect& r : tex->Updates)
+				{
+					stats.uploads++;
+					stats.uploadBytes += (size_t)r.w * r.h * tex->BytesPerPixel;
+				}
+				tex->SetStatus(ImTextureStatus_OK);
+			}
+
+			if (tex->Status == ImTextureStatus_WantDestroy && tex->UnusedFrames > 0)
+			{
+				TextureHandle texture;
+				texture.value = (unsigned int)tex->TexID;
+				DestroyTexture(texture);
+				tex->SetTexID(ImTextureID_Invalid);
+				tex->SetStatus(ImTextureStatus_Destroyed);
+			}
+		}
+	}
+
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+	{
+		for (const ImDrawCmd& cmd : drawData->CmdLists[i]->CmdBuffer)
+		{
+			if (cmd.UserCallback)
+				continue;
+
+			TextureHandle texture;
+			texture.value = (unsigned int)cmd.GetTexID();
+			if (!textures.IsValid(RetagHandle<Texture>(texture)))
+				Fail("RenderUI: draw with a %s texture", texture.IsNull() ? "null" : "stale");
+			stats.draws++;
+		}
+	}
+}
+
+void NullBackend::ShutDownUI()
+{
+	for (ImTextureData* tex : ImGui::GetPlatformIO().Textures)
+	{
+		if (tex->RefCount == 1 && tex->TexID != ImTextureID_Invalid)
+		{
+			TextureHandle texture;
+			texture.value = (unsigned int)tex->TexID;
+			DestroyTexture(texture);
+			tex->SetTexID(ImTextureID_Invalid);
+			tex->SetStatus(ImTextureStatus_Destroyed);
+		}
+	}
+
+	ImGuiIO& io = ImGui::GetIO();
+	io.BackendRendererName = nullptr;
+	io.BackendFlags &= ~(ImGuiBackendFlags_RendererHasVtxOffset | ImGuiBackendFlags_RendererHasTextures);
+}
+
+void* NullBackend::GetUITexture(TextureHandle texture)
+{
+	Texture* t = GetTexture(texture, "GetUITexture");
+	if (!t)
+		return nullptr;
+	if (!(t->desc.flags & RENDER_TEXTURE_SHADER))
+	{
+		Fail("GetUITexture: texture can't be read by shaders");
+		return nullptr;
+	}
+
+	// The handle is the texture's ID (RenderUI() checks them)
+	return (void*)(uintptr_t)texture.value;
+}
+
+const char* NullBackend::GetName() { return "Null"; }
+
+// Getters
+unsigned int NullBackend::GetLiveBuffers() { return buffers.Size(); }
+unsigned int NullBackend::GetLiveTextures() { return textures.Size(); }
+unsigned int NullBackend::GetPresents() { return presents; }
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+// Errors printed before the null backend only counts them
+#define NULL_BACKEND_MAX_PRINTED_ERRORS 10
+
+// --------------------------------------------------------
+// A backend with no device behind it
+//
+// - Keeps the description of everything created and the
+//    state everything bound, and checks each call against
+//    them: stale handles, wrong buffer types and texture
+//    flags, updates to immutable buffers, draws with nothing
+//    to draw from or to, reading a texture that's also bound
+//    as a target
+// - Nothing is drawn, so a frame costs only the CPU side
+//    (Headless.cpp times frames on it)
+// --------------------------------------------------------
+class NullBackend : public RenderBackend
+{
+private:
+	struct Buffer
+	{
+		RenderBufferDesc desc;
+	};
+
+	struct Texture
+	{
+		RenderTextureDesc desc;
+		BufferHandle buffer;	// Structured buffer views only
+	};
+
+	struct Shader
+	{
+		int stage;
+		int input;
+	};
+
+	struct Sampler
+	{
+		int kind;
+	};
+
+	Pool<Buffer> buffers;
+	Pool<Texture> textures;
+	Pool<Shader> shaders;
+	Pool<Sampler> samplers;
+
+	TextureHandle backBuffer;
+	TextureHandle depthBuffer;
+
+	// What's bound
+	ShaderHandle vs;
+	ShaderHandle ps;
+	BufferHandle vertexBuffer;
+	unsigned int vertexStride;
+	unsigned int vertexOffset;
+	BufferHandle indexBuffer;
+	int indexFormat;
+	unsigned int indexOffset;
+	TextureHandle targets[RENDER_MAX_TARGETS];
+	unsigned int targetCount;
+	TextureHandle depth;
+	TextureHandle psResources[RENDER_MAX_SHADER_RESOURCES];
+	unsigned int psResourceEnd;		// One past the highest slot ever bound
+	bool viewportSet;
+
+	unsigned int presents;
+	unsigned int printedErrors;
+
+	void Fail(const char* format, ...);
+
+	// Null if the handle is stale (and reports it)
+	Buffer* GetBuffer(BufferHandle buffer, const char* call);
+	Texture* GetTexture(TextureHandle texture, const char* call);
+
+	bool CheckDraw(const char* call);
+	bool CheckIndices(const char* call, unsigned int indexCount, unsigned int startIndex);
+
+public:
+	NullBackend(unsigned int width, unsigned int height);
+
+	BufferHandle CreateBuffer(RenderBufferDesc desc, const void* initialData) override;
+	TextureHandle CreateBufferView(BufferHandle buffer) override;
+	bool UpdateBuffer(BufferHandle buffer, const void* data, size_t bytes) override;
+	void DestroyBuffer(BufferHandle buffer) override;
+
+	TextureHandle CreateTexture(RenderTextureDesc desc) override;
+	TextureHandle LoadTexture(const std::wstring& path) override;
+	TextureHandle LoadCubemap(const std::wstring paths[6]) override;
+	void DestroyTexture(TextureHandle texture) override;
+	TextureHandle GetBackBuffer() override;
+	TextureHandle GetDepthBuffer() override;
+
+	ShaderHandle LoadVertexShader(const std::wstring& path, int input) override;
+	ShaderHandle LoadPixelShader(const std::wstring& path) override;
+	SamplerHandle CreateSampler(int kind) override;
+
+	void SetVertexShader(ShaderHandle vs) override;
+	void SetPixelShader(ShaderHandle ps) override;
+	void SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures) override;
+	void SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers) override;
+	void SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset) override;
+
+	void SetRenderTargets(unsigned int count, const TextureHandle* targets, TextureHandle depth) override;
+	void ClearRenderTarget(TextureHandle target, const float color[4]) override;
+	void ClearDepth(TextureHandle depth, float value) override;
+	void SetViewport(unsigned int width, unsigned int height) override;
+
+	void SetBlendMode(int mode) override;
+	void SetDepthMode(int mode) override;
+	void SetRasterMode(int mode) override;
+
+	void SetVertexShaderResource(unsigned int slot, TextureHandle texture) override;
+	void SetConstantBuffer(int stage, unsigned int slot, BufferHandle buffer) override;
+	void SetConstants(int stage, unsigned int slot, const void* data, unsigned int size) override;
+
+	void Draw(unsigned int vertexCount) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex) override;
+	void Present() override;
+
+	void InitUI() override;
+	void NewUIFrame() override;
+	void RenderUI(ImDrawData* drawData) override;
+	void ShutDownUI() override;
+	void* GetUITexture(TextureHandle texture) override;
+
+	const char* GetName() override;
+
+	// Getters
+	unsigned int GetLiveBuffers();
+	unsigned int GetLiveTextures();
+	unsigned int GetPresents();
+};
@@ -0,0 +1,299 @@
+#include "ObjectLights.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Ranked ahead of: a stronger light, or the lower index on a tie
+	inline bool Stronger(float score, unsigned int light, float otherScore, unsigned int otherLight)
+	{
+		return score > otherScore || (score == otherScore && light < otherLight);
+	}
+}
+
+ObjectLightSelector::ObjectLightSelector() :
+	gridMin(0, 0, 0),
+	cellSize(1.0f),
+	gridSize{ 1, 1, 1 },
+	stats{},
+	lightCapacity(0),
+	listCapacity(0)
+{
+}
+
+void ObjectLightSelector::Select(
+	const std::function<AABB(unsigned int object)>& getBounds,
+	unsigned int objectCount,
+	const Light* lights,
+	unsigned int lightCount,
+	bool parallel)
+{
+	stats = {};
+	stats.objects = objectCount;
+
+	auto start = Clock::now();
+	BuildGrid(lights, lightCount);
+	stats.gridMs = ElapsedMs(start);
+
+	// Each batch writes only its own objects' lists and counts
+	start = Clock::now();
+	lists.resize(objectCount);
+	unsigned int batchCount = (objectCount + OBJECT_LIGHTS_BATCH - 1) / OBJECT_LIGHTS_BATCH;
+	std::vector<unsigned int> batchCounts(batchCount * 4, 0);
+	auto selectBatch = [&](unsigned int batch)
+	{
+		unsigned int* counts = &batchCounts[batch * 4];
+		unsigned int end = std::min((batch + 1) * OBJECT_LIGHTS_BATCH, objectCount);
+		for (unsigned int i = batch * OBJECT_LIGHTS_BATCH; i < end; i++)
+		{
+			unsigned int touching = 0;
+			SelectObject(getBounds(i), &lists[i], &counts[0], &touching);
+			counts[1] += touching;
+			counts[2] += lists[i].count;
+			counts[3] += touching > OBJECT_LIGHTS_MAX;
+		}
+	};
+
+	if (parallel && batchCount > 1)
+	{
+		std::vector<unsigned int> batches(batchCount);
+		std::iota(batches.begin(), batches.end(), 0);
+		std::for_each(std::execution::par, batches.begin(), batches.end(), selectBatch);
+	}
+	else
+	{
+		for (unsigned int batch = 0; batch < batchCount; batch++)
+			selectBatch(batch);
+	}
+
+	for (unsigned int batch = 0; batch < batchCount; batch++)
+	{
+		stats.candidates += batchCounts[batch * 4];
+		stats.touching += batchCounts[batch * 4 + 1];
+		stats.kept += batchCounts[batch * 4 + 2];
+		stats.cappedObjects += batchCounts[batch * 4 + 3];
+	}
+	stats.selectMs = ElapsedMs(start);
+}
+
+void ObjectLightSelector::BuildGrid(const Light* lights, unsigned int lightCount)
+{
+	// Point and spot lights, and the box around all of them
+	lightInfos.clear();
+	lightIndices.clear();
+	AABB bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	float radiusSum = 0.0f;
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		LightInfo info;
+		if (!MakeInfo(lights[i], &info))
+			continue;
+
+		bounds = Bounds::Merge(bounds, Bounds::FromCenterExtents(info.center, XMFLOAT3(info.radius, info.radius, info.radius)));
+		radiusSum += info.radius;
+		lightInfos.push_back(info);
+		lightIndices.push_back(i);
+	}
+
+	unsigned int infoCount = (unsigned int)lightInfos.size();
+	stats.lights = infoCount;
+	if (infoCount == 0)
+	{
+		gridSize[0] = gridSize[1] = gridSize[2] = 1;
+		cellStarts.assign(2, 0);
+		cellLights.clear();
+		stats.gridCells = 1;
+		return;
+	}
+
+	// Cells about a light's radius across (small objects then
+	// test few lights they can't reach), bigger if there'd be too many
+	gridMin = bounds.min;
+	XMFLOAT3 extent(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z);
+	cellSize = std::max(radiusSum / infoCount, 0.001f);
+	while (true)
+	{
+		gridSize[0] = std::max((int)ceilf(extent.x / cellSize), 1);
+		gridSize[1] = std::max((int)ceilf(extent.y / cellSize), 1);
+		gridSize[2] = std::max((int)ceilf(extent.z / cellSize), 1);
+		if ((size_t)gridSize[0] * gridSize[1] * gridSize[2] <= OBJECT_LIGHTS_MAX_CELLS)
+			break;
+		cellSize *= 1.25f;
+	}
+	unsigned int cellCount = gridSize[0] * gridSize[1] * gridSize[2];
+	stats.gridCells = cellCount;
+
+	// Count, offset, then fill (in light order, so each
+	// cell's list is ascending)
+	cellStarts.assign(cellCount + 1, 0);
+	for (LightInfo& info : lightInfos)
+	{
+		CellRange(Bounds::FromCenterExtents(info.center, XMFLOAT3(info.radius, info.radius, info.radius)), info.minCell, info.maxCell);
+		for (int z = info.minCell[2]; z <= info.maxCell[2]; z++)
+			for (int y = info.minCell[1]; y <= info.maxCell[1]; y++)
+				for (int x = info.minCell[0]; x <= info.maxCell[0]; x++)
+					cellStarts[(z * gridSize[1] + y) * gridSize[0] + x + 1]++;
+	}
+	for (unsigned int c = 0; c < cellCount; c++)
+		cellStarts[c + 1] += cellStarts[c];
+
+	cellLights.resize(cellStarts[cellCount]);
+	stats.gridReferences = cellStarts[cellCount];
+	std::vector<unsigned int> cursor(cellStarts.begin(), cellStarts.end() - 1);
+	for (unsigned int l = 0; l < infoCount; l++)
+	{
+		const LightInfo& info = lightInfos[l];
+		CellLight entry = {};
+		entry.center = info.center;
+		entry.radiusSq = info.radius * info.radius;
+		entry.info = l;
+		for (int axis = 0; axis < 3; axis++)
+			entry.minCell[axis] = (unsigned short)info.minCell[axis];
+
+		for (int z = info.minCell[2]; z <= info.maxCell[2]; z++)
+			for (int y = info.minCell[1]; y <= info.maxCell[1]; y++)
+				for (int x = info.minCell[0]; x <= info.maxCell[0]; x++)
+					cellLights[cursor[(z * gridSize[1] + y) * gridSize[0] + x]++] = entry;
+	}
+}
+
+bool ObjectLightSelector::CellRange(const AABB& box, int* minCell, int* maxCell)
+{
+	const float* boxMin = &box.min.x;
+	const float* boxMax = &box.max.x;
+	const float* origin = &gridMin.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float low = (boxMin[axis] - origin[axis]) / cellSize;
+		float high = (boxMax[axis] - origin[axis]) / cellSize;
+		if (high < 0.0f || low >= (float)gridSize[axis])
+			return false;
+		minCell[axis] = std::clamp((int)floorf(low), 0, gridSize[axis] - 1);
+		maxCell[axis] = std::clamp((int)floorf(high), 0, gridSize[axis] - 1);
+	}
+	return true;
+}
+
+void ObjectLightSelector::SelectObject(const AABB& box, ObjectLightList* list, unsigned int* candidates, unsigned int* touching)
+{
+	list->count = 0;
+	int minCell[3], maxCell[3];
+	if (lightInfos.empty() || !CellRange(box, minCell, maxCell))
+		return;
+
+	XMFLOAT3 boxCenter = Bounds::GetCenter(box);
+	XMFLOAT3 extents = Bounds::GetExtents(box);
+	float boxRadius = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+
+	// Kept lights, strongest first
+	float scores[OBJECT_LIGHTS_MAX];
+	unsigned int kept = 0;
+	for (int z = minCell[2]; z <= maxCell[2]; z++)
+	{
+		for (int y = minCell[1]; y <= maxCell[1]; y++)
+		{
+			for (int x = minCell[0]; x <= maxCell[0]; x++)
+			{
+				unsigned int cell = (z * gridSize[1] + y) * gridSize[0] + x;
+				*candidates += cellStarts[cell + 1] - cellStarts[cell];
+				for (unsigned int c = cellStarts[cell]; c < cellStarts[cell + 1]; c++)
+				{
+					// Sphere against box first, from the entry alone
+					const CellLight& entry = cellLights[c];
+					if (Bounds::DistanceSq(entry.center, box) > entry.radiusSq)
+						continue;
+
+					// Only in the first cell the light and the box share
+					if (x != std::max(minCell[0], (int)entry.minCell[0]) ||
+						y != std::max(minCell[1], (int)entry.minCell[1]) ||
+						z != std::max(minCell[2], (int)entry.minCell[2]))
+						continue;
+
+					const LightInfo& info = lightInfos[entry.info];
+					float score = Score(info, box, boxCenter, boxRadius);
+					if (score < 0.0f)
+						continue;
+					(*touching)++;
+
+					// Insert into the ranked list (the weakest falls off the end)
+					unsigned int light = lightIndices[entry.info];
+					if (kept == OBJECT_LIGHTS_MAX && !Stronger(score, light, scores[kept - 1], list->lights[kept - 1]))
+						continue;
+					unsigned int slot = std::min(kept, (unsigned int)OBJECT_LIGHTS_MAX - 1);
+					while (slot > 0 && Stronger(score, light, scores[slot - 1], list->lights[slot - 1]))
+					{
+						scores[slot] = scores[slot - 1];
+						list->lights[slot] = list->lights[slot - 1];
+						slot--;
+					}
+					scores[slot] = score;
+					list->lights[slot] = light;
+					kept = std::min(kept + 1, (unsigned int)OBJECT_LIGHTS_MAX);
+				}
+			}
+		}
+	}
+	list->count = kept;
+}
+
+bool ObjectLightSelector::MakeInfo(const Light& light, LightInfo* info)
+{
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL || light.Range <= 0.0f)
+		return false;
+
+	*info = {};
+	info->center = light.Position;
+	info->radius = light.Range;
+	info->strength = light.Intensity * std::max(std::max(light.Color.x, light.Color.y), light.Color.z);
+
+	// Cones past a hemisphere are treated as points
+	info->spot = light.Type == LIGHT_TYPE_SPOT && light.SpotOuterAngle < XM_PIDIV2;
+	if (info->spot)
+	{
+		XMStoreFloat3(&info->direction, XMVector3Normalize(XMLoadFloat3(&light.Direction)));
+		info->cosAngle = cosf(light.SpotOuterAngle);
+		info->sinAngle = sinf(light.SpotOuterAngle);
+	}
+	return true;
+}
+
+float ObjectLightSelector::Score(const LightInfo& light, const AABB& box, const XMFLOAT3& boxCenter, float boxRadius)
+{
+	float distanceSq = Bounds::DistanceSq(light.center, box);
+	float radiusSq = light.radius * light.radius;
+	if (distanceSq > radiusSq)
+		return -1.0f;
+
+	// Spots: the cone against the sphere around the box
+	if (light.spot && !Bounds::ConeOverlapsSphere(light.center, light.direction, light.cosAngle, light.sinAngle, light.radius, boxCenter, boxRadius))
+		return -1.0f;
+
+	float falloff = 1.0f - distanceSq / radiusSq;
+	return light.strength * falloff * falloff;
+}
+
+float ObjectLightSelector::EstimateContribution(const Light& light, const AABB& box)
+{
+	LightInfo info;
+	if (!MakeInfo(light, &info))
+		return 0.0f;
+
+	XMFLOAT3 extents = Bounds::GetExtents(box);
+	float boxRadius = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+	return std::max(Score(info, box, Bounds::GetCenter(box), boxRadius), 0.0f);
+}
+
+// Getters
+const std::vector<ObjectLightList>& ObjectLightSelector::GetLists() { return lists; }
+TextureHandle ObjectLightSelector::GetLightView() { return lightView; }
+TextureHandle ObjectLightSelector::GetListView() { return listView; }
+ObjectLightStats ObjectLightSelector::GetStats() { return stats; }
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <functional>
+#include <vector>
+
+#include "Bounds.h"
+#include "Lights.h"
+#include "RenderBackend.h"
+
+// Lights kept per object, strongest first (must match PixelShader.hlsl)
+#define OBJECT_LIGHTS_MAX 8
+
+// Objects selected per parallel task
+#define OBJECT_LIGHTS_BATCH 512
+
+// Most cells in the light grid (cells grow to stay under it)
+#define OBJECT_LIGHTS_MAX_CELLS 32768
+
+// One object's lights, as indices into the light array
+// (a structured buffer element on the GPU)
+struct ObjectLightList
+{
+	unsigned int count;
+	unsigned int lights[OBJECT_LIGHTS_MAX];
+};
+
+// What the last Select() did
+struct ObjectLightStats
+{
+	unsigned int objects;
+	unsigned int lights;				// Point and spot lights in the grid
+	unsigned int gridCells;
+	unsigned int gridReferences;		// Light entries over every cell
+	unsigned int candidates;			// Cell entries tested (a light can be in several of an object's cells)
+	unsigned int touching;				// Pairs that passed
+	unsigned int kept;
+	unsigned int cappedObjects;			// Touched by more than OBJECT_LIGHTS_MAX lights
+	double gridMs;
+	double selectMs;
+	double uploadMs;
+};
+
+// --------------------------------------------------------
+// Per object light lists for forward rendering
+//
+// - Point and spot lights go into a uniform grid over their
+//    bounds (cells about a light's radius across), one list
+//    of lights per cell
+// - Each object's world box looks up the cells it overlaps;
+//    a light shared by several of them is only tested in the
+//    first cell the light and the box have in common
+// - Lights whose sphere (and, for spots, cone) reaches the box
+//    are ranked by intensity times their falloff at the box's
+//    closest point, and the strongest OBJECT_LIGHTS_MAX kept
+// - Objects are independent, so they're split into batches
+//    that run in parallel
+// - Everything but Upload() runs without a device (Upload()
+//    is in ObjectLightsUpload.cpp, so the rest links alone)
+// --------------------------------------------------------
+class ObjectLightSelector
+{
+private:
+	// A light in world space, with the cells it covers
+	struct LightInfo
+	{
+		DirectX::XMFLOAT3 center;
+		float radius;
+		DirectX::XMFLOAT3 direction;	// Spots only
+		float cosAngle;
+		float sinAngle;
+		float strength;					// Intensity times brightest color channel
+		int minCell[3];
+		int maxCell[3];
+		bool spot;
+	};
+
+	// A light's entry in a cell, with what the sphere test needs
+	// so a cell's lights are read in order
+	struct CellLight
+	{
+		DirectX::XMFLOAT3 center;
+		float radiusSq;
+		unsigned int info;				// Into lightInfos
+		unsigned short minCell[3];		// The light's first cell on each axis
+	};
+
+	std::vector<LightInfo> lightInfos;
+	std::vector<unsigned int> lightIndices;		// Into the caller's light array, per light info
+
+	// Light grid: each cell's lights are cellLights[cellStarts[c]]
+	// up to cellStarts[c + 1]
+	DirectX::XMFLOAT3 gridMin;
+	float cellSize;
+	int gridSize[3];
+	std::vector<unsigned int> cellStarts;
+	std::vector<CellLight> cellLights;
+
+	std::vector<ObjectLightList> lists;
+	ObjectLightStats stats;
+
+	// GPU copies
+	BufferHandle lightBuffer;
+	TextureHandle lightView;
+	BufferHandle listBuffer;
+	TextureHandle listView;
+	unsigned int lightCapacity;
+	unsigned int listCapacity;
+
+	void BuildGrid(const Light* lights, unsigned int lightCount);
+	bool CellRange(const AABB& box, int* minCell, int* maxCell);		// False if the box misses the grid
+	void SelectObject(const AABB& box, ObjectLightList* list, unsigned int* candidates, unsigned int* touching);
+
+	// False for lights the grid skips (directional, or no range)
+	static bool MakeInfo(const Light& light, LightInfo* info);
+
+	// Intensity times the falloff PixelShader.hlsl uses, at the
+	// box's closest point; negative when the light can't reach it
+	// (the box's center and radius are shared by all its lights)
+	static float Score(const LightInfo& light, const AABB& box, const DirectX::XMFLOAT3& boxCenter, float boxRadius);
+
+public:
+	ObjectLightSelector();
+
+	// Fills one list per object from getBounds(object), its
+	// world space box
+	void Select(
+		const std::function<AABB(unsigned int object)>& getBounds,
+		unsigned int objectCount,
+		const Light* lights,
+		unsigned int lightCount,
+		bool parallel = true);
+
+	// Copies the lights and the lists to the GPU
+	bool Upload(const Light* lights, unsigned int lightCount);
+
+	// How much a light would add to a box (0 if it can't reach
+	// it); the score Select() ranks by
+	static float EstimateContribution(const Light& light, const AABB& box);
+
+	// Getters
+	const std::vector<ObjectLightList>& GetLists();
+	TextureHandle GetLightView();
+	TextureHandle GetListView();
+	ObjectLightStats GetStats();
+};
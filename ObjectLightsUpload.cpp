@@ -0,0 +1,49 @@
+#include "ObjectLights.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// --------------------------------------------------------
+// The backend side of the selector, kept apart so selection
+// builds and runs on its own (see Tests.cpp)
+// --------------------------------------------------------
+bool ObjectLightSelector::Upload(const Light* lights, unsigned int lightCount)
+{
+	auto start = Clock::now();
+	unsigned int listCount = (unsigned int)lists.size();
+
+	// Grow in big steps so a growing scene doesn't recreate them every frame
+	if (lightCount > lightCapacity || lightBuffer.IsNull())
+	{
+		unsigned int capacity = std::max(lightCapacity, 256u);
+		while (capacity < lightCount)
+			capacity *= 2;
+		lightCapacity = 0;
+		if (!Graphics::Backend->CreateStructuredBuffer(sizeof(Light), capacity, &lightBuffer, &lightView))
+		{
+			printf("Could not create the object light buffer (%u lights)\n", capacity);
+			return false;
+		}
+		lightCapacity = capacity;
+	}
+	if (listCount > listCapacity || listBuffer.IsNull())
+	{
+		unsigned int capacity = std::max(listCapacity, 1024u);
+		while (capacity < listCount)
+			capacity *= 2;
+		listCapacity = 0;
+		if (!Graphics::Backend->CreateStructuredBuffer(sizeof(ObjectLightList), capacity, &listBuffer, &listView))
+		{
+			printf("Could not create the object light list buffer (%u objects)\n", capacity);
+			return false;
+		}
+		listCapacity = capacity;
+	}
+
+	bool filled =
+		Graphics::Backend->UpdateBuffer(lightBuffer, lights, lightCount * sizeof(Light)) &&
+		Graphics::Backend->UpdateBuffer(listBuffer, lists.data(), listCount * sizeof(ObjectLightList));
+	stats.uploadMs = ElapsedMs(start);
+	return filled;
+}
@@ -0,0 +1,339 @@
+#include "Occlusion.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int TilesX = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+	const unsigned int TilesY = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+	const unsigned int BlocksX = OCCLUSION_WIDTH / OCCLUSION_BLOCK_SIZE;
+	const unsigned int BlocksY = OCCLUSION_HEIGHT / OCCLUSION_BLOCK_SIZE;
+
+	// Point where the edge a -> b crosses the near plane (clip z = 0)
+	XMFLOAT4 ClipToNear(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		float t = a.z / (a.z - b.z);
+		return XMFLOAT4(
+			a.x + (b.x - a.x) * t,
+			a.y + (b.y - a.y) * t,
+			0.0f,
+			a.w + (b.w - a.w) * t);
+	}
+}
+
+OcclusionCuller::OcclusionCuller() :
+	viewProjection{},
+	stats{}
+{
+	tileBins.resize(TilesX * TilesY);
+	depth.resize(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+	blockDepth.resize(BlocksX * BlocksY, 1.0f);
+	tileDepth.resize(TilesX * TilesY, 1.0f);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	triangles.clear();
+	for (auto& bin : tileBins)
+		bin.clear();
+	stats = {};
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, unsigned int positionCount, const unsigned int* indices, unsigned int indexCount, const XMFLOAT4X4& world)
+{
+	Clock::time_point start = Clock::now();
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+
+	// Each vertex is transformed once, however many triangles share it
+	clipPositions.resize(positionCount);
+	for (unsigned int i = 0; i < positionCount; i++)
+		XMStoreFloat4(&clipPositions[i], XMVector3Transform(XMLoadFloat3(&positions[i]), worldViewProjection));
+
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMFLOAT4 clip[3];
+		int inFront = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			clip[v] = clipPositions[indices[i + v]];
+			if (clip[v].z >= 0.0f)
+				inFront++;
+		}
+
+		if (inFront == 3)
+		{
+			AddTriangle(clip);
+			continue;
+		}
+		if (inFront == 0)
+			continue;
+
+		// Clip against the near plane: the part in front is a
+		// triangle or a quad, which is split into two
+		XMFLOAT4 polygon[4];
+		int polygonCount = 0;
+		for (int v = 0; v < 3; v++)
+		{
+			const XMFLOAT4& a = clip[v];
+			const XMFLOAT4& b = clip[(v + 1) % 3];
+			if (a.z >= 0.0f)
+				polygon[polygonCount++] = a;
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+				polygon[polygonCount++] = ClipToNear(a, b);
+		}
+
+		AddTriangle(polygon);
+		if (polygonCount == 4)
+		{
+			XMFLOAT4 second[3] = { polygon[0], polygon[2], polygon[3] };
+			AddTriangle(second);
+		}
+	}
+
+	stats.occluders++;
+	stats.setupMs += ElapsedMs(start);
+}
+
+void OcclusionCuller::AddTriangle(const XMFLOAT4* clip)
+{
+	ScreenTriangle tri;
+	for (int v = 0; v < 3; v++)
+	{
+		if (clip[v].w <= 0.0f)
+			return;
+
+		float invW = 1.0f / clip[v].w;
+		tri.x[v] = (clip[v].x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		tri.y[v] = (0.5f - clip[v].y * invW * 0.5f) * OCCLUSION_HEIGHT;
+		tri.z[v] = clip[v].z * invW;
+	}
+
+	// Front faces are clockwise on screen (y down), so back
+	// faces and slivers have no positive area
+	float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+	if (area <= 0.0f)
+		return;
+
+	float minX = std::max(std::min({ tri.x[0], tri.x[1], tri.x[2] }), 0.0f);
+	float maxX = std::min(std::max({ tri.x[0], tri.x[1], tri.x[2] }), (float)OCCLUSION_WIDTH - 1);
+	float minY = std::max(std::min({ tri.y[0], tri.y[1], tri.y[2] }), 0.0f);
+	float maxY = std::min(std::max({ tri.y[0], tri.y[1], tri.y[2] }), (float)OCCLUSION_HEIGHT - 1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	unsigned int index = (unsigned int)triangles.size();
+	triangles.push_back(tri);
+	stats.triangles++;
+
+	// Bin into every tile the bounding rectangle touches
+	unsigned int tileX0 = (unsigned int)minX / OCCLUSION_TILE_WIDTH;
+	unsigned int tileX1 = (unsigned int)maxX / OCCLUSION_TILE_WIDTH;
+	unsigned int tileY0 = (unsigned int)minY / OCCLUSION_TILE_HEIGHT;
+	unsigned int tileY1 = (unsigned int)maxY / OCCLUSION_TILE_HEIGHT;
+	for (unsigned int ty = tileY0; ty <= tileY1; ty++)
+		for (unsigned int tx = tileX0; tx <= tileX1; tx++)
+			tileBins[ty * TilesX + tx].push_back(index);
+}
+
+void OcclusionCuller::Rasterize(bool parallel)
+{
+	Clock::time_point start = Clock::now();
+
+	std::vector<unsigned int> tiles(TilesX * TilesY);
+	std::iota(tiles.begin(), tiles.end(), 0);
+	if (parallel)
+		std::for_each(std::execution::par, tiles.begin(), tiles.end(), [&](unsigned int tile) { RasterizeTile(tile); });
+	else
+		std::for_each(tiles.begin(), tiles.end(), [&](unsigned int tile) { RasterizeTile(tile); });
+
+	stats.rasterMs = ElapsedMs(start);
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int tileX = (tile % TilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY = (tile / TilesX) * OCCLUSION_TILE_HEIGHT;
+
+	// Each tile clears its own part of the buffer
+	for (int y = tileY; y < tileY + OCCLUSION_TILE_HEIGHT; y++)
+		std::fill_n(&depth[y * OCCLUSION_WIDTH + tileX], OCCLUSION_TILE_WIDTH, 1.0f);
+
+	XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR noLanes = XMVectorFalseInt();
+	for (unsigned int index : tileBins[tile])
+	{
+		const ScreenTriangle& tri = triangles[index];
+
+		// Edge functions a * x + b * y + c, positive inside
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; e++)
+		{
+			int n = (e + 1) % 3;
+			a[e] = tri.y[e] - tri.y[n];
+			b[e] = tri.x[n] - tri.x[e];
+			c[e] = -(a[e] * tri.x[e] + b[e] * tri.y[e]);
+		}
+
+		// Depth plane through the three vertices
+		float dx1 = tri.x[1] - tri.x[0], dy1 = tri.y[1] - tri.y[0], dz1 = tri.z[1] - tri.z[0];
+		float dx2 = tri.x[2] - tri.x[0], dy2 = tri.y[2] - tri.y[0], dz2 = tri.z[2] - tri.z[0];
+		float area = dx1 * dy2 - dx2 * dy1;
+		float dzdx = (dz1 * dy2 - dz2 * dy1) / area;
+		float dzdy = (dx1 * dz2 - dx2 * dz1) / area;
+		float z0 = tri.z[0] - dzdx * tri.x[0] - dzdy * tri.y[0];
+
+		// Bounding rectangle inside the tile, starting on a lane boundary
+		// (clamped as floats, since vertices can be far off screen)
+		int minX = (int)std::max(std::min({ tri.x[0], tri.x[1], tri.x[2] }), (float)tileX) & ~(OCCLUSION_LANES - 1);
+		int maxX = (int)std::min(std::max({ tri.x[0], tri.x[1], tri.x[2] }), (float)(tileX + OCCLUSION_TILE_WIDTH - 1));
+		int minY = (int)std::max(std::min({ tri.y[0], tri.y[1], tri.y[2] }), (float)tileY);
+		int maxY = (int)std::min(std::max({ tri.y[0], tri.y[1], tri.y[2] }), (float)(tileY + OCCLUSION_TILE_HEIGHT - 1));
+
+		XMVECTOR a0 = XMVectorReplicate(a[0]), a1 = XMVectorReplicate(a[1]), a2 = XMVectorReplicate(a[2]);
+		XMVECTOR dz = XMVectorReplicate(dzdx);
+		for (int y = minY; y <= maxY; y++)
+		{
+			// Everything that only depends on the row
+			float py = y + 0.5f;
+			XMVECTOR row0 = XMVectorReplicate(b[0] * py + c[0]);
+			XMVECTOR row1 = XMVectorReplicate(b[1] * py + c[1]);
+			XMVECTOR row2 = XMVectorReplicate(b[2] * py + c[2]);
+			XMVECTOR rowZ = XMVectorReplicate(dzdy * py + z0);
+
+			float* rowDepth = &depth[y * OCCLUSION_WIDTH];
+			for (int x = minX; x <= maxX; x += OCCLUSION_LANES)
+			{
+				XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), laneOffsets);
+				XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a0, px, row0), zero);
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a1, px, row1), zero));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a2, px, row2), zero));
+				if (XMVector4EqualInt(inside, noLanes))
+					continue;
+
+				XMVECTOR z = XMVectorMultiplyAdd(dz, px, rowZ);
+				XMVECTOR old = XMLoadFloat4(reinterpret_cast<XMFLOAT4*>(&rowDepth[x]));
+				XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&rowDepth[x]), XMVectorSelect(old, XMVectorMin(old, z), inside));
+			}
+		}
+	}
+
+	// Farthest depth per block, then for the whole tile
+	float tileFarthest = 0.0f;
+	for (int by = tileY; by < tileY + OCCLUSION_TILE_HEIGHT; by += OCCLUSION_BLOCK_SIZE)
+	{
+		for (int bx = tileX; bx < tileX + OCCLUSION_TILE_WIDTH; bx += OCCLUSION_BLOCK_SIZE)
+		{
+			XMVECTOR farthest = zero;
+			for (int y = by; y < by + OCCLUSION_BLOCK_SIZE; y++)
+				for (int x = bx; x < bx + OCCLUSION_BLOCK_SIZE; x += OCCLUSION_LANES)
+					farthest = XMVectorMax(farthest, XMLoadFloat4(reinterpret_cast<XMFLOAT4*>(&depth[y * OCCLUSION_WIDTH + x])));
+
+			XMFLOAT4 lanes;
+			XMStoreFloat4(&lanes, farthest);
+			float blockFarthest = std::max(std::max(lanes.x, lanes.y), std::max(lanes.z, lanes.w));
+			blockDepth[(by / OCCLUSION_BLOCK_SIZE) * BlocksX + bx / OCCLUSION_BLOCK_SIZE] = blockFarthest;
+			tileFarthest = std::max(tileFarthest, blockFarthest);
+		}
+	}
+	tileDepth[tile] = tileFarthest;
+}
+
+bool OcclusionCuller::IsVisible(const AABB& box)
+{
+	// Screen rectangle and nearest depth of the box's corners
+	XMMATRIX vp = XMLoadFloat4x4(&viewProjection);
+	float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		XMVECTOR corner = XMVectorSet(
+			(i & 1) ? box.max.x : box.min.x,
+			(i & 2) ? box.max.y : box.min.y,
+			(i & 4) ? box.max.z : box.min.z,
+			1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(corner, vp));
+
+		// Crossing the near plane: too close to judge
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		float y = (0.5f - clip.y * invW * 0.5f) * OCCLUSION_HEIGHT;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	// Anything not on screen is the frustum culler's business
+	if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT)
+		return true;
+
+	int x0 = (int)std::max(minX, 0.0f);
+	int x1 = (int)std::min(maxX, (float)OCCLUSION_WIDTH - 1);
+	int y0 = (int)std::max(minY, 0.0f);
+	int y1 = (int)std::min(maxY, (float)OCCLUSION_HEIGHT - 1);
+
+	// Coarse level first: hidden behind every tile it touches
+	bool behindTiles = true;
+	for (int ty = y0 / OCCLUSION_TILE_HEIGHT; ty <= y1 / OCCLUSION_TILE_HEIGHT && behindTiles; ty++)
+		for (int tx = x0 / OCCLUSION_TILE_WIDTH; tx <= x1 / OCCLUSION_TILE_WIDTH; tx++)
+			if (minZ <= tileDepth[ty * TilesX + tx])
+			{
+				behindTiles = false;
+				break;
+			}
+	if (behindTiles)
+		return false;
+
+	// Then block by block, stopping at the first one it's in front of
+	for (int by = y0 / OCCLUSION_BLOCK_SIZE; by <= y1 / OCCLUSION_BLOCK_SIZE; by++)
+		for (int bx = x0 / OCCLUSION_BLOCK_SIZE; bx <= x1 / OCCLUSION_BLOCK_SIZE; bx++)
+			if (minZ <= blockDepth[by * BlocksX + bx])
+				return true;
+	return false;
+}
+
+void OcclusionCuller::Cull(FrustumCuller& bounds, std::vector<unsigned int>& visible, bool parallel)
+{
+	Clock::time_point start = Clock::now();
+
+	std::vector<char> keep(visible.size());
+	auto test = [&](unsigned int index) { return (char)IsVisible(bounds.GetBounds(index)); };
+	if (parallel)
+		std::transform(std::execution::par, visible.begin(), visible.end(), keep.begin(), test);
+	else
+		std::transform(visible.begin(), visible.end(), keep.begin(), test);
+
+	// Compact in place, keeping the order
+	size_t kept = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		if (keep[i])
+			visible[kept++] = visible[i];
+	}
+
+	stats.tested = (unsigned int)visible.size();
+	stats.occluded = (unsigned int)(visible.size() - kept);
+	visible.resize(kept);
+	stats.testMs = ElapsedMs(start);
+}
+
+// Getters
+OcclusionStats OcclusionCuller::GetStats() { return stats; }
+const std::vector<float>& OcclusionCuller::GetDepth() { return depth; }
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Culling.h"
+
+// Depth buffer size in pixels (small on purpose: it only has
+// to hide whole objects, not shade them)
+#define OCCLUSION_WIDTH 320
+#define OCCLUSION_HEIGHT 192
+
+// Rasterization is split into tiles that run in parallel; each
+// tile only sees the triangles binned to it
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 32
+
+// Pixels per side of a hierarchical depth block (divides the tile size)
+#define OCCLUSION_BLOCK_SIZE 8
+
+// Pixels rasterized per SIMD step (along a row)
+#define OCCLUSION_LANES 4
+
+// What the last frame's occlusion pass did
+struct OcclusionStats
+{
+	unsigned int occluders;
+	unsigned int triangles;			// Binned for rasterization (after clipping and back faces)
+	unsigned int tested;
+	unsigned int occluded;
+	double setupMs;					// Transforming, clipping and binning the occluders
+	double rasterMs;				// Rasterizing the tiles and building the hierarchy
+	double testMs;
+};
+
+// --------------------------------------------------------
+// Software occlusion culling
+//
+// - A few big occluder meshes are rasterized, depth only,
+//    into a small CPU depth buffer (z / w, 1 is far)
+// - Triangles are binned into screen tiles, then the tiles
+//    are rasterized in parallel, OCCLUSION_LANES pixels at a
+//    time with SIMD edge functions and depth planes
+// - Each tile also keeps the farthest depth of every block
+//    and of the whole tile; an occludee's box is hidden if its
+//    nearest point is behind the farthest occluder depth over
+//    every block its screen rectangle touches
+// - The test is conservative: boxes crossing the near plane
+//    or leaving the screen are always visible
+// --------------------------------------------------------
+class OcclusionCuller
+{
+private:
+	// A triangle in pixel coordinates, with z / w per vertex
+	struct ScreenTriangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+	};
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<DirectX::XMFLOAT4> clipPositions;		// One occluder's vertices, in clip space
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> tileBins;
+	std::vector<float> depth;			// OCCLUSION_WIDTH * OCCLUSION_HEIGHT, row by row
+	std::vector<float> blockDepth;		// Farthest depth per block
+	std::vector<float> tileDepth;		// Farthest depth per tile
+	OcclusionStats stats;
+
+	void AddTriangle(const DirectX::XMFLOAT4* clip);
+	void RasterizeTile(unsigned int tile);
+
+public:
+	OcclusionCuller();
+
+	// Clears the depth buffer and the occluders
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Transforms, clips and bins one occluder's triangles
+	void AddOccluder(const DirectX::XMFLOAT3* positions, unsigned int positionCount, const unsigned int* indices, unsigned int indexCount, const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes everything added since BeginFrame()
+	void Rasterize(bool parallel = true);
+
+	// Whether a world space box could be seen past the occluders
+	bool IsVisible(const AABB& box);
+
+	// Removes the occluded boxes from visible (indices into
+	// the culler's boxes), keeping the order of the rest
+	void Cull(FrustumCuller& bounds, std::vector<unsigned int>& visible, bool parallel = true);
+
+	// Getters
+	OcclusionStats GetStats();
+	const std::vector<float>& GetDepth();		// For debugging views
+};
@@ -0,0 +1,264 @@
+#include "Octree.h"
+
+using namespace DirectX;
+
+Octree::Octree(XMFLOAT3 center, float halfSize, int maxDepth) :
+	firstFreeItem(OCTREE_NONE),
+	itemCount(0),
+	maxDepth(maxDepth < OCTREE_MAX_DEPTH ? maxDepth : OCTREE_MAX_DEPTH)
+{
+	OctreeNode root = {};
+	root.center = center;
+	root.halfSize = halfSize;
+	root.parent = OCTREE_NONE;
+	root.firstChild = OCTREE_NONE;
+	root.firstItem = OCTREE_NONE;
+	nodes.push_back(root);
+}
+
+int Octree::FindNode(const AABB& bounds)
+{
+	XMFLOAT3 c = Bounds::GetCenter(bounds);
+	XMFLOAT3 e = Bounds::GetExtents(bounds);
+	float size = e.x > e.y ? (e.x > e.z ? e.x : e.z) : (e.y > e.z ? e.y : e.z);
+
+	// Items centered outside the root cell stay in the root
+	const OctreeNode& root = nodes[0];
+	if (c.x < root.center.x - root.halfSize || c.x > root.center.x + root.halfSize ||
+		c.y < root.center.y - root.halfSize || c.y > root.center.y + root.halfSize ||
+		c.z < root.center.z - root.halfSize || c.z > root.center.z + root.halfSize)
+		return 0;
+
+	int node = 0;
+	for (int depth = 0; depth < maxDepth; depth++)
+	{
+		// Stop once the item is bigger than a child cell
+		float childHalf = nodes[node].halfSize * 0.5f;
+		if (size > childHalf)
+			break;
+
+		// Split on first use
+		if (nodes[node].firstChild == OCTREE_NONE)
+		{
+			int first = (int)nodes.size();
+			XMFLOAT3 center = nodes[node].center;
+			for (int i = 0; i < 8; i++)
+			{
+				OctreeNode child = {};
+				child.center = XMFLOAT3(
+					center.x + (i & 1 ? childHalf : -childHalf),
+					center.y + (i & 2 ? childHalf : -childHalf),
+					center.z + (i & 4 ? childHalf : -childHalf));
+				child.halfSize = childHalf;
+				child.parent = node;
+				child.firstChild = OCTREE_NONE;
+				child.firstItem = OCTREE_NONE;
+				nodes.push_back(child);
+			}
+			nodes[node].firstChild = first;
+		}
+
+		// The child cell holding the item's center
+		const OctreeNode& n = nodes[node];
+		int octant =
+			(c.x >= n.center.x ? 1 : 0) |
+			(c.y >= n.center.y ? 2 : 0) |
+			(c.z >= n.center.z ? 4 : 0);
+		node = n.firstChild + octant;
+	}
+
+	return node;
+}
+
+void Octree::Link(int item, int node)
+{
+	itemNode[item] = node;
+	itemPrev[item] = OCTREE_NONE;
+	itemNext[item] = nodes[node].firstItem;
+	if (nodes[node].firstItem != OCTREE_NONE)
+		itemPrev[nodes[node].firstItem] = item;
+	nodes[node].firstItem = item;
+
+	for (int n = node; n != OCTREE_NONE; n = nodes[n].parent)
+		nodes[n].subtreeItems++;
+}
+
+void Octree::Unlink(int item)
+{
+	int node = itemNode[item];
+	if (itemPrev[item] != OCTREE_NONE)
+		itemNext[itemPrev[item]] = itemNext[item];
+	else
+		nodes[node].firstItem = itemNext[item];
+	if (itemNext[item] != OCTREE_NONE)
+		itemPrev[itemNext[item]] = itemPrev[item];
+
+	for (int n = node; n != OCTREE_NONE; n = nodes[n].parent)
+		nodes[n].subtreeItems--;
+
+	itemNode[item] = OCTREE_NONE;
+}
+
+int Octree::Insert(const AABB& bounds, unsigned int data)
+{
+	int item;
+	if (firstFreeItem != OCTREE_NONE)
+	{
+		item = firstFreeItem;
+		firstFreeItem = itemNext[item];
+	}
+	else
+	{
+		item = (int)itemBounds.size();
+		itemBounds.push_back({});
+		itemData.push_back(0);
+		itemNode.push_back(OCTREE_NONE);
+		itemNext.push_back(OCTREE_NONE);
+		itemPrev.push_back(OCTREE_NONE);
+	}
+
+	itemBounds[item] = bounds;
+	itemData[item] = data;
+	Link(item, FindNode(bounds));
+	itemCount++;
+	return item;
+}
+
+void Octree::Update(int item, const AABB& bounds)
+{
+	if (item < 0 || item >= (int)itemNode.size() || itemNode[item] == OCTREE_NONE)
+		return;
+
+	itemBounds[item] = bounds;
+
+	// Most moves stay inside the same (loose) node
+	int node = FindNode(bounds);
+	if (node == itemNode[item])
+		return;
+
+	Unlink(item);
+	Link(item, node);
+}
+
+void Octree::Remove(int item)
+{
+	if (item < 0 || item >= (int)itemNode.size() || itemNode[item] == OCTREE_NONE)
+		return;
+
+	Unlink(item);
+	itemNext[item] = firstFreeItem;
+	firstFreeItem = item;
+	itemCount--;
+}
+
+void Octree::Clear(XMFLOAT3 center, float halfSize)
+{
+	nodes[0].center = center;
+	nodes[0].halfSize = halfSize;
+	Clear();
+}
+
+void Octree::Clear()
+{
+	OctreeNode root = nodes[0];
+	root.firstChild = OCTREE_NONE;
+	root.firstItem = OCTREE_NONE;
+	root.subtreeItems = 0;
+
+	nodes.clear();
+	nodes.push_back(root);
+
+	itemBounds.clear();
+	itemData.clear();
+	itemNode.clear();
+	itemNext.clear();
+	itemPrev.clear();
+	firstFreeItem = OCTREE_NONE;
+	itemCount = 0;
+}
+
+template<typename Test>
+void Octree::Query(Test test, std::vector<unsigned int>& results)
+{
+	// Each pop pushes at most 8 children, so the stack never
+	// holds more than 7 entries per level plus the last 8
+	int stack[7 * OCTREE_MAX_DEPTH + 8];
+	bool inside[7 * OCTREE_MAX_DEPTH + 8];
+	int top = 0;
+	stack[top] = 0;
+	inside[top++] = false;
+
+	while (top > 0)
+	{
+		top--;
+		int nodeIndex = stack[top];
+		bool fullyInside = inside[top];
+		const OctreeNode& node = nodes[nodeIndex];
+		if (node.subtreeItems == 0)
+			continue;
+
+		// Test the node's loose bounds, unless the parent was already fully inside
+		int result = BOUNDS_INSIDE;
+		if (!fullyInside)
+		{
+			float loose = node.halfSize * 2.0f;
+			AABB looseBounds = Bounds::FromCenterExtents(node.center, XMFLOAT3(loose, loose, loose));
+			result = test(looseBounds);
+			fullyInside = result == BOUNDS_INSIDE;
+		}
+
+		// The root's items may stick out of its loose bounds, so
+		// they're tested whatever the root's result was
+		bool isRoot = nodeIndex == 0;
+		if (result != BOUNDS_OUTSIDE || isRoot)
+		{
+			for (int item = node.firstItem; item != OCTREE_NONE; item = itemNext[item])
+			{
+				if ((fullyInside && !isRoot) || test(itemBounds[item]) != BOUNDS_OUTSIDE)
+					results.push_back(itemData[item]);
+			}
+		}
+		if (result == BOUNDS_OUTSIDE)
+			continue;
+
+		if (node.firstChild != OCTREE_NONE)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				stack[top] = node.firstChild + i;
+				inside[top++] = fullyInside;
+			}
+		}
+	}
+}
+
+void Octree::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results)
+{
+	Query([&](const AABB& box) { return Bounds::FrustumTest(frustum, box); }, results);
+}
+
+void Octree::QueryAABB(const AABB& box, std::vector<unsigned int>& results)
+{
+	Query([&](const AABB& other) { return Bounds::AABBTest(box, other); }, results);
+}
+
+void Octree::QuerySphere(XMFLOAT3 center, float radius, std::vector<unsigned int>& results)
+{
+	Query([&](const AABB& box) { return Bounds::SphereTest(center, radius, box); }, results);
+}
+
+unsigned int Octree::GetItemCount()
+{
+	return itemCount;
+}
+
+unsigned int Octree::GetNodeCount()
+{
+	return (unsigned int)nodes.size();
+}
+
+size_t Octree::GetMemoryUsage()
+{
+	size_t perItem = sizeof(AABB) + sizeof(unsigned int) + sizeof(int) * 3;
+	return nodes.size() * sizeof(OctreeNode) + itemBounds.size() * perItem;
+}
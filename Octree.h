@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+
+#define OCTREE_NONE -1
+#define OCTREE_MAX_DEPTH 10
+
+struct OctreeNode
+{
+	DirectX::XMFLOAT3 center;
+	float halfSize;				// Of the node's cell - its loose bounds are twice as big
+	int parent;
+	int firstChild;				// Children are always 8 consecutive nodes
+	int firstItem;				// Head of the list of items stored in this node
+	unsigned int subtreeItems;	// Items in this node and all nodes below it
+};
+
+// --------------------------------------------------------
+// A loose octree over axis-aligned bounds
+//
+// - Each item lives in exactly one node: the deepest one whose
+//    cell holds the item's center and is at least as big as
+//    the item. Since a node's loose bounds are twice its cell,
+//    the whole item always fits in them
+// - Nodes and items are stored in flat arrays and refer to
+//    each other by index (no per-node allocations)
+// - Moving an item only touches the tree when it leaves its node
+// - Items that don't fit the root's loose bounds (centered
+//    outside its cell, or bigger than it) stay in the root, and
+//    queries always test the root's own items one by one
+// --------------------------------------------------------
+class Octree
+{
+private:
+	// Nodes (never freed, only emptied)
+	std::vector<OctreeNode> nodes;
+
+	// Items, as parallel arrays (free items are chained through itemNext)
+	std::vector<AABB> itemBounds;
+	std::vector<unsigned int> itemData;
+	std::vector<int> itemNode;
+	std::vector<int> itemNext;
+	std::vector<int> itemPrev;
+	int firstFreeItem;
+	unsigned int itemCount;
+
+	int maxDepth;
+
+	int FindNode(const AABB& bounds);	// Creates nodes on the way down as needed
+	void Link(int item, int node);
+	void Unlink(int item);
+
+	template<typename Test>
+	void Query(Test test, std::vector<unsigned int>& results);
+
+public:
+	Octree(DirectX::XMFLOAT3 center, float halfSize, int maxDepth = 8);
+
+	// Items are identified by the returned index; data is
+	// what queries hand back (an entity index, for example)
+	int Insert(const AABB& bounds, unsigned int data);
+	void Update(int item, const AABB& bounds);
+	void Remove(int item);
+	void Clear();
+	void Clear(DirectX::XMFLOAT3 center, float halfSize);	// And moves the root cell
+
+	// Queries append the data of every item that touches the volume
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results);
+	void QueryAABB(const AABB& box, std::vector<unsigned int>& results);
+	void QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<unsigned int>& results);
+
+	// Getters
+	unsigned int GetItemCount();
+	unsigned int GetNodeCount();
+	size_t GetMemoryUsage();
+};
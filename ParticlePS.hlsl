@@ -0,0 +1,11 @@
+#include "StructsIncludes.hlsli"
+
+// --------------------------------------------------------
+// Soft round particles, no texture needed
+// --------------------------------------------------------
+float4 main(VertexToPixel_Particle input) : SV_TARGET
+{
+    // Fade out towards the edge of the quad
+    float fade = saturate(1.0f - length(input.uv * 2.0f - 1.0f));
+    return float4(input.color.rgb, input.color.a * fade * fade);
+}
@@ -0,0 +1,476 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Timing.h"
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// SIMD loads and stores of one group of particles from a stream
+	inline XMVECTOR LoadLanes(const std::vector<float>& stream, unsigned int i)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&stream[i]));
+	}
+
+	inline void StoreLanes(std::vector<float>& stream, unsigned int i, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&stream[i]), v);
+	}
+}
+
+ParticleSystem::ParticleSystem(unsigned int capacity) :
+	count(0),
+	capacity(0),
+	sortedCount(0),
+	randomState(0x9E3779B9u),
+	stats{},
+	instanceBufferCapacity(0),
+	vsData{}
+{
+	SetCapacity(capacity);
+}
+
+ParticleEmitterSettings ParticleSystem::DefaultEmitterSettings()
+{
+	ParticleEmitterSettings settings = {};
+	settings.rate = 200.0f;
+	settings.minLifetime = 0.6f;
+	settings.maxLifetime = 1.4f;
+	settings.speed = 4.0f;
+	settings.speedJitter = 1.5f;
+	settings.spread = 0.5f;
+	settings.offset = XMFLOAT3(0, 0, 0);
+	settings.gravity = 6.0f;
+	settings.drag = 0.4f;
+	settings.startSize = 0.12f;
+	settings.endSize = 0.02f;
+	settings.startColor = XMFLOAT4(1.0f, 0.85f, 0.4f, 1.0f);
+	settings.endColor = XMFLOAT4(1.0f, 0.2f, 0.05f, 0.0f);
+	return settings;
+}
+
+float ParticleSystem::Random()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return (randomState >> 8) * (1.0f / 16777216.0f);
+}
+
+int ParticleSystem::AddEmitter(TransformHandle target, const ParticleEmitterSettings& settings)
+{
+	// Particles remember their emitter in 16 bits
+	if (emitters.size() >= 0xFFFF)
+		return -1;
+
+	Emitter emitter = {};
+	emitter.target = target;
+	emitter.settings = settings;
+	emitter.enabled = true;
+	emitters.push_back(emitter);
+	return (int)emitters.size() - 1;
+}
+
+void ParticleSystem::Clear()
+{
+	emitters.clear();
+	KillAll();
+}
+
+void ParticleSystem::KillAll()
+{
+	count = 0;
+	sortedCount = 0;
+	instances.clear();
+}
+
+void ParticleSystem::Emit(Emitter& emitter, unsigned short index, unsigned int spawnCount)
+{
+	const ParticleEmitterSettings& s = emitter.settings;
+
+	// Where and which way the emitter points this update
+	XMVECTOR origin = XMLoadFloat3(&s.offset);
+	XMVECTOR up = XMVectorSet(0, 1, 0, 0);
+	if (!emitter.target.IsNull())
+	{
+		Transform* transform = Resources::Transforms.Get(emitter.target);
+		XMFLOAT4X4 world = transform->GetWorldMatrix();
+		origin = XMVector3Transform(origin, XMLoadFloat4x4(&world));
+		XMFLOAT3 transformUp = transform->GetUp();
+		up = XMVector3Normalize(XMLoadFloat3(&transformUp));
+	}
+
+	// Two axes across the cone
+	XMVECTOR helper = fabsf(XMVectorGetY(up)) < 0.99f ? XMVectorSet(0, 1, 0, 0) : XMVectorSet(1, 0, 0, 0);
+	XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(up, helper));
+	XMVECTOR bitangent = XMVector3Cross(up, tangent);
+	float cosSpread = cosf(std::clamp(s.spread, 0.0f, XM_PI));
+
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, origin);
+	for (unsigned int n = 0; n < spawnCount; n++)
+	{
+		if (count >= capacity)
+		{
+			stats.dropped += spawnCount - n;
+			return;
+		}
+
+		// Uniform direction inside the cone
+		float cosTheta = 1.0f - Random() * (1.0f - cosSpread);
+		float sinTheta = sqrtf(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+		float phi = Random() * XM_2PI;
+		float speed = s.speed + (Random() * 2.0f - 1.0f) * s.speedJitter;
+
+		XMVECTOR direction = XMVectorScale(tangent, cosf(phi) * sinTheta);
+		direction = XMVectorMultiplyAdd(bitangent, XMVectorReplicate(sinf(phi) * sinTheta), direction);
+		direction = XMVectorMultiplyAdd(up, XMVectorReplicate(cosTheta), direction);
+		XMFLOAT3 v;
+		XMStoreFloat3(&v, XMVectorScale(direction, speed));
+
+		unsigned int i = count++;
+		positionX[i] = p.x;
+		positionY[i] = p.y;
+		positionZ[i] = p.z;
+		velocityX[i] = v.x;
+		velocityY[i] = v.y;
+		velocityZ[i] = v.z;
+		age[i] = 0.0f;
+		lifetime[i] = std::max(s.minLifetime + (s.maxLifetime - s.minLifetime) * Random(), 0.001f);
+		gravity[i] = s.gravity;
+		drag[i] = s.drag;
+		emitterIndex[i] = index;
+		stats.emitted++;
+	}
+}
+
+void ParticleSystem::Retire(unsigned int index)
+{
+	// Swap the last live particle into the hole
+	unsigned int last = --count;
+	positionX[index] = positionX[last];
+	positionY[index] = positionY[last];
+	positionZ[index] = positionZ[last];
+	velocityX[index] = velocityX[last];
+	velocityY[index] = velocityY[last];
+	velocityZ[index] = velocityZ[last];
+	age[index] = age[last];
+	lifetime[index] = lifetime[last];
+	gravity[index] = gravity[last];
+	drag[index] = drag[last];
+	emitterIndex[index] = emitterIndex[last];
+	stats.retired++;
+}
+
+void ParticleSystem::Update(float deltaTime)
+{
+	auto start = Clock::now();
+	stats.emitted = 0;
+	stats.retired = 0;
+	stats.dropped = 0;
+
+	// Spawn
+	for (size_t e = 0; e < emitters.size(); e++)
+	{
+		Emitter& emitter = emitters[e];
+		if (!emitter.enabled)
+			continue;
+
+		// Stale target: nothing to follow any more
+		if (!emitter.target.IsNull() && !Resources::Transforms.Get(emitter.target))
+		{
+			emitter.pending = 0.0f;
+			continue;
+		}
+
+		emitter.pending += std::max(emitter.settings.rate, 0.0f) * deltaTime;
+		unsigned int spawnCount = (unsigned int)emitter.pending;
+		emitter.pending -= (float)spawnCount;
+		Emit(emitter, (unsigned short)e, spawnCount);
+	}
+
+	// Integrate, PARTICLE_LANES at a time
+	// - The streams are padded to a whole number of groups, so the
+	//    last group can run past count without a scalar tail
+	XMVECTOR dt = XMVectorReplicate(deltaTime);
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR zero = XMVectorZero();
+	for (unsigned int i = 0; i < count; i += PARTICLE_LANES)
+	{
+		// Velocity: drag, then gravity
+		XMVECTOR damping = XMVectorMax(XMVectorNegativeMultiplySubtract(LoadLanes(drag, i), dt, one), zero);
+		XMVECTOR vx = XMVectorMultiply(LoadLanes(velocityX, i), damping);
+		XMVECTOR vy = XMVectorMultiply(LoadLanes(velocityY, i), damping);
+		XMVECTOR vz = XMVectorMultiply(LoadLanes(velocityZ, i), damping);
+		vy = XMVectorNegativeMultiplySubtract(LoadLanes(gravity, i), dt, vy);
+
+		StoreLanes(velocityX, i, vx);
+		StoreLanes(velocityY, i, vy);
+		StoreLanes(velocityZ, i, vz);
+		StoreLanes(positionX, i, XMVectorMultiplyAdd(vx, dt, LoadLanes(positionX, i)));
+		StoreLanes(positionY, i, XMVectorMultiplyAdd(vy, dt, LoadLanes(positionY, i)));
+		StoreLanes(positionZ, i, XMVectorMultiplyAdd(vz, dt, LoadLanes(positionZ, i)));
+		StoreLanes(age, i, XMVectorAdd(LoadLanes(age, i), dt));
+	}
+
+	// Retire anything past its lifetime
+	for (unsigned int i = 0; i < count;)
+	{
+		if (age[i] >= lifetime[i])
+			Retire(i);
+		else
+			i++;
+	}
+
+	stats.updateMs = ElapsedMs(start);
+}
+
+void ParticleSystem::Sort(XMFLOAT3 cameraPosition, XMFLOAT3 cameraForward)
+{
+	auto start = Clock::now();
+
+	// View depth of every particle, as a key that sorts far to near
+	// - Flipping the sign bit (and the rest too for negatives) makes
+	//    float bits sort like the floats; inverting that reverses it
+	XMVECTOR forward = XMVector3Normalize(XMLoadFloat3(&cameraForward));
+	XMVECTOR fx = XMVectorSplatX(forward);
+	XMVECTOR fy = XMVectorSplatY(forward);
+	XMVECTOR fz = XMVectorSplatZ(forward);
+	XMVECTOR cx = XMVectorReplicate(cameraPosition.x);
+	XMVECTOR cy = XMVectorReplicate(cameraPosition.y);
+	XMVECTOR cz = XMVectorReplicate(cameraPosition.z);
+	XMVECTOR absMask = XMVectorReplicateInt(0x7FFFFFFF);
+	XMVECTOR zero = XMVectorZero();
+	for (unsigned int i = 0; i < count; i += PARTICLE_LANES)
+	{
+		XMVECTOR depth = XMVectorMultiply(XMVectorSubtract(LoadLanes(positionX, i), cx), fx);
+		depth = XMVectorMultiplyAdd(XMVectorSubtract(LoadLanes(positionY, i), cy), fy, depth);
+		depth = XMVectorMultiplyAdd(XMVectorSubtract(LoadLanes(positionZ, i), cz), fz, depth);
+
+		XMVECTOR negative = XMVectorLess(depth, zero);
+		XMStoreInt4(&sortKeys[i], XMVectorXorInt(depth, XMVectorAndCInt(absMask, negative)));
+	}
+
+	// Least significant byte first radix sort of (key, index)
+	unsigned int n = count;
+	unsigned int histograms[4][256] = {};
+	for (unsigned int i = 0; i < n; i++)
+	{
+		unsigned int key = sortKeys[i];
+		histograms[0][key & 0xFF]++;
+		histograms[1][(key >> 8) & 0xFF]++;
+		histograms[2][(key >> 16) & 0xFF]++;
+		histograms[3][key >> 24]++;
+		sortedIndices[i] = i;
+	}
+
+	stats.sortPasses = 0;
+	for (int pass = 0; pass < 4 && n > 1; pass++)
+	{
+		unsigned int shift = pass * 8;
+		unsigned int* histogram = histograms[pass];
+
+		// Every key has the same byte here: the pass wouldn't move anything
+		if (histogram[(sortKeys[0] >> shift) & 0xFF] == n)
+			continue;
+
+		unsigned int offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			unsigned int bucket = histogram[b];
+			histogram[b] = offset;
+			offset += bucket;
+		}
+
+		for (unsigned int i = 0; i < n; i++)
+		{
+			unsigned int key = sortKeys[i];
+			unsigned int to = histogram[(key >> shift) & 0xFF]++;
+			scratchKeys[to] = key;
+			scratchIndices[to] = sortedIndices[i];
+		}
+		sortKeys.swap(scratchKeys);
+		sortedIndices.swap(scratchIndices);
+		stats.sortPasses++;
+	}
+	sortedCount = n;
+
+	stats.sortMs = ElapsedMs(start);
+}
+
+void ParticleSystem::Pack()
+{
+	auto start = Clock::now();
+
+	instances.resize(sortedCount);
+	unsigned int packed = 0;
+	for (unsigned int j = 0; j < sortedCount; j++)
+	{
+		// Particles retired since Sort() are skipped
+		unsigned int i = sortedIndices[j];
+		if (i >= count)
+			continue;
+
+		const ParticleEmitterSettings& s = emitters[emitterIndex[i]].settings;
+		float t = std::min(age[i] / lifetime[i], 1.0f);
+
+		ParticleInstance& instance = instances[packed++];
+		instance.position = XMFLOAT3(positionX[i], positionY[i], positionZ[i]);
+		instance.size = s.startSize + (s.endSize - s.startSize) * t;
+		XMStoreFloat4(&instance.color, XMVectorLerp(XMLoadFloat4(&s.startColor), XMLoadFloat4(&s.endColor), t));
+	}
+	instances.resize(packed);
+
+	stats.packMs = ElapsedMs(start);
+}
+
+void ParticleSystem::CreateRenderResources(std::wstring vsFilePath, std::wstring psFilePath)
+{
+	// No vertex data: the shader builds each quad from SV_VertexID
+	vs = Graphics::Backend->LoadVertexShader(vsFilePath, RENDER_INPUT_NONE);
+	ps = Graphics::Backend->LoadPixelShader(psFilePath);
+}
+
+bool ParticleSystem::CreateInstanceBuffer(unsigned int particleCount)
+{
+	// Grow in big steps so a growing effect doesn't recreate it every frame
+	unsigned int newCapacity = std::max(instanceBufferCapacity, 1024u);
+	while (newCapacity < particleCount)
+		newCapacity *= 2;
+
+	instanceBufferCapacity = 0;
+	if (!Graphics::Backend->CreateStructuredBuffer(sizeof(ParticleInstance), newCapacity, &instanceBuffer, &instanceView))
+	{
+		printf("Could not create the particle buffer (%u particles)\n", newCapacity);
+		return false;
+	}
+
+	instanceBufferCapacity = newCapacity;
+	return true;
+}
+
+void ParticleSystem::Draw(std::shared_ptr<Camera> camera)
+{
+	if (vs.IsNull() || ps.IsNull() || instances.empty())
+		return;
+
+	unsigned int drawCount = (unsigned int)instances.size();
+	if (drawCount > instanceBufferCapacity && !CreateInstanceBuffer(drawCount))
+		return;
+
+	// Upload this frame's instances
+	if (!Graphics::Backend->UpdateBuffer(instanceBuffer, instances.data(), drawCount * sizeof(ParticleInstance)))
+		return;
+
+	// Quads face the camera, so they need its axes
+	vsData.view = camera->GetView();
+	vsData.projection = camera->GetProjection();
+	vsData.cameraRight = camera->GetTransform()->GetRight();
+	vsData.cameraUp = camera->GetTransform()->GetUp();
+	Graphics::Backend->SetConstants(
+		RENDER_STAGE_VERTEX,
+		0,
+		&vsData,
+		sizeof(ParticleVSConstantBuffer));
+
+	Graphics::Backend->SetVertexShader(vs);
+	Graphics::Backend->SetPixelShader(ps);
+	Graphics::Backend->SetVertexShaderResource(0, instanceView);
+
+	// Ordinary alpha blending (hence the back-to-front sort), tested
+	// against the scene but never written, both sides of each quad
+	Graphics::Backend->SetBlendMode(RENDER_BLEND_ALPHA);
+	Graphics::Backend->SetDepthMode(RENDER_DEPTH_READ_ONLY);
+	Graphics::Backend->SetRasterMode(RENDER_RASTER_CULL_NONE);
+
+	// Two triangles per particle
+	Graphics::Backend->Draw(drawCount * 6);
+
+	// Reset render states
+	Graphics::Backend->SetVertexShaderResource(0, TextureHandle());
+	Graphics::Backend->SetBlendMode(RENDER_BLEND_OPAQUE);
+	Graphics::Backend->SetDepthMode(RENDER_DEPTH_DEFAULT);
+	Graphics::Backend->SetRasterMode(RENDER_RASTER_DEFAULT);
+}
+
+// Getters
+unsigned int ParticleSystem::GetParticleCount() { return count; }
+unsigned int ParticleSystem::GetCapacity() { return capacity; }
+int ParticleSystem::GetEmitterCount() { return (int)emitters.size(); }
+ParticleStats ParticleSystem::GetStats() { return stats; }
+const unsigned int* ParticleSystem::GetSortedIndices() { return sortedIndices.data(); }
+unsigned int ParticleSystem::GetSortedCount() { return sortedCount; }
+const std::vector<ParticleInstance>& ParticleSystem::GetInstances() { return instances; }
+
+ParticleEmitterSettings ParticleSystem::GetEmitterSettings(int emitter)
+{
+	if (emitter < 0 || emitter >= (int)emitters.size())
+		return DefaultEmitterSettings();
+	return emitters[emitter].settings;
+}
+
+bool ParticleSystem::GetEmitterEnabled(int emitter)
+{
+	return emitter >= 0 && emitter < (int)emitters.size() && emitters[emitter].enabled;
+}
+
+TransformHandle ParticleSystem::GetEmitterTarget(int emitter)
+{
+	if (emitter < 0 || emitter >= (int)emitters.size())
+		return TransformHandle();
+	return emitters[emitter].target;
+}
+
+size_t ParticleSystem::GetMemoryUsage()
+{
+	size_t padded = positionX.size();
+	return padded * (10 * sizeof(float) + sizeof(unsigned short) + 4 * sizeof(unsigned int)) +
+		instances.capacity() * sizeof(ParticleInstance);
+}
+
+// Setters
+void ParticleSystem::SetEmitterSettings(int emitter, const ParticleEmitterSettings& settings)
+{
+	if (emitter >= 0 && emitter < (int)emitters.size())
+		emitters[emitter].settings = settings;
+}
+
+void ParticleSystem::SetEmitterEnabled(int emitter, bool enabled)
+{
+	if (emitter >= 0 && emitter < (int)emitters.size())
+		emitters[emitter].enabled = enabled;
+}
+
+void ParticleSystem::SetCapacity(unsigned int capacity)
+{
+	// Pad every stream to whole SIMD groups (the padding is never live)
+	unsigned int padded = (capacity + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+
+	this->capacity = capacity;
+	count = std::min(count, capacity);
+	sortedCount = 0;
+	instances.clear();
+
+	positionX.resize(padded, 0.0f);
+	positionY.resize(padded, 0.0f);
+	positionZ.resize(padded, 0.0f);
+	velocityX.resize(padded, 0.0f);
+	velocityY.resize(padded, 0.0f);
+	velocityZ.resize(padded, 0.0f);
+	age.resize(padded, 0.0f);
+	lifetime.resize(padded, 1.0f);
+	gravity.resize(padded, 0.0f);
+	drag.resize(padded, 0.0f);
+	emitterIndex.resize(padded, 0);
+	sortKeys.resize(padded, 0);
+	sortedIndices.resize(padded, 0);
+	scratchKeys.resize(padded, 0);
+	scratchIndices.resize(padded, 0);
+}
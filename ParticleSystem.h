@@ -0,0 +1,157 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BufferStructs.h"
+#include "Camera.h"
+#include "RenderBackend.h"
+#include "Resources.h"
+
+// Particles integrated per SIMD step (capacity is rounded up to this)
+#define PARTICLE_LANES 4
+
+// How one emitter spawns and shapes its particles
+struct ParticleEmitterSettings
+{
+	float rate;							// Particles per second
+	float minLifetime;					// Seconds
+	float maxLifetime;
+	float speed;						// Initial speed, +/- speedJitter
+	float speedJitter;
+	float spread;						// Cone half-angle around the target's up, in radians
+	DirectX::XMFLOAT3 offset;			// From the target, in its local space (world position without a target)
+	float gravity;						// Down along world Y
+	float drag;							// Share of velocity lost per second
+	float startSize;					// World units, blended to endSize over the lifetime
+	float endSize;
+	DirectX::XMFLOAT4 startColor;		// Blended to endColor over the lifetime
+	DirectX::XMFLOAT4 endColor;
+};
+
+// One particle, packed the way ParticleVS reads it (32 bytes)
+struct ParticleInstance
+{
+	DirectX::XMFLOAT3 position;
+	float size;
+	DirectX::XMFLOAT4 color;
+};
+
+// What the last Update/Sort/Pack did
+struct ParticleStats
+{
+	unsigned int emitted;
+	unsigned int retired;
+	unsigned int dropped;				// Wanted to spawn, but the system was full
+	unsigned int sortPasses;			// Radix passes actually run (uniform bytes are skipped)
+	double updateMs;
+	double sortMs;
+	double packMs;
+};
+
+// --------------------------------------------------------
+// CPU particles for small effects (sparks, dust, ...)
+//
+// - Particles are stored as structure of arrays, with the
+//    live ones packed at the front, so integration is a
+//    straight SIMD walk over a few float arrays
+// - Emitters follow a transform in the resource pool; a
+//    stale target just stops emitting
+// - Sort() builds a back-to-front index list with a radix
+//    sort on view depth, for alpha blending
+// - Pack() writes instance data in that order, ready to be
+//    copied straight into the GPU buffer by Draw()
+// --------------------------------------------------------
+class ParticleSystem
+{
+private:
+	struct Emitter
+	{
+		TransformHandle target;
+		ParticleEmitterSettings settings;
+		float pending;					// Fractional particles carried to the next update
+		bool enabled;
+	};
+	std::vector<Emitter> emitters;
+
+	// Particle data (capacity entries each, count alive)
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> velocityX;
+	std::vector<float> velocityY;
+	std::vector<float> velocityZ;
+	std::vector<float> age;
+	std::vector<float> lifetime;
+	std::vector<float> gravity;			// Copied from the emitter, so integration needs no lookups
+	std::vector<float> drag;
+	std::vector<unsigned short> emitterIndex;
+	unsigned int count;
+	unsigned int capacity;
+
+	// Sort and pack output, plus radix scratch
+	std::vector<unsigned int> sortKeys;
+	std::vector<unsigned int> sortedIndices;
+	std::vector<unsigned int> scratchKeys;
+	std::vector<unsigned int> scratchIndices;
+	unsigned int sortedCount;
+	std::vector<ParticleInstance> instances;
+
+	unsigned int randomState;
+	ParticleStats stats;
+
+	// Rendering (only made by CreateRenderResources)
+	BufferHandle instanceBuffer;
+	TextureHandle instanceView;
+	unsigned int instanceBufferCapacity;
+	ShaderHandle vs;
+	ShaderHandle ps;
+	ParticleVSConstantBuffer vsData;
+
+	float Random();		// [0, 1)
+	void Emit(Emitter& emitter, unsigned short index, unsigned int spawnCount);
+	void Retire(unsigned int index);
+	bool CreateInstanceBuffer(unsigned int particleCount);
+
+public:
+	ParticleSystem(unsigned int capacity = 65536);
+
+	// Something that reads as a small puff of sparks
+	static ParticleEmitterSettings DefaultEmitterSettings();
+
+	// A null target makes settings.offset a world position
+	int AddEmitter(TransformHandle target, const ParticleEmitterSettings& settings);
+	void Clear();			// Emitters and particles
+	void KillAll();			// Particles only
+
+	// Spawn, integrate and retire (one SIMD pass over the live particles)
+	void Update(float deltaTime);
+
+	// Back-to-front order from the camera, then instance data in that order
+	void Sort(DirectX::XMFLOAT3 cameraPosition, DirectX::XMFLOAT3 cameraForward);
+	void Pack();
+
+	// Rendering
+	void CreateRenderResources(std::wstring vsFilePath, std::wstring psFilePath);
+	void Draw(std::shared_ptr<Camera> camera);		// Uploads the packed instances and draws them
+
+	// Getters
+	unsigned int GetParticleCount();
+	unsigned int GetCapacity();
+	int GetEmitterCount();
+	ParticleEmitterSettings GetEmitterSettings(int emitter);
+	bool GetEmitterEnabled(int emitter);
+	TransformHandle GetEmitterTarget(int emitter);
+	ParticleStats GetStats();
+	const unsigned int* GetSortedIndices();		// GetSortedCount() of them, far to near
+	unsigned int GetSortedCount();
+	const std::vector<ParticleInstance>& GetInstances();
+	size_t GetMemoryUsage();		// Bytes of particle, sort and instance storage
+
+	// Setters
+	void SetEmitterSettings(int emitter, const ParticleEmitterSettings& settings);
+	void SetEmitterEnabled(int emitter, bool enabled);
+	void SetCapacity(unsigned int capacity);		// Drops particles past the new capacity
+};
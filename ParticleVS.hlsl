@@ -0,0 +1,49 @@
+#include "StructsIncludes.hlsli"
+
+// One particle, matches ParticleInstance on the C++ side
+struct Particle
+{
+    float3 position;
+    float size;
+    float4 color;
+};
+
+StructuredBuffer<Particle> Particles : register(t0);
+
+cbuffer ExternalData : register(b0)
+{
+    float4x4 view;
+    float4x4 projection;
+    float3 cameraRight;
+    float3 cameraUp;
+}
+
+// Corners of the two triangles making up each quad
+static const float2 corners[6] =
+{
+    float2(-1, 1), float2(1, 1), float2(1, -1),
+    float2(-1, 1), float2(1, -1), float2(-1, -1)
+};
+
+// --------------------------------------------------------
+// Camera facing quads with no vertex buffer
+// - Every 6 vertices are one particle, read from the
+//    structured buffer by SV_VertexID
+// --------------------------------------------------------
+VertexToPixel_Particle main(uint id : SV_VertexID)
+{
+    VertexToPixel_Particle output;
+
+    Particle particle = Particles[id / 6];
+    float2 corner = corners[id % 6];
+
+    // Spread the corner out along the camera's axes
+    float3 worldPosition = particle.position +
+        (cameraRight * corner.x + cameraUp * corner.y) * particle.size * 0.5f;
+
+    output.screenPosition = mul(projection, mul(view, float4(worldPosition, 1.0f)));
+    output.uv = corner * float2(0.5f, -0.5f) + 0.5f;
+    output.color = particle.color;
+
+    return output;
+}
@@ -3,19 +3,49 @@
 
 #define MAX_LIGHTS 128
 
+// Froxel grid (must match LightClusters.h)
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+
+// Lighting modes and lights per object (must match BufferStructs.h
+// and ObjectLights.h)
+#define LIGHTING_CONSTANT_BUFFER 0
+#define LIGHTING_CLUSTERED 1
+#define LIGHTING_PER_OBJECT 2
+#define OBJECT_LIGHTS_MAX 8
+
+// One object's lights, strongest first
+struct ObjectLightList
+{
+    uint count;
+    uint lights[OBJECT_LIGHTS_MAX];
+};
+
+// Per material
 cbuffer ExternalData : register(b0)
 {
     float4 colorTint;
-    float totalTime;
-    float3 intensities;
     float2 scale;
     float2 offset;
+}
+
+// Per frame
+cbuffer FrameData : register(b1)
+{
+    float totalTime;
+    float3 intensities;
     float3 cameraPos;
     float padding1;
-    //float3 ambientColor;
-    //float padding2;
     Light lights[MAX_LIGHTS];
     int lightCount;
+    
+    // Clustered or per object point and spot lights
+    float3 cameraForward;
+    float2 clusterScreenScale;
+    float clusterDepthScale;
+    float clusterDepthBias;
+    int lightingMode;
 }
 
 Texture2D Albedo : register(t0);
@@ -24,6 +54,14 @@ Texture2D RoughnessMap : register(t2);
 Texture2D MetalnessMap : register(t3);
 Texture2D ShadowMap : register(t4);
 
+// Every light, each cluster's range of the index list, and the
+// index list (see LightClusters.h), or each object's list
+// (see ObjectLights.h)
+StructuredBuffer<Light> SceneLights : register(t5);
+StructuredBuffer<uint2> ClusterRanges : register(t6);
+StructuredBuffer<uint> ClusterLightIndices : register(t7);
+StructuredBuffer<ObjectLightList> ObjectLights : register(t8);
+
 SamplerState BasicSampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
 
@@ -126,8 +164,43 @@ float4 main(VertexToPixel input) : SV_TARGET
         }
     }
     
-    // Gamma correction
-    float4 gammaCorrected = float4(pow(totalLight, 1.0f / 2.2f), 1);
+    // Point and spot lights from this pixel's cluster
+    if (lightingMode == LIGHTING_CLUSTERED)
+    {
+        float3 toCamera = normalize(cameraPos - input.worldPosition);
+        float viewDepth = dot(input.worldPosition - cameraPos, cameraForward);
+        uint2 tile = (uint2)min(input.screenPosition.xy * clusterScreenScale, float2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+        uint slice = (uint)clamp(log(max(viewDepth, 0.0001f)) * clusterDepthScale + clusterDepthBias, 0, LIGHT_CLUSTERS_Z - 1);
+        uint2 range = ClusterRanges[(slice * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x];
+        
+        for (uint j = 0; j < range.y; j++)
+        {
+            Light light = SceneLights[ClusterLightIndices[range.x + j]];
+            if (light.Type == LIGHT_TYPE_SPOT)
+                totalLight += SpotLight(light, finalNormal, input.worldPosition, toCamera, roughness, metalness, f0, albedoColor);
+            else
+                totalLight += PointLight(light, finalNormal, input.worldPosition, toCamera, roughness, metalness, f0, albedoColor);
+        }
+    }
+    
+    // Point and spot lights picked for this object
+    if (lightingMode == LIGHTING_PER_OBJECT)
+    {
+        float3 toCamera = normalize(cameraPos - input.worldPosition);
+        ObjectLightList list = ObjectLights[input.objectIndex];
+        
+        for (uint j = 0; j < list.count; j++)
+        {
+            Light light = SceneLights[list.lights[j]];
+            if (light.Type == LIGHT_TYPE_SPOT)
+                totalLight += SpotLight(light, finalNormal, input.worldPosition, toCamera, roughness, metalness, f0, albedoColor);
+            else
+                totalLight += PointLight(light, finalNormal, input.worldPosition, toCamera, roughness, metalness, f0, albedoColor);
+        }
+    }
+    
+    // Gamma correction (the tint's alpha is kept for transparent materials)
+    float4 gammaCorrected = float4(pow(totalLight, 1.0f / 2.2f), colorTint.a);
     
     return gammaCorrected;
 }
\ No newline at end of file
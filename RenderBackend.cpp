@@ -0,0 +1,61 @@
+#include "RenderBackend.h"
+
+unsigned int RenderFormatBytes(int format)
+{
+	switch (format)
+	{
+	case RENDER_FORMAT_R8:
+		return 1;
+	case RENDER_FORMAT_RG8:
+	case RENDER_FORMAT_R16F:
+		return 2;
+	case RENDER_FORMAT_RGBA8:
+	case RENDER_FORMAT_R32F:
+	case RENDER_FORMAT_DEPTH24_STENCIL8:
+	case RENDER_FORMAT_DEPTH32:
+		return 4;
+	case RENDER_FORMAT_RG32F:
+	case RENDER_FORMAT_RGBA16F:
+		return 8;
+	case RENDER_FORMAT_RGBA32F:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+bool RenderBackend::CreateStructuredBuffer(unsigned int stride, unsigned int count, BufferHandle* buffer, TextureHandle* view)
+{
+	DestroyTexture(*view);
+	DestroyBuffer(*buffer);
+	*view = TextureHandle();
+	*buffer = BufferHandle();
+
+	RenderBufferDesc desc = {};
+	desc.type = RENDER_BUFFER_STRUCTURED;
+	desc.size = stride * count;
+	desc.stride = stride;
+	desc.dynamic = true;
+	BufferHandle newBuffer = CreateBuffer(desc, 0);
+	if (newBuffer.IsNull())
+		return false;
+
+	TextureHandle newView = CreateBufferView(newBuffer);
+	if (newView.IsNull())
+	{
+		DestroyBuffer(newBuffer);
+		return false;
+	}
+
+	*buffer = newBuffer;
+	*view = newView;
+	return true;
+}
+
+// Getters
+RenderBackendStats RenderBackend::GetStats() { return stats; }
+
+void RenderBackend::ResetStats()
+{
+	stats = {};
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <string>
+#include "HandlePool.h"
+
+struct ImDrawData;
+
+// Tags for the handles the backend hands out (never defined;
+// each backend keeps its own records behind them)
+struct RenderBuffer;
+struct RenderTexture;
+struct RenderShader;
+struct RenderSampler;
+
+typedef Handle<RenderBuffer> BufferHandle;
+typedef Handle<RenderTexture> TextureHandle;	// Images, cube maps, targets, depth buffers and structured buffer views
+typedef Handle<RenderShader> ShaderHandle;
+typedef Handle<RenderSampler> SamplerHandle;
+
+// Shader stages
+#define RENDER_STAGE_VERTEX 0
+#define RENDER_STAGE_PIXEL 1
+
+// Buffer types
+#define RENDER_BUFFER_VERTEX 0
+#define RENDER_BUFFER_INDEX 1
+#define RENDER_BUFFER_CONSTANT 2
+#define RENDER_BUFFER_STRUCTURED 3
+
+// Index formats
+#define RENDER_INDEX_UNKNOWN 0
+#define RENDER_INDEX_16 1
+#define RENDER_INDEX_32 2
+
+// Texture formats
+#define RENDER_FORMAT_UNKNOWN 0
+#define RENDER_FORMAT_R8 1
+#define RENDER_FORMAT_RG8 2
+#define RENDER_FORMAT_R16F 3
+#define RENDER_FORMAT_RGBA8 4
+#define RENDER_FORMAT_R32F 5
+#define RENDER_FORMAT_RG32F 6
+#define RENDER_FORMAT_RGBA16F 7
+#define RENDER_FORMAT_RGBA32F 8
+#define RENDER_FORMAT_DEPTH24_STENCIL8 9
+#define RENDER_FORMAT_DEPTH32 10
+
+// How a texture can be bound (combine as needed)
+#define RENDER_TEXTURE_SHADER 1
+#define RENDER_TEXTURE_TARGET 2
+#define RENDER_TEXTURE_DEPTH 4
+
+// Vertex input a vertex shader expects
+#define RENDER_INPUT_NONE 0		// Generates its own vertices (fullscreen, particles)
+#define RENDER_INPUT_VERTEX 1	// One Vertex (Vertex.h) per vertex
+
+// Fixed function modes
+#define RENDER_BLEND_OPAQUE 0
+#define RENDER_BLEND_ALPHA 1
+#define RENDER_BLEND_MODES 2
+
+#define RENDER_DEPTH_DEFAULT 0		// Less, writes depth
+#define RENDER_DEPTH_LESS_EQUAL 1	// Read only; the sky, drawn at the far plane
+#define RENDER_DEPTH_READ_ONLY 2	// Less; transparent objects and particles
+#define RENDER_DEPTH_MODES 3
+
+#define RENDER_RASTER_DEFAULT 0
+#define RENDER_RASTER_CULL_FRONT 1	// Inside of the sky box
+#define RENDER_RASTER_CULL_NONE 2	// Camera facing quads
+#define RENDER_RASTER_SHADOW 3		// Depth biased, no depth clip
+#define RENDER_RASTER_MODES 4
+
+// Sampler kinds
+#define RENDER_SAMPLER_WRAP_ANISOTROPIC 0
+#define RENDER_SAMPLER_CLAMP_LINEAR 1
+#define RENDER_SAMPLER_SHADOW 2		// Comparison, outside the map is lit
+#define RENDER_SAMPLER_KINDS 3
+
+// Slots per shader stage, and targets (matches D3D11)
+#define RENDER_MAX_SHADER_RESOURCES 128
+#define RENDER_MAX_SAMPLERS 16
+#define RENDER_MAX_CONSTANT_BUFFERS 14
+#define RENDER_MAX_TARGETS 8
+
+// Biggest constant buffer (matches D3D11)
+#define RENDER_MAX_CONSTANT_BYTES 65536
+
+struct RenderBufferDesc
+{
+	int type;				// RENDER_BUFFER_*
+	unsigned int size;		// Bytes
+	unsigned int stride;	// Structured buffers only
+	bool dynamic;			// Replaced by UpdateBuffer(), otherwise immutable
+};
+
+struct RenderTextureDesc
+{
+	unsigned int width;
+	unsigned int height;
+	int format;				// RENDER_FORMAT_*
+	unsigned int flags;		// RENDER_TEXTURE_*
+};
+
+// What the backend did since the last ResetStats()
+struct RenderBackendStats
+{
+	unsigned int draws;
+	unsigned int binds;		// Shader, resource, buffer and target binds that reached the backend
+	unsigned int uploads;
+	size_t uploadBytes;
+	unsigned int errors;	// Calls a backend rejected
+};
+
+// Bytes per texel (0 for unknown formats)
+unsigned int RenderFormatBytes(int format);
+
+// --------------------------------------------------------
+// Where the state cache's binds end up
+// - The backend is one, but so is a recording stand-in, so
+//    the cache's filtering can be checked without a device
+// --------------------------------------------------------
+class StateTarget
+{
+public:
+	virtual ~StateTarget() {}
+
+	virtual void SetVertexShader(ShaderHandle vs) = 0;
+	virtual void SetPixelShader(ShaderHandle ps) = 0;
+	virtual void SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures) = 0;
+	virtual void SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers) = 0;
+	virtual void SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset) = 0;
+};
+
+// --------------------------------------------------------
+// Everything the renderer asks of the GPU
+//
+// - Resources are handles; a stale or null handle binds
+//    nothing (and the null backend reports it)
+// - Handles are plain values, so copies share a resource;
+//    whoever created it destroys it, and whatever is left
+//    goes when the backend does
+// - D3D11Backend does the work, NullBackend only checks the
+//    calls, so a frame can run without a device
+// --------------------------------------------------------
+class RenderBackend : public StateTarget
+{
+protected:
+	RenderBackendStats stats = {};
+
+public:
+	virtual ~RenderBackend() {}
+
+	// Buffers
+	virtual BufferHandle CreateBuffer(RenderBufferDesc desc, const void* initialData) = 0;
+	virtual TextureHandle CreateBufferView(BufferHandle buffer) = 0;	// Structured buffers, for shaders
+	virtual bool UpdateBuffer(BufferHandle buffer, const void* data, size_t bytes) = 0;	// Dynamic only, discards the old contents
+	virtual void DestroyBuffer(BufferHandle buffer) = 0;
+
+	// Textures
+	virtual TextureHandle CreateTexture(RenderTextureDesc desc) = 0;
+	virtual TextureHandle LoadTexture(const std::wstring& path) = 0;
+	virtual TextureHandle LoadCubemap(const std::wstring paths[6]) = 0;	// +X, -X, +Y, -Y, +Z, -Z
+	virtual void DestroyTexture(TextureHandle texture) = 0;
+	virtual TextureHandle GetBackBuffer() = 0;
+	virtual TextureHandle GetDepthBuffer() = 0;
+
+	// Shaders and samplers
+	virtual ShaderHandle LoadVertexShader(const std::wstring& path, int input) = 0;
+	virtual ShaderHandle LoadPixelShader(const std::wstring& path) = 0;
+	virtual SamplerHandle CreateSampler(int kind) = 0;
+
+	// Targets
+	virtual void SetRenderTargets(unsigned int count, const TextureHandle* targets, TextureHandle depth) = 0;
+	virtual void ClearRenderTarget(TextureHandle target, const float color[4]) = 0;
+	virtual void ClearDepth(TextureHandle depth, float value) = 0;
+	virtual void SetViewport(unsigned int width, unsigned int height) = 0;
+
+	// Fixed function state
+	virtual void SetBlendMode(int mode) = 0;
+	virtual void SetDepthMode(int mode) = 0;
+	virtual void SetRasterMode(int mode) = 0;
+
+	// Resources outside the state cache
+	virtual void SetVertexShaderResource(unsigned int slot, TextureHandle texture) = 0;
+	virtual void SetConstantBuffer(int stage, unsigned int slot, BufferHandle buffer) = 0;
+	virtual void SetConstants(int stage, unsigned int slot, const void* data, unsigned int size) = 0;	// Copied now, from a shared ring
+
+	// Drawing
+	virtual void Draw(unsigned int vertexCount) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void Present() = 0;
+
+	// ImGui renderer
+	virtual void InitUI() = 0;
+	virtual void NewUIFrame() = 0;
+	virtual void RenderUI(ImDrawData* drawData) = 0;
+	virtual void ShutDownUI() = 0;
+	virtual void* GetUITexture(TextureHandle texture) = 0;	// For ImGui::Image()
+
+	virtual const char* GetName() = 0;
+
+	// Makes a dynamic structured buffer and its view
+	// - Whatever the handles held is destroyed first; false
+	//    (and both null) if either fails
+	bool CreateStructuredBuffer(unsigned int stride, unsigned int count, BufferHandle* buffer, TextureHandle* view);
+
+	RenderBackendStats GetStats();
+	void ResetStats();
+};
+
+namespace Graphics
+{
+	// The backend everything draws through (set up by Main)
+	inline RenderBackend* Backend = nullptr;
+}
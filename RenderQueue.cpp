@@ -0,0 +1,227 @@
+#include "RenderQueue.h"
+#include "Timing.h"
+
+#include <algorithm>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const int SortPasses = 64 / RENDER_SORT_RADIX_BITS;
+	const unsigned int SortBuckets = 1u << RENDER_SORT_RADIX_BITS;
+	const uint64_t DepthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+
+	inline uint64_t Field(uint64_t value, int bits)
+	{
+		return value & ((1ull << bits) - 1);
+	}
+
+	// Shader, material and mesh back out of a key (where they
+	// sit depends on the pass)
+	void DecodeState(uint64_t key, uint64_t* shader, uint64_t* material, uint64_t* mesh)
+	{
+		int top = 64 - RENDER_KEY_PASS_BITS;
+		if (RenderQueue::GetPass(key) == RENDER_PASS_TRANSPARENT)
+			top -= RENDER_KEY_DEPTH_BITS;
+
+		*shader = Field(key >> (top - RENDER_KEY_SHADER_BITS), RENDER_KEY_SHADER_BITS);
+		top -= RENDER_KEY_SHADER_BITS;
+		*material = Field(key >> (top - RENDER_KEY_MATERIAL_BITS), RENDER_KEY_MATERIAL_BITS);
+		top -= RENDER_KEY_MATERIAL_BITS;
+		*mesh = Field(key >> (top - RENDER_KEY_MESH_BITS), RENDER_KEY_MESH_BITS);
+	}
+}
+
+RenderQueue::RenderQueue() :
+	depthScale(1.0f),
+	nextMaterialId(0),
+	nextMeshId(0),
+	frame(0),
+	stats{}
+{
+}
+
+void RenderQueue::Begin(float farPlane)
+{
+	keys.clear();
+	items.clear();
+	depthScale = farPlane > 0.0f ? 1.0f / farPlane : 1.0f;
+
+	// Every slot's frame id goes stale at once
+	frame++;
+	nextMaterialId = 0;
+	nextMeshId = 0;
+}
+
+unsigned int RenderQueue::GetShaderID(MaterialHandle handle, Material* material)
+{
+	// Usually a straight lookup by material slot, as long as the
+	// material still uses the shaders the slot's id was for
+	unsigned int slot = handle.Index();
+	std::pair<unsigned int, unsigned int> shaders(material->GetVertexShader().value, material->GetPixelShader().value);
+	if (slot < materialShaders.size() && materialShaders[slot] == shaders)
+		return materialShaderIds[slot];
+
+	auto found = shaderIds.find(shaders);
+	unsigned int id;
+	if (found != shaderIds.end())
+	{
+		id = found->second;
+	}
+	else
+	{
+		id = (unsigned int)Field(shaderIds.size(), RENDER_KEY_SHADER_BITS);
+		shaderIds[shaders] = id;
+	}
+
+	if (slot >= materialShaders.size())
+	{
+		materialShaders.resize(slot + 1, std::pair<unsigned int, unsigned int>(0, 0));
+		materialShaderIds.resize(slot + 1, 0);
+	}
+	materialShaders[slot] = shaders;
+	materialShaderIds[slot] = id;
+	return id;
+}
+
+unsigned int RenderQueue::GetFrameID(unsigned int handle, unsigned int slot, std::vector<FrameId>& ids, unsigned int* nextId)
+{
+	if (slot >= ids.size())
+		ids.resize(slot + 1, FrameId{ 0, 0, 0 });
+
+	FrameId& entry = ids[slot];
+	if (entry.frame != frame || entry.handle != handle)
+	{
+		entry.handle = handle;
+		entry.frame = frame;
+		entry.id = (*nextId)++;
+	}
+	return entry.id;
+}
+
+uint64_t RenderQueue::MakeKey(MaterialHandle materialHandle, Material* material, MeshHandle meshHandle, int lod, float viewDepth)
+{
+	int pass = material->GetColorTint().w < 1.0f ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+	unsigned int materialId = GetFrameID(materialHandle.value, materialHandle.Index(), materialFrameIds, &nextMaterialId);
+	unsigned int meshId = GetFrameID(meshHandle.value, meshHandle.Index(), meshFrameIds, &nextMeshId);
+	return MakeKey(pass, GetShaderID(materialHandle, material), materialId, meshId, lod, viewDepth);
+}
+
+uint64_t RenderQueue::MakeKey(int pass, unsigned int shader, unsigned int material, unsigned int mesh, int lod, float viewDepth)
+{
+	uint64_t depth = (uint64_t)(std::clamp(viewDepth * depthScale, 0.0f, 1.0f) * DepthMax);
+	uint64_t state = Field(shader, RENDER_KEY_SHADER_BITS);
+	state = (state << RENDER_KEY_MATERIAL_BITS) | Field(material, RENDER_KEY_MATERIAL_BITS);
+	state = (state << RENDER_KEY_MESH_BITS) | Field(mesh, RENDER_KEY_MESH_BITS);
+	state = (state << RENDER_KEY_LOD_BITS) | Field(std::max(lod, 0), RENDER_KEY_LOD_BITS);
+
+	uint64_t key = Field(pass, RENDER_KEY_PASS_BITS) << (64 - RENDER_KEY_PASS_BITS);
+	if (pass == RENDER_PASS_TRANSPARENT)
+		key |= ((DepthMax - depth) << (64 - RENDER_KEY_PASS_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+	else
+		key |= (state << RENDER_KEY_DEPTH_BITS) | depth;
+	return key;
+}
+
+void RenderQueue::Add(uint64_t key, unsigned int item)
+{
+	keys.push_back(key);
+	items.push_back(item);
+}
+
+void RenderQueue::Sort()
+{
+	unsigned int n = (unsigned int)keys.size();
+	stats = {};
+	stats.draws = n;
+	CountStateChanges(&stats.shaderChangesUnsorted, &stats.materialChangesUnsorted, &stats.meshChangesUnsorted);
+
+	auto start = Clock::now();
+
+	// Least significant digit first radix sort of (key, item),
+	// with every digit's histogram built in one read
+	unsigned int histograms[SortPasses][SortBuckets] = {};
+	for (unsigned int i = 0; i < n; i++)
+	{
+		uint64_t key = keys[i];
+		for (int pass = 0; pass < SortPasses; pass++)
+			histograms[pass][Field(key >> (pass * RENDER_SORT_RADIX_BITS), RENDER_SORT_RADIX_BITS)]++;
+		if (GetPass(key) == RENDER_PASS_TRANSPARENT)
+			stats.transparentDraws++;
+	}
+
+	scratchKeys.resize(n);
+	scratchItems.resize(n);
+	for (int pass = 0; pass < SortPasses && n > 1; pass++)
+	{
+		int shift = pass * RENDER_SORT_RADIX_BITS;
+		unsigned int* histogram = histograms[pass];
+
+		// Every key has the same digit here: the pass wouldn't move anything
+		if (histogram[Field(keys[0] >> shift, RENDER_SORT_RADIX_BITS)] == n)
+			continue;
+
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < SortBuckets; b++)
+		{
+			unsigned int bucket = histogram[b];
+			histogram[b] = offset;
+			offset += bucket;
+		}
+
+		for (unsigned int i = 0; i < n; i++)
+		{
+			uint64_t key = keys[i];
+			unsigned int to = histogram[Field(key >> shift, RENDER_SORT_RADIX_BITS)]++;
+			scratchKeys[to] = key;
+			scratchItems[to] = items[i];
+		}
+		keys.swap(scratchKeys);
+		items.swap(scratchItems);
+		stats.sortPasses++;
+	}
+
+	stats.sortMs = ElapsedMs(start);
+	CountStateChanges(&stats.shaderChanges, &stats.materialChanges, &stats.meshChanges);
+}
+
+void RenderQueue::CountStateChanges(unsigned int* shaderChanges, unsigned int* materialChanges, unsigned int* meshChanges)
+{
+	*shaderChanges = 0;
+	*materialChanges = 0;
+	*meshChanges = 0;
+
+	// The first draw binds everything
+	uint64_t shader = UINT64_MAX, material = UINT64_MAX, mesh = UINT64_MAX;
+	for (uint64_t key : keys)
+	{
+		uint64_t keyShader, keyMaterial, keyMesh;
+		DecodeState(key, &keyShader, &keyMaterial, &keyMesh);
+		*shaderChanges += keyShader != shader;
+		*materialChanges += keyMaterial != material;
+		*meshChanges += keyMesh != mesh;
+		shader = keyShader;
+		material = keyMaterial;
+		mesh = keyMesh;
+	}
+}
+
+int RenderQueue::GetPass(uint64_t key)
+{
+	return (int)(key >> (64 - RENDER_KEY_PASS_BITS));
+}
+
+uint64_t RenderQueue::GetState(uint64_t key)
+{
+	const int stateBits = RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS + RENDER_KEY_LOD_BITS;
+	uint64_t pass = (uint64_t)GetPass(key) << stateBits;
+	if (GetPass(key) == RENDER_PASS_TRANSPARENT)
+		return pass | Field(key, stateBits);
+	return pass | Field(key >> RENDER_KEY_DEPTH_BITS, stateBits);
+}
+
+// Getters
+unsigned int RenderQueue::GetCount() { return (unsigned int)keys.size(); }
+const uint64_t* RenderQueue::GetKeys() { return keys.data(); }
+const unsigned int* RenderQueue::GetItems() { return items.data(); }
+RenderQueueStats RenderQueue::GetStats() { return stats; }
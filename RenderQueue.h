@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Resources.h"
+
+// Passes, in the order they're drawn (the top bits of each key)
+#define RENDER_PASS_OPAQUE 0
+#define RENDER_PASS_TRANSPARENT 1
+
+// Key fields, from the top:
+//  opaque:       pass | shader | material | mesh | lod | depth (near to far)
+//  transparent:  pass | depth (far to near) | shader | material | mesh | lod
+// (material and mesh handles have more index bits than their fields,
+// so keys hold small per-frame ids instead, see MakeKey())
+#define RENDER_KEY_PASS_BITS 2
+#define RENDER_KEY_SHADER_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_MESH_BITS 16
+#define RENDER_KEY_LOD_BITS 2
+#define RENDER_KEY_DEPTH_BITS 18
+
+// Bits per radix sort pass
+#define RENDER_SORT_RADIX_BITS 8
+
+// What the last frame's queue did
+struct RenderQueueStats
+{
+	unsigned int draws;
+	unsigned int transparentDraws;
+	unsigned int sortPasses;				// Radix passes actually run (uniform bytes are skipped)
+	double sortMs;
+
+	// State changes if the draws ran in submission order, and sorted
+	unsigned int shaderChangesUnsorted;
+	unsigned int materialChangesUnsorted;
+	unsigned int meshChangesUnsorted;
+	unsigned int shaderChanges;
+	unsigned int materialChanges;
+	unsigned int meshChanges;
+};
+
+// --------------------------------------------------------
+// A frame's draws, sorted to keep state changes down
+//
+// - Each draw is a 64-bit key plus a caller defined item
+//    (an index into whatever the caller draws from)
+// - Opaque draws group by shader, then material, then mesh,
+//    and go near to far within a group; transparent draws
+//    come after, far to near, for blending
+// - Sort() is an LSD radix sort over the keys that skips
+//    the bytes every key shares
+// --------------------------------------------------------
+class RenderQueue
+{
+private:
+	std::vector<uint64_t> keys;
+	std::vector<unsigned int> items;
+	std::vector<uint64_t> scratchKeys;
+	std::vector<unsigned int> scratchItems;
+	float depthScale;
+
+	// Small ids for vertex/pixel shader pairs, and the id each
+	// material slot last mapped to (with the pair it was for, so
+	// a material that swaps shaders gets a new id)
+	std::map<std::pair<unsigned int, unsigned int>, unsigned int> shaderIds;
+	std::vector<std::pair<unsigned int, unsigned int>> materialShaders;
+	std::vector<unsigned int> materialShaderIds;
+
+	// Per-frame ids for material and mesh handles, in the order
+	// they're first seen (a slot's id is only valid for the
+	// frame and handle it was given for)
+	struct FrameId
+	{
+		unsigned int handle;
+		unsigned int frame;
+		unsigned int id;
+	};
+	std::vector<FrameId> materialFrameIds;
+	std::vector<FrameId> meshFrameIds;
+	unsigned int nextMaterialId;
+	unsigned int nextMeshId;
+	unsigned int frame;
+
+	RenderQueueStats stats;
+
+	void CountStateChanges(unsigned int* shaderChanges, unsigned int* materialChanges, unsigned int* meshChanges);
+	unsigned int GetFrameID(unsigned int handle, unsigned int slot, std::vector<FrameId>& ids, unsigned int* nextId);
+
+public:
+	RenderQueue();
+
+	// Empties the queue; depths are stored relative to farPlane
+	void Begin(float farPlane);
+
+	// Id of the material's shader pair (stable for the queue's life)
+	unsigned int GetShaderID(MaterialHandle handle, Material* material);
+
+	// Key for one draw; transparency comes from the tint's alpha
+	//  - Materials and meshes get ids in the order this frame first
+	//    queues them, so they only alias past 65536 of each per frame
+	uint64_t MakeKey(MaterialHandle materialHandle, Material* material, MeshHandle meshHandle, int lod, float viewDepth);
+	uint64_t MakeKey(int pass, unsigned int shader, unsigned int material, unsigned int mesh, int lod, float viewDepth);
+
+	void Add(uint64_t key, unsigned int item);
+	void Sort();
+
+	static int GetPass(uint64_t key);
+	static uint64_t GetState(uint64_t key);		// Pass, shader, material, mesh and LOD (no depth)
+
+	// Getters
+	unsigned int GetCount();
+	const uint64_t* GetKeys();			// Sorted after Sort()
+	const unsigned int* GetItems();		// In the same order as the keys
+	RenderQueueStats GetStats();
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "HandlePool.h"
+#include "Mesh.h"
+#include "Transform.h"
+#include "Material.h"
+
+// Handle types for the shared resource pools
+typedef Handle<Mesh> MeshHandle;
+typedef Handle<Transform> TransformHandle;
+typedef Handle<Material> MaterialHandle;
+
+namespace Resources
+{
+	// --- GLOBAL POOLS ---
+	inline Pool<Mesh> Meshes;
+	inline Pool<Transform> Transforms;
+	inline Pool<Material> Materials;
+
+	// Releases everything in the pools (call before shutting down graphics)
+	inline void Clear()
+	{
+		Meshes.Clear();
+		Transforms.Clear();
+		Materials.Clear();
+	}
+}
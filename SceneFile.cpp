@@ -0,0 +1,371 @@
+#include "SceneFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace DirectX;
+
+SceneFile::SceneFile() :
+	file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	view(0),
+	size(0),
+	header(0),
+	meshes(0),
+	materials(0),
+	entities(0),
+	lights(0),
+	strings(0)
+{
+}
+
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+bool SceneFile::Open(const std::string& path)
+{
+	Close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SceneFileHeader))
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+
+	view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view || !Validate())
+	{
+		printf("Scene file %s is not a valid version %i scene\n", path.c_str(), SCENE_FILE_VERSION);
+		Close();
+		return false;
+	}
+
+	// The only "loading" there is: offsets to pointers
+	meshes = (const SceneAssetRef*)(view + header->meshOffset);
+	materials = (const SceneAssetRef*)(view + header->materialOffset);
+	entities = (const SceneEntityRecord*)(view + header->entityOffset);
+	lights = (const Light*)(view + header->lightOffset);
+	strings = (const char*)(view + header->stringOffset);
+	return true;
+}
+
+bool SceneFile::Validate()
+{
+	header = (const SceneFileHeader*)view;
+	if (header->magic != SCENE_FILE_MAGIC ||
+		header->version != SCENE_FILE_VERSION ||
+		header->fileSize != size)
+		return false;
+
+	// Every section has to fit in the file
+	auto fits = [&](unsigned int offset, size_t count, size_t stride)
+	{
+		return offset % SCENE_FILE_ALIGNMENT == 0 && offset <= size && count * stride <= size - offset;
+	};
+	if (!fits(header->meshOffset, header->meshCount, sizeof(SceneAssetRef)) ||
+		!fits(header->materialOffset, header->materialCount, sizeof(SceneAssetRef)) ||
+		!fits(header->entityOffset, header->entityCount, sizeof(SceneEntityRecord)) ||
+		!fits(header->lightOffset, header->lightCount, sizeof(Light)) ||
+		!fits(header->stringOffset, header->stringSize, 1))
+		return false;
+
+	// Strings must be terminated, and every reference must land inside their table
+	const char* table = (const char*)(view + header->stringOffset);
+	if (header->stringSize == 0 || table[header->stringSize - 1] != 0)
+		return false;
+
+	const SceneAssetRef* refs[2] = {
+		(const SceneAssetRef*)(view + header->meshOffset),
+		(const SceneAssetRef*)(view + header->materialOffset) };
+	unsigned int refCounts[2] = { header->meshCount, header->materialCount };
+	for (int r = 0; r < 2; r++)
+	{
+		for (unsigned int i = 0; i < refCounts[r]; i++)
+		{
+			if (refs[r][i].name >= header->stringSize ||
+				(refs[r][i].path != SCENE_NONE && refs[r][i].path >= header->stringSize))
+				return false;
+		}
+	}
+
+	const SceneEntityRecord* records = (const SceneEntityRecord*)(view + header->entityOffset);
+	for (unsigned int i = 0; i < header->entityCount; i++)
+	{
+		if (records[i].mesh >= header->meshCount || records[i].material >= header->materialCount)
+			return false;
+	}
+
+	return true;
+}
+
+void SceneFile::Close()
+{
+	if (view)
+		UnmapViewOfFile(view);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	view = 0;
+	size = 0;
+	header = 0;
+	meshes = 0;
+	materials = 0;
+	entities = 0;
+	lights = 0;
+	strings = 0;
+}
+
+bool SceneFile::IsOpen()
+{
+	return strings != 0;
+}
+
+unsigned int SceneFile::GetMeshCount()
+{
+	return header->meshCount;
+}
+
+const char* SceneFile::GetMeshName(unsigned int index)
+{
+	return strings + meshes[index].name;
+}
+
+const char* SceneFile::GetMeshPath(unsigned int index)
+{
+	if (meshes[index].path == SCENE_NONE)
+		return "";
+	return strings + meshes[index].path;
+}
+
+unsigned int SceneFile::GetMaterialCount()
+{
+	return header->materialCount;
+}
+
+const char* SceneFile::GetMaterialName(unsigned int index)
+{
+	return strings + materials[index].name;
+}
+
+unsigned int SceneFile::GetEntityCount()
+{
+	return header->entityCount;
+}
+
+const SceneEntityRecord* SceneFile::GetEntities()
+{
+	return entities;
+}
+
+unsigned int SceneFile::GetLightCount()
+{
+	return header->lightCount;
+}
+
+const Light* SceneFile::GetLights()
+{
+	return lights;
+}
+
+size_t SceneFile::GetFileSize()
+{
+	return size;
+}
+
+bool SceneFile::ParseText(const std::string& textPath, SceneData* scene)
+{
+	std::ifstream in(textPath);
+	if (!in.is_open())
+		return false;
+
+	auto find = [](const std::vector<std::string>& names, const std::string& name)
+	{
+		for (size_t i = 0; i < names.size(); i++)
+			if (names[i] == name)
+				return (unsigned int)i;
+		return (unsigned int)SCENE_NONE;
+	};
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		std::istringstream tokens(line);
+		std::string type;
+		if (!(tokens >> type))
+			continue;
+
+		bool ok = true;
+		if (type == "mesh")
+		{
+			std::string name, path;
+			ok = (bool)(tokens >> std::quoted(name) >> std::quoted(path));
+			scene->meshNames.push_back(name);
+			scene->meshPaths.push_back(path);
+		}
+		else if (type == "material")
+		{
+			std::string name;
+			ok = (bool)(tokens >> std::quoted(name));
+			scene->materialNames.push_back(name);
+		}
+		else if (type == "entity")
+		{
+			std::string meshName, materialName;
+			SceneEntityRecord e = {};
+			ok = (bool)(tokens >> std::quoted(meshName) >> std::quoted(materialName) >>
+				e.position.x >> e.position.y >> e.position.z >>
+				e.pitchYawRoll.x >> e.pitchYawRoll.y >> e.pitchYawRoll.z >>
+				e.scale.x >> e.scale.y >> e.scale.z);
+			e.mesh = find(scene->meshNames, meshName);
+			e.material = find(scene->materialNames, materialName);
+			ok = ok && e.mesh != SCENE_NONE && e.material != SCENE_NONE;
+			scene->entities.push_back(e);
+		}
+		else if (type == "light")
+		{
+			std::string kind;
+			Light l = {};
+			tokens >> kind;
+			if (kind == "directional")
+			{
+				l.Type = LIGHT_TYPE_DIRECTIONAL;
+				ok = (bool)(tokens >> l.Direction.x >> l.Direction.y >> l.Direction.z >>
+					l.Color.x >> l.Color.y >> l.Color.z >> l.Intensity);
+			}
+			else if (kind == "point")
+			{
+				l.Type = LIGHT_TYPE_POINT;
+				ok = (bool)(tokens >> l.Position.x >> l.Position.y >> l.Position.z >>
+					l.Color.x >> l.Color.y >> l.Color.z >> l.Intensity >> l.Range);
+			}
+			else if (kind == "spot")
+			{
+				l.Type = LIGHT_TYPE_SPOT;
+				ok = (bool)(tokens >> l.Position.x >> l.Position.y >> l.Position.z >>
+					l.Direction.x >> l.Direction.y >> l.Direction.z >>
+					l.Color.x >> l.Color.y >> l.Color.z >> l.Intensity >> l.Range >>
+					l.SpotInnerAngle >> l.SpotOuterAngle);
+			}
+			else
+				ok = false;
+			scene->lights.push_back(l);
+		}
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			printf("%s(%i): can't read \"%s\"\n", textPath.c_str(), lineNumber, line.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool SceneFile::Write(const SceneData& scene, const std::string& binaryPath)
+{
+	auto align = [](size_t offset) { return (offset + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT; };
+
+	// String table (every name is stored once per reference, which is fine
+	// - there are only ever a handful of meshes and materials)
+	std::string table;
+	auto addString = [&](const std::string& s)
+	{
+		unsigned int offset = (unsigned int)table.size();
+		table.append(s.c_str(), s.size() + 1);
+		return offset;
+	};
+
+	std::vector<SceneAssetRef> meshRefs;
+	for (size_t i = 0; i < scene.meshNames.size(); i++)
+	{
+		unsigned int name = addString(scene.meshNames[i]);
+		unsigned int path = addString(scene.meshPaths[i]);
+		meshRefs.push_back({ name, path });
+	}
+
+	std::vector<SceneAssetRef> materialRefs;
+	for (auto& name : scene.materialNames)
+		materialRefs.push_back({ addString(name), SCENE_NONE });
+
+	if (table.empty())
+		table.push_back(0);
+
+	// Lay out the sections
+	SceneFileHeader header = {};
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.meshCount = (unsigned int)meshRefs.size();
+	header.materialCount = (unsigned int)materialRefs.size();
+	header.entityCount = (unsigned int)scene.entities.size();
+	header.lightCount = (unsigned int)scene.lights.size();
+	header.stringSize = (unsigned int)table.size();
+
+	size_t offset = align(sizeof(SceneFileHeader));
+	header.meshOffset = (unsigned int)offset;
+	offset = align(offset + meshRefs.size() * sizeof(SceneAssetRef));
+	header.materialOffset = (unsigned int)offset;
+	offset = align(offset + materialRefs.size() * sizeof(SceneAssetRef));
+	header.entityOffset = (unsigned int)offset;
+	offset = align(offset + scene.entities.size() * sizeof(SceneEntityRecord));
+	header.lightOffset = (unsigned int)offset;
+	offset = align(offset + scene.lights.size() * sizeof(Light));
+	header.stringOffset = (unsigned int)offset;
+	offset += table.size();
+	header.fileSize = (unsigned int)offset;
+
+	// Assemble in memory and write in one go
+	std::vector<unsigned char> bytes(offset, 0);
+	auto copy = [&](unsigned int at, const void* data, size_t count)
+	{
+		if (count > 0)
+			memcpy(&bytes[at], data, count);
+	};
+	copy(0, &header, sizeof(header));
+	copy(header.meshOffset, meshRefs.data(), meshRefs.size() * sizeof(SceneAssetRef));
+	copy(header.materialOffset, materialRefs.data(), materialRefs.size() * sizeof(SceneAssetRef));
+	copy(header.entityOffset, scene.entities.data(), scene.entities.size() * sizeof(SceneEntityRecord));
+	copy(header.lightOffset, scene.lights.data(), scene.lights.size() * sizeof(Light));
+	copy(header.stringOffset, table.data(), table.size());
+
+	std::ofstream out(binaryPath, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+	out.write((const char*)bytes.data(), bytes.size());
+	return out.good();
+}
+
+bool SceneFile::ConvertText(const std::string& textPath, const std::string& binaryPath)
+{
+	SceneData scene;
+	return ParseText(textPath, &scene) && Write(scene, binaryPath);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "Lights.h"
+
+#define SCENE_FILE_MAGIC 0x4E454353	// "SCEN"
+#define SCENE_FILE_VERSION 1
+#define SCENE_FILE_ALIGNMENT 16			// Every section starts on this boundary
+#define SCENE_NONE 0xFFFFFFFF
+
+// --------------------------------------------------------
+// Binary scene layout
+//
+// - One header followed by tightly packed sections, each
+//    addressed by a byte offset from the start of the file
+// - Everything is stored exactly as it's used in memory, so
+//    loading is just mapping the file and turning offsets
+//    into pointers (no parsing, no copies)
+// - Names and paths live in a string table of null-terminated
+//    strings, referenced by offset into that table
+// --------------------------------------------------------
+struct SceneFileHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int fileSize;
+
+	unsigned int meshCount;
+	unsigned int materialCount;
+	unsigned int entityCount;
+	unsigned int lightCount;
+
+	unsigned int meshOffset;		// SceneAssetRef[meshCount]
+	unsigned int materialOffset;	// SceneAssetRef[materialCount]
+	unsigned int entityOffset;		// SceneEntityRecord[entityCount]
+	unsigned int lightOffset;		// Light[lightCount]
+	unsigned int stringOffset;
+	unsigned int stringSize;
+};
+
+// A mesh or material the scene refers to by name
+struct SceneAssetRef
+{
+	unsigned int name;		// String table offsets
+	unsigned int path;		// SCENE_NONE for materials (they're defined in code)
+};
+
+struct SceneEntityRecord
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 pitchYawRoll;
+	DirectX::XMFLOAT3 scale;
+	unsigned int mesh;		// Index into the scene's meshes
+	unsigned int material;	// Index into the scene's materials
+};
+
+// An editable scene, as parsed from text or built in code
+struct SceneData
+{
+	std::vector<std::string> meshNames;
+	std::vector<std::string> meshPaths;
+	std::vector<std::string> materialNames;
+	std::vector<SceneEntityRecord> entities;
+	std::vector<Light> lights;
+};
+
+// --------------------------------------------------------
+// A read-only, memory-mapped binary scene file
+//
+// The text format (one item per line, # starts a comment):
+//   mesh <name> <obj path>
+//   material <name>
+//   entity <mesh> <material> px py pz pitch yaw roll sx sy sz
+//   light directional dx dy dz r g b intensity
+//   light point px py pz r g b intensity range
+//   light spot px py pz dx dy dz r g b intensity range inner outer
+// Names may be quoted if they contain spaces; angles are radians
+// --------------------------------------------------------
+class SceneFile
+{
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const unsigned char* view;
+	size_t size;
+
+	// Fixed up section pointers into the view
+	const SceneFileHeader* header;
+	const SceneAssetRef* meshes;
+	const SceneAssetRef* materials;
+	const SceneEntityRecord* entities;
+	const Light* lights;
+	const char* strings;
+
+	bool Validate();
+
+public:
+	SceneFile();
+	~SceneFile();
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen();
+
+	// Getters (only valid while the file is open)
+	unsigned int GetMeshCount();
+	const char* GetMeshName(unsigned int index);
+	const char* GetMeshPath(unsigned int index);	// Empty if the mesh has no path
+	unsigned int GetMaterialCount();
+	const char* GetMaterialName(unsigned int index);
+	unsigned int GetEntityCount();
+	const SceneEntityRecord* GetEntities();
+	unsigned int GetLightCount();
+	const Light* GetLights();
+	size_t GetFileSize();
+
+	// Authoring side
+	static bool ParseText(const std::string& textPath, SceneData* scene);
+	static bool Write(const SceneData& scene, const std::string& binaryPath);
+	static bool ConvertText(const std::string& textPath, const std::string& binaryPath);
+};
@@ -0,0 +1,233 @@
+#include "SceneGenerator.h"
+#include "SeededRandom.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Picks an index with the given relative weights (equal if there are none)
+	struct WeightedPick
+	{
+		std::vector<float> cumulative;
+
+		WeightedPick(const std::vector<float>& weights, size_t count)
+		{
+			float total = 0.0f;
+			for (size_t i = 0; i < count; i++)
+			{
+				total += i < weights.size() ? std::max(weights[i], 0.0f) : (weights.empty() ? 1.0f : 0.0f);
+				cumulative.push_back(total);
+			}
+			if (total <= 0.0f)
+				for (size_t i = 0; i < count; i++)
+					cumulative[i] = (float)(i + 1);
+		}
+
+		unsigned int Pick(SeededRandom& rng)
+		{
+			float r = rng.Next() * cumulative.back();
+			return (unsigned int)(std::upper_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin());
+		}
+	};
+}
+
+SceneGeneratorSettings SceneGenerator::DefaultSettings(int entityCount, int layout, unsigned int seed)
+{
+	SceneGeneratorSettings s = {};
+	s.seed = seed;
+	s.entityCount = entityCount;
+	s.layout = layout;
+
+	// Same density as the spatial benchmarks: 10k entities in a 100 unit cube
+	s.worldHalfSize = 50.0f * std::cbrt(std::max(entityCount, 1) / 10000.0f);
+	s.minHeight = -s.worldHalfSize;
+	s.maxHeight = s.worldHalfSize;
+
+	// Clusters about 8x as dense as the world on average, hot spots about 20x
+	s.clusterCount = std::max(1, entityCount / 100);
+	s.clusterRadius = s.worldHalfSize * 0.6f / std::cbrt((float)s.clusterCount);
+	s.hotSpotCount = 4;
+	s.hotSpotRadius = s.worldHalfSize * 0.18f;
+	s.hotSpotFraction = 0.25f;
+
+	s.meshNames = { "Cube", "Cylinder", "Helix", "Sphere", "Torus" };
+	s.meshPaths = {
+		"../../Assets/Meshes/cube.obj",
+		"../../Assets/Meshes/cylinder.obj",
+		"../../Assets/Meshes/helix.obj",
+		"../../Assets/Meshes/sphere.obj",
+		"../../Assets/Meshes/torus.obj" };
+	s.materialNames = { "Bronze", "Cobblestone", "Floor", "Paint", "Rough", "Scratched", "Wood" };
+	s.minScale = 0.25f;
+	s.maxScale = 1.5f;
+
+	s.pointLightCount = 64;
+	s.spotLightCount = 32;
+	s.lightRange = 10.0f;
+
+	s.movingEntityFraction = 0.1f;
+	s.spinningEntityFraction = 0.1f;
+	s.movingLightFraction = 0.25f;
+	s.maxSpeed = 2.0f;
+	s.maxSpin = XM_PI;
+	return s;
+}
+
+void SceneGenerator::Generate(const SceneGeneratorSettings& settings, GeneratedScene* scene)
+{
+	SeededRandom rng = { settings.seed * 2654435761u + 1 };
+	float half = settings.worldHalfSize;
+	XMFLOAT3 boundsMin(-half, settings.minHeight, -half);
+	XMFLOAT3 boundsMax(half, settings.maxHeight, half);
+
+	auto randomPoint = [&]()
+	{
+		return XMFLOAT3(
+			rng.Range(boundsMin.x, boundsMax.x),
+			rng.Range(boundsMin.y, boundsMax.y),
+			rng.Range(boundsMin.z, boundsMax.z));
+	};
+	auto around = [&](XMFLOAT3 center, float radius)
+	{
+		XMFLOAT3 offset = rng.InSphere();
+		return XMFLOAT3(
+			std::clamp(center.x + offset.x * radius, boundsMin.x, boundsMax.x),
+			std::clamp(center.y + offset.y * radius, boundsMin.y, boundsMax.y),
+			std::clamp(center.z + offset.z * radius, boundsMin.z, boundsMax.z));
+	};
+	auto velocity = [&]()
+	{
+		XMFLOAT3 direction = rng.InSphere();
+		XMVECTOR v = XMVector3Normalize(XMLoadFloat3(&direction));
+		XMStoreFloat3(&direction, XMVectorScale(v, rng.Range(0.25f, 1.0f) * settings.maxSpeed));
+		return direction;
+	};
+
+	// Layout anchors come first so they don't depend on the entity count
+	std::vector<XMFLOAT3> clusters;
+	for (int i = 0; i < settings.clusterCount; i++)
+		clusters.push_back(randomPoint());
+	std::vector<XMFLOAT3> hotSpots;
+	for (int i = 0; i < settings.hotSpotCount; i++)
+		hotSpots.push_back(randomPoint());
+
+	SceneData& data = scene->data;
+	data = SceneData();
+	data.meshNames = settings.meshNames;
+	data.meshPaths = settings.meshPaths;
+	data.materialNames = settings.materialNames;
+
+	WeightedPick meshPick(settings.meshWeights, settings.meshNames.size());
+	WeightedPick materialPick(settings.materialWeights, settings.materialNames.size());
+
+	// Entities
+	data.entities.resize(settings.entityCount);
+	scene->entityVelocities.assign(settings.entityCount, XMFLOAT3(0, 0, 0));
+	scene->movingEntityCount = 0;
+	for (int i = 0; i < settings.entityCount; i++)
+	{
+		SceneEntityRecord& e = data.entities[i];
+		switch (settings.layout)
+		{
+		case SCENE_LAYOUT_CLUSTERED:
+			e.position = clusters.empty() ? randomPoint() :
+				around(clusters[rng.Index((int)clusters.size())], settings.clusterRadius);
+			break;
+
+		case SCENE_LAYOUT_HOTSPOTS:
+			e.position = !hotSpots.empty() && rng.Next() < settings.hotSpotFraction ?
+				around(hotSpots[rng.Index((int)hotSpots.size())], settings.hotSpotRadius) :
+				randomPoint();
+			break;
+
+		default:
+			e.position = randomPoint();
+			break;
+		}
+
+		float scale = rng.Range(settings.minScale, settings.maxScale);
+		e.pitchYawRoll = XMFLOAT3(0.0f, rng.Range(0.0f, XM_2PI), 0.0f);
+		e.scale = XMFLOAT3(scale, scale, scale);
+		e.mesh = meshPick.Pick(rng);
+		e.material = materialPick.Pick(rng);
+
+		if (rng.Next() < settings.movingEntityFraction)
+		{
+			scene->entityVelocities[i] = velocity();
+			scene->movingEntityCount++;
+		}
+	}
+
+	// Lights: a sun, then point and spot lights scattered through the world
+	Light sun = {};
+	sun.Type = LIGHT_TYPE_DIRECTIONAL;
+	sun.Direction = XMFLOAT3(0.0f, -0.707f, 0.707f);
+	sun.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	sun.Intensity = 0.5f;
+	data.lights.push_back(sun);
+
+	int lightCount = settings.pointLightCount + settings.spotLightCount;
+	for (int i = 0; i < lightCount; i++)
+	{
+		Light light = {};
+		light.Type = i < settings.pointLightCount ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+		light.Position = randomPoint();
+		light.Color = XMFLOAT3(rng.Range(0.2f, 1.0f), rng.Range(0.2f, 1.0f), rng.Range(0.2f, 1.0f));
+		light.Intensity = rng.Range(0.5f, 2.0f);
+		light.Range = settings.lightRange;
+		if (light.Type == LIGHT_TYPE_SPOT)
+		{
+			// Mostly downward, with some tilt
+			XMVECTOR direction = XMVector3Normalize(XMVectorSet(rng.Range(-0.5f, 0.5f), -1.0f, rng.Range(-0.5f, 0.5f), 0.0f));
+			XMStoreFloat3(&light.Direction, direction);
+			light.SpotInnerAngle = XM_PI / 16.0f;
+			light.SpotOuterAngle = XM_PI / 8.0f;
+		}
+		data.lights.push_back(light);
+	}
+
+	scene->lightVelocities.assign(data.lights.size(), XMFLOAT3(0, 0, 0));
+	scene->movingLightCount = 0;
+	for (size_t i = 1; i < data.lights.size(); i++)
+	{
+		if (rng.Next() < settings.movingLightFraction)
+		{
+			scene->lightVelocities[i] = velocity();
+			scene->movingLightCount++;
+		}
+	}
+
+	// Spinning entities last, so the rest of a seed's scene doesn't
+	// change with the spinning fraction
+	scene->entitySpins.assign(settings.entityCount, XMFLOAT3(0, 0, 0));
+	scene->spinningEntityCount = 0;
+	for (int i = 0; i < settings.entityCount; i++)
+	{
+		const XMFLOAT3& v = scene->entityVelocities[i];
+		if (v.x != 0.0f || v.y != 0.0f || v.z != 0.0f)
+			continue;
+		if (rng.Next() < settings.spinningEntityFraction)
+		{
+			scene->entitySpins[i] = XMFLOAT3(0.0f, rng.Range(0.25f, 1.0f) * settings.maxSpin, 0.0f);
+			scene->spinningEntityCount++;
+		}
+	}
+
+	scene->boundsMin = boundsMin;
+	scene->boundsMax = boundsMax;
+}
+
+const char* SceneGenerator::GetLayoutName(int layout)
+{
+	switch (layout)
+	{
+	case SCENE_LAYOUT_CLUSTERED: return "Clustered";
+	case SCENE_LAYOUT_HOTSPOTS: return "Hot Spots";
+	default: return "Uniform";
+	}
+}
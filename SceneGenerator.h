@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "SceneFile.h"
+
+// How entities are spread over the world
+#define SCENE_LAYOUT_UNIFORM 0		// Evenly everywhere
+#define SCENE_LAYOUT_CLUSTERED 1	// In many loose clusters
+#define SCENE_LAYOUT_HOTSPOTS 2		// Mostly uniform, with a few very dense spots
+
+struct SceneGeneratorSettings
+{
+	unsigned int seed;
+	int entityCount;
+	int layout;
+
+	// World volume (entities and lights stay inside it)
+	float worldHalfSize;				// On X and Z
+	float minHeight;
+	float maxHeight;
+
+	// Layout details
+	int clusterCount;
+	float clusterRadius;
+	int hotSpotCount;
+	float hotSpotRadius;
+	float hotSpotFraction;				// Share of entities in the hot spots
+
+	// Relative weights per mesh and material (empty for equal weights)
+	std::vector<std::string> meshNames;
+	std::vector<std::string> meshPaths;
+	std::vector<std::string> materialNames;
+	std::vector<float> meshWeights;
+	std::vector<float> materialWeights;
+	float minScale;
+	float maxScale;
+
+	// Lights (a directional light always comes first, for shadows)
+	int pointLightCount;
+	int spotLightCount;
+	float lightRange;
+
+	// Moving subsets (spinning entities are picked among the static ones)
+	float movingEntityFraction;
+	float spinningEntityFraction;
+	float movingLightFraction;
+	float maxSpeed;
+	float maxSpin;						// Radians per second
+};
+
+// A generated scene plus what the scene file format can't hold
+struct GeneratedScene
+{
+	SceneData data;
+	std::vector<DirectX::XMFLOAT3> entityVelocities;	// Zero for static entities
+	std::vector<DirectX::XMFLOAT3> entitySpins;			// Pitch/yaw/roll per second, zero if not spinning
+	std::vector<DirectX::XMFLOAT3> lightVelocities;		// Zero for static lights
+	DirectX::XMFLOAT3 boundsMin;						// World volume
+	DirectX::XMFLOAT3 boundsMax;
+	unsigned int movingEntityCount;
+	unsigned int spinningEntityCount;
+	unsigned int movingLightCount;
+};
+
+// --------------------------------------------------------
+// Deterministic stress scenes for scaling tests
+// - The same settings (seed included) always produce the
+//    same scene, on any machine
+// --------------------------------------------------------
+namespace SceneGenerator
+{
+	// Reasonable settings for a count and layout, using the
+	// default scene's meshes and materials
+	SceneGeneratorSettings DefaultSettings(int entityCount, int layout, unsigned int seed = 1);
+
+	void Generate(const SceneGeneratorSettings& settings, GeneratedScene* scene);
+
+	const char* GetLayoutName(int layout);
+}
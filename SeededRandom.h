@@ -0,0 +1,39 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+
+// --------------------------------------------------------
+// Small deterministic random number generator (xorshift)
+//
+// - The same seed gives the same sequence on any machine,
+//    unlike std:: distributions, which differ between
+//    standard libraries
+// - Used wherever runs have to be repeatable (generated
+//    scenes, benchmarks)
+// --------------------------------------------------------
+struct SeededRandom
+{
+	unsigned int state;
+
+	float Next() // [0, 1)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+	float Range(float min, float max) { return min + (max - min) * Next(); }
+	int Index(int count) { return std::min((int)(Next() * count), count - 1); }
+
+	// Uniform inside the unit sphere
+	DirectX::XMFLOAT3 InSphere()
+	{
+		DirectX::XMFLOAT3 p;
+		do
+		{
+			p = DirectX::XMFLOAT3(Range(-1, 1), Range(-1, 1), Range(-1, 1));
+		} while (p.x * p.x + p.y * p.y + p.z * p.z > 1.0f);
+		return p;
+	}
+};
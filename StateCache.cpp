@@ -0,0 +1,263 @@
+#include "StateCache.h"
+
+#include <type_traits>
+
+// --------------------------------------------------------
+// Recording target: mirrors the state and logs each call
+// --------------------------------------------------------
+void RecordingStateTarget::SetVertexShader(ShaderHandle vs)
+{
+	this->vs = vs;
+	calls.push_back({ STATE_BIND_VERTEX_SHADER, 0, 1 });
+}
+
+void RecordingStateTarget::SetPixelShader(ShaderHandle ps)
+{
+	this->ps = ps;
+	calls.push_back({ STATE_BIND_PIXEL_SHADER, 0, 1 });
+}
+
+void RecordingStateTarget::SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures)
+{
+	for (unsigned int i = 0; i < count && startSlot + i < STATE_MAX_SRVS; i++)
+		srvs[startSlot + i] = textures[i];
+	calls.push_back({ STATE_BIND_SRV, startSlot, count });
+}
+
+void RecordingStateTarget::SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers)
+{
+	for (unsigned int i = 0; i < count && startSlot + i < STATE_MAX_SAMPLERS; i++)
+		this->samplers[startSlot + i] = samplers[i];
+	calls.push_back({ STATE_BIND_SAMPLER, startSlot, count });
+}
+
+void RecordingStateTarget::SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	vertexBuffer = buffer;
+	vertexStride = stride;
+	vertexOffset = offset;
+	calls.push_back({ STATE_BIND_VERTEX_BUFFER, 0, 1 });
+}
+
+void RecordingStateTarget::SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset)
+{
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	calls.push_back({ STATE_BIND_INDEX_BUFFER, 0, 1 });
+}
+
+// --------------------------------------------------------
+// State cache
+// --------------------------------------------------------
+StateCache::StateCache(StateTarget* target) :
+	target(target),
+	filtering(true),
+	pendingSRVMask(0),
+	pendingSamplerMask(0),
+	stats{}
+{
+	Invalidate();
+}
+
+void StateCache::BeginFrame()
+{
+	Invalidate();
+	stats = {};
+}
+
+void StateCache::Invalidate()
+{
+	vs = ShaderHandle();
+	ps = ShaderHandle();
+	vertexBuffer = BufferHandle();
+	vertexStride = 0;
+	vertexOffset = 0;
+	indexBuffer = BufferHandle();
+	indexFormat = RENDER_INDEX_UNKNOWN;
+	indexOffset = 0;
+	vsKnown = false;
+	psKnown = false;
+	vertexBufferKnown = false;
+	indexBufferKnown = false;
+	for (unsigned int i = 0; i < STATE_MAX_SRVS; i++)
+	{
+		srvs[i] = TextureHandle();
+		srvKnown[i] = false;
+	}
+	for (unsigned int i = 0; i < STATE_MAX_SAMPLERS; i++)
+	{
+		samplers[i] = SamplerHandle();
+		samplerKnown[i] = false;
+	}
+
+	// Staged slots still go out at the next Commit()
+}
+
+void StateCache::SetVertexShader(ShaderHandle vs)
+{
+	stats.requested[STATE_BIND_VERTEX_SHADER]++;
+	if (filtering && vsKnown && this->vs == vs)
+	{
+		stats.skipped[STATE_BIND_VERTEX_SHADER]++;
+		return;
+	}
+
+	target->SetVertexShader(vs);
+	stats.issued[STATE_BIND_VERTEX_SHADER]++;
+	this->vs = vs;
+	vsKnown = true;
+}
+
+void StateCache::SetPixelShader(ShaderHandle ps)
+{
+	stats.requested[STATE_BIND_PIXEL_SHADER]++;
+	if (filtering && psKnown && this->ps == ps)
+	{
+		stats.skipped[STATE_BIND_PIXEL_SHADER]++;
+		return;
+	}
+
+	target->SetPixelShader(ps);
+	stats.issued[STATE_BIND_PIXEL_SHADER]++;
+	this->ps = ps;
+	psKnown = true;
+}
+
+void StateCache::SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	stats.requested[STATE_BIND_VERTEX_BUFFER]++;
+	if (filtering && vertexBufferKnown && vertexBuffer == buffer && vertexStride == stride && vertexOffset == offset)
+	{
+		stats.skipped[STATE_BIND_VERTEX_BUFFER]++;
+		return;
+	}
+
+	target->SetVertexBuffer(buffer, stride, offset);
+	stats.issued[STATE_BIND_VERTEX_BUFFER]++;
+	vertexBuffer = buffer;
+	vertexStride = stride;
+	vertexOffset = offset;
+	vertexBufferKnown = true;
+}
+
+void StateCache::SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset)
+{
+	stats.requested[STATE_BIND_INDEX_BUFFER]++;
+	if (filtering && indexBufferKnown && indexBuffer == buffer && indexFormat == format && indexOffset == offset)
+	{
+		stats.skipped[STATE_BIND_INDEX_BUFFER]++;
+		return;
+	}
+
+	target->SetIndexBuffer(buffer, format, offset);
+	stats.issued[STATE_BIND_INDEX_BUFFER]++;
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	indexBufferKnown = true;
+}
+
+void StateCache::SetPixelShaderResource(unsigned int slot, TextureHandle texture)
+{
+	stats.requested[STATE_BIND_SRV]++;
+	if (!filtering || slot >= STATE_MAX_SRVS)
+	{
+		target->SetPixelShaderResources(slot, 1, &texture);
+		stats.issued[STATE_BIND_SRV]++;
+		if (slot < STATE_MAX_SRVS)
+			srvKnown[slot] = false;
+		return;
+	}
+
+	// Overwriting a staged slot: the earlier request never goes out
+	if (pendingSRVMask & (1u << slot))
+		stats.skipped[STATE_BIND_SRV]++;
+	pendingSRVs[slot] = texture;
+	pendingSRVMask |= 1u << slot;
+}
+
+void StateCache::SetPixelSampler(unsigned int slot, SamplerHandle sampler)
+{
+	stats.requested[STATE_BIND_SAMPLER]++;
+	if (!filtering || slot >= STATE_MAX_SAMPLERS)
+	{
+		target->SetPixelSamplers(slot, 1, &sampler);
+		stats.issued[STATE_BIND_SAMPLER]++;
+		if (slot < STATE_MAX_SAMPLERS)
+			samplerKnown[slot] = false;
+		return;
+	}
+
+	if (pendingSamplerMask & (1u << slot))
+		stats.skipped[STATE_BIND_SAMPLER]++;
+	pendingSamplers[slot] = sampler;
+	pendingSamplerMask |= 1u << slot;
+}
+
+template<typename T>
+void StateCache::CommitSlots(int kind, T* bound, bool* known, T* pending, unsigned int mask, unsigned int slotCount)
+{
+	// Drop the staged slots that already hold their value
+	unsigned int changed = 0;
+	for (unsigned int slot = 0; slot < slotCount; slot++)
+	{
+		if (!(mask & (1u << slot)))
+			continue;
+		if (known[slot] && bound[slot] == pending[slot])
+		{
+			stats.skipped[kind]++;
+			continue;
+		}
+		changed |= 1u << slot;
+		bound[slot] = pending[slot];
+		known[slot] = true;
+	}
+
+	// One call per run of contiguous changed slots
+	unsigned int slot = 0;
+	while (slot < slotCount)
+	{
+		if (!(changed & (1u << slot)))
+		{
+			slot++;
+			continue;
+		}
+
+		unsigned int start = slot;
+		while (slot < slotCount && (changed & (1u << slot)))
+			slot++;
+
+		if constexpr (std::is_same_v<T, TextureHandle>)
+			target->SetPixelShaderResources(start, slot - start, &pending[start]);
+		else
+			target->SetPixelSamplers(start, slot - start, &pending[start]);
+		stats.issued[kind]++;
+	}
+}
+
+void StateCache::Commit()
+{
+	stats.commits++;
+	CommitSlots(STATE_BIND_SRV, srvs, srvKnown, pendingSRVs, pendingSRVMask, STATE_MAX_SRVS);
+	CommitSlots(STATE_BIND_SAMPLER, samplers, samplerKnown, pendingSamplers, pendingSamplerMask, STATE_MAX_SAMPLERS);
+	pendingSRVMask = 0;
+	pendingSamplerMask = 0;
+}
+
+// Getters
+StateCacheStats StateCache::GetStats() { return stats; }
+bool StateCache::GetFiltering() { return filtering; }
+
+// Setters
+void StateCache::SetTarget(StateTarget* target)
+{
+	this->target = target;
+	Invalidate();
+}
+
+void StateCache::SetFiltering(bool filtering)
+{
+	this->filtering = filtering;
+	Invalidate();
+}
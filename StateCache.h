@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+
+// Pixel shader slots the cache tracks (binds past these go straight through)
+#define STATE_MAX_SRVS 16
+#define STATE_MAX_SAMPLERS 16
+
+// Kinds of bind, for the stats
+#define STATE_BIND_VERTEX_SHADER 0
+#define STATE_BIND_PIXEL_SHADER 1
+#define STATE_BIND_SRV 2
+#define STATE_BIND_SAMPLER 3
+#define STATE_BIND_VERTEX_BUFFER 4
+#define STATE_BIND_INDEX_BUFFER 5
+#define STATE_BIND_KINDS 6
+
+// What the cache did since the last BeginFrame()
+struct StateCacheStats
+{
+	unsigned int requested[STATE_BIND_KINDS];		// Binds asked for (one per slot for SRVs and samplers)
+	unsigned int issued[STATE_BIND_KINDS];			// API calls that reached the target
+	unsigned int skipped[STATE_BIND_KINDS];			// Requests that matched what was already bound
+	unsigned int commits;
+};
+
+// --------------------------------------------------------
+// A stand-in target with no backend behind it
+// - Keeps the state it was left in plus every call, so the
+//    cache's output can be checked (the handles are never
+//    looked up, any distinct values will do)
+// --------------------------------------------------------
+class RecordingStateTarget : public StateTarget
+{
+public:
+	struct Call
+	{
+		int kind;					// STATE_BIND_*
+		unsigned int startSlot;
+		unsigned int count;
+	};
+
+	std::vector<Call> calls;
+	ShaderHandle vs;
+	ShaderHandle ps;
+	TextureHandle srvs[STATE_MAX_SRVS];
+	SamplerHandle samplers[STATE_MAX_SAMPLERS];
+	BufferHandle vertexBuffer;
+	unsigned int vertexStride = 0;
+	unsigned int vertexOffset = 0;
+	BufferHandle indexBuffer;
+	int indexFormat = RENDER_INDEX_UNKNOWN;
+	unsigned int indexOffset = 0;
+
+	void SetVertexShader(ShaderHandle vs) override;
+	void SetPixelShader(ShaderHandle ps) override;
+	void SetPixelShaderResources(unsigned int startSlot, unsigned int count, const TextureHandle* textures) override;
+	void SetPixelSamplers(unsigned int startSlot, unsigned int count, const SamplerHandle* samplers) override;
+	void SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset) override;
+};
+
+// --------------------------------------------------------
+// Redundant state filtering in front of the render backend
+//
+// - Shaders and buffers are compared with what the cache last
+//    bound and only passed on when they differ
+// - Pixel shader SRVs and samplers are staged per slot and
+//    sent by Commit() (call it before each draw), one call per
+//    run of contiguous changed slots
+// - Anything that binds around the cache (the sky, particles,
+//    post processing) leaves it stale: Invalidate() forgets
+//    what's bound so the next request of each kind goes through
+// - With filtering off every request is passed straight on,
+//    for comparison
+// --------------------------------------------------------
+class StateCache
+{
+private:
+	StateTarget* target;
+	bool filtering;
+
+	// What the target has, if known
+	ShaderHandle vs;
+	ShaderHandle ps;
+	BufferHandle vertexBuffer;
+	unsigned int vertexStride;
+	unsigned int vertexOffset;
+	BufferHandle indexBuffer;
+	int indexFormat;
+	unsigned int indexOffset;
+	TextureHandle srvs[STATE_MAX_SRVS];
+	SamplerHandle samplers[STATE_MAX_SAMPLERS];
+	bool vsKnown;
+	bool psKnown;
+	bool vertexBufferKnown;
+	bool indexBufferKnown;
+	bool srvKnown[STATE_MAX_SRVS];
+	bool samplerKnown[STATE_MAX_SAMPLERS];
+
+	// Staged for the next Commit()
+	TextureHandle pendingSRVs[STATE_MAX_SRVS];
+	SamplerHandle pendingSamplers[STATE_MAX_SAMPLERS];
+	unsigned int pendingSRVMask;
+	unsigned int pendingSamplerMask;
+
+	StateCacheStats stats;
+
+	template<typename T>
+	void CommitSlots(int kind, T* bound, bool* known, T* pending, unsigned int mask, unsigned int slotCount);
+
+public:
+	StateCache(StateTarget* target);
+
+	// Resets the stats and forgets what's bound
+	void BeginFrame();
+	void Invalidate();
+
+	void SetVertexShader(ShaderHandle vs);
+	void SetPixelShader(ShaderHandle ps);
+	void SetVertexBuffer(BufferHandle buffer, unsigned int stride, unsigned int offset = 0);
+	void SetIndexBuffer(BufferHandle buffer, int format, unsigned int offset = 0);
+
+	// Staged until Commit()
+	void SetPixelShaderResource(unsigned int slot, TextureHandle texture);
+	void SetPixelSampler(unsigned int slot, SamplerHandle sampler);
+	void Commit();
+
+	// Getters
+	StateCacheStats GetStats();
+	bool GetFiltering();
+
+	// Setters
+	void SetTarget(StateTarget* target);	// Also invalidates
+	void SetFiltering(bool filtering);
+};
@@ -29,6 +29,7 @@ struct VertexToPixel
     float3 worldPosition	: POSITION;			// World position
     float3 tangent			: TANGENT;			// Tangent vector
     float4 shadowMapPos		: SHADOW_POSITION;	// Shadow map position
+    nointerpolation uint objectIndex : OBJECT_INDEX;	// Render queue position (its light list)
 };
 
 // Struct representing a single pixel worth of data for sky box
@@ -43,4 +44,17 @@ struct VertexToPixel_Skybox
     float3 sampleDir		: DIRECTION;	// Sample direction
 };
 
+// Struct representing a single pixel worth of data for particles
+struct VertexToPixel_Particle
+{
+	// Data type
+	//  |
+	//  |   Name          Semantic
+	//  |    |                |
+	//  v    v                v
+    float4 screenPosition	: SV_POSITION;	// XYZW position (System Value Position)
+    float2 uv				: TEXCOORD;		// 0-1 across the quad
+    float4 color			: COLOR;		// Tint and opacity
+};
+
 #endif
\ No newline at end of file
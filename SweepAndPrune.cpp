@@ -0,0 +1,312 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+SweepAndPrune::SweepAndPrune(int axisCount) :
+	bodyCount(0),
+	axisCount(axisCount == 1 ? 1 : 3),
+	sweepAxis(0),
+	rebuild(false),
+	lastSwaps(0),
+	lastTests(0)
+{
+}
+
+float SweepAndPrune::GetValue(const SAPEndpoint& endpoint, int axis)
+{
+	const AABB& bounds = bodies[endpoint.body >> 1].bounds;
+	return (endpoint.body & 1) ? (&bounds.max.x)[axis] : (&bounds.min.x)[axis];
+}
+
+bool SweepAndPrune::Before(const SAPEndpoint& a, const SAPEndpoint& b)
+{
+	// On a tie, mins go first so touching boxes count as overlapping
+	return a.value < b.value || (a.value == b.value && !(a.body & 1) && (b.body & 1));
+}
+
+unsigned long long SweepAndPrune::PairKey(unsigned int a, unsigned int b)
+{
+	return a < b ?
+		((unsigned long long)a << 32) | b :
+		((unsigned long long)b << 32) | a;
+}
+
+void SweepAndPrune::SortAxis(int axis)
+{
+	std::vector<SAPEndpoint>& list = endpoints[axis];
+	for (auto& endpoint : list)
+		endpoint.value = GetValue(endpoint, axis);
+
+	// Insertion sort - nearly sorted already, so this is
+	// mostly a walk over the list with the odd short shuffle
+	for (size_t i = 1; i < list.size(); i++)
+	{
+		SAPEndpoint moving = list[i];
+		size_t j = i;
+		while (j > 0 && Before(moving, list[j - 1]))
+		{
+			const SAPEndpoint& passed = list[j - 1];
+			if (axisCount == 3)
+			{
+				unsigned int a = moving.body >> 1;
+				unsigned int b = passed.body >> 1;
+				bool movingIsMax = (moving.body & 1) != 0;
+				bool passedIsMax = (passed.body & 1) != 0;
+
+				// A min passing a max: the two now overlap on this
+				// axis, so they're a pair if they do on the others
+				if (!movingIsMax && passedIsMax)
+				{
+					if (Bounds::Overlaps(bodies[a].bounds, bodies[b].bounds))
+						pairs.insert(PairKey(a, b));
+				}
+				// A max passing a min: they no longer overlap at all
+				else if (movingIsMax && !passedIsMax)
+					pairs.erase(PairKey(a, b));
+			}
+
+			list[j] = passed;
+			j--;
+			lastSwaps++;
+		}
+		list[j] = moving;
+	}
+}
+
+void SweepAndPrune::Rebuild()
+{
+	// With one axis, sweep along the one the bodies are most spread out on
+	if (axisCount == 1)
+	{
+		XMVECTOR sum = XMVectorZero();
+		XMVECTOR sumSquares = XMVectorZero();
+		for (auto& body : bodies)
+		{
+			if (!body.alive)
+				continue;
+			XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&body.bounds.min), XMLoadFloat3(&body.bounds.max)), 0.5f);
+			sum = XMVectorAdd(sum, center);
+			sumSquares = XMVectorMultiplyAdd(center, center, sumSquares);
+		}
+
+		XMFLOAT3 variance;
+		float count = (float)std::max(bodyCount, 1u);
+		XMVECTOR mean = XMVectorScale(sum, 1.0f / count);
+		XMStoreFloat3(&variance, XMVectorSubtract(XMVectorScale(sumSquares, 1.0f / count), XMVectorMultiply(mean, mean)));
+		sweepAxis = variance.x >= variance.y && variance.x >= variance.z ? 0 : (variance.y >= variance.z ? 1 : 2);
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		endpoints[axis].clear();
+		if (axisCount == 1 && axis != sweepAxis)
+			continue;
+
+		for (unsigned int i = 0; i < bodies.size(); i++)
+		{
+			if (!bodies[i].alive)
+				continue;
+			endpoints[axis].push_back({ (&bodies[i].bounds.min.x)[axis], i << 1 });
+			endpoints[axis].push_back({ (&bodies[i].bounds.max.x)[axis], (i << 1) | 1 });
+		}
+		std::sort(endpoints[axis].begin(), endpoints[axis].end(), Before);
+	}
+
+	// Three axes: start the pair set off with one sweep
+	pairs.clear();
+	if (axisCount == 3)
+	{
+		bodyPairs.clear();
+		Sweep(0, bodyPairs);
+		for (auto& pair : bodyPairs)
+			pairs.insert(PairKey(pair.a, pair.b));
+	}
+
+	rebuild = false;
+}
+
+void SweepAndPrune::Sweep(int axis, std::vector<OverlapPair>& results)
+{
+	// Bodies whose interval we're inside of, in no order
+	active.clear();
+	activeSlot.resize(bodies.size());
+
+	for (auto& endpoint : endpoints[axis])
+	{
+		unsigned int body = endpoint.body >> 1;
+		if (endpoint.body & 1)
+		{
+			// Leaving: the last active body takes its slot
+			unsigned int slot = activeSlot[body];
+			active[slot] = active.back();
+			activeSlot[active[slot]] = slot;
+			active.pop_back();
+		}
+		else
+		{
+			// Entering: test against everything open on this axis
+			for (unsigned int other : active)
+			{
+				lastTests++;
+				if (Bounds::Overlaps(bodies[body].bounds, bodies[other].bounds))
+					results.push_back({ body, other });
+			}
+			activeSlot[body] = (unsigned int)active.size();
+			active.push_back(body);
+		}
+	}
+}
+
+int SweepAndPrune::Add(const AABB& bounds, unsigned int data)
+{
+	int body;
+	if (!freeBodies.empty())
+	{
+		body = freeBodies.back();
+		freeBodies.pop_back();
+	}
+	else
+	{
+		body = (int)bodies.size();
+		bodies.push_back({});
+	}
+
+	bodies[body].bounds = bounds;
+	bodies[body].data = data;
+	bodies[body].alive = true;
+	pending.push_back(body);
+	bodyCount++;
+	return body;
+}
+
+void SweepAndPrune::Remove(int proxy)
+{
+	if (proxy < 0 || proxy >= (int)bodies.size() || !bodies[proxy].alive)
+		return;
+
+	// Its endpoints and pairs go at the next update
+	bodies[proxy].alive = false;
+	removed.push_back(proxy);
+	bodyCount--;
+}
+
+void SweepAndPrune::Update(int proxy, const AABB& bounds)
+{
+	if (proxy < 0 || proxy >= (int)bodies.size() || !bodies[proxy].alive)
+		return;
+
+	bodies[proxy].bounds = bounds;
+}
+
+void SweepAndPrune::Clear()
+{
+	bodies.clear();
+	freeBodies.clear();
+	for (auto& list : endpoints)
+		list.clear();
+	pending.clear();
+	removed.clear();
+	pairs.clear();
+	bodyCount = 0;
+	rebuild = false;
+}
+
+void SweepAndPrune::FindPairs(std::vector<OverlapPair>& results)
+{
+	lastSwaps = 0;
+	lastTests = 0;
+
+	// Drop removed bodies, then let their slots be reused
+	if (!removed.empty())
+	{
+		for (auto& list : endpoints)
+		{
+			list.erase(std::remove_if(list.begin(), list.end(),
+				[&](const SAPEndpoint& e) { return !bodies[e.body >> 1].alive; }), list.end());
+		}
+		for (auto it = pairs.begin(); it != pairs.end();)
+		{
+			if (!bodies[*it >> 32].alive || !bodies[*it & 0xFFFFFFFF].alive)
+				it = pairs.erase(it);
+			else
+				++it;
+		}
+		freeBodies.insert(freeBodies.end(), removed.begin(), removed.end());
+		removed.clear();
+	}
+
+	// Lots of new bodies: sorting from scratch beats inserting them one by one
+	if (pending.size() > 64 && pending.size() > bodyCount / 8)
+		rebuild = true;
+
+	if (rebuild)
+		Rebuild();
+	else
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (axisCount == 1 && axis != sweepAxis)
+				continue;
+
+			// New bodies start at the end and sort into place
+			for (int body : pending)
+			{
+				if (!bodies[body].alive)
+					continue;
+				endpoints[axis].push_back({ 0.0f, (unsigned int)body << 1 });
+				endpoints[axis].push_back({ 0.0f, ((unsigned int)body << 1) | 1 });
+			}
+			SortAxis(axis);
+		}
+	}
+	pending.clear();
+
+	bodyPairs.clear();
+	if (axisCount == 1)
+		Sweep(sweepAxis, bodyPairs);
+	else
+	{
+		for (unsigned long long key : pairs)
+			bodyPairs.push_back({ (unsigned int)(key >> 32), (unsigned int)(key & 0xFFFFFFFF) });
+	}
+
+	// Body indices to data, sorted so the list is the same
+	// from frame to frame whatever order the sets iterate in
+	results.clear();
+	for (auto& pair : bodyPairs)
+	{
+		unsigned int a = bodies[pair.a].data;
+		unsigned int b = bodies[pair.b].data;
+		results.push_back(a < b ? OverlapPair{ a, b } : OverlapPair{ b, a });
+	}
+	std::sort(results.begin(), results.end(),
+		[](const OverlapPair& x, const OverlapPair& y) { return x.a < y.a || (x.a == y.a && x.b < y.b); });
+}
+
+unsigned int SweepAndPrune::GetBodyCount()
+{
+	return bodyCount;
+}
+
+int SweepAndPrune::GetAxisCount()
+{
+	return axisCount;
+}
+
+unsigned int SweepAndPrune::GetLastSwaps()
+{
+	return lastSwaps;
+}
+
+unsigned int SweepAndPrune::GetLastTests()
+{
+	return lastTests;
+}
+
+void SweepAndPrune::SetAxisCount(int axisCount)
+{
+	this->axisCount = axisCount == 1 ? 1 : 3;
+	rebuild = true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <unordered_set>
+#include <vector>
+
+#include "Bounds.h"
+
+#define SAP_NONE -1
+
+// Two overlapping bodies, by their data (a < b)
+struct OverlapPair
+{
+	unsigned int a;
+	unsigned int b;
+};
+
+// One end of a body's interval on an axis
+struct SAPEndpoint
+{
+	float value;
+	unsigned int body;		// Body index << 1, plus 1 for a max endpoint
+};
+
+struct SAPBody
+{
+	AABB bounds;
+	unsigned int data;
+	bool alive;
+};
+
+// --------------------------------------------------------
+// Sort-and-sweep broadphase for overlap pairs between
+// moving boxes
+//
+// - Body intervals are kept as sorted endpoint lists and
+//    re-sorted with insertion sort every update; from one
+//    frame to the next bodies barely move, so that's close
+//    to linear
+// - One axis: the sorted axis is swept and every body that
+//    overlaps on it is tested on the other two
+// - Three axes: pairs are added and removed as endpoints
+//    swap past each other during the sorts, so the set is
+//    only ever touched where something changed
+// - Pairs come out sorted, so the list is stable from frame
+//    to frame
+// - Big batches of new bodies trigger a full sort instead
+// --------------------------------------------------------
+class SweepAndPrune
+{
+private:
+	std::vector<SAPBody> bodies;
+	std::vector<int> freeBodies;
+	unsigned int bodyCount;
+
+	std::vector<SAPEndpoint> endpoints[3];
+	std::vector<int> pending;				// Added since the last update
+	std::vector<int> removed;				// Removed since the last update
+	std::unordered_set<unsigned long long> pairs;	// Three axes only, by body index
+	int axisCount;
+	int sweepAxis;							// One axis only: the one with the most spread
+	bool rebuild;
+
+	// Sweep scratch
+	std::vector<unsigned int> active;
+	std::vector<unsigned int> activeSlot;
+	std::vector<OverlapPair> bodyPairs;
+
+	// Stats
+	unsigned int lastSwaps;
+	unsigned int lastTests;
+
+	float GetValue(const SAPEndpoint& endpoint, int axis);
+	void SortAxis(int axis);
+	void Rebuild();
+	void Sweep(int axis, std::vector<OverlapPair>& results);	// Pairs of body indices
+	static bool Before(const SAPEndpoint& a, const SAPEndpoint& b);
+	unsigned long long PairKey(unsigned int a, unsigned int b);
+
+public:
+	// axisCount is 1 or 3
+	SweepAndPrune(int axisCount = 3);
+
+	// Proxies are body indices; data is handed back in pairs
+	int Add(const AABB& bounds, unsigned int data);
+	void Remove(int proxy);
+	void Update(int proxy, const AABB& bounds);
+	void Clear();
+
+	// Re-sorts with the latest bounds and replaces pairs with
+	// every overlapping pair, sorted
+	void FindPairs(std::vector<OverlapPair>& results);
+
+	// Getters
+	unsigned int GetBodyCount();
+	int GetAxisCount();
+	unsigned int GetLastSwaps();		// Endpoint swaps in the last FindPairs()
+	unsigned int GetLastTests();		// Box tests in the last FindPairs()
+
+	// Setters
+	void SetAxisCount(int axisCount);
+};
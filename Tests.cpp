@@ -0,0 +1,720 @@
+#include "BufferStructs.h"
+#include "Culling.h"
+#include "FrameGraph.h"
+#include "LightBudget.h"
+#include "LightClusters.h"
+#include "NullBackend.h"
+#include "ObjectLights.h"
+#include "SceneGenerator.h"
+#include "SeededRandom.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Correctness checks for the engine's CPU side systems
+//
+// - Built as its own console program (Tests.vcxproj), which
+//    runs it after every build: a failed check fails the build
+// - Only device free code is linked in: rendering goes through
+//    the null backend, and anything that needs a real device is
+//    checked by running the game
+// - Each failed check prints where it is, and the exit code
+//    is the number of test functions that failed
+// --------------------------------------------------------
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	int checksRun = 0;
+	int checksFailed = 0;
+
+	void Check(bool passed, const char* condition, const char* file, int line)
+	{
+		checksRun++;
+		if (passed)
+			return;
+		checksFailed++;
+		printf("  FAILED: %s (%s:%d)\n", condition, file, line);
+	}
+
+	// Runs one test function, reporting whether all of its checks passed
+	bool Run(const char* name, void (*test)())
+	{
+		int failedBefore = checksFailed;
+		test();
+		bool passed = checksFailed == failedBefore;
+		printf("%s %s\n", passed ? "[pass]" : "[FAIL]", name);
+		return passed;
+	}
+
+	// Bounding boxes of a generated stress scene's entities
+	// (each entity's scale is the half size of its box)
+	std::vector<AABB> GenerateBoxes(int entityCount, int layout, float* worldHalf)
+	{
+		GeneratedScene scene;
+		SceneGenerator::Generate(SceneGenerator::DefaultSettings(entityCount, layout, 777), &scene);
+		*worldHalf = scene.boundsMax.x;
+
+		std::vector<AABB> boxes(entityCount);
+		for (int i = 0; i < entityCount; i++)
+			boxes[i] = Bounds::FromCenterExtents(scene.data.entities[i].position, scene.data.entities[i].scale);
+		return boxes;
+	}
+
+	// Stand-in handles: distinct values the recording target
+	// never looks up
+	template<typename T>
+	Handle<T> Fake(unsigned int id)
+	{
+		return Handle<T>::Make(id, 1);
+	}
+}
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+// --------------------------------------------------------
+// The temporal cache has to give exactly what full culling
+// gives, every frame, while a share of the boxes drift and
+// the camera turns (slowly, then quickly)
+// - The multi-view masks are checked the same way: the camera
+//    plus CULL_MAX_VIEWS - 1 more views, with the camera's
+//    view temporal, against plain CullViews()
+// --------------------------------------------------------
+void TestTemporalCulling()
+{
+	const int entityCount = 20000;
+	const int frames = 120;
+	float worldHalf;
+	std::vector<AABB> boxes = GenerateBoxes(entityCount, SCENE_LAYOUT_UNIFORM, &worldHalf);
+
+	FrustumCuller culler, viewsCuller;
+	culler.Resize(entityCount);
+	viewsCuller.Resize(entityCount);
+	for (int i = 0; i < entityCount; i++)
+	{
+		culler.SetBounds(i, boxes[i]);
+		viewsCuller.SetBounds(i, boxes[i]);
+	}
+
+	// A tenth of the boxes wander a little every frame
+	SeededRandom rng = { 99 };
+	std::vector<XMFLOAT3> velocities(entityCount, XMFLOAT3(0, 0, 0));
+	for (int i = 0; i < entityCount; i += 10)
+		velocities[i] = XMFLOAT3(rng.Range(-0.05f, 0.05f), rng.Range(-0.05f, 0.05f), rng.Range(-0.05f, 0.05f));
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, worldHalf * 2.0f);
+	std::vector<unsigned int> fullVisible, temporalVisible;
+	std::vector<unsigned int> fullMasks, temporalMasks;
+	std::vector<Frustum> views(CULL_MAX_VIEWS);
+	const float degreesPerFrame[2] = { 0.05f, 2.0f };
+	for (int speed = 0; speed < 2; speed++)
+	{
+		culler.InvalidateTemporal();
+		viewsCuller.InvalidateTemporal();
+		int mismatchedFrames = 0;
+		int mismatchedMaskFrames = 0;
+		unsigned int retested = 0;
+		for (int f = 0; f < frames; f++)
+		{
+			for (int i = 0; i < entityCount; i += 10)
+			{
+				XMFLOAT3 v = velocities[i];
+				boxes[i].min = XMFLOAT3(boxes[i].min.x + v.x, boxes[i].min.y + v.y, boxes[i].min.z + v.z);
+				boxes[i].max = XMFLOAT3(boxes[i].max.x + v.x, boxes[i].max.y + v.y, boxes[i].max.z + v.z);
+				culler.SetBounds(i, boxes[i]);
+				viewsCuller.SetBounds(i, boxes[i]);
+			}
+
+			float angle = XMConvertToRadians(degreesPerFrame[speed] * f);
+			XMVECTOR eye = XMVectorSet(sinf(angle) * worldHalf * 0.5f, 2.0f, cosf(angle) * worldHalf * 0.5f, 0);
+			XMVECTOR target = XMVectorSet(-sinf(angle) * worldHalf, 0.0f, -cosf(angle) * worldHalf, 0);
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(eye, target, XMVectorSet(0, 1, 0, 0)) * proj);
+			Frustum frustum = Bounds::FrustumFromMatrix(viewProj);
+
+			culler.Cull(frustum, fullVisible, false);
+			culler.CullTemporal(frustum, temporalVisible, false);
+			if (fullVisible != temporalVisible)
+				mismatchedFrames++;
+			if (f > 0)
+				retested += culler.GetTemporalStats().retested;
+
+			// The other views look out from the same spot, spread around the circle
+			views[0] = frustum;
+			for (int v = 1; v < CULL_MAX_VIEWS; v++)
+			{
+				float viewAngle = angle + XM_2PI * v / CULL_MAX_VIEWS;
+				XMVECTOR viewTarget = XMVectorSet(-sinf(viewAngle) * worldHalf, 0.0f, -cosf(viewAngle) * worldHalf, 0);
+				XMStoreFloat4x4(&viewProj, XMMatrixLookAtLH(eye, viewTarget, XMVectorSet(0, 1, 0, 0)) * proj);
+				views[v] = Bounds::FrustumFromMatrix(viewProj);
+			}
+			viewsCuller.CullViews(views.data(), CULL_MAX_VIEWS, fullMasks, true);
+			viewsCuller.CullViewsTemporal(views.data(), CULL_MAX_VIEWS, temporalMasks, true);
+			if (fullMasks != temporalMasks)
+				mismatchedMaskFrames++;
+		}
+
+		CHECK(mismatchedFrames == 0);
+		CHECK(mismatchedMaskFrames == 0);
+
+		// The slow camera has to actually reuse results (or the
+		// frames above only prove full culling matches itself)
+		if (speed == 0)
+			CHECK(retested < (unsigned int)entityCount * (frames - 1) / 2);
+	}
+}
+
+// --------------------------------------------------------
+// The state cache against a recording target: what reaches
+// the target, and in how many calls
+// --------------------------------------------------------
+void TestStateCache()
+{
+	ShaderHandle vs = Fake<RenderShader>(1);
+	ShaderHandle ps = Fake<RenderShader>(2);
+	BufferHandle buffer = Fake<RenderBuffer>(3);
+	TextureHandle srvs[4] = { Fake<RenderTexture>(4), Fake<RenderTexture>(5), Fake<RenderTexture>(6), Fake<RenderTexture>(7) };
+	SamplerHandle sampler = Fake<RenderSampler>(8);
+
+	// A repeated bind is skipped
+	{
+		RecordingStateTarget target;
+		StateCache cache(&target);
+		for (int i = 0; i < 2; i++)
+		{
+			cache.SetVertexShader(vs);
+			cache.SetPixelShader(ps);
+			cache.SetVertexBuffer(buffer, 32, 0);
+			cache.SetIndexBuffer(buffer, RENDER_INDEX_32, 0);
+			cache.SetPixelShaderResource(0, srvs[0]);
+			cache.SetPixelSampler(0, sampler);
+			cache.Commit();
+		}
+		CHECK(target.calls.size() == 6);
+		StateCacheStats stats = cache.GetStats();
+		for (int kind = 0; kind < STATE_BIND_KINDS; kind++)
+			CHECK(stats.issued[kind] == 1 && stats.skipped[kind] == 1);
+
+		// Same buffer, different stride: not a repeat
+		cache.SetVertexBuffer(buffer, 48, 0);
+		CHECK(target.calls.size() == 7 && target.vertexStride == 48);
+	}
+
+	// Contiguous changed slots go out as one call
+	{
+		RecordingStateTarget target;
+		StateCache cache(&target);
+		cache.SetPixelShaderResource(0, srvs[0]);
+		cache.SetPixelShaderResource(1, srvs[1]);
+		cache.SetPixelShaderResource(2, srvs[2]);
+		cache.SetPixelShaderResource(5, srvs[3]);
+		cache.Commit();
+		CHECK(target.calls.size() == 2);
+		if (target.calls.size() == 2)
+		{
+			CHECK(target.calls[0].kind == STATE_BIND_SRV && target.calls[0].startSlot == 0 && target.calls[0].count == 3);
+			CHECK(target.calls[1].kind == STATE_BIND_SRV && target.calls[1].startSlot == 5 && target.calls[1].count == 1);
+		}
+		CHECK(target.srvs[0] == srvs[0] && target.srvs[1] == srvs[1] && target.srvs[2] == srvs[2] && target.srvs[5] == srvs[3]);
+
+		// Changing the middle of the run only sends the middle
+		target.calls.clear();
+		cache.SetPixelShaderResource(0, srvs[0]);
+		cache.SetPixelShaderResource(1, srvs[3]);
+		cache.SetPixelShaderResource(2, srvs[2]);
+		cache.Commit();
+		CHECK(target.calls.size() == 1);
+		if (target.calls.size() == 1)
+			CHECK(target.calls[0].startSlot == 1 && target.calls[0].count == 1);
+	}
+
+	// Binds after Invalidate() go through, even if they match
+	{
+		RecordingStateTarget target;
+		StateCache cache(&target);
+		cache.SetVertexShader(vs);
+		cache.SetPixelShaderResource(3, srvs[0]);
+		cache.Commit();
+		cache.Invalidate();
+		target.calls.clear();
+
+		cache.SetVertexShader(vs);
+		cache.SetPixelShaderResource(3, srvs[0]);
+		cache.Commit();
+		CHECK(target.calls.size() == 2);
+
+		// And are filtered again after that
+		cache.SetVertexShader(vs);
+		cache.SetPixelShaderResource(3, srvs[0]);
+		cache.Commit();
+		CHECK(target.calls.size() == 2);
+	}
+
+	// Staged slots survive Invalidate()
+	{
+		RecordingStateTarget target;
+		StateCache cache(&target);
+		cache.SetPixelShaderResource(2, srvs[1]);
+		cache.SetPixelSampler(1, sampler);
+		cache.Invalidate();
+		cache.Commit();
+		CHECK(target.calls.size() == 2);
+		CHECK(target.srvs[2] == srvs[1]);
+		CHECK(target.samplers[1] == sampler);
+	}
+}
+
+// --------------------------------------------------------
+// Clustered light assignment for a camera looking across a
+// generated scene's point and spot lights
+// - Every cluster's list is in light order, and only holds
+//    lights Touches() accepts for it (Assign() also trims by
+//    the light's screen rect, so it may keep fewer)
+// - Random points in the view, against every light (brute
+//    force): every light that reaches a point must be in the
+//    list of the point's cluster
+// - Serial and parallel assignment give the same lists
+// --------------------------------------------------------
+void TestLightClusters()
+{
+	const unsigned int lightCount = 2000;
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(lightCount * 10, SCENE_LAYOUT_CLUSTERED, 31337);
+	settings.pointLightCount = lightCount * 2 / 3;
+	settings.spotLightCount = lightCount - settings.pointLightCount;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	float nearPlane = 0.1f;
+	float farPlane = settings.worldHalfSize * 2.0f;
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(
+		XMVectorSet(0, settings.maxHeight, -settings.worldHalfSize, 0),
+		XMVectorSet(0, 0, settings.worldHalfSize * 0.25f, 0),
+		XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, nearPlane, farPlane));
+
+	LightClusters clusters;
+	clusters.Build(view, projection, nearPlane, farPlane);
+	clusters.Assign(lights.data(), (unsigned int)lights.size(), false);
+	std::vector<LightClusterRange> ranges = clusters.GetRanges();
+	std::vector<unsigned int> indices = clusters.GetIndices();
+	CHECK(ranges.size() == LIGHT_CLUSTER_COUNT);
+	CHECK(clusters.GetStats().clusteredLights > 0);
+
+	// Each list's entries
+	unsigned int unsortedLists = 0, wrongEntries = 0;
+	for (unsigned int c = 0; c < LIGHT_CLUSTER_COUNT; c++)
+	{
+		const unsigned int* first = indices.data() + ranges[c].offset;
+		const unsigned int* last = first + ranges[c].count;
+		if (!std::is_sorted(first, last) || std::adjacent_find(first, last) != last)
+			unsortedLists++;
+		for (const unsigned int* light = first; light != last; light++)
+			if (*light >= lights.size() || !clusters.Touches(*light, c))
+				wrongEntries++;
+	}
+	CHECK(unsortedLists == 0);
+	CHECK(wrongEntries == 0);
+
+	// Random points through the view volume (depth spread in log
+	// space, like the slices), each checked against every light
+	SeededRandom rng = { 99 };
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	unsigned int litSamples = 0, missed = 0;
+	for (unsigned int s = 0; s < 10000; s++)
+	{
+		float ndcX = rng.Range(-1.0f, 1.0f);
+		float ndcY = rng.Range(-1.0f, 1.0f);
+		float depth = nearPlane * powf(farPlane / nearPlane, rng.Next());
+		XMFLOAT3 point(ndcX * depth / projection._11, ndcY * depth / projection._22, depth);
+
+		int x = std::min((int)((ndcX * 0.5f + 0.5f) * LIGHT_CLUSTERS_X), LIGHT_CLUSTERS_X - 1);
+		int y = std::min((int)((0.5f - ndcY * 0.5f) * LIGHT_CLUSTERS_Y), LIGHT_CLUSTERS_Y - 1);
+		LightClusterRange range = ranges[LightClusters::GetClusterIndex(x, y, clusters.GetSlice(depth))];
+		const unsigned int* first = indices.data() + range.offset;
+		const unsigned int* last = first + range.count;
+
+		bool lit = false;
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			const Light& light = lights[i];
+			if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+				continue;
+
+			XMVECTOR toPoint = XMLoadFloat3(&point) - XMVector3TransformCoord(XMLoadFloat3(&light.Position), viewMatrix);
+			float distance = XMVectorGetX(XMVector3Length(toPoint));
+			if (distance > light.Range)
+				continue;
+			if (light.Type == LIGHT_TYPE_SPOT && distance > 0.0f)
+			{
+				XMVECTOR direction = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), viewMatrix));
+				if (XMVectorGetX(XMVector3Dot(toPoint, direction)) / distance < cosf(light.SpotOuterAngle))
+					continue;
+			}
+
+			lit = true;
+			if (!std::binary_search(first, last, i))
+				missed++;
+		}
+		litSamples += lit;
+	}
+	CHECK(litSamples > 0);
+	CHECK(missed == 0);
+
+	// The parallel path fills the same lists
+	clusters.Assign(lights.data(), (unsigned int)lights.size(), true);
+	CHECK(clusters.GetRanges().size() == ranges.size() && std::equal(ranges.begin(), ranges.end(), clusters.GetRanges().begin(),
+		[](const LightClusterRange& a, const LightClusterRange& b) { return a.offset == b.offset && a.count == b.count; }));
+	CHECK(clusters.GetIndices() == indices);
+}
+
+// --------------------------------------------------------
+// Per object light lists for a generated scene's entities
+// - The first objects against every light (brute force):
+//    the kept lists must be exactly the top ranked ones
+// - Serial and parallel selection give the same lists
+// --------------------------------------------------------
+void TestObjectLights()
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(20000, SCENE_LAYOUT_CLUSTERED, 4242);
+	settings.pointLightCount = 1000;
+	settings.spotLightCount = 500;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	std::vector<AABB> boxes(scene.data.entities.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+		boxes[i] = Bounds::FromCenterExtents(scene.data.entities[i].position, scene.data.entities[i].scale);
+	auto getBounds = [&](unsigned int object) { return boxes[object]; };
+
+	ObjectLightSelector selector;
+	selector.Select(getBounds, (unsigned int)boxes.size(), lights.data(), (unsigned int)lights.size(), false);
+	std::vector<ObjectLightList> lists = selector.GetLists();
+	CHECK(lists.size() == boxes.size());
+
+	// Brute force: rank every light that reaches the box
+	unsigned int lit = 0, mismatches = 0;
+	std::vector<std::pair<float, unsigned int>> ranked;
+	for (unsigned int o = 0; o < 1000; o++)
+	{
+		ranked.clear();
+		for (unsigned int i = 0; i < lights.size(); i++)
+		{
+			float score = ObjectLightSelector::EstimateContribution(lights[i], boxes[o]);
+			if (score > 0.0f)
+				ranked.push_back({ -score, i });
+		}
+		std::sort(ranked.begin(), ranked.end());
+
+		unsigned int expected = std::min((unsigned int)ranked.size(), (unsigned int)OBJECT_LIGHTS_MAX);
+		bool same = lists[o].count == expected;
+		for (unsigned int k = 0; same && k < expected; k++)
+			same = lists[o].lights[k] == ranked[k].second;
+		mismatches += !same;
+		lit += expected > 0;
+	}
+	CHECK(lit > 0);
+	CHECK(mismatches == 0);
+
+	// The parallel path keeps the same lights
+	selector.Select(getBounds, (unsigned int)boxes.size(), lights.data(), (unsigned int)lights.size(), true);
+	unsigned int disagreements = 0;
+	const std::vector<ObjectLightList>& parallelLists = selector.GetLists();
+	for (size_t o = 0; o < lists.size(); o++)
+		if (memcmp(&lists[o], &parallelLists[o], sizeof(unsigned int) * (1 + lists[o].count)) != 0)
+			disagreements++;
+	CHECK(disagreements == 0);
+}
+
+// --------------------------------------------------------
+// Light budget from a camera circling a generated scene
+// - The first frame picks exactly the top scores (there's
+//    no bonus for lights already in the budget yet)
+// - Serial and parallel updates agree every frame
+// - No frame overflows the constant buffer
+// --------------------------------------------------------
+void TestLightBudget()
+{
+	SceneGeneratorSettings settings = SceneGenerator::DefaultSettings(3000, SCENE_LAYOUT_CLUSTERED, 777);
+	settings.pointLightCount = 2000;
+	settings.spotLightCount = 1000;
+	settings.lightRange = 8.0f;
+	GeneratedScene scene;
+	SceneGenerator::Generate(settings, &scene);
+	const std::vector<Light>& lights = scene.data.lights;
+
+	unsigned int budget = MAX_LIGHTS * 3 / 4;
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, settings.worldHalfSize * 2.0f);
+
+	LightBudget serial, parallel;
+	unsigned int topMisses = 0, ranked = 0, disagreements = 0, overCapacity = 0;
+	for (int f = 0; f < 120; f++)
+	{
+		float angle = f * XM_2PI / 600.0f;
+		XMFLOAT3 position(sinf(angle) * settings.worldHalfSize, settings.maxHeight, -cosf(angle) * settings.worldHalfSize);
+		XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&position), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+
+		serial.Update(lights.data(), (unsigned int)lights.size(), viewProjection, position, budget, MAX_LIGHTS, 1.0f / 60.0f, false);
+		parallel.Update(lights.data(), (unsigned int)lights.size(), viewProjection, position, budget, MAX_LIGHTS, 1.0f / 60.0f, true);
+
+		const std::vector<unsigned int>& selected = parallel.GetSelected();
+		disagreements += selected != serial.GetSelected();
+		overCapacity += parallel.GetStats().drawn > MAX_LIGHTS;
+
+		// Brute force on the first frame: every score, sorted
+		if (f == 0)
+		{
+			Frustum frustum = Bounds::FrustumFromMatrix(viewProjection);
+			std::vector<std::pair<float, unsigned int>> scores;
+			for (unsigned int i = 0; i < lights.size(); i++)
+			{
+				float score = LightBudget::ScoreLight(lights[i], frustum, position);
+				if (score > 0.0f)
+					scores.push_back({ -score, i });
+			}
+			std::sort(scores.begin(), scores.end());
+			ranked = std::min(budget, (unsigned int)scores.size());
+			for (unsigned int k = 0; k < ranked; k++)
+				topMisses += !std::binary_search(selected.begin(), selected.end(), scores[k].second);
+		}
+	}
+	CHECK(ranked > 0);
+	CHECK(topMisses == 0);
+	CHECK(disagreements == 0);
+	CHECK(overCapacity == 0);
+}
+
+// --------------------------------------------------------
+// Compiles the game's frame (shadow, main, bloom extract, blur
+// and combine, then a final blur) plus a debug pass nothing
+// reads, without a device
+// - The debug pass is culled, and nothing else
+// - No two textures sharing memory are alive at once
+// - Lifetimes and aliasing are what this graph must give: the
+//    scene color lives from the main pass to the combine, and
+//    the combined bloom reuses the bloom extract's memory, so
+//    four targets fit in three textures
+// --------------------------------------------------------
+void TestFrameGraph()
+{
+	FrameGraphTextureDesc screenDesc = { 1280, 720, RENDER_FORMAT_RGBA8 };
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	FrameGraph graph;
+	FrameGraphResource backBuffer = graph.Import("Back Buffer", TextureHandle(), true);
+	FrameGraphResource shadowMap = graph.Import("Shadow Map", TextureHandle(), false, false);
+	FrameGraphResource sceneColor = graph.CreateTexture("Scene Color", screenDesc);
+	FrameGraphResource bloomExtract = graph.CreateTexture("Bloom Extract", screenDesc);
+	FrameGraphResource bloomBlur = graph.CreateTexture("Bloom Blur", screenDesc);
+	FrameGraphResource bloomCombined = graph.CreateTexture("Bloom Combined", screenDesc);
+	FrameGraphResource debugView = graph.CreateTexture("Debug View", screenDesc);
+
+	int pass = graph.AddPass("Shadow", nullptr);
+	graph.Write(pass, shadowMap);
+
+	pass = graph.AddPass("Main", nullptr);
+	graph.Read(pass, shadowMap);
+	graph.Write(pass, sceneColor, black);
+
+	pass = graph.AddPass("Bloom Extract", nullptr);
+	graph.Read(pass, sceneColor, 0);
+	graph.Write(pass, bloomExtract);
+
+	pass = graph.AddPass("Bloom Blur", nullptr);
+	graph.Read(pass, bloomExtract, 0);
+	graph.Write(pass, bloomBlur);
+
+	pass = graph.AddPass("Bloom Combine", nullptr);
+	graph.Read(pass, sceneColor, 0);
+	graph.Read(pass, bloomBlur, 1);
+	graph.Write(pass, bloomCombined);
+
+	pass = graph.AddPass("Blur", nullptr);
+	graph.Read(pass, bloomCombined, 0);
+	graph.Write(pass, backBuffer);
+
+	int debugPass = graph.AddPass("Debug View", nullptr);
+	graph.Read(debugPass, sceneColor, 0);
+	graph.Write(debugPass, debugView, black);
+
+	graph.Compile();
+	FrameGraphStats stats = graph.GetStats();
+
+	CHECK(graph.IsCulled(debugPass));
+	CHECK(stats.culledPasses == 1);
+
+	// Brute force: every pair of textures in the same memory
+	unsigned int overlaps = 0;
+	for (FrameGraphResource a = 0; a <= debugView; a++)
+	{
+		for (FrameGraphResource b = a + 1; b <= debugView; b++)
+		{
+			if (graph.GetPhysical(a) < 0 || graph.GetPhysical(a) != graph.GetPhysical(b))
+				continue;
+			overlaps += graph.GetFirstPass(a) <= graph.GetLastPass(b) && graph.GetFirstPass(b) <= graph.GetLastPass(a);
+		}
+	}
+	CHECK(overlaps == 0);
+
+	// Known answers for this graph (passes: 0 shadow, 1 main,
+	// 2 extract, 3 bloom blur, 4 combine, 5 blur, 6 debug)
+	CHECK(graph.GetFirstPass(sceneColor) == 1 && graph.GetLastPass(sceneColor) == 4);
+	CHECK(graph.GetFirstPass(bloomExtract) == 2 && graph.GetLastPass(bloomExtract) == 3);
+	CHECK(graph.GetFirstPass(bloomBlur) == 3 && graph.GetLastPass(bloomBlur) == 4);
+	CHECK(graph.GetFirstPass(bloomCombined) == 4 && graph.GetLastPass(bloomCombined) == 5);
+	CHECK(graph.GetFirstPass(debugView) == -1 && graph.GetLastPass(debugView) == -1);
+
+	CHECK(stats.physicalTextures == 3);
+	CHECK(graph.GetPhysical(bloomCombined) == graph.GetPhysical(bloomExtract));
+	CHECK(graph.GetPhysical(sceneColor) != graph.GetPhysical(bloomExtract));
+	CHECK(graph.GetPhysical(sceneColor) != graph.GetPhysical(bloomBlur));
+	CHECK(graph.GetPhysical(bloomBlur) != graph.GetPhysical(bloomExtract));
+	CHECK(graph.GetPhysical(debugView) == -1);
+}
+
+// --------------------------------------------------------
+// The null backend catches misuse, and a frame graph's bloom
+// chain run on it a few frames in a row is clean
+// - Every misuse below counts exactly one error (the backend
+//    prints them, so they show up in the output)
+// - Running the graph binds, clears and unbinds so that no
+//    pass reads a texture it also draws to (the shadow map is
+//    left for its pass to bind as depth), and the pool stays
+//    the same size from frame to frame
+// --------------------------------------------------------
+void TestNullBackend()
+{
+	NullBackend backend(1280, 720);
+	Graphics::Backend = &backend;
+	unsigned int expected = 0;
+
+	// Misuse
+	unsigned char data[64] = {};
+	RenderBufferDesc immutable = { RENDER_BUFFER_VERTEX, sizeof(data), 16, false };
+	CHECK(backend.CreateBuffer(immutable, nullptr).IsNull());
+	expected++;
+
+	BufferHandle vertices = backend.CreateBuffer(immutable, data);
+	CHECK(!vertices.IsNull());
+	CHECK(!backend.UpdateBuffer(vertices, data, sizeof(data)));
+	expected++;
+
+	backend.DestroyBuffer(vertices);
+	backend.SetVertexBuffer(vertices, 16, 0);
+	expected++;
+	backend.DestroyBuffer(vertices);
+	expected++;
+
+	TextureHandle colorDepth = backend.CreateTexture({ 64, 64, RENDER_FORMAT_RGBA8, RENDER_TEXTURE_DEPTH });
+	CHECK(colorDepth.IsNull());
+	expected++;
+
+	backend.SetVertexShader(ShaderHandle());
+	backend.Draw(3);
+	expected++;
+	CHECK(backend.GetStats().errors == expected);
+	CHECK(backend.GetLiveBuffers() == 0);
+
+	// A frame graph on top of it
+	ShaderHandle fullscreenVS = backend.LoadVertexShader(L"FullscreenVS.cso", RENDER_INPUT_NONE);
+	ShaderHandle ps = backend.LoadPixelShader(L"BloomPS.cso");
+	StateCache states(&backend);
+	auto drawFullscreen = [&]()
+	{
+		states.SetVertexShader(fullscreenVS);
+		states.SetPixelShader(ps);
+		states.Commit();
+		backend.Draw(3);
+	};
+
+	FrameGraphTextureDesc screenDesc = { 1280, 720, RENDER_FORMAT_RGBA8 };
+	const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	TextureHandle shadowDepth = backend.CreateTexture({ 1024, 1024, RENDER_FORMAT_DEPTH32, RENDER_TEXTURE_DEPTH | RENDER_TEXTURE_SHADER });
+	CHECK(!shadowDepth.IsNull());
+	auto drawShadow = [&]()
+	{
+		backend.ClearDepth(shadowDepth, 1.0f);
+		backend.SetRenderTargets(0, nullptr, shadowDepth);
+		backend.SetViewport(1024, 1024);
+		states.SetVertexShader(fullscreenVS);
+		states.SetPixelShader(ShaderHandle());
+		backend.Draw(3);
+		backend.SetViewport(1280, 720);
+	};
+
+	FrameGraph graph;
+	unsigned int poolTextures = 0;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		backend.ResetStats();
+		states.BeginFrame();
+		graph.Reset();
+
+		FrameGraphResource backBuffer = graph.Import("Back Buffer", backend.GetBackBuffer(), true);
+		FrameGraphResource shadowMap = graph.Import("Shadow Map", shadowDepth, false, false);
+		FrameGraphResource sceneColor = graph.CreateTexture("Scene Color", screenDesc);
+		FrameGraphResource bloomExtract = graph.CreateTexture("Bloom Extract", screenDesc);
+		FrameGraphResource bloomBlur = graph.CreateTexture("Bloom Blur", screenDesc);
+
+		int pass = graph.AddPass("Shadow", drawShadow);
+		graph.Write(pass, shadowMap);
+
+		pass = graph.AddPass("Main", drawFullscreen);
+		graph.Read(pass, shadowMap, 4);
+		graph.Write(pass, sceneColor, black);
+		graph.SetDepth(pass, backend.GetDepthBuffer());
+
+		pass = graph.AddPass("Bloom Extract", drawFullscreen);
+		graph.Read(pass, sceneColor, 0);
+		graph.Write(pass, bloomExtract);
+
+		pass = graph.AddPass("Bloom Blur", drawFullscreen);
+		graph.Read(pass, bloomExtract, 0);
+		graph.Write(pass, bloomBlur);
+
+		pass = graph.AddPass("Combine", drawFullscreen);
+		graph.Read(pass, sceneColor, 0);
+		graph.Read(pass, bloomBlur, 1);
+		graph.Write(pass, backBuffer);
+
+		CHECK(graph.Execute(states));
+		CHECK(backend.GetStats().errors == 0);
+		CHECK(backend.GetStats().draws == 5);
+
+		if (frame == 0)
+			poolTextures = backend.GetLiveTextures();
+		CHECK(backend.GetLiveTextures() == poolTextures);
+	}
+
+	Graphics::Backend = nullptr;
+}
+
+int main()
+{
+	int failed = 0;
+	failed += !Run("Temporal culling", TestTemporalCulling);
+	failed += !Run("State cache", TestStateCache);
+	failed += !Run("Light clusters", TestLightClusters);
+	failed += !Run("Object lights", TestObjectLights);
+	failed += !Run("Light budget", TestLightBudget);
+	failed += !Run("Frame graph", TestFrameGraph);
+	failed += !Run("Null backend", TestNullBackend);
+
+	printf("%d checks, %d failed\n", checksRun, checksFailed);
+	return failed;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <chrono>
+
+// Clock used for every CPU timing (stats, benchmarks, frame timings)
+typedef std::chrono::high_resolution_clock Clock;
+
+// Milliseconds since the given start time
+inline double ElapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
@@ -11,10 +11,15 @@ Transform::Transform() :
 	right(1, 0, 0),
 	up(0, 1, 0),
 	matrixDirty(true),
-	vectorDirty(true)
+	vectorDirty(true),
+	version(0)
 {
 	XMStoreFloat4x4(&world, XMMatrixIdentity());
 	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
+	XMStoreFloat4x4(&renderWorld, XMMatrixIdentity());
+	XMStoreFloat4x4(&renderWorldInverseTranspose, XMMatrixIdentity());
+
+	StorePreviousState();
 }
 
 void Transform::SetPosition(float x, float y, float z)
@@ -27,6 +32,7 @@ void Transform::SetPosition(DirectX::XMFLOAT3 position)
 	// Load the position into an XMVECTOR and store it back in the XMFLOAT3
 	XMStoreFloat3(&this->position, XMLoadFloat3(&position));
 	matrixDirty = true;
+	version++;
 }
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
@@ -39,6 +45,7 @@ void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 	// Load the rotation into an XMVECTOR and store it back in the XMFLOAT3
 	XMStoreFloat3(&this->pitchYawRoll, XMLoadFloat3(&rotation));
 	matrixDirty = true;
+	version++;
 	vectorDirty = true;
 }
 
@@ -52,6 +59,7 @@ void Transform::SetScale(DirectX::XMFLOAT3 scale)
 	// Load the scale into an XMVECTOR and store it back in the XMFLOAT3
 	XMStoreFloat3(&this->scale, XMLoadFloat3(&scale));
 	matrixDirty = true;
+	version++;
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
@@ -99,6 +107,21 @@ DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 	return worldInverseTranspose;
 }
 
+DirectX::XMFLOAT4X4 Transform::GetRenderWorldMatrix()
+{
+	return renderWorld;
+}
+
+DirectX::XMFLOAT4X4 Transform::GetRenderWorldInverseTransposeMatrix()
+{
+	return renderWorldInverseTranspose;
+}
+
+unsigned int Transform::GetVersion()
+{
+	return version;
+}
+
 void Transform::MoveAbsolute(float x, float y, float z)
 {
 	MoveAbsolute(XMFLOAT3(x, y, z));
@@ -118,6 +141,7 @@ void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 	);
 
 	matrixDirty = true;
+	version++;
 }
 
 void Transform::MoveRelative(float x, float y, float z)
@@ -142,6 +166,9 @@ void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 			rotatedOffset
 		)
 	);
+
+	matrixDirty = true;
+	version++;
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll)
@@ -163,6 +190,7 @@ void Transform::Rotate(DirectX::XMFLOAT3 rotation)
 	);
 
 	matrixDirty = true;
+	version++;
 	vectorDirty = true;
 
 }
@@ -186,6 +214,35 @@ void Transform::Scale(DirectX::XMFLOAT3 scale)
 	);
 
 	matrixDirty = true;
+	version++;
+}
+
+void Transform::StorePreviousState()
+{
+	prevPosition = position;
+	prevPitchYawRoll = pitchYawRoll;
+	prevScale = scale;
+}
+
+void Transform::Interpolate(float alpha)
+{
+	// Blend position and scale linearly
+	XMVECTOR p = XMVectorLerp(XMLoadFloat3(&prevPosition), XMLoadFloat3(&position), alpha);
+	XMVECTOR s = XMVectorLerp(XMLoadFloat3(&prevScale), XMLoadFloat3(&scale), alpha);
+
+	// Blend rotations as quaternions so we always take the shortest path
+	XMVECTOR q = XMQuaternionSlerp(
+		XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&prevPitchYawRoll)),
+		XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll)),
+		alpha);
+
+	// Build the render-side world matrix the same way as CalculateWorldMatrix()
+	XMMATRIX w = XMMatrixMultiply(
+		XMMatrixMultiply(XMMatrixScalingFromVector(s), XMMatrixRotationQuaternion(q)),
+		XMMatrixTranslationFromVector(p));
+
+	XMStoreFloat4x4(&renderWorld, w);
+	XMStoreFloat4x4(&renderWorldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(w)));
 }
 
 void Transform::CalculateWorldMatrix()
@@ -16,9 +16,22 @@ private:
 	DirectX::XMFLOAT4X4 world;
 	DirectX::XMFLOAT4X4 worldInverseTranspose;
 
+	// State as of the previous fixed simulation step
+	DirectX::XMFLOAT3 prevPosition;
+	DirectX::XMFLOAT3 prevPitchYawRoll;
+	DirectX::XMFLOAT3 prevScale;
+
+	// Matrices blended between the previous and current state for rendering
+	DirectX::XMFLOAT4X4 renderWorld;
+	DirectX::XMFLOAT4X4 renderWorldInverseTranspose;
+
 	bool matrixDirty;
 	bool vectorDirty;
 
+	// Bumped on every change, so other systems (like spatial
+	// indices) can tell when this transform has moved
+	unsigned int version;
+
 public:
 	Transform();
 
@@ -42,6 +55,12 @@ public:
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
+	// Interpolated matrices (see Interpolate())
+	DirectX::XMFLOAT4X4 GetRenderWorldMatrix();
+	DirectX::XMFLOAT4X4 GetRenderWorldInverseTransposeMatrix();
+
+	unsigned int GetVersion();
+
 	// Transformers
 	void MoveAbsolute(float x = 0.0f, float y = 0.0f, float z = 0.0f);
 	void MoveAbsolute(DirectX::XMFLOAT3 offset);
@@ -52,6 +71,10 @@ public:
 	void Scale(float x = 1.0f, float y = 1.0f, float z = 1.0f);
 	void Scale(DirectX::XMFLOAT3 scale);
 
+	// Fixed timestep helpers
+	void StorePreviousState();		// Call before each simulation step
+	void Interpolate(float alpha);	// Blend previous -> current for rendering
+
 private: 
 	// Calulation helper methods
 	void CalculateWorldMatrix();
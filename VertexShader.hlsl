@@ -1,9 +1,16 @@
 #include "StructsIncludes.hlsli"
 
+// Per object
 cbuffer ExternalData : register(b0) 
 {
     matrix world;
     matrix worldInvTranspose;
+    uint objectIndex;
+}
+
+// Per frame
+cbuffer FrameData : register(b1)
+{
     matrix view;
     matrix projection;
     matrix lightView;
@@ -51,6 +58,9 @@ VertexToPixel main( VertexShaderInput input )
 	// Calculate the position in the shadow map (similar to screen position)
     matrix shadowWVP = mul(lightProjection, mul(lightView, world));
     output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
+	
+	// Which light list the pixel shader reads
+    output.objectIndex = objectIndex;
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
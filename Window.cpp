@@ -158,6 +158,18 @@ HRESULT Window::Create(
 }
 
 
+// --------------------------------------------------------
+// Stands in for a window when running without one: the
+// size is all anything asks of it (Handle() stays null)
+// --------------------------------------------------------
+void Window::CreateHeadless(unsigned int width, unsigned int height)
+{
+	windowWidth = width;
+	windowHeight = height;
+	hasFocus = true;
+	windowCreated = true;
+}
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -21,6 +21,7 @@ namespace Window
 		std::wstring titleBarText,
 		bool statsInTitleBar,
 		void (*resizeCallback)());
+	void CreateHeadless(unsigned int width, unsigned int height);	// Size only, no OS window
 	void UpdateStats(float totalTime);
 	void Quit();
 
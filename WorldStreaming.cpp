@@ -0,0 +1,464 @@
+#include "WorldStreaming.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+using namespace DirectX;
+
+WorldStreamer::WorldStreamer() :
+	cellSize(0),
+	stopping(false),
+	lastPosition(0, 0, 0),
+	travelDirection(0, 0, 0),
+	hasLastPosition(false),
+	residentBytes(0),
+	peakResidentBytes(0),
+	residentEntities(0),
+	cellsLoaded(0),
+	cellsUnloaded(0),
+	lastUpdateMs(0)
+{
+	settings.loadRadius = 120.0f;
+	settings.unloadRadius = 160.0f;
+	settings.travelWeight = 1.0f;
+	settings.budgetMs = 2.0f;
+}
+
+WorldStreamer::~WorldStreamer()
+{
+	// Entities left in a world are that world's problem now
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& loader : loaders)
+		loader.join();
+}
+
+std::string WorldStreamer::GetCellPath(int x, int z)
+{
+	return directory + "/cell_" + std::to_string(x) + "_" + std::to_string(z) + ".scene";
+}
+
+bool WorldStreamer::WriteCells(const SceneData& scene, float cellSize, const std::string& directory)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	// Bucket the entities by the cell under their position
+	std::map<std::pair<int, int>, SceneData> buckets;
+	for (auto& entity : scene.entities)
+	{
+		int x = (int)std::floor(entity.position.x / cellSize);
+		int z = (int)std::floor(entity.position.z / cellSize);
+		SceneData& cell = buckets[{ x, z }];
+		if (cell.entities.empty())
+		{
+			// Every cell carries the full reference tables so
+			// the indices in the records stay the same
+			cell.meshNames = scene.meshNames;
+			cell.meshPaths = scene.meshPaths;
+			cell.materialNames = scene.materialNames;
+		}
+		cell.entities.push_back(entity);
+	}
+
+	std::ofstream index(directory + "/cells.txt");
+	if (!index.is_open())
+		return false;
+
+	index << "cellsize " << cellSize << "\n";
+	for (auto& bucket : buckets)
+	{
+		int x = bucket.first.first;
+		int z = bucket.first.second;
+		std::string path = directory + "/cell_" + std::to_string(x) + "_" + std::to_string(z) + ".scene";
+		if (!SceneFile::Write(bucket.second, path))
+			return false;
+		index << "cell " << x << " " << z << " " << bucket.second.entities.size() << "\n";
+	}
+	return true;
+}
+
+bool WorldStreamer::Open(const std::string& directory, MeshResolver resolveMesh, MaterialResolver resolveMaterial)
+{
+	// Only one world at a time - the previous one has to be closed first
+	if (IsOpen())
+		return false;
+
+	std::ifstream index(directory + "/cells.txt");
+	if (!index.is_open())
+		return false;
+
+	std::vector<std::unique_ptr<StreamCell>> newCells;
+	float newCellSize = 0.0f;
+	std::string type;
+	while (index >> type)
+	{
+		if (type == "cellsize")
+			index >> newCellSize;
+		else if (type == "cell")
+		{
+			auto cell = std::make_unique<StreamCell>();
+			index >> cell->x >> cell->z >> cell->entityCount;
+			cell->state = STREAM_CELL_UNLOADED;
+			cell->priority = 0.0f;
+			cell->cancelled = false;
+			cell->residentBytes = 0;
+			newCells.push_back(std::move(cell));
+		}
+	}
+	if (newCellSize <= 0.0f)
+		return false;
+
+	this->directory = directory;
+	this->resolveMesh = resolveMesh;
+	this->resolveMaterial = resolveMaterial;
+	cells = std::move(newCells);
+	cellSize = newCellSize;
+	hasLastPosition = false;
+	residentBytes = 0;
+	peakResidentBytes = 0;
+	residentEntities = 0;
+	cellsLoaded = 0;
+	cellsUnloaded = 0;
+
+	stopping = false;
+	for (int i = 0; i < STREAM_LOADER_THREADS; i++)
+		loaders.push_back(std::thread(&WorldStreamer::LoaderThread, this));
+	return true;
+}
+
+void WorldStreamer::Close(World& world)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	wake.notify_all();
+	for (auto& loader : loaders)
+		loader.join();
+	loaders.clear();
+
+	// No loader is running anymore, so every cell is ours
+	completed.clear();
+	finalizing.clear();
+	for (auto& cell : cells)
+		UnloadCell(world, cell.get());
+	cells.clear();
+	cellSize = 0;
+}
+
+bool WorldStreamer::IsOpen()
+{
+	return !loaders.empty();
+}
+
+void WorldStreamer::LoaderThread()
+{
+	while (true)
+	{
+		StreamCell* cell = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+
+			// Closest (most wanted) cell first - priorities change
+			// every frame, so there's no point keeping this sorted
+			auto best = std::min_element(queue.begin(), queue.end(),
+				[](StreamCell* a, StreamCell* b) { return a->priority < b->priority; });
+			cell = *best;
+			*best = queue.back();
+			queue.pop_back();
+			cell->state = STREAM_CELL_LOADING;
+		}
+
+		LoadCell(cell);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		cell->state = STREAM_CELL_LOADED;
+		completed.push_back(cell);
+	}
+}
+
+void WorldStreamer::LoadCell(StreamCell* cell)
+{
+	// Copy out of the mapped file so it can be closed right away
+	SceneFile file;
+	if (!file.Open(GetCellPath(cell->x, cell->z)))
+		return;
+
+	const SceneEntityRecord* records = file.GetEntities();
+	cell->records.assign(records, records + file.GetEntityCount());
+	for (unsigned int i = 0; i < file.GetMeshCount(); i++)
+	{
+		cell->meshNames.push_back(file.GetMeshName(i));
+		cell->meshPaths.push_back(file.GetMeshPath(i));
+	}
+	for (unsigned int i = 0; i < file.GetMaterialCount(); i++)
+		cell->materialNames.push_back(file.GetMaterialName(i));
+}
+
+bool WorldStreamer::FinalizeSlice(World& world, StreamCell* cell)
+{
+	// References are resolved once, with the first slice
+	if (cell->entities.empty())
+	{
+		cell->meshes.clear();
+		cell->materials.clear();
+		for (size_t i = 0; i < cell->meshNames.size(); i++)
+			cell->meshes.push_back(resolveMesh(cell->meshNames[i], cell->meshPaths[i]));
+		for (auto& name : cell->materialNames)
+			cell->materials.push_back(resolveMaterial(name));
+		cell->entities.reserve(cell->records.size());
+	}
+
+	const ComponentMask mask = ComponentsOf<LocalTransform, WorldMatrix, MeshRenderer>();
+	size_t first = cell->entities.size();
+	size_t last = std::min(first + STREAM_SLICE_ENTITIES, cell->records.size());
+	for (size_t i = first; i < last; i++)
+	{
+		const SceneEntityRecord& record = cell->records[i];
+		Entity e = world.CreateEntity(mask);
+
+		LocalTransform* t = world.GetComponent<LocalTransform>(e);
+		t->position = record.position;
+		t->pitchYawRoll = record.pitchYawRoll;
+		t->scale = record.scale;
+
+		MeshRenderer* r = world.GetComponent<MeshRenderer>(e);
+		r->mesh = record.mesh < cell->meshes.size() ? cell->meshes[record.mesh] : MeshHandle();
+		r->material = record.material < cell->materials.size() ? cell->materials[record.material] : MaterialHandle();
+
+		cell->entities.push_back(e);
+	}
+
+	size_t bytesPerEntity = sizeof(LocalTransform) + sizeof(WorldMatrix) + sizeof(MeshRenderer) + sizeof(Entity);
+	residentEntities += (unsigned int)(last - first);
+	residentBytes += (last - first) * bytesPerEntity;
+	cell->residentBytes += (last - first) * bytesPerEntity;
+
+	if (last < cell->records.size())
+		return false;
+
+	// All in - the staging copy isn't needed anymore
+	residentBytes -= cell->records.capacity() * sizeof(SceneEntityRecord);
+	cell->residentBytes -= cell->records.capacity() * sizeof(SceneEntityRecord);
+	cell->records = std::vector<SceneEntityRecord>();
+	cell->state = STREAM_CELL_RESIDENT;
+	cellsLoaded++;
+	return true;
+}
+
+void WorldStreamer::UnloadCell(World& world, StreamCell* cell)
+{
+	for (Entity e : cell->entities)
+		world.DestroyEntity(e);
+	if (!cell->entities.empty() || cell->state == STREAM_CELL_RESIDENT)
+		cellsUnloaded++;
+
+	residentEntities -= (unsigned int)cell->entities.size();
+	residentBytes -= cell->residentBytes;
+
+	cell->entities = std::vector<Entity>();
+	cell->records = std::vector<SceneEntityRecord>();
+	cell->meshNames.clear();
+	cell->meshPaths.clear();
+	cell->materialNames.clear();
+	cell->residentBytes = 0;
+	cell->cancelled = false;
+	cell->state = STREAM_CELL_UNLOADED;
+}
+
+float WorldStreamer::DistanceToCell(const StreamCell& cell, XMFLOAT3 position)
+{
+	// Distance on the XZ plane to the closest point of the cell's square
+	float minX = cell.x * cellSize;
+	float minZ = cell.z * cellSize;
+	float dx = std::max(std::max(minX - position.x, position.x - (minX + cellSize)), 0.0f);
+	float dz = std::max(std::max(minZ - position.z, position.z - (minZ + cellSize)), 0.0f);
+	return std::sqrt(dx * dx + dz * dz);
+}
+
+void WorldStreamer::Update(World& world, XMFLOAT3 position, float deltaTime)
+{
+	Clock::time_point start = Clock::now();
+
+	// Direction of travel (smoothed, so a single jittery frame doesn't reorder everything)
+	if (hasLastPosition && deltaTime > 0.0f)
+	{
+		XMVECTOR moved = XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&lastPosition));
+		moved = XMVectorSetY(moved, 0.0f);
+		XMVECTOR direction = XMVectorLerp(XMLoadFloat3(&travelDirection), XMVector3Normalize(moved), std::min(deltaTime * 4.0f, 1.0f));
+		XMStoreFloat3(&travelDirection, direction);
+	}
+	lastPosition = position;
+	hasLastPosition = true;
+
+	std::vector<StreamCell*> toUnload;
+	bool queued;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (auto& c : cells)
+		{
+			StreamCell* cell = c.get();
+			float distance = DistanceToCell(*cell, position);
+
+			// Favor cells ahead: up to travelWeight cells closer (or farther, behind)
+			float centerX = (cell->x + 0.5f) * cellSize - position.x;
+			float centerZ = (cell->z + 0.5f) * cellSize - position.z;
+			float length = std::sqrt(centerX * centerX + centerZ * centerZ);
+			float ahead = length > 0.0f ? (centerX * travelDirection.x + centerZ * travelDirection.z) / length : 0.0f;
+			cell->priority = distance - ahead * settings.travelWeight * cellSize;
+
+			if (distance <= settings.loadRadius)
+			{
+				if (cell->state == STREAM_CELL_UNLOADED)
+				{
+					cell->state = STREAM_CELL_QUEUED;
+					queue.push_back(cell);
+				}
+				cell->cancelled = false;
+			}
+			else if (distance > settings.unloadRadius)
+			{
+				if (cell->state == STREAM_CELL_QUEUED)
+				{
+					queue.erase(std::find(queue.begin(), queue.end(), cell));
+					cell->state = STREAM_CELL_UNLOADED;
+				}
+				else if (cell->state == STREAM_CELL_LOADING)
+					cell->cancelled = true;
+				else if (cell->state == STREAM_CELL_LOADED || cell->state == STREAM_CELL_RESIDENT)
+					toUnload.push_back(cell);
+			}
+		}
+
+		// Pick up whatever the loaders finished
+		for (StreamCell* cell : completed)
+		{
+			size_t staged = cell->records.capacity() * sizeof(SceneEntityRecord);
+			residentBytes += staged;
+			cell->residentBytes += staged;
+
+			if (cell->cancelled)
+				toUnload.push_back(cell);
+			else
+				finalizing.push_back(cell);
+		}
+		completed.clear();
+		queued = !queue.empty();
+	}
+	if (queued)
+		wake.notify_all();
+
+	// Drop what's out of range (cheap compared to creating entities)
+	for (StreamCell* cell : toUnload)
+	{
+		auto pending = std::find(finalizing.begin(), finalizing.end(), cell);
+		if (pending != finalizing.end())
+			finalizing.erase(pending);
+		UnloadCell(world, cell);
+	}
+	peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+
+	// Create entities for loaded cells, most wanted first, until the budget runs out
+	std::sort(finalizing.begin(), finalizing.end(),
+		[](StreamCell* a, StreamCell* b) { return a->priority < b->priority; });
+	while (!finalizing.empty() && ElapsedMs(start) < settings.budgetMs)
+	{
+		if (FinalizeSlice(world, finalizing.front()))
+			finalizing.erase(finalizing.begin());
+	}
+	peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+
+	lastUpdateMs = ElapsedMs(start);
+}
+
+unsigned int WorldStreamer::GetCellCount()
+{
+	return (unsigned int)cells.size();
+}
+
+unsigned int WorldStreamer::GetCellCount(int state)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int count = 0;
+	for (auto& cell : cells)
+		if (cell->state == state)
+			count++;
+	return count;
+}
+
+unsigned int WorldStreamer::GetResidentEntities()
+{
+	return residentEntities;
+}
+
+size_t WorldStreamer::GetResidentBytes()
+{
+	return residentBytes;
+}
+
+size_t WorldStreamer::GetPeakResidentBytes()
+{
+	return peakResidentBytes;
+}
+
+unsigned int WorldStreamer::GetCellsLoaded()
+{
+	return cellsLoaded;
+}
+
+unsigned int WorldStreamer::GetCellsUnloaded()
+{
+	return cellsUnloaded;
+}
+
+double WorldStreamer::GetLastUpdateMs()
+{
+	return lastUpdateMs;
+}
+
+float WorldStreamer::GetCellSize()
+{
+	return cellSize;
+}
+
+StreamSettings WorldStreamer::GetSettings()
+{
+	return settings;
+}
+
+bool WorldStreamer::IsResident(XMFLOAT3 position)
+{
+	int x = (int)std::floor(position.x / cellSize);
+	int z = (int)std::floor(position.z / cellSize);
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& cell : cells)
+	{
+		if (cell->x == x && cell->z == z)
+			return cell->state == STREAM_CELL_RESIDENT;
+	}
+
+	// No cell there means nothing to load
+	return true;
+}
+
+void WorldStreamer::SetSettings(const StreamSettings& settings)
+{
+	this->settings = settings;
+
+	// Hysteresis only works if cells have to move farther away to unload
+	if (this->settings.unloadRadius < this->settings.loadRadius)
+		this->settings.unloadRadius = this->settings.loadRadius;
+}
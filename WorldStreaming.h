@@ -0,0 +1,146 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ECS.h"
+#include "SceneFile.h"
+
+// Cell states
+#define STREAM_CELL_UNLOADED 0
+#define STREAM_CELL_QUEUED 1		// Waiting for a loader thread
+#define STREAM_CELL_LOADING 2		// A loader thread is reading it
+#define STREAM_CELL_LOADED 3		// Read, waiting to be finalized on the main thread
+#define STREAM_CELL_RESIDENT 4		// Entities exist in the world
+
+#define STREAM_SLICE_ENTITIES 256	// Entities created between budget checks
+#define STREAM_LOADER_THREADS 2
+
+// One square of the world on the XZ plane, stored in its own file
+struct StreamCell
+{
+	int x;
+	int z;
+	unsigned int entityCount;
+	int state;
+	float priority;					// Lower loads sooner
+	bool cancelled;					// Left the unload radius while loading
+
+	// Read by a loader thread
+	std::vector<SceneEntityRecord> records;
+	std::vector<std::string> meshNames;
+	std::vector<std::string> meshPaths;
+	std::vector<std::string> materialNames;
+
+	// Made on the main thread
+	std::vector<MeshHandle> meshes;
+	std::vector<MaterialHandle> materials;
+	std::vector<Entity> entities;
+	size_t residentBytes;
+};
+
+// Streaming distances and budget
+struct StreamSettings
+{
+	float loadRadius;
+	float unloadRadius;		// Bigger than loadRadius, for hysteresis
+	float travelWeight;		// How strongly cells ahead are favored, in cell sizes
+	float budgetMs;			// Main thread finalization time per frame
+};
+
+// Resolve a cell's references to loaded assets (called on the main thread)
+typedef std::function<MeshHandle(const std::string& name, const std::string& path)> MeshResolver;
+typedef std::function<MaterialHandle(const std::string& name)> MaterialResolver;
+
+// --------------------------------------------------------
+// Streams grid cells of entities in and out of a World
+// around a moving point (the active camera)
+//
+// - Cells are binary scene files, one per cell, plus a small
+//    text index (see WriteCells())
+// - Cells inside the load radius are queued; loader threads
+//    read them in order of distance, preferring cells in the
+//    direction of travel
+// - Cells are only dropped once they're past the (larger)
+//    unload radius, so hovering on a border doesn't thrash
+// - Creating entities happens on the main thread, in slices,
+//    within a per-frame time budget
+// --------------------------------------------------------
+class WorldStreamer
+{
+private:
+	std::vector<std::unique_ptr<StreamCell>> cells;
+	std::string directory;
+	float cellSize;
+
+	StreamSettings settings;
+	MeshResolver resolveMesh;
+	MaterialResolver resolveMaterial;
+
+	// Shared with the loader threads
+	std::vector<std::thread> loaders;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<StreamCell*> queue;
+	std::vector<StreamCell*> completed;
+	bool stopping;
+
+	// Main thread only
+	std::vector<StreamCell*> finalizing;
+	DirectX::XMFLOAT3 lastPosition;
+	DirectX::XMFLOAT3 travelDirection;
+	bool hasLastPosition;
+
+	// Stats
+	size_t residentBytes;
+	size_t peakResidentBytes;
+	unsigned int residentEntities;
+	unsigned int cellsLoaded;
+	unsigned int cellsUnloaded;
+	double lastUpdateMs;
+
+	void LoaderThread();
+	void LoadCell(StreamCell* cell);
+	void UnloadCell(World& world, StreamCell* cell);
+	bool FinalizeSlice(World& world, StreamCell* cell);
+	float DistanceToCell(const StreamCell& cell, DirectX::XMFLOAT3 position);
+	std::string GetCellPath(int x, int z);
+
+public:
+	WorldStreamer();
+	~WorldStreamer();
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+	// Splits a scene's entities into cells and writes them (plus the index) to a directory
+	static bool WriteCells(const SceneData& scene, float cellSize, const std::string& directory);
+
+	bool Open(const std::string& directory, MeshResolver resolveMesh, MaterialResolver resolveMaterial);
+	void Close(World& world);
+	bool IsOpen();
+
+	// Call once per frame with the point to stream around
+	void Update(World& world, DirectX::XMFLOAT3 position, float deltaTime);
+
+	// Getters
+	unsigned int GetCellCount();
+	unsigned int GetCellCount(int state);
+	unsigned int GetResidentEntities();
+	size_t GetResidentBytes();
+	size_t GetPeakResidentBytes();
+	unsigned int GetCellsLoaded();
+	unsigned int GetCellsUnloaded();
+	double GetLastUpdateMs();
+	float GetCellSize();
+	StreamSettings GetSettings();
+	bool IsResident(DirectX::XMFLOAT3 position);		// Is the cell under this point in the world?
+
+	// Setters
+	void SetSettings(const StreamSettings& settings);
+};